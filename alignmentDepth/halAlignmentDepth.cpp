@@ -49,6 +49,22 @@ static void printGenome(ostream &outStream, const Genome *genome, const Sequence
 
 static const hal_size_t StringBufferSize = 1024;
 
+/** Count the distinct genomes among the rows of a column (or block), using
+ * stamps indexed by genome index that are set to the column's number */
+template <class RowIt>
+static hal_size_t countGenomes(RowIt begin, RowIt end, size_t numGenomes, vector<hal_size_t> &genomeStamps,
+                               hal_size_t columnNumber) {
+    genomeStamps.resize(numGenomes, 0);
+    hal_size_t count = 0;
+    for (RowIt row = begin; row != end; ++row) {
+        if (genomeStamps[row->_genomeIndex] != columnNumber) {
+            genomeStamps[row->_genomeIndex] = columnNumber;
+            ++count;
+        }
+    }
+    return count;
+}
+
 static void initParser(CLParser &optionsParser) {
     /** It is convenient to use the HAL command line parser for the command
      * line because it automatically adds some comman options.  Using the
@@ -251,28 +267,41 @@ void printSequence(ostream &outStream, const Sequence *sequence, const set<const
     // convert to genome coordinates
     pos += sequence->getStartPosition();
     last += sequence->getStartPosition();
-    // keep track of unique genomes
-    set<const Genome *> genomeSet;
-    while (pos <= last) {
-        genomeSet.clear();
-        hal_size_t count = 0;
-        /** ColumnIterator::ColumnMap maps a Sequence to a list of bases
-         * the bases in the map form the alignment column.  Some sequences
-         * in the map can have no bases (for efficiency reasons) */
-        const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-
-        /** For every sequence in the map */
-        for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin(); i != cmap->end(); ++i) {
-            if (countDupes == true) {
-                // countDupes enabled: we just count everything
-                count += i->second->size();
-            } else if (!i->second->empty()) {
-                // just counting unique genomes: add it if there's at least one base
-                genomeSet.insert(i->first->getGenome());
+    /** Rather than walking the ColumnMap, we read the bases of each
+     * column as rows tagged with a small genome index.  Unique genomes are
+     * then counted by stamping the genome indexes with the column number,
+     * without building a set per column. */
+    vector<hal_size_t> genomeStamps;
+    hal_size_t columnNumber = 0;
+    if (step == 1) {
+        /** Columns with the same rows have the same depth, so we let a
+         * BlockColumnIterator group the columns into gapless blocks and
+         * only count once per block.  It also takes care of calling
+         * defragment() on the column iterator now and again. */
+        BlockColumnIterator blockIt(colIt);
+        while (blockIt.toNextBlock()) {
+            const vector<BlockColumnIterator::BlockRow> &rows = blockIt.getRows();
+            hal_size_t count = rows.size();
+            if (countDupes == false) {
+                count = countGenomes(rows.begin(), rows.end(), blockIt.getColumnGenomes().size(), genomeStamps,
+                                     ++columnNumber);
+            }
+            // don't want to include reference base in output
+            --count;
+
+            for (hal_size_t i = 0; i < blockIt.getLength(); ++i) {
+                outStream << count << '\n';
             }
         }
+        return;
+    }
+
+    vector<ColumnIterator::ColumnRow> rows;
+    while (pos <= last) {
+        colIt->getColumnRows(rows);
+        hal_size_t count = rows.size();
         if (countDupes == false) {
-            count = genomeSet.size();
+            count = countGenomes(rows.begin(), rows.end(), colIt->getColumnGenomes().size(), genomeStamps, ++columnNumber);
         }
         // don't want to include reference base in output
         --count;
@@ -288,19 +317,7 @@ void printSequence(ostream &outStream, const Sequence *sequence, const set<const
         }
 
         pos += step;
-        if (step == 1) {
-            /** Move the iterator one position to the right */
-            colIt->toRight();
-
-            /** This is some tuning code that will probably be hidden from
-             * the interface at some point.  It is a good idea to use for now
-             * though */
-            // erase empty entries from the column.  helps when there are
-            // millions of sequences (ie from fastas with lots of scaffolds)
-            if (pos % 1000 == 0) {
-                colIt->defragment();
-            }
-        } else {
+        if (pos <= last) {
             /** Reset the iterator to a non-contiguous position */
             colIt->toSite(pos, last);
         }
@@ -9,6 +9,7 @@
 #include "halCLParser.h"
 #include "halCommon.h"
 #include "halSequenceIterator.h"
+#include "hdf5BlockCacheDriver.h"
 #include "hdf5Common.h"
 #include "hdf5Genome.h"
 #include "hdf5MetaData.h"
@@ -45,6 +46,8 @@ const hsize_t Hdf5Alignment::DefaultCacheRDCElems = 599999;
 const hsize_t Hdf5Alignment::DefaultCacheRDCBytes = 15728640;
 const double Hdf5Alignment::DefaultCacheW0 = 0.75;
 const bool Hdf5Alignment::DefaultInMemory = false;
+const hsize_t Hdf5Alignment::DefaultReadAhead = 16;
+const hsize_t Hdf5Alignment::DefaultWindowBytes = Hdf5ExternalArray::DefaultWindowBytes;
 
 /* check if first bit of file has HDF5 header */
 bool hal::Hdf5Alignment::isHdf5File(const std::string &initialBytes) {
@@ -67,7 +70,8 @@ Hdf5Alignment::Hdf5Alignment(const string &alignmentPath, unsigned mode, const H
                              const H5::FileAccPropList &fileAccessProps, const H5::DSetCreatPropList &datasetCreateProps,
                              bool inMemory)
     : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _file(NULL), _flags(hdf5DefaultFlags(_mode)),
-      _inMemory(inMemory), _metaData(NULL), _tree(NULL), _dirty(false) {
+      _inMemory(inMemory), _readAhead(DefaultReadAhead), _windowBytes(DefaultWindowBytes), _metaData(NULL), _tree(NULL), _dirty(false),
+      _printMemoryStats(false) {
     _cprops.copy(fileCreateProps);
     _aprops.copy(fileAccessProps);
     _dcprops.copy(datasetCreateProps);
@@ -83,7 +87,8 @@ Hdf5Alignment::Hdf5Alignment(const string &alignmentPath, unsigned mode, const H
 
 Hdf5Alignment::Hdf5Alignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser)
     : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _file(NULL), _flags(hdf5DefaultFlags(_mode)),
-      _inMemory(false), _metaData(NULL), _tree(NULL), _dirty(false) {
+      _inMemory(false), _readAhead(DefaultReadAhead), _windowBytes(DefaultWindowBytes), _metaData(NULL), _tree(NULL), _dirty(false),
+      _printMemoryStats(false) {
     initializeFromOptions(parser);
     if (_inMemory) {
         setInMemory();
@@ -123,6 +128,14 @@ void Hdf5Alignment::defineOptions(CLParser *parser, unsigned mode) {
 
     parser->addOptionFlag("hdf5InMemory", "load all data in memory (and disable hdf5 cache)", DefaultInMemory);
     parser->addOptionFlag("inMemory", "obsolete name for --hdf5InMemory", DefaultInMemory);
+
+    parser->addOption("hdf5ReadAhead", "number of chunks of each array to read and decompress on background threads"
+                                       " ahead of sequential access [0: disable]",
+                      DefaultReadAhead);
+
+    parser->addOption("hdf5WindowBytes", "size in bytes of the buffer each array pages into memory when its"
+                                         " dataset isn't chunked",
+                      DefaultWindowBytes);
 }
 
 /* initialize class from options */
@@ -131,6 +144,11 @@ void Hdf5Alignment::initializeFromOptions(const CLParser *parser) {
     _dcprops.copy(H5::DSetCreatPropList::DEFAULT);
     _aprops.copy(H5::FileAccPropList::DEFAULT);
     _inMemory = parser->getFlagAlt("hdf5InMemory", "inMemory");
+    _readAhead = parser->getOption<hsize_t>("hdf5ReadAhead");
+    _windowBytes = parser->getOption<hsize_t>("hdf5WindowBytes");
+    _blockCacheConfig = LocalBlockCacheConfig::fromOptions(parser);
+    _printMemoryStats = parser->getFlag("genomeMemoryStats");
+    _memoryBudget.setBudget(parser->getOption<hal_size_t>("genomeMemoryBudget") * 1024 * 1024, _printMemoryStats);
     if ((_mode & CREATE_ACCESS) || (_mode & WRITE_ACCESS)) {
         // these are only available on create
         hsize_t chunk = parser->getOptionAlt<hsize_t>("hdf5Chunk", "chunk");
@@ -178,6 +196,9 @@ void Hdf5Alignment::open() {
         throw hal_errno_exception("Unable to open " + _alignmentPath, errno);
     }
 #endif
+    if (((_mode & WRITE_ACCESS) == 0) and _blockCacheConfig.isEnabled() and not isUrl(_alignmentPath)) {
+        setHdf5BlockCacheDriver(_aprops, &_blockCacheConfig);
+    }
     _file = new H5File(_alignmentPath.c_str(), _flags, _cprops, _aprops);
 #if 0
     // This check is not really correct, as the HAL API version doesn't correspond
@@ -224,6 +245,9 @@ void Hdf5Alignment::close() {
             _metaData = NULL;
         }
         writeVersion();
+        if (_printMemoryStats and not _openGenomes.empty()) {
+            cerr << _alignmentPath << ": " << getGenomeMemoryStats() << endl;
+        }
         map<string, Hdf5Genome *>::iterator mapIt;
         for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt) {
             Hdf5Genome *genome = mapIt->second;
@@ -432,10 +456,15 @@ Genome *Hdf5Alignment::openGenome(const string &name) {
     if (_nodeMap.find(name) != _nodeMap.end()) {
         genome = new Hdf5Genome(name, this, _file, _dcprops, _inMemory);
         _openGenomes.insert(pair<string, Hdf5Genome *>(name, genome));
+        _memoryBudget.touch(genome);
     }
     return genome;
 }
 
+GenomeMemoryStats Hdf5Alignment::getGenomeMemoryStats() const {
+    return _memoryBudget.getStats();
+}
+
 void Hdf5Alignment::closeGenome(const Genome *genome) const {
     string name = genome->getName();
     map<string, Hdf5Genome *>::iterator mapIt = _openGenomes.find(name);
@@ -9,6 +9,7 @@
 #define _HDF5ALIGNMENT_H
 
 #include "halAlignmentInstance.h"
+#include "halLocalBlockCache.h"
 #include "hdf5Alignment.h"
 #include "hdf5Genome.h"
 #include "hdf5MetaData.h"
@@ -83,6 +84,24 @@ namespace hal {
 
         void replaceNewickTree(const std::string &newNewickString);
 
+        /* number of chunks of each array to read ahead of sequential
+         * access, 0 when the alignment can be modified */
+        hsize_t getReadAhead() const {
+            return (_mode & WRITE_ACCESS) ? 0 : _readAhead;
+        }
+
+        /* size in bytes of the buffer for each unchunked array */
+        hsize_t getWindowBytes() const {
+            return _windowBytes;
+        }
+
+        /* budget for the memory of the open genomes */
+        GenomeMemoryBudget &getMemoryBudget() const {
+            return _memoryBudget;
+        }
+
+        GenomeMemoryStats getGenomeMemoryStats() const;
+
       private:
         // FIXME: should these be private?
         void loadTree();
@@ -109,6 +128,8 @@ namespace hal {
         static const hsize_t DefaultCacheRDCBytes;
         static const double DefaultCacheW0;
         static const bool DefaultInMemory;
+        static const hsize_t DefaultReadAhead;
+        static const hsize_t DefaultWindowBytes;
 
         static const H5std_string MetaGroupName;
         static const H5std_string TreeGroupName;
@@ -122,6 +143,9 @@ namespace hal {
         H5::H5File *_file;
         int _flags;
         bool _inMemory;
+        hsize_t _readAhead;
+        hsize_t _windowBytes;
+        LocalBlockCacheConfig _blockCacheConfig;
         H5::FileCreatPropList _cprops;
         H5::FileAccPropList _aprops;
         H5::DSetCreatPropList _dcprops;
@@ -130,6 +154,8 @@ namespace hal {
         mutable std::map<std::string, stTree *> _nodeMap;
         bool _dirty;
         mutable std::map<std::string, Hdf5Genome *> _openGenomes;
+        mutable GenomeMemoryBudget _memoryBudget;
+        bool _printMemoryStats;
     };
 }
 #endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HDF5ARRAYWINDOW_H
+#define _HDF5ARRAYWINDOW_H
+
+#include <H5Cpp.h>
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace hal {
+
+    /**
+     * In-memory buffer holding a window of consecutive elements of an
+     * Hdf5ExternalArray.  The window has a fixed capacity and is always
+     * aligned to a multiple of it, so it only holds fewer elements at the
+     * end of the array.  It knows nothing about the dataset: the array
+     * moves it and reads or writes its contents.
+     */
+    class Hdf5ArrayWindow {
+      public:
+        Hdf5ArrayWindow() : _capacity(0), _elementSize(0), _start(0), _size(0), _dirty(false) {
+        }
+
+        /** Set the dimensions of the window, which starts out empty.  The
+         * buffer is allocated when the window is first moved.
+         * @param capacity Maximum number of elements in window
+         * @param elementSize Size of each element in bytes */
+        void init(hsize_t capacity, hsize_t elementSize) {
+            _capacity = capacity;
+            _elementSize = elementSize;
+            release();
+        }
+
+        /** Forget the contents and free the buffer */
+        void release() {
+            std::vector<char>().swap(_buf);
+            clear();
+        }
+
+        /** Forget the contents, so nothing is in the window */
+        void clear() {
+            _start = 0;
+            _size = 0;
+            _dirty = false;
+        }
+
+        /** Position the window over the elements around index i, leaving
+         * the contents to be read by the caller
+         * @param i Index of element that must be in the window
+         * @param arraySize Number of elements in the array */
+        void moveTo(hsize_t i, hsize_t arraySize) {
+            assert(i < arraySize && _capacity > 0);
+            if (_buf.empty()) {
+                _buf.assign(_capacity * _elementSize, 0);
+            }
+            _start = (i / _capacity) * _capacity;
+            _size = std::min(_capacity, arraySize - _start);
+            _dirty = false;
+        }
+
+        /** Is element i in the window? */
+        bool contains(hsize_t i) const {
+            return i >= _start && i - _start < _size;
+        }
+
+        /** Maximum number of elements in the window */
+        hsize_t getCapacity() const {
+            return _capacity;
+        }
+
+        /** Index of first element in the window */
+        hsize_t getStart() const {
+            return _start;
+        }
+
+        /** Number of elements in the window */
+        hsize_t getSize() const {
+            return _size;
+        }
+
+        /** Bytes allocated for the buffer */
+        hsize_t getAllocatedBytes() const {
+            return _buf.size();
+        }
+
+        /** In-memory buffer, which does not move until released */
+        char *getBuf() {
+            return _buf.data();
+        }
+
+        /** Element i, which must be in the window */
+        char *get(hsize_t i) {
+            assert(contains(i));
+            return _buf.data() + (i - _start) * _elementSize;
+        }
+
+        /** Has the buffer been modified since it was read? */
+        bool isDirty() const {
+            return _dirty;
+        }
+
+        void setDirty(bool dirty = true) {
+            _dirty = dirty;
+        }
+
+      private:
+        std::vector<char> _buf;
+        hsize_t _capacity;
+        hsize_t _elementSize;
+        hsize_t _start;
+        hsize_t _size;
+        bool _dirty;
+    };
+}
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "hdf5BlockCacheDriver.h"
+#include "hdf5.h"
+#include <cstring>
+#include <exception>
+#include <string>
+
+using namespace hal;
+using namespace std;
+
+/* The driver follows the public-API-only sec2 and stdio drivers that come
+ * with HDF5, with reads served by a LocalBlockCache.  It is read-only, so
+ * there is nothing to write, flush or truncate. */
+
+namespace {
+    /* driver information in the file access property list */
+    struct BlockCacheFapl {
+        const LocalBlockCacheConfig *config;
+    };
+
+    /* an open file; the public fields are filled in by HDF5 */
+    struct BlockCacheFile {
+        H5FD_t pub; // must be first
+        string path;
+        LocalBlockCache *cache;
+        int fd; // local copy, for get_handle
+        haddr_t eoa;
+    };
+}
+
+/* largest address, so sizes and offsets fit in off_t */
+static const haddr_t MAXADDR = (((haddr_t)1 << (8 * sizeof(off_t) - 1)) - 1);
+
+static void pushError(const char *func, hid_t minor, const string &msg) {
+    H5Epush2(H5E_DEFAULT, __FILE__, func, __LINE__, H5E_ERR_CLS, H5E_VFL, minor, "%s", msg.c_str());
+}
+
+extern "C" {
+static H5FD_t *blockCacheOpen(const char *name, unsigned flags, hid_t fapl, haddr_t maxaddr) {
+    H5Eclear2(H5E_DEFAULT);
+    if (flags & (H5F_ACC_RDWR | H5F_ACC_CREAT | H5F_ACC_TRUNC | H5F_ACC_EXCL)) {
+        pushError(__func__, H5E_CANTOPENFILE, string(name) + ": files are read-only through the block cache");
+        return NULL;
+    }
+    const BlockCacheFapl *info = static_cast<const BlockCacheFapl *>(H5Pget_driver_info(fapl));
+    if ((info == NULL) || (info->config == NULL)) {
+        pushError(__func__, H5E_BADVALUE, "no block cache configuration");
+        return NULL;
+    }
+    BlockCacheFile *file = new BlockCacheFile();
+    file->path = name;
+    try {
+        file->cache = new LocalBlockCache(name, *info->config);
+    } catch (const exception &ex) {
+        delete file;
+        pushError(__func__, H5E_CANTOPENFILE, ex.what());
+        return NULL;
+    }
+    file->fd = file->cache->getCacheFd();
+    file->eoa = 0;
+    return &file->pub;
+}
+
+static herr_t blockCacheClose(H5FD_t *pub) {
+    BlockCacheFile *file = reinterpret_cast<BlockCacheFile *>(pub);
+    delete file->cache;
+    delete file;
+    return 0;
+}
+
+static int blockCacheCmp(const H5FD_t *pub1, const H5FD_t *pub2) {
+    return reinterpret_cast<const BlockCacheFile *>(pub1)->path.compare(
+        reinterpret_cast<const BlockCacheFile *>(pub2)->path);
+}
+
+static herr_t blockCacheQuery(const H5FD_t *pub, unsigned long *flags) {
+    if (flags != NULL) {
+        *flags = H5FD_FEAT_AGGREGATE_METADATA | H5FD_FEAT_ACCUMULATE_METADATA | H5FD_FEAT_DATA_SIEVE |
+                 H5FD_FEAT_AGGREGATE_SMALLDATA;
+    }
+    return 0;
+}
+
+static haddr_t blockCacheGetEoa(const H5FD_t *pub, H5FD_mem_t type) {
+    return reinterpret_cast<const BlockCacheFile *>(pub)->eoa;
+}
+
+static herr_t blockCacheSetEoa(H5FD_t *pub, H5FD_mem_t type, haddr_t addr) {
+    reinterpret_cast<BlockCacheFile *>(pub)->eoa = addr;
+    return 0;
+}
+
+#if H5_VERSION_GE(1, 10, 0)
+static haddr_t blockCacheGetEof(const H5FD_t *pub, H5FD_mem_t type) {
+#else
+static haddr_t blockCacheGetEof(const H5FD_t *pub) {
+#endif
+    return reinterpret_cast<const BlockCacheFile *>(pub)->cache->getFileSize();
+}
+
+static herr_t blockCacheGetHandle(H5FD_t *pub, hid_t fapl, void **handle) {
+    *handle = &reinterpret_cast<BlockCacheFile *>(pub)->fd;
+    return 0;
+}
+
+static herr_t blockCacheRead(H5FD_t *pub, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, void *buf) {
+    BlockCacheFile *file = reinterpret_cast<BlockCacheFile *>(pub);
+    H5Eclear2(H5E_DEFAULT);
+    if ((addr == HADDR_UNDEF) || (addr > MAXADDR) || (size > MAXADDR - addr) || (addr + size > file->eoa)) {
+        pushError(__func__, H5E_OVERFLOW, file->path + ": file address overflowed");
+        return -1;
+    }
+    try {
+        file->cache->read(buf, size, addr);
+    } catch (const exception &ex) {
+        pushError(__func__, H5E_READERROR, ex.what());
+        return -1;
+    }
+    return 0;
+}
+
+static herr_t blockCacheWrite(H5FD_t *pub, H5FD_mem_t type, hid_t dxpl, haddr_t addr, size_t size, const void *buf) {
+    pushError(__func__, H5E_WRITEERROR, reinterpret_cast<BlockCacheFile *>(pub)->path + ": block cache is read-only");
+    return -1;
+}
+
+static herr_t blockCacheFlush(H5FD_t *pub, hid_t dxpl, hbool_t closing) {
+    return 0;
+}
+
+static herr_t blockCacheTruncate(H5FD_t *pub, hid_t dxpl, hbool_t closing) {
+    return 0;
+}
+}
+
+static const H5FD_class_t blockCacheClass = {
+    "hal_block_cache",      /* name         */
+    MAXADDR,                /* maxaddr      */
+    H5F_CLOSE_WEAK,         /* fc_degree    */
+#if H5_VERSION_GE(1, 10, 0)
+    NULL,                   /* terminate    */
+#endif
+    NULL,                   /* sb_size      */
+    NULL,                   /* sb_encode    */
+    NULL,                   /* sb_decode    */
+    sizeof(BlockCacheFapl), /* fapl_size    */
+    NULL,                   /* fapl_get     */
+    NULL,                   /* fapl_copy    */
+    NULL,                   /* fapl_free    */
+    0,                      /* dxpl_size    */
+    NULL,                   /* dxpl_copy    */
+    NULL,                   /* dxpl_free    */
+    blockCacheOpen,         /* open         */
+    blockCacheClose,        /* close        */
+    blockCacheCmp,          /* cmp          */
+    blockCacheQuery,        /* query        */
+    NULL,                   /* get_type_map */
+    NULL,                   /* alloc        */
+    NULL,                   /* free         */
+    blockCacheGetEoa,       /* get_eoa      */
+    blockCacheSetEoa,       /* set_eoa      */
+    blockCacheGetEof,       /* get_eof      */
+    blockCacheGetHandle,    /* get_handle   */
+    blockCacheRead,         /* read         */
+    blockCacheWrite,        /* write        */
+    blockCacheFlush,        /* flush        */
+    blockCacheTruncate,     /* truncate     */
+    NULL,                   /* lock         */
+    NULL,                   /* unlock       */
+    H5FD_FLMAP_DICHOTOMY    /* fl_map       */
+};
+
+void hal::setHdf5BlockCacheDriver(H5::FileAccPropList &aprops, const LocalBlockCacheConfig *config) {
+    static const hid_t driverId = H5FDregister(&blockCacheClass);
+    if (driverId < 0) {
+        throw hal_exception("can't register HDF5 block cache driver");
+    }
+    BlockCacheFapl info = {config};
+    aprops.setDriver(driverId, &info);
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HDF5BLOCKCACHEDRIVER_H
+#define _HDF5BLOCKCACHEDRIVER_H
+
+#include "halLocalBlockCache.h"
+#include <H5Cpp.h>
+
+namespace hal {
+    /**
+     * Set a file access property list to open files read-only through a
+     * LocalBlockCache (a HDF5 virtual file driver).  The configuration must
+     * outlive the files opened with the property list.
+     */
+    void setHdf5BlockCacheDriver(H5::FileAccPropList &aprops, const LocalBlockCacheConfig *config);
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -56,17 +56,19 @@ namespace hal {
         static H5::CompType dataType(hal_size_t numChildren);
         static hal_size_t numChildrenFromDataType(const H5::DataType &dataType);
 
-      private:
-        Hdf5Genome *getHdf5Genome() const {
-            return static_cast<Hdf5Genome *>(_genome);
-        }
-
+        // layout of an element of the array, each child has an index
+        // followed by a reversed flag
         static const size_t genomeIndexOffset;
         static const size_t lengthOffset;
         static const size_t topIndexOffset;
         static const size_t firstChildOffset;
         static const size_t totalSize(hal_size_t numChildren);
 
+      private:
+        Hdf5Genome *getHdf5Genome() const {
+            return static_cast<Hdf5Genome *>(_genome);
+        }
+
         Hdf5ExternalArray *_array;
     };
 
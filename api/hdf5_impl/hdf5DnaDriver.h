@@ -24,6 +24,9 @@ namespace hal {
 
         void flush();
 
+        /** Flush and forget the buffer, before the array frees it */
+        void release();
+
       protected:
         virtual void fetch(hal_index_t index) const;
 
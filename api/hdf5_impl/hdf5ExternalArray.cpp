@@ -6,36 +6,186 @@
  */
 
 #include "hdf5ExternalArray.h"
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
 
 using namespace hal;
 using namespace H5;
 using namespace std;
 
+/* number of chunks that must be paged in one after the other before reading
+ * ahead */
+static const hsize_t readAheadMinSequential = 2;
+
+const hsize_t Hdf5ExternalArray::DefaultWindowBytes = 1 << 16;
+const hsize_t Hdf5ExternalArray::NumWindows = 4;
+
+namespace {
+    /* a chunk read ahead, inflated by the pool */
+    struct ReadAheadChunk {
+        vector<char> raw;
+        vector<char> data;
+        bool done;
+        bool failed;
+    };
+
+    /* threads inflating chunks read ahead, shared by all arrays.  They only
+     * call zlib, the HDF5 library is only used by the thread paging the
+     * array. */
+    class InflatePool {
+      public:
+        static InflatePool &instance() {
+            static InflatePool pool;
+            return pool;
+        }
+
+        void submit(const shared_ptr<ReadAheadChunk> &chunk) {
+            lock_guard<mutex> lock(_mutex);
+            _queue.push_back(chunk);
+            _queued.notify_one();
+        }
+
+        /* wait for a chunk to be inflated, false if it couldn't be */
+        bool wait(const ReadAheadChunk &chunk) {
+            unique_lock<mutex> lock(_mutex);
+            _inflated.wait(lock, [&chunk]() { return chunk.done; });
+            return not chunk.failed;
+        }
+
+      private:
+        InflatePool() : _stop(false) {
+            unsigned numThreads = max(thread::hardware_concurrency(), 1u);
+            for (unsigned i = 0; i < numThreads; ++i) {
+                _threads.push_back(thread(&InflatePool::run, this));
+            }
+        }
+
+        ~InflatePool() {
+            {
+                lock_guard<mutex> lock(_mutex);
+                _stop = true;
+                _queued.notify_all();
+            }
+            for (thread &t : _threads) {
+                t.join();
+            }
+        }
+
+        void run() {
+            unique_lock<mutex> lock(_mutex);
+            while (true) {
+                _queued.wait(lock, [this]() { return _stop or not _queue.empty(); });
+                if (_stop) {
+                    return;
+                }
+                shared_ptr<ReadAheadChunk> chunk = _queue.front();
+                _queue.pop_front();
+                if (chunk.use_count() == 1) {
+                    continue; // the array no longer wants it
+                }
+                lock.unlock();
+                uLongf length = chunk->data.size();
+                bool failed = (uncompress(reinterpret_cast<Bytef *>(chunk->data.data()), &length,
+                                          reinterpret_cast<const Bytef *>(chunk->raw.data()), chunk->raw.size()) != Z_OK) ||
+                              (length != chunk->data.size());
+                vector<char>().swap(chunk->raw);
+                lock.lock();
+                chunk->failed = failed;
+                chunk->done = true;
+                _inflated.notify_all();
+            }
+        }
+
+        mutex _mutex;
+        condition_variable _queued;
+        condition_variable _inflated;
+        deque<shared_ptr<ReadAheadChunk>> _queue;
+        vector<thread> _threads;
+        bool _stop;
+    };
+}
+
+/* chunks of an array read ahead, by chunk number */
+class hal::Hdf5ReadAhead {
+  public:
+    Hdf5ReadAhead(hsize_t numChunks) : _numChunks(numChunks), _lastChunk(-1), _numSequential(0) {
+    }
+    hsize_t _numChunks;
+    hsize_t _lastChunk;
+    hsize_t _numSequential;
+    map<hsize_t, shared_ptr<ReadAheadChunk>> _chunks;
+};
+
 /** Constructor */
 Hdf5ExternalArray::Hdf5ExternalArray()
-    : _file(NULL), _size(0), _chunkSize(0), _bufStart(0), _bufEnd(0), _bufSize(0), _buf(NULL), _dirty(false) {
+    : _file(NULL), _dataSetClosed(false), _size(0), _chunkSize(0), _dataSize(0), _windows(1), _readAhead(NULL),
+      _chunkCacheBytes(0), _chunkCacheSlotBytes(0), _chunkCacheReadBytes(0), _memoryBudget(NULL), _memoryClient(NULL) {
 }
 
 /** Destructor */
 Hdf5ExternalArray::~Hdf5ExternalArray() {
-    delete[] _buf;
+    delete _readAhead;
 }
 
-/* initialize the internal data buffer */
-void Hdf5ExternalArray::initBuf() {
-    _bufSize = _chunkSize > 1 ? _chunkSize : _size;
-    _bufStart = 0;
-    _bufEnd = _bufSize - 1;
-    delete[] _buf;
-    _buf = new char[_bufSize * _dataSize];
+/* allocate the internal data buffers: one holding the whole array if
+ * chunksInBuffer is 0, otherwise NumWindows of that many chunks of a chunked
+ * dataset or of windowBytes worth of elements.  They start out empty. */
+void Hdf5ExternalArray::initWindows(hsize_t chunksInBuffer, hsize_t windowBytes) {
+    hsize_t capacity;
+    if (chunksInBuffer == 0) {
+        capacity = _size;
+    } else if (_chunkSize > 0) {
+        capacity = _chunkSize * chunksInBuffer;
+    } else {
+        capacity = max(windowBytes / _dataSize, (hsize_t)1);
+    }
+    capacity = max(min(capacity, _size), (hsize_t)1);
+    _windows.assign(capacity < _size ? NumWindows : 1, Hdf5ArrayWindow());
+    for (Hdf5ArrayWindow &window : _windows) {
+        window.init(capacity, _dataSize);
+    }
+}
+
+/* get the size of the chunk cache of the dataset, and the memory taken by
+ * its table of slots, which is allocated when a chunked dataset is opened */
+void Hdf5ExternalArray::initChunkCacheSize() {
+    _chunkCacheBytes = 0;
+    _chunkCacheSlotBytes = 0;
+    _chunkCacheReadBytes = 0;
+    if (_chunkSize > 0) {
+        hid_t dapl = H5Dget_access_plist(_dataSet.getId());
+        size_t numSlots = 0, numBytes = 0;
+        double w0 = 0;
+        H5Pget_chunk_cache(dapl, &numSlots, &numBytes, &w0);
+        H5Pclose(dapl);
+        _chunkCacheBytes = numBytes;
+        _chunkCacheSlotBytes = numSlots * sizeof(void *);
+    }
+}
+
+/* open the dataset again if it was closed to release its memory */
+void Hdf5ExternalArray::reopen() {
+    if (_dataSetClosed) {
+        _dataSet = _file->openDataSet(_path);
+        _dataSetClosed = false;
+    }
 }
 
 // Create a new dataset in specifed location
 void Hdf5ExternalArray::create(PortableH5Location *file, const H5std_string &path, const DataType &dataType,
-                               hsize_t numElements, const DSetCreatPropList *inCparms, hsize_t chunksInBuffer) {
+                               hsize_t numElements, const DSetCreatPropList *inCparms, hsize_t chunksInBuffer,
+                               hsize_t windowBytes) {
     // copy in parameters
+    setReadAhead(0);
     _file = file;
     _path = path;
     _dataType = dataType;
@@ -61,27 +211,32 @@ void Hdf5ExternalArray::create(PortableH5Location *file, const H5std_string &pat
             _chunkSize = _size;
             cparms.setChunk(1, &_chunkSize);
         }
-        _chunkSize *= chunksInBuffer;
     } else {
         _chunkSize = 0;
     }
 
-    // create the internal data buffer
-    initBuf();
+    // create the internal data buffers, the first over the start of the new array
+    initWindows(chunksInBuffer, windowBytes);
+    if (_size > 0) {
+        _windows.front().moveTo(0, _size);
+    }
 
     // create the hdf5 array
     _dataSet = _file->createDataSet(_path, _dataType, _dataSpace, cparms);
-    _chunkSpace = DataSpace(1, &_bufSize);
+    _dataSetClosed = false;
+    initChunkCacheSize();
     assert(getSize() == numElements);
-    assert(_bufSize > 0 || _size == 0);
 }
 
 // Load an existing dataset into memory
-void Hdf5ExternalArray::load(PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer) {
+void Hdf5ExternalArray::load(PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer,
+                             hsize_t windowBytes) {
     // load up the parameters
+    setReadAhead(0);
     _file = file;
     _path = path;
     _dataSet = _file->openDataSet(_path);
+    _dataSetClosed = false;
     _dataType = _dataSet.getDataType();
     _dataSpace = _dataSet.getSpace();
     _dataSize = _dataType.getSize();
@@ -93,49 +248,290 @@ void Hdf5ExternalArray::load(PortableH5Location *file, const H5std_string &path,
     // resolve chunking size (0 = do not chunk)
     if (cparms.getLayout() == H5D_CHUNKED) {
         cparms.getChunk(1, &_chunkSize);
-        _chunkSize *= chunksInBuffer;
-        if (_chunkSize == 1) {
-            throw hal_exception("Hdf5ExternalArray::create: "
-                                "chunkSize of 1 not supported");
-        }
-        if (_chunkSize > _size) {
-            throw hal_exception("Hdf5ExternalArray::create: "
-                                "chunkSize > array size is not supported");
-        }
     } else {
         _chunkSize = 0;
     }
-    initBuf();
-    _bufStart = _bufEnd + 1; // set out of range to ensure page happens
-    _chunkSpace = DataSpace(1, &_bufSize);
-    assert(_bufSize > 0 || _size == 0);
+    initChunkCacheSize();
+    // the buffers start out empty to ensure page happens
+    initWindows(chunksInBuffer, windowBytes);
+}
+
+/* write a buffer back to the file if it has been modified */
+void Hdf5ExternalArray::writeWindow(Hdf5ArrayWindow &window) {
+    if (window.isDirty()) {
+        reopen();
+        discardReadAhead();
+        hsize_t start = window.getStart();
+        hsize_t count = window.getSize();
+        DataSpace memSpace(1, &count);
+        _dataSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        _dataSet.write(window.getBuf(), _dataType, memSpace, _dataSpace);
+        window.setDirty(false);
+    }
 }
 
-// Write the memory buffer back to the file
+// Write the memory buffers back to the file
 void Hdf5ExternalArray::write() {
-    if (_dirty) {
-        _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-        _dataSet.write(_buf, _dataType, _chunkSpace, _dataSpace);
-        _dirty = false;
+    for (Hdf5ArrayWindow &window : _windows) {
+        writeWindow(window);
     }
 }
 
-// Page chunk containing index i into memory
+// Page window containing index i into memory
 void Hdf5ExternalArray::page(hsize_t i) {
-    if (_dirty) {
-        write();
+    assert(i < _size);
+    // make the buffer holding i, or else the least recently used one, current
+    auto found = find_if(_windows.begin(), _windows.end(),
+                         [i](const Hdf5ArrayWindow &window) { return window.contains(i); });
+    bool hit = found != _windows.end();
+    if (!hit) {
+        found = _windows.end() - 1;
     }
-    _bufStart = (i / _bufSize) * _bufSize; // todo: review
-    _bufEnd = _bufStart + _bufSize - 1;
+    rotate(_windows.begin(), found, found + 1);
+    Hdf5ArrayWindow &window = _windows.front();
+    if (hit) {
+        return;
+    }
+    writeWindow(window);
+    reopen();
+    if ((_readAhead == NULL) || !pageReadAhead(i)) {
+        window.moveTo(i, _size);
+        hsize_t start = window.getStart();
+        hsize_t count = window.getSize();
+        DataSpace memSpace(1, &count);
+        _dataSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+        _dataSet.read(window.getBuf(), _dataType, memSpace, _dataSpace);
+        countRead(count);
+    }
+    if (_memoryBudget != NULL) {
+        _memoryBudget->touch(_memoryClient);
+    }
+}
 
-    if (_bufEnd >= _size) {
-        _bufEnd = _size - 1;
-        _bufSize = _bufEnd - _bufStart + 1;
-        _chunkSpace = DataSpace(1, &_bufSize);
+/* account for count elements read through the chunk cache */
+void Hdf5ExternalArray::countRead(hsize_t count) {
+    if (_chunkCacheReadBytes < _chunkCacheBytes) {
+        _chunkCacheReadBytes = min(_chunkCacheReadBytes + count * _dataSize, _chunkCacheBytes);
     }
+}
 
-    _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-    _dataSet.read(_buf, _dataType, _chunkSpace, _dataSpace);
-    _dirty = false;
-    assert(_bufSize > 0 || _size == 0);
+hsize_t Hdf5ExternalArray::getResidentBytes() const {
+    hsize_t bytes = 0;
+    if (!_dataSetClosed) {
+        bytes += _chunkCacheSlotBytes + _chunkCacheReadBytes;
+    }
+    for (const Hdf5ArrayWindow &window : _windows) {
+        bytes += window.getAllocatedBytes();
+    }
+    if (_readAhead != NULL) {
+        bytes += _readAhead->_chunks.size() * _chunkSize * _dataSize;
+    }
+    return bytes;
+}
+
+// Free the buffers and caches
+void Hdf5ExternalArray::releaseMemory() {
+    write();
+    discardReadAhead();
+    for (Hdf5ArrayWindow &window : _windows) {
+        window.release();
+    }
+    // closing the dataset frees its chunk cache, it is opened again when
+    // next accessed
+    if (!_dataSetClosed && (_file != NULL) && (H5Iis_valid(_dataSet.getId()) > 0)) {
+        _dataSet.close();
+        _dataSetClosed = true;
+        _chunkCacheReadBytes = 0;
+    }
+}
+
+/* discard the buffers, so the next access pages them in again */
+void Hdf5ExternalArray::clearWindows() {
+    for (Hdf5ArrayWindow &window : _windows) {
+        window.clear();
+    }
+}
+
+// Read ahead of sequential access
+void Hdf5ExternalArray::setReadAhead(hsize_t numChunks) {
+    delete _readAhead;
+    _readAhead = NULL;
+    if ((numChunks > 0) && (_chunkSize > 1) && (getBufCapacity() == _chunkSize) &&
+        (getRawChunkDeflateLevel(_dataType) >= 0)) {
+        _readAhead = new Hdf5ReadAhead(numChunks);
+    }
+}
+
+/* page the chunk containing index i into the current buffer if it was read
+ * ahead, then read ahead if access is sequential.  returns false if the chunk is to be paged in as
+ * usual */
+bool Hdf5ExternalArray::pageReadAhead(hsize_t i) {
+    map<hsize_t, shared_ptr<ReadAheadChunk>> &chunks = _readAhead->_chunks;
+    hsize_t chunk = i / _chunkSize;
+    if (chunk == _readAhead->_lastChunk + 1) {
+        ++_readAhead->_numSequential;
+    } else if (chunk != _readAhead->_lastChunk) {
+        _readAhead->_numSequential = 0;
+    }
+    _readAhead->_lastChunk = chunk;
+
+    // drop chunks behind, and after jumping back those too far ahead
+    chunks.erase(chunks.begin(), chunks.lower_bound(chunk));
+    chunks.erase(chunks.upper_bound(chunk + _readAhead->_numChunks), chunks.end());
+
+    bool paged = false;
+    auto found = chunks.find(chunk);
+    if (found != chunks.end()) {
+        shared_ptr<ReadAheadChunk> readChunk = found->second;
+        chunks.erase(found);
+        if (InflatePool::instance().wait(*readChunk)) {
+            Hdf5ArrayWindow &window = _windows.front();
+            window.moveTo(i, _size);
+            memcpy(window.getBuf(), readChunk->data.data(), window.getSize() * _dataSize);
+            paged = true;
+        }
+    }
+
+    if (_readAhead->_numSequential >= readAheadMinSequential) {
+        hsize_t numChunks = (_size + _chunkSize - 1) / _chunkSize;
+        hsize_t next = chunks.empty() ? chunk + 1 : chunks.rbegin()->first + 1;
+        hsize_t end = min(chunk + 1 + _readAhead->_numChunks, numChunks);
+        for (; next < end; ++next) {
+            shared_ptr<ReadAheadChunk> readChunk(new ReadAheadChunk());
+            bool deflated = false;
+            readRawChunk(next, readChunk->raw, deflated);
+            readChunk->failed = false;
+            if (deflated) {
+                readChunk->data.resize(_chunkSize * _dataSize);
+                readChunk->done = false;
+                InflatePool::instance().submit(readChunk);
+            } else {
+                readChunk->data.swap(readChunk->raw);
+                readChunk->failed = readChunk->data.size() != _chunkSize * _dataSize;
+                readChunk->done = true;
+            }
+            chunks[next] = readChunk;
+        }
+    }
+    return paged;
+}
+
+/* forget chunks read ahead, which are stale once the array is written */
+void Hdf5ExternalArray::discardReadAhead() {
+    if (_readAhead != NULL) {
+        _readAhead->_chunks.clear();
+        _readAhead->_numSequential = 0;
+    }
+}
+
+// Read elements straight from the dataset
+void Hdf5ExternalArray::readRange(hsize_t start, hsize_t count, char *buf) {
+    assert(start + count <= _size);
+    if (count == 0) {
+        return;
+    }
+    write();
+    reopen();
+    DataSpace memSpace(1, &count);
+    _dataSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+    _dataSet.read(buf, _dataType, memSpace, _dataSpace);
+    countRead(count);
+    if (_memoryBudget != NULL) {
+        _memoryBudget->touch(_memoryClient);
+    }
+}
+
+// Write elements straight to the dataset
+void Hdf5ExternalArray::writeRange(hsize_t start, hsize_t count, const char *buf) {
+    if (start + count > _size) {
+        throw hal_exception("error: attempt to write hdf5 array out of bounds");
+    }
+    if (count == 0) {
+        return;
+    }
+    write();
+    reopen();
+    DataSpace memSpace(1, &count);
+    _dataSpace.selectHyperslab(H5S_SELECT_SET, &count, &start);
+    _dataSet.write(buf, _dataType, memSpace, _dataSpace);
+    clearWindows();
+    discardReadAhead();
+}
+
+hsize_t Hdf5ExternalArray::getDataSetChunkSize() const {
+    return _chunkSize;
+}
+
+int Hdf5ExternalArray::getRawChunkDeflateLevel(const DataType &dataType) const {
+#if H5_VERSION_GE(1, 10, 5)
+    // reading the properties doesn't change the contents
+    const_cast<Hdf5ExternalArray *>(this)->reopen();
+    DSetCreatPropList cparms = _dataSet.getCreatePlist();
+    if ((cparms.getLayout() != H5D_CHUNKED) || !(_dataType == dataType)) {
+        return -1;
+    }
+    int numFilters = cparms.getNfilters();
+    if (numFilters == 0) {
+        return 0;
+    }
+    unsigned flags;
+    size_t numValues = 1;
+    unsigned values[1] = {0};
+    char name[32];
+    unsigned config;
+    if ((numFilters != 1) ||
+        (cparms.getFilter(0, flags, numValues, values, sizeof(name), name, config) != H5Z_FILTER_DEFLATE)) {
+        return -1;
+    }
+    return values[0];
+#else
+    // no direct chunk access
+    return -1;
+#endif
+}
+
+// Read the stored bytes of a chunk
+void Hdf5ExternalArray::readRawChunk(hsize_t chunk, vector<char> &raw, bool &deflated) {
+#if H5_VERSION_GE(1, 10, 5)
+    hsize_t offset = chunk * getDataSetChunkSize();
+    hsize_t storageSize = 0;
+    reopen();
+    if (H5Dget_chunk_storage_size(_dataSet.getId(), &offset, &storageSize) < 0) {
+        throw hal_exception("error: getting size of chunk " + std::to_string(chunk) + " of hdf5 array " + _path + " failed");
+    }
+    if (storageSize == 0) {
+        // never written, all fill value
+        raw.assign(getDataSetChunkSize() * _dataSize, 0);
+        deflated = false;
+        return;
+    }
+    raw.resize(storageSize);
+    uint32_t filterMask = 0;
+    if (H5Dread_chunk(_dataSet.getId(), H5P_DEFAULT, &offset, &filterMask, raw.data()) < 0) {
+        throw hal_exception("error: reading chunk " + std::to_string(chunk) + " of hdf5 array " + _path + " failed");
+    }
+    // the deflate filter is optional, a chunk it failed on is stored as-is
+    deflated = (filterMask & 1) == 0;
+#else
+    throw hal_exception("error: direct chunk access requires HDF5 1.10.5 or later");
+#endif
+}
+
+// Write the stored bytes of a chunk
+void Hdf5ExternalArray::writeRawChunk(hsize_t chunk, const vector<char> &raw) {
+#if H5_VERSION_GE(1, 10, 5)
+    hsize_t offset = chunk * getDataSetChunkSize();
+    if (offset >= _size) {
+        throw hal_exception("error: attempt to write hdf5 array out of bounds");
+    }
+    write();
+    reopen();
+    if (H5Dwrite_chunk(_dataSet.getId(), H5P_DEFAULT, 0, &offset, raw.size(), raw.data()) < 0) {
+        throw hal_exception("error: writing chunk " + std::to_string(chunk) + " of hdf5 array " + _path + " failed");
+    }
+    clearWindows();
+    discardReadAhead();
+#else
+    throw hal_exception("error: direct chunk access requires HDF5 1.10.5 or later");
+#endif
 }
@@ -9,8 +9,11 @@
 #define _HDF5EXTERNALARRAY_H
 
 #include "halDefs.h"
+#include "halGenomeMemoryBudget.h"
+#include "hdf5ArrayWindow.h"
 #include <H5Cpp.h>
 #include <cassert>
+#include <vector>
 
 // Hack to compile with various versions of HDF5 that aren't themselves compatible
 namespace H5 {
@@ -26,11 +29,14 @@ namespace H5 {
 }
 
 namespace hal {
+    class Hdf5ReadAhead;
 
     /**
      * Wrapper for a 1-dimensional HDF5 array of fixed length.  Array objects
      * are defined (and typed) by the input datatype.  The array is paged into
-     * memory chunk-by-chunk as needed (using the HDF5 cache as a back-end).
+     * a window in memory as needed (using the HDF5 cache as a back-end): a
+     * whole number of chunks for chunked datasets, and a hyperslab of bounded
+     * size for unchunked ones.
      * We can't use compiler tpying of the input objects (and instead just
      * expose the raw void* data) because the elements' sizes are not known
      * at compile time, and we don't want to move it around once its read.
@@ -53,9 +59,11 @@ namespace hal {
           * 0: load entire array into buffer
           * 1: use default chunking (from dataset)
           * N: buffersize will be N chunks.
+          * @param windowBytes Buffer size in bytes if the dataset isn't chunked
           */
         void create(H5::PortableH5Location *file, const H5std_string &path, const H5::DataType &dataType, hsize_t numElements,
-                    const H5::DSetCreatPropList *inCparms = NULL, hsize_t chunksInBuffer = 1);
+                    const H5::DSetCreatPropList *inCparms = NULL, hsize_t chunksInBuffer = 1,
+                    hsize_t windowBytes = DefaultWindowBytes);
 
         /** Load an existing dataset into memory
           * @param file Pointer to the HDF5 file in which to create array
@@ -64,10 +72,12 @@ namespace hal {
           * 0: load entire array into buffer
           * 1: use default chunking (from dataset)
           * N: buffersize will be N chunks.
+          * @param windowBytes Buffer size in bytes if the dataset isn't chunked
           */
-        void load(H5::PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer = 1);
+        void load(H5::PortableH5Location *file, const H5std_string &path, hsize_t chunksInBuffer = 1,
+                  hsize_t windowBytes = DefaultWindowBytes);
 
-        /** Write the memory buffer back to the file */
+        /** Write the memory buffers back to the file */
         void write();
 
         /** Access the raw data at given index
@@ -106,33 +116,110 @@ namespace hal {
 
         /** get the current buffered start */
         hsize_t getBufStart() const {
-            return _bufStart;
+            return _windows.front().getStart();
         }
         /** Get index of last element in memory buffer (close-ended) */
         hsize_t getBufEnd() const {
-            return _bufEnd;
+            return _windows.front().getStart() + _windows.front().getSize() - 1;
         }
 
-        /** get in-memory buffer */
+        /** Maximum number of elements in each memory buffer */
+        hsize_t getBufCapacity() const {
+            return _windows.front().getCapacity();
+        }
+
+        /** get current in-memory buffer, the one most recently paged */
         char *getBuf() {
-            return _buf;
+            return _windows.front().getBuf();
         }
 
-        /* is the buffer dirty? */
+        /* is the current buffer dirty? */
         bool getDirty() const {
-            return _dirty;
+            return _windows.front().isDirty();
         }
 
-        /*  dirty if buffer has been modified directly */
+        /*  dirty if current buffer has been modified directly */
         void setDirty() {
-            _dirty = true;
+            _windows.front().setDirty();
         }
 
-        /** Read chunk from file */
+        /** Make the buffer containing index i current, reading it from
+         * file in place of the least recently used buffer if needed */
         void page(hsize_t i);
 
+        /** Read elements straight from the dataset, bypassing the buffer
+         * @param start Index of first element
+         * @param count Number of elements
+         * @param buf Destination with room for count elements */
+        void readRange(hsize_t start, hsize_t count, char *buf);
+
+        /** Write elements straight to the dataset, bypassing the buffer
+         * @param start Index of first element
+         * @param count Number of elements
+         * @param buf Source of count elements */
+        void writeRange(hsize_t start, hsize_t count, const char *buf);
+
+        /** Number of elements in each chunk of the dataset, or 0 if it isn't
+         * chunked */
+        hsize_t getDataSetChunkSize() const;
+
+        /** Deflate level of the dataset's chunks if they can be read and
+         * written directly with readRawChunk() and writeRawChunk(): the
+         * dataset is chunked, its datatype is dataType, and deflate is its
+         * only filter.  0 for no filter, -1 if chunks can't be accessed
+         * directly. */
+        int getRawChunkDeflateLevel(const H5::DataType &dataType) const;
+
+        /** Read the stored bytes of a chunk, which are deflated if
+         * getRawChunkDeflateLevel() > 0 and deflated is set on return.  An
+         * unallocated chunk is returned as zeros. */
+        void readRawChunk(hsize_t chunk, std::vector<char> &raw, bool &deflated);
+
+        /** Write the stored bytes of a chunk, deflated if
+         * getRawChunkDeflateLevel() > 0 */
+        void writeRawChunk(hsize_t chunk, const std::vector<char> &raw);
+
+        /** Read ahead of sequential access: once chunks are paged in one
+         * after another, the stored bytes of the next numChunks chunks are
+         * read and inflated on background threads before they are needed.
+         * Only for arrays that are read but not written, with one chunk in
+         * the buffer.  0 disables read-ahead, as do other buffer sizes and
+         * filters other than deflate. */
+        void setReadAhead(hsize_t numChunks);
+
+        /** Count the memory of the array against a budget, touching client
+         * whenever the array pages data in.  NULL to stop counting. */
+        void setMemoryBudget(GenomeMemoryBudget *budget, GenomeMemoryBudget::Client *client) {
+            _memoryBudget = budget;
+            _memoryClient = client;
+        }
+
+        /** Estimate of the memory held by the buffers, the chunks read
+         * ahead and the HDF5 chunk cache of the dataset */
+        hsize_t getResidentBytes() const;
+
+        /** Write the buffers back to the file and free them, along with the
+         * chunks read ahead, and close the dataset to free its HDF5 chunk
+         * cache.  The dataset is opened and read again when next
+         * accessed. */
+        void releaseMemory();
+
+        /** Default buffer size in bytes for unchunked datasets */
+        static const hsize_t DefaultWindowBytes;
+        /** Number of buffers of an array that isn't held whole in memory,
+         * so that iterators alternating between a few places in the array
+         * don't page it in again each time */
+        static const hsize_t NumWindows;
+
       private:
-        void initBuf();
+        void initWindows(hsize_t chunksInBuffer, hsize_t windowBytes);
+        void writeWindow(Hdf5ArrayWindow &window);
+        void clearWindows();
+        bool pageReadAhead(hsize_t i);
+        void discardReadAhead();
+        void countRead(hsize_t count);
+        void initChunkCacheSize();
+        void reopen();
 
         /** Pointer to file that owns this dataset */
         H5::PortableH5Location *_file;
@@ -144,25 +231,28 @@ namespace hal {
         H5::DataSpace _dataSpace;
         /** The HDF5 array object */
         H5::DataSet _dataSet;
+        /** Has the dataset been closed to release its memory? */
+        bool _dataSetClosed;
         /** Number of elements in the array (fixed length)*/
         hsize_t _size;
-        /** Size of chunk in elements */
+        /** Size of dataset chunk in elements (0 if not chunked) */
         hsize_t _chunkSize;
         /** Size of datatype in bytes */
         hsize_t _dataSize;
-        /** Index of first element in memory buffer */
-        hsize_t _bufStart;
-        /** Index of last element in memory buffer */
-        hsize_t _bufEnd; // DANGER: close-ended
-        /** Number of elements in memory buffer */
-        hsize_t _bufSize;
-        /** In-memory buffer */
-        char *_buf;
-        /** Dimensional information for in-memory buffer */
-        H5::DataSpace _chunkSpace;
-        /** Flag saying we should write to disk on write
-         * or page-out calls (set by getUpdate()) */
-        bool _dirty;
+        /** In-memory buffers, most recently used first, written to disk
+         * on write or page-out calls if dirty (set by getUpdate()) */
+        std::vector<Hdf5ArrayWindow> _windows;
+        /** Chunks being read ahead, NULL if not enabled */
+        Hdf5ReadAhead *_readAhead;
+        /** Size of the HDF5 chunk cache of the dataset in bytes */
+        hsize_t _chunkCacheBytes;
+        /** Bytes taken by the slots of the chunk cache */
+        hsize_t _chunkCacheSlotBytes;
+        /** Bytes read through the chunk cache since it was last emptied */
+        hsize_t _chunkCacheReadBytes;
+        /** Budget the memory is counted against, or NULL */
+        GenomeMemoryBudget *_memoryBudget;
+        GenomeMemoryBudget::Client *_memoryClient;
 
       private:
         Hdf5ExternalArray(const Hdf5ExternalArray &);
@@ -176,23 +266,21 @@ namespace hal {
 
     inline const char *Hdf5ExternalArray::get(hsize_t i) {
         assert(i < _size);
-        if (i < _bufStart || i > _bufEnd) {
+        if (!_windows.front().contains(i)) {
             page(i);
         }
-        assert((i - _bufStart) < _bufSize);
-        return _buf + (i - _bufStart) * _dataSize;
+        return _windows.front().get(i);
     }
 
     inline char *Hdf5ExternalArray::getUpdate(hsize_t i) {
         if (i >= _size) {
             throw hal_exception("error: attempt to write hdf5 array out of bounds");
         }
-        if (i < _bufStart || i > _bufEnd) {
+        if (!_windows.front().contains(i)) {
             page(i);
         }
-        _dirty = true;
-        assert((i - _bufStart) < _bufSize);
-        return _buf + (i - _bufStart) * _dataSize;
+        _windows.front().setDirty();
+        return _windows.front().get(i);
     }
 
     template <typename T> inline T Hdf5ExternalArray::getValue(hsize_t index, hsize_t offset) const {
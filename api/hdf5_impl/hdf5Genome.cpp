@@ -38,10 +38,14 @@ const double Hdf5Genome::dnaChunkScale = 10.;
 Hdf5Genome::Hdf5Genome(const string &name, Hdf5Alignment *alignment, PortableH5Location *h5Parent,
                        const DSetCreatPropList &dcProps, bool inMemory)
     : Genome(alignment, name), _alignment(alignment), _h5Parent(h5Parent), _name(name), _numChildrenInBottomArray(0),
-      _totalSequenceLength(0), _numChunksInArrayBuffer(inMemory ? 0 : 1) {
+      _totalSequenceLength(0), _numChunksInArrayBuffer(inMemory ? 0 : 1),
+      _windowBytes(alignment->getWindowBytes()) {
     _dcprops.copy(dcProps);
     assert(!name.empty());
     assert(alignment != NULL && h5Parent != NULL);
+    for (Hdf5ExternalArray *array : {&_dnaArray, &_topArray, &_bottomArray, &_sequenceIdxArray, &_sequenceNameArray}) {
+        array->setMemoryBudget(&alignment->getMemoryBudget(), this);
+    }
 
     try {
         HDF5DisableExceptionPrinting prDisable;
@@ -63,6 +67,7 @@ Hdf5Genome::Hdf5Genome(const string &name, Hdf5Alignment *alignment, PortableH5L
 }
 
 Hdf5Genome::~Hdf5Genome() {
+    _alignment->getMemoryBudget().remove(this);
     delete _metaData;
     delete _rup;
     deleteSequenceCache();
@@ -129,15 +134,15 @@ void Hdf5Genome::setDimensions(const vector<Sequence::Info> &sequenceDimensions,
         DSetCreatPropList dnaDC;
         dnaDC.copy(_dcprops);
         dnaDC.setChunk(1, &chunk);
-        _dnaArray.create(&_group, dnaArrayName, dnaDataType(), arrayLength, &dnaDC, _numChunksInArrayBuffer);
+        _dnaArray.create(&_group, dnaArrayName, dnaDataType(), arrayLength, &dnaDC, _numChunksInArrayBuffer, _windowBytes);
         _dnaAccess = DnaAccessPtr(new HDF5DnaAccess(this, &_dnaArray, 0));
     }
     if (totalSeq > 0) {
         _sequenceIdxArray.create(&_group, sequenceIdxArrayName, Hdf5Sequence::idxDataType(), totalSeq + 1, &_dcprops,
-                                 _numChunksInArrayBuffer);
+                                 _numChunksInArrayBuffer, _windowBytes);
 
         _sequenceNameArray.create(&_group, sequenceNameArrayName, Hdf5Sequence::nameDataType(maxName + 1), totalSeq, &_dcprops,
-                                  _numChunksInArrayBuffer);
+                                  _numChunksInArrayBuffer, _windowBytes);
 
         writeSequences(sequenceDimensions);
     }
@@ -288,7 +293,8 @@ void Hdf5Genome::setGenomeTopDimensions(const vector<Sequence::UpdateInfo> &topD
         _group.unlink(topArrayName);
     } catch (H5::Exception &) {
     }
-    _topArray.create(&_group, topArrayName, Hdf5TopSegment::dataType(), numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer);
+    _topArray.create(&_group, topArrayName, Hdf5TopSegment::dataType(), numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer,
+                     _windowBytes);
     reload();
 }
 
@@ -316,7 +322,7 @@ void Hdf5Genome::setGenomeBottomDimensions(const vector<Sequence::UpdateInfo> &b
     botDC.setChunk(1, &chunk);
 
     _bottomArray.create(&_group, bottomArrayName, Hdf5BottomSegment::dataType(numChildren), numBottomSegments + 1, &botDC,
-                        _numChunksInArrayBuffer);
+                        _numChunksInArrayBuffer, _windowBytes);
     reload();
 }
 
@@ -412,7 +418,7 @@ TopSegmentIteratorPtr Hdf5Genome::getTopSegmentIterator(hal_index_t position) {
     // ownership of topSeg is passed into newIt, whose lifespan is
     // governed by the returned smart pointer
     TopSegmentIterator *topSegIt = new TopSegmentIterator(topSeg);
-    return TopSegmentIteratorPtr(topSegIt);
+    return makeFreeListPtr(topSegIt);
 }
 
 TopSegmentIteratorPtr Hdf5Genome::getTopSegmentIterator(hal_index_t position) const {
@@ -422,7 +428,7 @@ TopSegmentIteratorPtr Hdf5Genome::getTopSegmentIterator(hal_index_t position) co
     // ownership of topSeg is passed into newIt, whose lifespan is
     // governed by the returned smart pointer
     TopSegmentIterator *topSegIt = new TopSegmentIterator(topSeg);
-    return TopSegmentIteratorPtr(topSegIt);
+    return makeFreeListPtr(topSegIt);
 }
 
 BottomSegmentIteratorPtr Hdf5Genome::getBottomSegmentIterator(hal_index_t position) {
@@ -431,7 +437,7 @@ BottomSegmentIteratorPtr Hdf5Genome::getBottomSegmentIterator(hal_index_t positi
     // ownership of botSeg is passed into newIt, whose lifespan is
     // governed by the returned smart pointer
     BottomSegmentIterator *botSegIt = new BottomSegmentIterator(botSeg);
-    return BottomSegmentIteratorPtr(botSegIt);
+    return makeFreeListPtr(botSegIt);
 }
 
 BottomSegmentIteratorPtr Hdf5Genome::getBottomSegmentIterator(hal_index_t position) const {
@@ -441,7 +447,7 @@ BottomSegmentIteratorPtr Hdf5Genome::getBottomSegmentIterator(hal_index_t positi
     // ownership of botSeg is passed into newIt, whose lifespan is
     // governed by the returned smart pointer
     BottomSegmentIterator *botSegIt = new BottomSegmentIterator(botSeg);
-    return BottomSegmentIteratorPtr(botSegIt);
+    return makeFreeListPtr(botSegIt);
 }
 
 DnaIteratorPtr Hdf5Genome::getDnaIterator(hal_index_t position) {
@@ -531,7 +537,7 @@ void Hdf5Genome::read() {
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(dnaArrayName);
-        _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer);
+        _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer, _windowBytes);
         dnaLoaded = true;
     } catch (H5::Exception &) {
     }
@@ -539,13 +545,13 @@ void Hdf5Genome::read() {
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(topArrayName);
-        _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer);
+        _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer, _windowBytes);
     } catch (H5::Exception &) {
     }
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(bottomArrayName);
-        _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer);
+        _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer, _windowBytes);
         _numChildrenInBottomArray = Hdf5BottomSegment::numChildrenFromDataType(_bottomArray.getDataType());
     } catch (H5::Exception &) {
     }
@@ -554,16 +560,20 @@ void Hdf5Genome::read() {
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(sequenceIdxArrayName);
-        _sequenceIdxArray.load(&_group, sequenceIdxArrayName, _numChunksInArrayBuffer);
+        _sequenceIdxArray.load(&_group, sequenceIdxArrayName, _numChunksInArrayBuffer, _windowBytes);
     } catch (H5::Exception &) {
     }
     try {
         HDF5DisableExceptionPrinting prDisable;
         _group.openDataSet(sequenceNameArrayName);
-        _sequenceNameArray.load(&_group, sequenceNameArrayName, _numChunksInArrayBuffer);
+        _sequenceNameArray.load(&_group, sequenceNameArrayName, _numChunksInArrayBuffer, _windowBytes);
     } catch (H5::Exception &) {
     }
 
+    _dnaArray.setReadAhead(_alignment->getReadAhead());
+    _topArray.setReadAhead(_alignment->getReadAhead());
+    _bottomArray.setReadAhead(_alignment->getReadAhead());
+
     readSequences();
     if (dnaLoaded) {
         _dnaAccess = DnaAccessPtr(new HDF5DnaAccess(this, &_dnaArray, 0));
@@ -687,8 +697,7 @@ void Hdf5Genome::writeSequences(const vector<Sequence::Info> &sequenceDimensions
 }
 
 void Hdf5Genome::resetBranchCaches() {
-    _parentCache = NULL;
-    _childCache.clear();
+    clearGenomeCache();
 }
 
 void Hdf5Genome::rename(const string &newName) {
@@ -729,10 +738,29 @@ void Hdf5Genome::resizeNameArray(size_t newMaxSize) {
         }
 
         _sequenceNameArray.create(&_group, sequenceNameArrayName, Hdf5Sequence::nameDataType(newMaxSize + 1), numSequences,
-                                  &_dcprops, _numChunksInArrayBuffer);
+                                  &_dcprops, _numChunksInArrayBuffer, _windowBytes);
         for (size_t i = 0; i < numSequences; i++) {
             char *arrayBuffer = _sequenceNameArray.getUpdate(i);
             strcpy(arrayBuffer, names[i].c_str());
         }
     }
 }
+
+// MEMORY BUDGET CLIENT INTERFACE
+
+hal_size_t Hdf5Genome::getResidentBytes() const {
+    return _dnaArray.getResidentBytes() + _topArray.getResidentBytes() + _bottomArray.getResidentBytes() +
+           _sequenceIdxArray.getResidentBytes() + _sequenceNameArray.getResidentBytes();
+}
+
+void Hdf5Genome::releaseMemory() {
+    // the DNA access points into the buffer of the DNA array
+    if (_dnaAccess) {
+        static_cast<HDF5DnaAccess *>(_dnaAccess.get())->release();
+    }
+    _dnaArray.releaseMemory();
+    _topArray.releaseMemory();
+    _bottomArray.releaseMemory();
+    _sequenceIdxArray.releaseMemory();
+    _sequenceNameArray.releaseMemory();
+}
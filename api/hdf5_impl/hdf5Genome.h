@@ -24,7 +24,7 @@ namespace hal {
     /**
      * HDF5 implementation of hal::Genome
      */
-    class Hdf5Genome : public Genome {
+    class Hdf5Genome : public Genome, public GenomeMemoryBudget::Client {
         friend class Hdf5TopSegment;
         friend class Hdf5BottomSegment;
         friend class Hdf5SequenceIterator;
@@ -122,6 +122,15 @@ namespace hal {
         void resetTreeCache();
         void resetBranchCaches();
         void renameSequence(const std::string &oldName, size_t index, const std::string &newName);
+        Hdf5ExternalArray &getDnaArray() {
+            return _dnaArray;
+        }
+        Hdf5ExternalArray &getTopArray() {
+            return _topArray;
+        }
+        Hdf5ExternalArray &getBottomArray() {
+            return _bottomArray;
+        }
 
       private:
         void readSequences();
@@ -134,6 +143,12 @@ namespace hal {
         void setGenomeBottomDimensions(const std::vector<hal::Sequence::UpdateInfo> &sequenceDimensions);
         void resizeNameArray(size_t newMaxSize);
 
+        // MEMORY BUDGET CLIENT INTERFACE
+
+        hal_size_t getResidentBytes() const;
+
+        void releaseMemory();
+
       private:
         Hdf5Alignment *_alignment;
         H5::PortableH5Location *_h5Parent;
@@ -156,6 +171,7 @@ namespace hal {
         hal_size_t _numChildrenInBottomArray;
         hal_size_t _totalSequenceLength;
         hal_size_t _numChunksInArrayBuffer;
+        hsize_t _windowBytes;
 
         mutable std::map<hal_size_t, Hdf5Sequence *> _sequencePosCache;
         mutable std::vector<Hdf5Sequence *> _zeroLenPosCache;
@@ -55,11 +55,7 @@ namespace hal {
         // HDF5 SPECIFIC
         static H5::CompType dataType();
 
-      private:
-        Hdf5Genome *getHdf5Genome() const {
-            return static_cast<Hdf5Genome *>(_genome);
-        }
-
+        // layout of an element of the array
         static const size_t genomeIndexOffset;
         static const size_t bottomIndexOffset;
         static const size_t parIndexOffset;
@@ -67,6 +63,11 @@ namespace hal {
         static const size_t parentReversedOffset;
         static const size_t totalSize;
 
+      private:
+        Hdf5Genome *getHdf5Genome() const {
+            return static_cast<Hdf5Genome *>(_genome);
+        }
+
         Hdf5ExternalArray *_array;
     };
 
@@ -131,10 +131,64 @@ void hdf5ExternalArrayTestCompression(CuTest *testCase) {
     }
 }
 
+void hdf5ExternalArrayTestWindow(CuTest *testCase) {
+    // 499999 = 31 * 127 * 127, so the last chunk holds one element
+    static const hsize_t oddChunkSize = 16129;
+    static const hsize_t windowSize = 1000;
+    setup();
+    try {
+        // unchunked datasets are paged through a window of bounded size
+        {
+            IntType datatype(PredType::NATIVE_HSIZE);
+            H5File file(H5std_string(fileName), H5F_ACC_TRUNC);
+            Hdf5ExternalArray myArray;
+            myArray.create(&file, datasetName, datatype, N, NULL, 1, windowSize * sizeof(int64_t));
+            CuAssertTrue(testCase, myArray.getBufCapacity() == windowSize);
+            for (hsize_t i = 0; i < N; ++i) {
+                hsize_t *block = reinterpret_cast<hsize_t *>(myArray.getUpdate(i));
+                *block = i;
+            }
+            myArray.write();
+            file.flush(H5F_SCOPE_LOCAL);
+            file.close();
+            checkNumbers(testCase);
+
+            H5File rfile(H5std_string(fileName), H5F_ACC_RDONLY);
+            Hdf5ExternalArray myrArray;
+            myrArray.load(&rfile, datasetName, 1, windowSize * sizeof(int64_t));
+            CuAssertTrue(testCase, myrArray.getBufCapacity() == windowSize);
+            for (hsize_t i = N; i > 0; --i) {
+                const int64_t *val = reinterpret_cast<const int64_t *>(myrArray.get(i - 1));
+                CuAssertTrue(testCase, *val == numbers[i - 1]);
+                CuAssertTrue(testCase, myrArray.getBufEnd() - myrArray.getBufStart() < windowSize);
+            }
+            rfile.close();
+        }
+
+        // a short last chunk doesn't shrink the buffer for the others
+        writeNumbers(oddChunkSize);
+        H5File cfile(H5std_string(fileName), H5F_ACC_RDONLY);
+        Hdf5ExternalArray mycArray;
+        mycArray.load(&cfile, datasetName);
+        CuAssertTrue(testCase, *reinterpret_cast<const int64_t *>(mycArray.get(N - 1)) == numbers[N - 1]);
+        CuAssertTrue(testCase, mycArray.getBufStart() == N - 1 && mycArray.getBufEnd() == N - 1);
+        CuAssertTrue(testCase, *reinterpret_cast<const int64_t *>(mycArray.get(0)) == numbers[0]);
+        CuAssertTrue(testCase, mycArray.getBufStart() == 0 && mycArray.getBufEnd() == oddChunkSize - 1);
+        CuAssertTrue(testCase, *reinterpret_cast<const int64_t *>(mycArray.get(oddChunkSize)) == numbers[oddChunkSize]);
+    } catch (Exception &exception) {
+        cerr << exception.getCDetailMsg() << endl;
+        CuAssertTrue(testCase, 0);
+    } catch (...) {
+        CuAssertTrue(testCase, 0);
+    }
+    teardown();
+}
+
 CuSuite *hdf5ExternalArrayTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCreate);
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestLoad);
     SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCompression);
+    SUITE_ADD_TEST(suite, hdf5ExternalArrayTestWindow);
     return suite;
 }
@@ -69,8 +69,9 @@ Alignment *hal::hdf5AlignmentInstance(const std::string &alignmentPath, unsigned
     return new Hdf5Alignment(alignmentPath, mode, fileCreateProps, fileAccessProps, datasetCreateProps, inMemory);
 }
 
-Alignment *hal::mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode, size_t fileSize) {
-    return new MMapAlignment(alignmentPath, mode, fileSize);
+Alignment *hal::mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode, size_t fileSize, bool packDna,
+                                      bool compactSegments, bool compress, size_t cacheBytes) {
+    return new MMapAlignment(alignmentPath, mode, fileSize, packDna, compactSegments, compress, cacheBytes);
 }
 
 static const int DETECT_INITIAL_NUM_BYTES = 64;
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halBlockColumnIterator.h"
+#include "halCommon.h"
+#include <algorithm>
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t BlockColumnIterator::defragmentInterval = 1000;
+
+BlockColumnIterator::BlockColumnIterator(const ColumnIteratorPtr &colIt, hal_size_t maxBlockLength)
+    : _colIt(colIt), _maxBlockLength(maxBlockLength), _numColumnsRead(0), _length(0), _refSequence(NULL),
+      _refStart(NULL_INDEX), _refStep(0), _lastRefPosition(NULL_INDEX), _nextRefSequence(NULL),
+      _nextRefPosition(NULL_INDEX), _hasNextColumn(true) {
+    readColumn();
+}
+
+bool BlockColumnIterator::toNextBlock() {
+    if (_hasNextColumn == false) {
+        _rows.clear();
+        _length = 0;
+        return false;
+    }
+
+    // start the block with the column read ahead by the last call
+    _lastColumn.swap(_nextColumn);
+    _lastRefPosition = _nextRefPosition;
+    _refSequence = _nextRefSequence;
+    _refStart = _nextRefPosition;
+    _refStep = 0;
+    _length = 1;
+    _rows.resize(_lastColumn.size());
+    for (size_t i = 0; i < _lastColumn.size(); ++i) {
+        const ColumnIterator::ColumnRow &column = _lastColumn[i];
+        BlockRow &row = _rows[i];
+        row._sequence = column._sequence;
+        row._genomeIndex = column._genomeIndex;
+        row._start = column._position;
+        row._step = column._reversed ? -1 : 1;
+        row._reversed = column._reversed;
+    }
+
+    // add columns until one doesn't line up with the last, which is then
+    // kept for the next block
+    while (true) {
+        if (_colIt->lastColumn()) {
+            _hasNextColumn = false;
+            break;
+        }
+        _colIt->toRight();
+        if (++_numColumnsRead % defragmentInterval == 0) {
+            _colIt->defragment();
+        }
+        readColumn();
+        if (_length == _maxBlockLength || !extendsBlock()) {
+            break;
+        }
+        if (_length == 1) {
+            // the second column fixes the direction of each row
+            _refStep = _nextRefPosition - _lastRefPosition;
+            for (size_t i = 0; i < _rows.size(); ++i) {
+                _rows[i]._step = _nextColumn[i]._position - _lastColumn[i]._position;
+            }
+        }
+        ++_length;
+        _lastColumn.swap(_nextColumn);
+        _lastRefPosition = _nextRefPosition;
+    }
+    return true;
+}
+
+void BlockColumnIterator::getRowString(size_t row, string &outString) const {
+    const BlockRow &blockRow = _rows.at(row);
+    hal_index_t first = blockRow._step > 0 ? blockRow._start : blockRow._start - (hal_index_t)_length + 1;
+    blockRow._sequence->getSubString(outString, first, _length);
+    if (blockRow._step < 0) {
+        reverse(outString.begin(), outString.end());
+    }
+    if (blockRow._reversed) {
+        for (size_t i = 0; i < outString.length(); ++i) {
+            outString[i] = reverseComplement(outString[i]);
+        }
+    }
+}
+
+void BlockColumnIterator::readColumn() {
+    _colIt->getColumnRows(_nextColumn);
+    _nextRefSequence = _colIt->getReferenceSequence();
+    _nextRefPosition = _colIt->getReferenceSequencePosition();
+}
+
+bool BlockColumnIterator::extendsBlock() const {
+    if (_nextRefSequence != _refSequence || _nextColumn.size() != _lastColumn.size()) {
+        return false;
+    }
+    hal_index_t refStep = _nextRefPosition - _lastRefPosition;
+    if (_length == 1 ? (refStep != 1 && refStep != -1) : refStep != _refStep) {
+        return false;
+    }
+    for (size_t i = 0; i < _nextColumn.size(); ++i) {
+        const ColumnIterator::ColumnRow &last = _lastColumn[i];
+        const ColumnIterator::ColumnRow &next = _nextColumn[i];
+        if (next._sequence != last._sequence || next._reversed != last._reversed) {
+            return false;
+        }
+        hal_index_t step = next._position - last._position;
+        if (_length == 1 ? (step != 1 && step != -1) : step != _rows[i]._step) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -5,6 +5,7 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include "halCLParser.h"
+#include "halLocalBlockCache.h"
 #include "hdf5Alignment.h"
 #include "mmapAlignment.h"
 #include <cassert>
@@ -23,8 +24,24 @@ CLParser::CLParser(unsigned mode) : _prefix("--"), _maxArgLen(0), _maxOptLen(0)
     Hdf5Alignment::defineOptions(this, mode);
     MMapAlignment::defineOptions(this, mode);
     addOption("format", "choose the back-end storage format.", STORAGE_FORMAT_HDF5);
-#ifdef ENABLE_UDC
+    addOption("genomeMemoryBudget",
+              "memory (in megabytes) open genomes may hold in buffers, caches and mapped pages before that of the "
+              "least recently used is released, 0 for no limit",
+              0);
+    addOptionFlag("genomeMemoryStats", "print the memory held by open genomes to stderr when the alignment is closed",
+                  false);
     // these can be used by multiple storage formats
+    addOption("blockCacheDir",
+              "local directory (e.g. on SSD) caching the blocks read from *input* hal file(s) on a slow shared or network "
+              "filesystem, for later reads by any process on this machine",
+              "");
+    addOption("blockCacheSize",
+              "size (in megabytes) --blockCacheDir is kept within by deleting the copies of the least recently opened "
+              "files, 0 for no limit",
+              0);
+    addOption("blockCacheBlockSize", "size (in kilobytes) of the blocks copied to --blockCacheDir",
+              LOCAL_BLOCK_CACHE_DEFAULT_BLOCK_SIZE / 1024);
+#ifdef ENABLE_UDC
     addOption("udcCacheDir", "udc cache path for *input* hal file(s).", "");
     addOptionFlag("udcVerbose", "enable verbose output from UDC", false);
 #endif
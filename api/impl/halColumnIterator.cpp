@@ -189,6 +189,55 @@ hal_index_t ColumnIterator::getArrayIndex() const {
     return _stack[0]->_index;
 }
 
+void ColumnIterator::getColumnRows(vector<ColumnRow> &rows) const {
+    rows.clear();
+    appendColumnRows(rows);
+}
+
+hal_size_t ColumnIterator::readColumns(ColumnBatch &batch, hal_size_t maxColumns) {
+    hal_size_t numColumns = 0;
+    while (numColumns < maxColumns) {
+        appendColumnRows(batch._rows);
+        batch._columnStarts.push_back(batch._rows.size());
+        ++numColumns;
+        if (numColumns == maxColumns || lastColumn()) {
+            break;
+        }
+        toRight();
+    }
+    return numColumns;
+}
+
+const vector<const Genome *> &ColumnIterator::getColumnGenomes() const {
+    return _columnGenomes;
+}
+
+void ColumnIterator::appendColumnRows(vector<ColumnRow> &rows) const {
+    for (ColumnMap::const_iterator i = _colMap.begin(); i != _colMap.end(); ++i) {
+        const DNASet *dnaSet = i->second;
+        if (dnaSet->empty()) {
+            continue;
+        }
+        const Sequence *sequence = i->first;
+        const Genome *genome = sequence->getGenome();
+        auto genomeIt = _columnGenomeIndexes.find(genome);
+        if (genomeIt == _columnGenomeIndexes.end()) {
+            genomeIt = _columnGenomeIndexes.insert(make_pair(genome, (hal_index_t)_columnGenomes.size())).first;
+            _columnGenomes.push_back(genome);
+        }
+        ColumnRow row;
+        row._sequence = sequence;
+        row._genomeIndex = genomeIt->second;
+        row._sequenceIndex = sequence->getArrayIndex();
+        for (DNASet::const_iterator j = dnaSet->begin(); j != dnaSet->end(); ++j) {
+            row._position = (*j)->getArrayIndex() - sequence->getStartPosition();
+            row._base = (*j)->getBase();
+            row._reversed = (*j)->getReversed();
+            rows.push_back(row);
+        }
+    }
+}
+
 void ColumnIterator::defragment() {
     ColumnMap::iterator i = _colMap.begin();
     ColumnMap::iterator next;
@@ -0,0 +1,475 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halConvert.h"
+#include "halAlignment.h"
+#include "halCommon.h"
+#include "halGenome.h"
+#include "halSequenceIterator.h"
+#include "hdf5BottomSegment.h"
+#include "hdf5Genome.h"
+#include "hdf5TopSegment.h"
+#include "mmapBottomSegmentData.h"
+#include "mmapGenome.h"
+#include "mmapSegmentTable.h"
+#include "mmapTopSegmentData.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <zlib.h>
+
+using namespace std;
+using namespace hal;
+
+/* HDF5 chunks per block of work, when an array is stored in HDF5 */
+static const hal_size_t chunksPerBlock = 64;
+
+/* bytes per block of work otherwise */
+static const hal_size_t bytesPerBlock = 4 * 1024 * 1024;
+
+/* the HDF5 C++ API isn't thread-safe, all HDF5 calls are made holding this */
+static mutex hdf5Mutex;
+
+template <typename T> static inline T getField(const char *element, size_t offset) {
+    T value;
+    memcpy(&value, element + offset, sizeof(T));
+    return value;
+}
+
+template <typename T> static inline void setField(char *element, size_t offset, T value) {
+    memcpy(element + offset, &value, sizeof(T));
+}
+
+namespace {
+    /* The DNA, top segment or bottom segment array of a genome.  Elements
+     * are transferred laid out as they are in HDF5 files; a segment array
+     * has an extra element after the last segment holding its end. */
+    class ConvertArray {
+      public:
+        ConvertArray(hal_size_t size, size_t elementSize) : _size(size), _elementSize(elementSize) {
+        }
+        virtual ~ConvertArray() {
+        }
+        hal_size_t getSize() const {
+            return _size;
+        }
+        size_t getElementSize() const {
+            return _elementSize;
+        }
+        /* elements per chunk if the array is stored in HDF5 chunks, else 0 */
+        virtual hal_size_t getChunkSize() const {
+            return 0;
+        }
+        virtual void read(hal_size_t start, hal_size_t count, char *elements) = 0;
+        virtual void write(hal_size_t start, hal_size_t count, const char *elements) = 0;
+
+      protected:
+        hal_size_t _size;
+        size_t _elementSize;
+    };
+
+    /* An array of an HDF5 genome.  Whole chunks are transferred with direct
+     * chunk access when possible, deflating or inflating them outside the
+     * HDF5 library. */
+    class Hdf5ConvertArray : public ConvertArray {
+      public:
+        Hdf5ConvertArray(Hdf5ExternalArray &array, const H5::DataType &dataType)
+            : ConvertArray(array.getSize(), array.getDataType().getSize()), _array(array) {
+            lock_guard<mutex> lock(hdf5Mutex);
+            _chunkSize = array.getDataSetChunkSize();
+            _deflateLevel = array.getRawChunkDeflateLevel(dataType);
+        }
+        hal_size_t getChunkSize() const {
+            return _chunkSize;
+        }
+        void read(hal_size_t start, hal_size_t count, char *elements);
+        void write(hal_size_t start, hal_size_t count, const char *elements);
+
+      private:
+        /* can the range be transferred as whole chunks? */
+        bool isRawChunkRange(hal_size_t start, hal_size_t count) const {
+            return (_deflateLevel >= 0) && (_chunkSize > 0) && ((start % _chunkSize) == 0) &&
+                   (((count % _chunkSize) == 0) || (start + count == _size));
+        }
+
+        Hdf5ExternalArray &_array;
+        hal_size_t _chunkSize;
+        int _deflateLevel;
+    };
+
+    /* DNA of an mmap genome, which is stored a base per nibble unless it
+     * is packed */
+    class MMapDnaConvertArray : public ConvertArray {
+      public:
+        MMapDnaConvertArray(MMapGenome *genome)
+            : ConvertArray((genome->getSequenceLength() + 1) / 2, 1), _genome(genome) {
+        }
+        void read(hal_size_t start, hal_size_t count, char *elements);
+        void write(hal_size_t start, hal_size_t count, const char *elements) {
+            memcpy(_genome->getDNA(start, count), elements, count);
+        }
+
+      private:
+        MMapGenome *_genome;
+    };
+
+    /* top segments of an mmap genome, which may be a compact table */
+    class MMapTopConvertArray : public ConvertArray {
+      public:
+        MMapTopConvertArray(MMapGenome *genome)
+            : ConvertArray(genome->getNumTopSegments() + 1, Hdf5TopSegment::totalSize), _genome(genome) {
+        }
+        void read(hal_size_t start, hal_size_t count, char *elements);
+        void write(hal_size_t start, hal_size_t count, const char *elements);
+
+      private:
+        MMapGenome *_genome;
+    };
+
+    /* bottom segments of an mmap genome, which may be a compact table */
+    class MMapBottomConvertArray : public ConvertArray {
+      public:
+        MMapBottomConvertArray(MMapGenome *genome)
+            : ConvertArray(genome->getNumBottomSegments() + 1, Hdf5BottomSegment::totalSize(genome->getNumChildren())),
+              _genome(genome), _numChildren(genome->getNumChildren()) {
+        }
+        void read(hal_size_t start, hal_size_t count, char *elements);
+        void write(hal_size_t start, hal_size_t count, const char *elements);
+
+      private:
+        static size_t childIndexOffset(hal_size_t child) {
+            return Hdf5BottomSegment::firstChildOffset + child * (sizeof(hal_index_t) + sizeof(bool));
+        }
+
+        MMapGenome *_genome;
+        hal_size_t _numChildren;
+    };
+
+    /* a range of elements of an array to copy */
+    struct ConvertBlock {
+        ConvertArray *inArray;
+        ConvertArray *outArray;
+        hal_size_t start;
+        hal_size_t count;
+    };
+}
+
+void Hdf5ConvertArray::read(hal_size_t start, hal_size_t count, char *elements) {
+    if (not isRawChunkRange(start, count)) {
+        lock_guard<mutex> lock(hdf5Mutex);
+        _array.readRange(start, count, elements);
+        return;
+    }
+    size_t chunkBytes = _chunkSize * _elementSize;
+    vector<char> raw;
+    vector<char> chunk(chunkBytes);
+    for (hal_size_t first = start; first < start + count; first += _chunkSize) {
+        bool deflated = false;
+        {
+            lock_guard<mutex> lock(hdf5Mutex);
+            _array.readRawChunk(first / _chunkSize, raw, deflated);
+        }
+        const char *chunkData = raw.data();
+        if (deflated) {
+            uLongf length = chunkBytes;
+            if ((uncompress(reinterpret_cast<Bytef *>(chunk.data()), &length, reinterpret_cast<const Bytef *>(raw.data()),
+                            raw.size()) != Z_OK) ||
+                (length != chunkBytes)) {
+                throw hal_exception("error: can't inflate chunk " + std::to_string(first / _chunkSize) + " of hdf5 array");
+            }
+            chunkData = chunk.data();
+        } else if (raw.size() != chunkBytes) {
+            throw hal_exception("error: chunk " + std::to_string(first / _chunkSize) + " of hdf5 array has the wrong size");
+        }
+        hal_size_t n = min(_chunkSize, start + count - first);
+        memcpy(elements + (first - start) * _elementSize, chunkData, n * _elementSize);
+    }
+}
+
+void Hdf5ConvertArray::write(hal_size_t start, hal_size_t count, const char *elements) {
+    if (not isRawChunkRange(start, count)) {
+        lock_guard<mutex> lock(hdf5Mutex);
+        _array.writeRange(start, count, elements);
+        return;
+    }
+    size_t chunkBytes = _chunkSize * _elementSize;
+    vector<char> chunk(chunkBytes);
+    vector<char> raw;
+    for (hal_size_t first = start; first < start + count; first += _chunkSize) {
+        // the last chunk is stored whole, padded with the fill value
+        hal_size_t n = min(_chunkSize, start + count - first);
+        memcpy(chunk.data(), elements + (first - start) * _elementSize, n * _elementSize);
+        memset(chunk.data() + n * _elementSize, 0, (_chunkSize - n) * _elementSize);
+        if (_deflateLevel > 0) {
+            uLongf length = compressBound(chunkBytes);
+            raw.resize(length);
+            if (compress2(reinterpret_cast<Bytef *>(raw.data()), &length, reinterpret_cast<const Bytef *>(chunk.data()),
+                          chunkBytes, _deflateLevel) != Z_OK) {
+                throw hal_exception("error: can't deflate chunk " + std::to_string(first / _chunkSize) + " of hdf5 array");
+            }
+            raw.resize(length);
+        } else {
+            raw = chunk;
+        }
+        lock_guard<mutex> lock(hdf5Mutex);
+        _array.writeRawChunk(first / _chunkSize, raw);
+    }
+}
+
+void MMapDnaConvertArray::read(hal_size_t start, hal_size_t count, char *elements) {
+    if (_genome->getPackedDna() == NULL) {
+        memcpy(elements, _genome->getDNA(start, count), count);
+        return;
+    }
+    // two bases per byte, the last byte may hold only one
+    hal_size_t firstBase = start * 2;
+    hal_size_t numBases = min(count * 2, _genome->getSequenceLength() - firstBase);
+    vector<char> bases(numBases);
+    _genome->getBases(firstBase, numBases, bases.data());
+    memset(elements, 0, count);
+    dnaPackString(bases.data(), numBases, elements, 0);
+}
+
+void MMapTopConvertArray::read(hal_size_t start, hal_size_t count, char *elements) {
+    const MMapSegmentTable *table = _genome->getTopSegmentTable();
+    hal_size_t last = _size - 1; // element holding the end of the last segment
+    memset(elements, 0, count * _elementSize);
+    for (hal_size_t i = start; i < start + count; ++i) {
+        char *element = elements + (i - start) * _elementSize;
+        if (table != NULL) {
+            setField<hal_index_t>(element, Hdf5TopSegment::genomeIndexOffset, table->getStartPosition(_genome->_alignment, i));
+            if (i < last) {
+                setField<hal_index_t>(element, Hdf5TopSegment::bottomIndexOffset,
+                                      table->getIndex(_genome->_alignment, MMapSegmentTable::TOP_PARSE_INDEX, i));
+                setField<hal_index_t>(element, Hdf5TopSegment::parIndexOffset,
+                                      table->getIndex(_genome->_alignment, MMapSegmentTable::TOP_PARALOGY_INDEX, i));
+                setField<hal_index_t>(element, Hdf5TopSegment::parentIndexOffset,
+                                      table->getIndex(_genome->_alignment, MMapSegmentTable::TOP_PARENT_INDEX, i));
+                setField<bool>(element, Hdf5TopSegment::parentReversedOffset, table->getFlag(_genome->_alignment, 0, i));
+            }
+        } else {
+            const MMapTopSegmentData *segment = _genome->getTopSegmentPointer(i);
+            setField<hal_index_t>(element, Hdf5TopSegment::genomeIndexOffset, segment->getStartPosition());
+            if (i < last) {
+                setField<hal_index_t>(element, Hdf5TopSegment::bottomIndexOffset, segment->getBottomParseIndex());
+                setField<hal_index_t>(element, Hdf5TopSegment::parIndexOffset, segment->getNextParalogyIndex());
+                setField<hal_index_t>(element, Hdf5TopSegment::parentIndexOffset, segment->getParentIndex());
+                setField<bool>(element, Hdf5TopSegment::parentReversedOffset, segment->getReversed() != 0);
+            }
+        }
+    }
+}
+
+void MMapTopConvertArray::write(hal_size_t start, hal_size_t count, const char *elements) {
+    for (hal_size_t i = start; i < start + count; ++i) {
+        const char *element = elements + (i - start) * _elementSize;
+        MMapTopSegmentData *segment = _genome->getTopSegmentPointer(i);
+        segment->setStartPosition(getField<hal_index_t>(element, Hdf5TopSegment::genomeIndexOffset));
+        segment->setBottomParseIndex(getField<hal_index_t>(element, Hdf5TopSegment::bottomIndexOffset));
+        segment->setNextParalogyIndex(getField<hal_index_t>(element, Hdf5TopSegment::parIndexOffset));
+        segment->setParentIndex(getField<hal_index_t>(element, Hdf5TopSegment::parentIndexOffset));
+        segment->setReversed(getField<char>(element, Hdf5TopSegment::parentReversedOffset) != 0);
+    }
+}
+
+void MMapBottomConvertArray::read(hal_size_t start, hal_size_t count, char *elements) {
+    const MMapSegmentTable *table = _genome->getBottomSegmentTable();
+    hal_size_t last = _size - 1; // element holding the end of the last segment
+    memset(elements, 0, count * _elementSize);
+    for (hal_size_t i = start; i < start + count; ++i) {
+        char *element = elements + (i - start) * _elementSize;
+        if (table != NULL) {
+            setField<hal_index_t>(element, Hdf5BottomSegment::genomeIndexOffset,
+                                  table->getStartPosition(_genome->_alignment, i));
+            if (i < last) {
+                setField<hal_index_t>(element, Hdf5BottomSegment::topIndexOffset,
+                                      table->getIndex(_genome->_alignment, MMapSegmentTable::BOTTOM_PARSE_INDEX, i));
+                for (hal_size_t child = 0; child < _numChildren; ++child) {
+                    setField<hal_index_t>(
+                        element, childIndexOffset(child),
+                        table->getIndex(_genome->_alignment, MMapSegmentTable::BOTTOM_CHILD_INDEX + child, i));
+                    setField<bool>(element, childIndexOffset(child) + sizeof(hal_index_t),
+                                   table->getFlag(_genome->_alignment, child, i));
+                }
+            }
+        } else {
+            const MMapBottomSegmentData *segment = _genome->getBottomSegmentPointer(i);
+            setField<hal_index_t>(element, Hdf5BottomSegment::genomeIndexOffset, segment->getStartPosition());
+            if (i < last) {
+                setField<hal_index_t>(element, Hdf5BottomSegment::topIndexOffset, segment->getTopParseIndex());
+                for (hal_size_t child = 0; child < _numChildren; ++child) {
+                    setField<hal_index_t>(element, childIndexOffset(child), segment->getChildIndex(child));
+                    setField<bool>(element, childIndexOffset(child) + sizeof(hal_index_t),
+                                   segment->getChildReversed(_numChildren, child) != 0);
+                }
+            }
+        }
+    }
+}
+
+void MMapBottomConvertArray::write(hal_size_t start, hal_size_t count, const char *elements) {
+    for (hal_size_t i = start; i < start + count; ++i) {
+        const char *element = elements + (i - start) * _elementSize;
+        MMapBottomSegmentData *segment = _genome->getBottomSegmentPointer(i);
+        segment->setStartPosition(getField<hal_index_t>(element, Hdf5BottomSegment::genomeIndexOffset));
+        segment->setTopParseIndex(getField<hal_index_t>(element, Hdf5BottomSegment::topIndexOffset));
+        for (hal_size_t child = 0; child < _numChildren; ++child) {
+            segment->setChildIndex(child, getField<hal_index_t>(element, childIndexOffset(child)));
+            segment->setChildReversed(_numChildren, child,
+                                      getField<char>(element, childIndexOffset(child) + sizeof(hal_index_t)) != 0);
+        }
+    }
+}
+
+/* get the DNA, top and bottom arrays of a genome, NULL where it has none */
+static void getConvertArrays(const Genome *genome, vector<unique_ptr<ConvertArray>> &arrays) {
+    Genome *mutableGenome = const_cast<Genome *>(genome);
+    Hdf5Genome *hdf5Genome = dynamic_cast<Hdf5Genome *>(mutableGenome);
+    MMapGenome *mmapGenome = dynamic_cast<MMapGenome *>(mutableGenome);
+    arrays.clear();
+    arrays.resize(3);
+    if (hdf5Genome != NULL) {
+        if (genome->containsDNAArray() && (genome->getSequenceLength() > 0)) {
+            arrays[0].reset(new Hdf5ConvertArray(hdf5Genome->getDnaArray(), Hdf5Genome::dnaDataType()));
+        }
+        if (genome->getNumTopSegments() > 0) {
+            arrays[1].reset(new Hdf5ConvertArray(hdf5Genome->getTopArray(), Hdf5TopSegment::dataType()));
+        }
+        if (genome->getNumBottomSegments() > 0) {
+            arrays[2].reset(new Hdf5ConvertArray(hdf5Genome->getBottomArray(),
+                                                 Hdf5BottomSegment::dataType(genome->getNumChildren())));
+        }
+    } else if (mmapGenome != NULL) {
+        if (genome->getSequenceLength() > 0) {
+            arrays[0].reset(new MMapDnaConvertArray(mmapGenome));
+        }
+        if (genome->getNumTopSegments() > 0) {
+            arrays[1].reset(new MMapTopConvertArray(mmapGenome));
+        }
+        if (genome->getNumBottomSegments() > 0) {
+            arrays[2].reset(new MMapBottomConvertArray(mmapGenome));
+        }
+    } else {
+        throw hal_exception("can't convert genome " + genome->getName() + ", storage format not supported");
+    }
+}
+
+/* split the copy of an array into blocks, aligned to the HDF5 chunks of
+ * the output, or failing that the input */
+static void addConvertBlocks(ConvertArray *inArray, ConvertArray *outArray, deque<ConvertBlock> &blocks) {
+    if ((inArray->getSize() != outArray->getSize()) || (inArray->getElementSize() != outArray->getElementSize())) {
+        throw hal_exception("array dimensions of converted genome don't match");
+    }
+    hal_size_t chunkSize = outArray->getChunkSize() > 0 ? outArray->getChunkSize() : inArray->getChunkSize();
+    hal_size_t blockSize = chunkSize > 0 ? chunkSize * chunksPerBlock : max(bytesPerBlock / inArray->getElementSize(), (size_t)1);
+    for (hal_size_t start = 0; start < inArray->getSize(); start += blockSize) {
+        blocks.push_back({inArray, outArray, start, min(blockSize, inArray->getSize() - start)});
+    }
+}
+
+/* copy the blocks with numThreads threads */
+static void convertBlocks(deque<ConvertBlock> &blocks, unsigned numThreads) {
+    atomic<size_t> nextBlock(0);
+    vector<exception_ptr> errors(numThreads);
+    vector<thread> threads;
+    for (unsigned t = 0; t < numThreads; ++t) {
+        threads.push_back(thread([&, t]() {
+            try {
+                vector<char> elements;
+                for (size_t i = nextBlock++; i < blocks.size(); i = nextBlock++) {
+                    const ConvertBlock &block = blocks[i];
+                    elements.resize(block.count * block.inArray->getElementSize());
+                    block.inArray->read(block.start, block.count, elements.data());
+                    block.outArray->write(block.start, block.count, elements.data());
+                }
+            } catch (...) {
+                errors[t] = current_exception();
+                nextBlock = blocks.size(); // stop the other threads
+            }
+        }));
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    for (exception_ptr &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+ConvertStats hal::convertAlignment(const Alignment *inAlignment, Alignment *outAlignment, unsigned numThreads) {
+    if (outAlignment->getNumGenomes() != 0) {
+        throw hal_exception("output alignment for conversion must be empty");
+    }
+    if (numThreads == 0) {
+        numThreads = max(thread::hardware_concurrency(), 1u);
+    }
+
+    // the tree, with children in the same order so the child indexes of the
+    // bottom segments carry over
+    vector<string> names(1, inAlignment->getRootName());
+    outAlignment->addRootGenome(names.front());
+    for (size_t i = 0; i < names.size(); ++i) {
+        vector<string> childNames = inAlignment->getChildNames(names[i]);
+        for (const string &childName : childNames) {
+            outAlignment->addLeafGenome(childName, names[i], inAlignment->getBranchLength(names[i], childName));
+            names.push_back(childName);
+        }
+        if (outAlignment->getChildNames(names[i]) != childNames) {
+            throw hal_exception("children of genome " + names[i] + " are out of order in converted alignment");
+        }
+    }
+    // dimensions are set one genome at a time, as they allocate space in
+    // the output file, then the arrays of all genomes are copied at once
+    ConvertStats stats;
+    vector<pair<const Genome *, Genome *>> genomes;
+    vector<unique_ptr<ConvertArray>> arrays;
+    deque<ConvertBlock> blocks;
+    for (const string &name : names) {
+        const Genome *inGenome = inAlignment->openGenome(name);
+        Genome *outGenome = outAlignment->openGenome(name);
+        bool root = inGenome->getParent() == NULL;
+        bool leaf = inGenome->getNumChildren() == 0;
+        vector<Sequence::Info> dimensions;
+        for (SequenceIteratorPtr seqIt = inGenome->getSequenceIterator(); not seqIt->atEnd(); seqIt->toNext()) {
+            const Sequence *sequence = seqIt->getSequence();
+            dimensions.push_back(Sequence::Info(sequence->getName(), sequence->getSequenceLength(),
+                                                root ? 0 : sequence->getNumTopSegments(),
+                                                leaf ? 0 : sequence->getNumBottomSegments()));
+        }
+        outGenome->setDimensions(dimensions, inGenome->containsDNAArray());
+        inGenome->copyMetadata(outGenome);
+        genomes.push_back(make_pair(inGenome, outGenome));
+
+        vector<unique_ptr<ConvertArray>> inArrays, outArrays;
+        getConvertArrays(inGenome, inArrays);
+        getConvertArrays(outGenome, outArrays);
+        for (size_t i = 0; i < inArrays.size(); ++i) {
+            if ((inArrays[i] != NULL) && (outArrays[i] != NULL)) {
+                addConvertBlocks(inArrays[i].get(), outArrays[i].get(), blocks);
+                stats.numBytes += inArrays[i]->getSize() * inArrays[i]->getElementSize();
+                arrays.push_back(move(inArrays[i]));
+                arrays.push_back(move(outArrays[i]));
+            }
+        }
+        stats.numGenomes += 1;
+        stats.numBases += inGenome->getSequenceLength();
+        stats.numTopSegments += outGenome->getNumTopSegments();
+        stats.numBottomSegments += outGenome->getNumBottomSegments();
+    }
+    convertBlocks(blocks, numThreads);
+
+    for (auto &inOut : genomes) {
+        outAlignment->closeGenome(inOut.second);
+        inAlignment->closeGenome(inOut.first);
+    }
+    return stats;
+}
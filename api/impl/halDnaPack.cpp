@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "halCommon.h"
+#include <algorithm>
+#include <cstring>
+
+// bulk conversion between characters and the nibble encoding.  on x86-64 the
+// kernels use SSSE3 or AVX2 table lookups, picked when the library is loaded
+// from what the CPU supports, so the library itself can still be built for
+// the baseline instruction set.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(HAL_NO_SIMD)
+#define HAL_DNA_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace hal;
+
+/* unpack numBytes bytes (two characters each) */
+typedef void (*UnpackKernel)(const uint8_t *packed, size_t numBytes, char *out);
+
+static void unpackScalar(const uint8_t *packed, size_t numBytes, char *out) {
+    for (size_t i = 0; i < numBytes; ++i) {
+        out[2 * i] = dnaUnpackMap[packed[i] >> 4];
+        out[2 * i + 1] = dnaUnpackMap[packed[i] & 0x0F];
+    }
+}
+
+#ifdef HAL_DNA_SIMD
+__attribute__((target("ssse3"))) static void unpackSsse3(const uint8_t *packed, size_t numBytes, char *out) {
+    const __m128i map = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dnaUnpackMap));
+    const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 16 <= numBytes; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(packed + i));
+        __m128i first = _mm_shuffle_epi8(map, _mm_and_si128(_mm_srli_epi16(bytes, 4), lowNibbles));
+        __m128i second = _mm_shuffle_epi8(map, _mm_and_si128(bytes, lowNibbles));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi8(first, second));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 16), _mm_unpackhi_epi8(first, second));
+    }
+    unpackScalar(packed + i, numBytes - i, out + 2 * i);
+}
+
+__attribute__((target("avx2"))) static void unpackAvx2(const uint8_t *packed, size_t numBytes, char *out) {
+    const __m256i map = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(dnaUnpackMap)));
+    const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= numBytes; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(packed + i));
+        __m256i first = _mm256_shuffle_epi8(map, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), lowNibbles));
+        __m256i second = _mm256_shuffle_epi8(map, _mm256_and_si256(bytes, lowNibbles));
+        // the unpacks interleave within each 128-bit lane, so the lanes are
+        // put back in order
+        __m256i low = _mm256_unpacklo_epi8(first, second);
+        __m256i high = _mm256_unpackhi_epi8(first, second);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i), _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * i + 32), _mm256_permute2x128_si256(low, high, 0x31));
+    }
+    unpackScalar(packed + i, numBytes - i, out + 2 * i);
+}
+#endif
+
+static UnpackKernel getUnpackKernel() {
+#ifdef HAL_DNA_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return unpackAvx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        return unpackSsse3;
+    }
+#endif
+    return unpackScalar;
+}
+
+void hal::dnaUnpackString(const char *packed, hal_index_t index, hal_size_t length, char *out) {
+    static const UnpackKernel unpackKernel = getUnpackKernel();
+    if (length == 0) {
+        return;
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(packed) + index / 2;
+    if (index & 1) {
+        *out++ = dnaUnpackMap[*bytes++ & 0x0F];
+        --length;
+    }
+    unpackKernel(bytes, length / 2, out);
+    if (length & 1) {
+        out[length - 1] = dnaUnpackMap[bytes[length / 2] >> 4];
+    }
+}
+
+void hal::dnaPackString(const char *in, hal_size_t length, char *packed, hal_index_t index) {
+    if (length == 0) {
+        return;
+    }
+    if (index & 1) {
+        packed[index / 2] = dnaPack(*in, index, packed[index / 2]);
+        ++in;
+        ++index;
+        --length;
+    }
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(packed) + index / 2;
+    for (hal_size_t i = 0; i < length / 2; ++i) {
+        bytes[i] = (dnaPackMap[uint8_t(in[2 * i])] << 4) | dnaPackMap[uint8_t(in[2 * i + 1])];
+    }
+    if (length & 1) {
+        bytes[length / 2] = dnaPack(in[length - 1], 0, bytes[length / 2]);
+    }
+}
+
+#ifdef HAL_DNA_SIMD
+/* complement 16 characters, or return false if any isn't one of ACGTN in
+ * either case (those are left to the scalar code) */
+__attribute__((target("ssse3"))) static inline bool complement16(__m128i &dna) {
+    // indexed by the low nibble of the character, which is the same for
+    // upper and lower case: the uppercase character expected for that nibble
+    // (0xFF for none), and what to xor it with to complement it
+    const __m128i expected = _mm_setr_epi8(-1, 'A', -1, 'C', 'T', -1, -1, 'G', -1, -1, -1, -1, -1, -1, 'N', -1);
+    const __m128i flip = _mm_setr_epi8(0, 'A' ^ 'T', 0, 'C' ^ 'G', 'A' ^ 'T', 0, 0, 'C' ^ 'G', 0, 0, 0, 0, 0, 0, 0, 0);
+    __m128i lowNibbles = _mm_and_si128(dna, _mm_set1_epi8(0x0F));
+    __m128i upper = _mm_and_si128(dna, _mm_set1_epi8(~0x20));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(upper, _mm_shuffle_epi8(expected, lowNibbles))) != 0xFFFF) {
+        return false;
+    }
+    dna = _mm_xor_si128(dna, _mm_shuffle_epi8(flip, lowNibbles));
+    return true;
+}
+
+/* reverse complement 16 characters from each end at a time, returning how
+ * many have been done at each end */
+__attribute__((target("ssse3"))) static size_t reverseComplementSsse3(char *dna, size_t length) {
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t done = 0;
+    for (; 2 * (done + 16) <= length; done += 16) {
+        char *left = dna + done;
+        char *right = dna + length - done - 16;
+        __m128i leftDna = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(left)), reverse);
+        __m128i rightDna = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(right)), reverse);
+        if (!complement16(leftDna) || !complement16(rightDna)) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(left), rightDna);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(right), leftDna);
+    }
+    return done;
+}
+
+static bool getHaveSsse3() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+}
+#endif
+
+void hal::reverseComplement(char *dna, hal_size_t length) {
+    size_t done = 0;
+#ifdef HAL_DNA_SIMD
+    static const bool haveSsse3 = getHaveSsse3();
+    if (haveSsse3) {
+        done = reverseComplementSsse3(dna, length);
+    }
+#endif
+    char *left = dna + done;
+    char *right = dna + length - done;
+    for (; right - left > 1; ++left) {
+        --right;
+        char buf = reverseComplement(*left);
+        *left = reverseComplement(*right);
+        *right = buf;
+    }
+    if (left + 1 == right) {
+        *left = reverseComplement(*left);
+    }
+}
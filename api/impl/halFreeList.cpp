@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "halFreeList.h"
+#include <new>
+
+using namespace std;
+using namespace hal;
+
+// blocks are rounded up to a multiple of blockAlign, and each multiple up to
+// maxBlockSize has its own list.  a thread keeps at most maxFreeBytes of free
+// blocks, anything more is returned to the heap.
+static const size_t blockAlign = 16;
+static const size_t maxBlockSize = 512;
+static const size_t numBlockSizes = maxBlockSize / blockAlign;
+static const size_t maxFreeBytes = 16 * 1024 * 1024;
+
+// the free lists are bypassed under AddressSanitizer so that it can still
+// catch use-after-free of segments
+#if defined(__SANITIZE_ADDRESS__)
+#define HAL_FREE_LIST_DISABLED 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define HAL_FREE_LIST_DISABLED 1
+#endif
+#endif
+
+namespace {
+    struct FreeBlock {
+        FreeBlock *_next;
+    };
+
+    struct FreeLists {
+        FreeLists() : _freeBytes(0) {
+            for (size_t i = 0; i < numBlockSizes; ++i) {
+                _heads[i] = NULL;
+            }
+        }
+        ~FreeLists();
+
+        FreeBlock *_heads[numBlockSizes];
+        size_t _freeBytes;
+    };
+
+    // set once a thread's lists have been destroyed, as blocks can still be
+    // freed by other thread-local or static destructors after that.
+    thread_local bool freeListsDestroyed = false;
+    thread_local FreeLists freeLists;
+
+    FreeLists::~FreeLists() {
+        for (size_t i = 0; i < numBlockSizes; ++i) {
+            while (_heads[i] != NULL) {
+                FreeBlock *block = _heads[i];
+                _heads[i] = block->_next;
+                ::operator delete(block);
+            }
+        }
+        freeListsDestroyed = true;
+    }
+}
+
+static inline size_t getSizeClass(size_t size) {
+    return size == 0 ? 0 : (size - 1) / blockAlign;
+}
+
+void *hal::freeListAllocate(size_t size) {
+#ifndef HAL_FREE_LIST_DISABLED
+    if (size <= maxBlockSize && !freeListsDestroyed) {
+        size_t sizeClass = getSizeClass(size);
+        FreeLists &lists = freeLists;
+        FreeBlock *block = lists._heads[sizeClass];
+        if (block != NULL) {
+            lists._heads[sizeClass] = block->_next;
+            lists._freeBytes -= (sizeClass + 1) * blockAlign;
+            return block;
+        }
+        return ::operator new((sizeClass + 1) * blockAlign);
+    }
+#endif
+    return ::operator new(size);
+}
+
+void hal::freeListDeallocate(void *ptr, size_t size) {
+#ifndef HAL_FREE_LIST_DISABLED
+    if (ptr != NULL && size <= maxBlockSize && !freeListsDestroyed) {
+        size_t sizeClass = getSizeClass(size);
+        size_t blockSize = (sizeClass + 1) * blockAlign;
+        FreeLists &lists = freeLists;
+        if (lists._freeBytes + blockSize <= maxFreeBytes) {
+            FreeBlock *block = static_cast<FreeBlock *>(ptr);
+            block->_next = lists._heads[sizeClass];
+            lists._heads[sizeClass] = block;
+            lists._freeBytes += blockSize;
+            return;
+        }
+    }
+#endif
+    ::operator delete(ptr);
+}
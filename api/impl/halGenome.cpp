@@ -6,12 +6,16 @@
 #include "halSegmentIterator.h"
 #include "halSequenceIterator.h"
 #include "halTopSegmentIterator.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <map>
 using namespace std;
 using namespace hal;
 
+// number of bases copied at a time by copySequence()
+static const hal_size_t copySequenceBufferSize = 1024 * 1024;
+
 void hal::Genome::copy(Genome *dest) const {
     copyDimensions(dest);
     copySequence(dest);
@@ -246,12 +250,25 @@ void hal::Genome::copySequence(Genome *dest) const {
     DnaIteratorPtr outDna = dest->getDnaIterator();
     hal_size_t n = getSequenceLength();
     assert(n == dest->getSequenceLength());
-    for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), outDna->toRight()) {
-        outDna->setBase(inDna->getBase());
+    vector<char> buffer(min(n, copySequenceBufferSize));
+    for (hal_size_t i = 0; i < n; i += buffer.size()) {
+        hal_size_t length = min(n - i, (hal_size_t)buffer.size());
+        inDna->readBases(buffer.data(), length);
+        outDna->writeBases(buffer.data(), length);
     }
     outDna->flush();
 }
 
+void hal::Genome::getBases(hal_size_t start, hal_size_t length, char *out) const {
+    DnaIteratorPtr dnaIt(getDnaIterator(start));
+    dnaIt->readBases(out, length);
+}
+
+void hal::Genome::setBases(hal_size_t start, hal_size_t length, const char *in) {
+    DnaIteratorPtr dnaIt(getDnaIterator(start));
+    dnaIt->writeBases(in, length);
+}
+
 void hal::Genome::copyMetadata(Genome *dest) const {
     const map<string, string> &meta = getMetaData()->getMap();
     map<string, string>::const_iterator i = meta.begin();
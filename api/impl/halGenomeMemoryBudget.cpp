@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halGenomeMemoryBudget.h"
+#include <algorithm>
+
+using namespace std;
+using namespace hal;
+
+static const double MEGABYTE = 1024. * 1024.;
+
+ostream &hal::operator<<(ostream &os, const GenomeMemoryStats &stats) {
+    os << "genome memory: ";
+    if (stats.budgetBytes > 0) {
+        os << "budget " << stats.budgetBytes / MEGABYTE << " MB, ";
+    } else {
+        os << "no budget, ";
+    }
+    os << "resident " << stats.residentBytes / MEGABYTE << " MB in " << stats.numResidentGenomes << " genomes, peak "
+       << stats.peakResidentBytes / MEGABYTE << " MB, " << stats.numEvictions << " evictions released "
+       << stats.evictedBytes / MEGABYTE << " MB";
+    return os;
+}
+
+GenomeMemoryBudget::GenomeMemoryBudget(hal_size_t budgetBytes, bool track)
+    : _budgetBytes(0), _track(false), _residentBytes(0), _peakResidentBytes(0), _numEvictions(0), _evictedBytes(0) {
+    setBudget(budgetBytes, track);
+}
+
+void GenomeMemoryBudget::setBudget(hal_size_t budgetBytes, bool track) {
+    lock_guard<mutex> lock(_mutex);
+    _budgetBytes = budgetBytes;
+    _track = track || budgetBytes > 0;
+}
+
+void GenomeMemoryBudget::touchTracked(Client *client) {
+    lock_guard<mutex> lock(_mutex);
+    auto found = _entryMap.find(client);
+    if (found == _entryMap.end()) {
+        _entries.push_front(Entry{client, 0});
+        _entryMap[client] = _entries.begin();
+    } else if (found->second != _entries.begin()) {
+        _entries.splice(_entries.begin(), _entries, found->second);
+    }
+    // only the touched client can have grown since it was last counted
+    Entry &entry = _entries.front();
+    hal_size_t bytes = client->getResidentBytes();
+    _residentBytes = _residentBytes - entry.bytes + bytes;
+    entry.bytes = bytes;
+    _peakResidentBytes = max(_peakResidentBytes, _residentBytes);
+    if (_budgetBytes > 0 && _residentBytes > _budgetBytes) {
+        evict(client);
+    }
+}
+
+/* release the memory of the least recently used clients other than keep
+ * until within budget */
+void GenomeMemoryBudget::evict(Client *keep) {
+    for (auto it = _entries.rbegin(); it != _entries.rend() && _residentBytes > _budgetBytes; ++it) {
+        if (it->client == keep || it->bytes == 0) {
+            continue;
+        }
+        it->client->releaseMemory();
+        hal_size_t bytes = min(it->client->getResidentBytes(), it->bytes);
+        _residentBytes -= it->bytes - bytes;
+        _evictedBytes += it->bytes - bytes;
+        ++_numEvictions;
+        it->bytes = bytes;
+    }
+}
+
+void GenomeMemoryBudget::remove(Client *client) {
+    lock_guard<mutex> lock(_mutex);
+    auto found = _entryMap.find(client);
+    if (found != _entryMap.end()) {
+        _residentBytes -= found->second->bytes;
+        _entries.erase(found->second);
+        _entryMap.erase(found);
+    }
+}
+
+GenomeMemoryStats GenomeMemoryBudget::getStats() const {
+    lock_guard<mutex> lock(_mutex);
+    GenomeMemoryStats stats;
+    stats.budgetBytes = _budgetBytes;
+    stats.residentBytes = _residentBytes;
+    stats.peakResidentBytes = _peakResidentBytes;
+    stats.numResidentGenomes = 0;
+    for (const Entry &entry : _entries) {
+        if (entry.bytes > 0) {
+            ++stats.numResidentGenomes;
+        }
+    }
+    stats.numEvictions = _numEvictions;
+    stats.evictedBytes = _evictedBytes;
+    return stats;
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halLocalBlockCache.h"
+#include "halCLParser.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace hal;
+
+/* first line of the info file of a cache entry */
+static const string INFO_FORMAT = "HAL-BLOCK-CACHE 1";
+
+/* suffix of cache entry directories; nothing else in the cache directory
+ * is ever deleted */
+static const string ENTRY_SUFFIX = ".halcache";
+
+/* files of a cache entry: the info file is written last, so an entry
+ * without it is incomplete */
+static const char *const INFO_FILE = "info";
+static const char *const DATA_FILE = "data";
+static const char *const BLOCKS_FILE = "blocks";
+static const char *const ENTRY_FILES[] = {"info", "data", "blocks", "info.tmp", "data.tmp", "blocks.tmp"};
+
+/* blocks are a multiple of this, so they are whole pages and the map of
+ * blocks stays small */
+static const size_t MIN_BLOCK_SIZE = 4096;
+
+LocalBlockCacheConfig LocalBlockCacheConfig::fromOptions(const CLParser *parser) {
+    LocalBlockCacheConfig config;
+    config.dir = parser->getOption<const string &>("blockCacheDir");
+    config.maxBytes = parser->getOption<size_t>("blockCacheSize") * 1024 * 1024;
+    config.blockSize = parser->getOption<size_t>("blockCacheBlockSize") * 1024;
+    return config;
+}
+
+/* read length bytes at offset, failing on a short read */
+static void preadFully(int fd, const string &path, void *buf, size_t length, size_t offset) {
+    char *dest = static_cast<char *>(buf);
+    while (length > 0) {
+        ssize_t n = ::pread(fd, dest, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw hal_errno_exception(path, "read failed", errno);
+        } else if (n == 0) {
+            throw hal_exception(path + ": unexpected end of file");
+        }
+        dest += n;
+        length -= n;
+        offset += n;
+    }
+}
+
+static void pwriteFully(int fd, const string &path, const void *buf, size_t length, size_t offset) {
+    const char *src = static_cast<const char *>(buf);
+    while (length > 0) {
+        ssize_t n = ::pwrite(fd, src, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw hal_errno_exception(path, "write failed", errno);
+        }
+        src += n;
+        length -= n;
+        offset += n;
+    }
+}
+
+/* create a directory unless it exists */
+static void makeDir(const string &path) {
+    if ((::mkdir(path.c_str(), 0777) < 0) && (errno != EEXIST)) {
+        throw hal_errno_exception(path, "can't create block cache directory", errno);
+    }
+}
+
+/* create an empty file of the given size, open for read and write */
+static int createSizedFile(const string &path, size_t size) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        throw hal_errno_exception(path, "can't create block cache file", errno);
+    }
+    if (::ftruncate(fd, size) < 0) {
+        int err = errno;
+        ::close(fd);
+        throw hal_errno_exception(path, "can't size block cache file", err);
+    }
+    return fd;
+}
+
+static void renameFile(const string &fromPath, const string &toPath) {
+    if (::rename(fromPath.c_str(), toPath.c_str()) < 0) {
+        throw hal_errno_exception(toPath, "rename of block cache file failed", errno);
+    }
+}
+
+/* open a file, checking its size, or return -1 */
+static int openSizedFile(const string &path, size_t size) {
+    int fd = ::open(path.c_str(), O_RDWR);
+    struct stat fileStat;
+    if ((fd >= 0) && ((::fstat(fd, &fileStat) < 0) || (size_t(fileStat.st_size) != size))) {
+        ::close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* Delete a cache entry, unless it is being opened.  Processes reading the
+ * entry keep their open copy. */
+static bool removeEntry(const string &entryDir) {
+    int dirFd = ::open(entryDir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dirFd < 0) {
+        return false;
+    }
+    bool removed = false;
+    if (::flock(dirFd, LOCK_EX | LOCK_NB) == 0) {
+        for (const char *name : ENTRY_FILES) {
+            ::unlink((entryDir + "/" + name).c_str());
+        }
+        removed = (::rmdir(entryDir.c_str()) == 0);
+    }
+    ::close(dirFd);
+    return removed;
+}
+
+/* absolute path without links, so all paths to a file share an entry */
+static string resolvePath(const string &path) {
+    string fullPath = path;
+    char *resolved = ::realpath(path.c_str(), NULL);
+    if (resolved != NULL) {
+        fullPath = resolved;
+        ::free(resolved);
+    }
+    return fullPath;
+}
+
+/* Constructor.  The entry directory is locked while it is checked or
+ * created, so processes opening the same file don't collide. */
+LocalBlockCache::LocalBlockCache(const string &path, const LocalBlockCacheConfig &config)
+    : _path(path), _config(config), _blockSize(max((config.blockSize + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE, size_t(1)) * MIN_BLOCK_SIZE), _fileSize(0), _numBlocks(0),
+      _fileFd(-1), _cacheFd(-1), _present(NULL), _numFetchedBlocks(0) {
+    assert(config.isEnabled());
+    _fileFd = ::open(path.c_str(), O_RDONLY);
+    if (_fileFd < 0) {
+        throw hal_errno_exception(path, "open failed", errno);
+    }
+    struct stat fileStat;
+    if (::fstat(_fileFd, &fileStat) < 0) {
+        int err = errno;
+        closeFds();
+        throw hal_errno_exception(path, "stat failed", err);
+    }
+    _fileSize = fileStat.st_size;
+    _numBlocks = (_fileSize + _blockSize - 1) / _blockSize;
+
+    string fullPath = resolvePath(path);
+    ostringstream info;
+    info << INFO_FORMAT << "\n"
+         << fullPath << "\n"
+         << _fileSize << "\n"
+         << fileStat.st_mtim.tv_sec << "." << setfill('0') << setw(9) << fileStat.st_mtim.tv_nsec << "\n"
+         << _blockSize << "\n";
+
+    int dirFd = -1;
+    try {
+        makeDir(_config.dir);
+        _entryDir = _config.dir + "/" + getEntryName(fullPath);
+        // another process may delete the entry between creating and
+        // locking it, in which case try again
+        while (true) {
+            makeDir(_entryDir);
+            dirFd = ::open(_entryDir.c_str(), O_RDONLY | O_DIRECTORY);
+            if (dirFd < 0) {
+                if (errno == ENOENT) {
+                    continue;
+                }
+                throw hal_errno_exception(_entryDir, "can't open block cache directory", errno);
+            }
+            if (::flock(dirFd, LOCK_EX) < 0) {
+                throw hal_errno_exception(_entryDir, "can't lock block cache directory", errno);
+            }
+            struct stat lockedStat, pathStat;
+            if ((::fstat(dirFd, &lockedStat) == 0) && (::stat(_entryDir.c_str(), &pathStat) == 0) &&
+                (lockedStat.st_ino == pathStat.st_ino) && (lockedStat.st_dev == pathStat.st_dev)) {
+                break;
+            }
+            ::close(dirFd);
+            dirFd = -1;
+        }
+        if (not openEntry(info.str())) {
+            createEntry(info.str());
+        }
+        // the modification time of the info file orders entries by use
+        ::utimensat(AT_FDCWD, (_entryDir + "/" + INFO_FILE).c_str(), NULL, 0);
+    } catch (...) {
+        if (dirFd >= 0) {
+            ::close(dirFd);
+        }
+        closeFds();
+        throw;
+    }
+    ::close(dirFd);
+    if (_config.maxBytes > 0) {
+        trimCache(_config.maxBytes);
+    }
+}
+
+LocalBlockCache::~LocalBlockCache() {
+    closeFds();
+}
+
+void LocalBlockCache::closeFds() {
+    if (_present != NULL) {
+        ::munmap(_present, _numBlocks);
+        _present = NULL;
+    }
+    if (_cacheFd >= 0) {
+        ::close(_cacheFd);
+        _cacheFd = -1;
+    }
+    if (_fileFd >= 0) {
+        ::close(_fileFd);
+        _fileFd = -1;
+    }
+}
+
+/* name of the entry directory: the file name followed by a hash of its
+ * full path, so it is recognizable but unique */
+string LocalBlockCache::getEntryName(const string &fullPath) const {
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for (char c : fullPath) {
+        hash = (hash ^ uint8_t(c)) * 1099511628211ULL;
+    }
+    size_t slash = fullPath.rfind('/');
+    ostringstream name;
+    name << fullPath.substr((slash == string::npos) ? 0 : slash + 1) << "." << hex << setfill('0') << setw(16) << hash
+         << ENTRY_SUFFIX;
+    return name.str();
+}
+
+/* open an existing entry made from the same version of the file, returning
+ * false if there isn't one */
+bool LocalBlockCache::openEntry(const string &infoText) {
+    ifstream infoStream((_entryDir + "/" + INFO_FILE).c_str());
+    stringstream entryInfo;
+    entryInfo << infoStream.rdbuf();
+    if ((not infoStream) or (entryInfo.str() != infoText)) {
+        return false;
+    }
+    int cacheFd = openSizedFile(_entryDir + "/" + DATA_FILE, _fileSize);
+    int blocksFd = openSizedFile(_entryDir + "/" + BLOCKS_FILE, _numBlocks);
+    void *present = NULL;
+    if ((cacheFd >= 0) && (blocksFd >= 0) && (_numBlocks > 0)) {
+        present = ::mmap(NULL, _numBlocks, PROT_READ | PROT_WRITE, MAP_SHARED, blocksFd, 0);
+    }
+    if (blocksFd >= 0) {
+        ::close(blocksFd);
+    }
+    if ((cacheFd < 0) || (blocksFd < 0) || (present == MAP_FAILED)) {
+        if (cacheFd >= 0) {
+            ::close(cacheFd);
+        }
+        return false;
+    }
+    _cacheFd = cacheFd;
+    _present = static_cast<uint8_t *>(present);
+    return true;
+}
+
+/* Create the entry afresh.  New files replace any old ones, so processes
+ * still reading an old version of the file keep their copy. */
+void LocalBlockCache::createEntry(const string &infoText) {
+    string infoPath = _entryDir + "/" + INFO_FILE;
+    ::unlink(infoPath.c_str());
+    string dataPath = _entryDir + "/" + DATA_FILE;
+    string blocksPath = _entryDir + "/" + BLOCKS_FILE;
+    _cacheFd = createSizedFile(dataPath + ".tmp", _fileSize);
+    renameFile(dataPath + ".tmp", dataPath);
+    int blocksFd = createSizedFile(blocksPath + ".tmp", _numBlocks);
+    if (_numBlocks > 0) {
+        void *present = ::mmap(NULL, _numBlocks, PROT_READ | PROT_WRITE, MAP_SHARED, blocksFd, 0);
+        if (present == MAP_FAILED) {
+            int err = errno;
+            ::close(blocksFd);
+            throw hal_errno_exception(blocksPath, "mmap failed", err);
+        }
+        _present = static_cast<uint8_t *>(present);
+    }
+    ::close(blocksFd);
+    renameFile(blocksPath + ".tmp", blocksPath);
+
+    ofstream infoStream((infoPath + ".tmp").c_str());
+    infoStream << infoText;
+    infoStream.close();
+    if (not infoStream) {
+        throw hal_errno_exception(infoPath, "can't write block cache file", errno);
+    }
+    renameFile(infoPath + ".tmp", infoPath);
+}
+
+/* delete the entries of other files, least recently used first, until the
+ * cache directory is within maxBytes */
+void LocalBlockCache::trimCache(size_t maxBytes) {
+    struct Entry {
+        struct timespec usedTime;
+        string dir;
+        size_t bytes;
+    };
+    vector<Entry> entries;
+    size_t totalBytes = 0;
+    DIR *dir = ::opendir(_config.dir.c_str());
+    if (dir == NULL) {
+        return;
+    }
+    for (struct dirent *dirEntry = ::readdir(dir); dirEntry != NULL; dirEntry = ::readdir(dir)) {
+        string name = dirEntry->d_name;
+        if ((name.size() <= ENTRY_SUFFIX.size()) or
+            (name.compare(name.size() - ENTRY_SUFFIX.size(), ENTRY_SUFFIX.size(), ENTRY_SUFFIX) != 0)) {
+            continue;
+        }
+        Entry entry = {{0, 0}, _config.dir + "/" + name, 0};
+        struct stat fileStat;
+        if (::stat((entry.dir + "/" + INFO_FILE).c_str(), &fileStat) == 0) {
+            entry.usedTime = fileStat.st_mtim;
+        }
+        for (const char *fileName : {DATA_FILE, BLOCKS_FILE}) {
+            if (::stat((entry.dir + "/" + fileName).c_str(), &fileStat) == 0) {
+                entry.bytes += size_t(fileStat.st_blocks) * 512;
+            }
+        }
+        totalBytes += entry.bytes;
+        if (entry.dir != _entryDir) {
+            entries.push_back(entry);
+        }
+    }
+    ::closedir(dir);
+
+    sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return (a.usedTime.tv_sec < b.usedTime.tv_sec) ||
+               ((a.usedTime.tv_sec == b.usedTime.tv_sec) && (a.usedTime.tv_nsec < b.usedTime.tv_nsec));
+    });
+    for (size_t i = 0; (i < entries.size()) && (totalBytes > maxBytes); ++i) {
+        if (removeEntry(entries[i].dir)) {
+            totalBytes -= entries[i].bytes;
+        }
+    }
+}
+
+/* Copy a block from the file to the local copy.  It is marked present only
+ * once written, so other processes never read it early; two processes
+ * fetching the same block write the same data. */
+void LocalBlockCache::fetchBlock(size_t block) {
+    lock_guard<mutex> lock(_fetchMutex);
+    if (__atomic_load_n(&_present[block], __ATOMIC_ACQUIRE) != 0) {
+        return;
+    }
+    size_t offset = block * _blockSize;
+    size_t length = min(_blockSize, _fileSize - offset);
+    vector<char> buffer(length);
+    preadFully(_fileFd, _path, buffer.data(), length, offset);
+    pwriteFully(_cacheFd, _entryDir, buffer.data(), length, offset);
+    __atomic_store_n(&_present[block], 1, __ATOMIC_RELEASE);
+    ++_numFetchedBlocks;
+}
+
+void LocalBlockCache::read(void *buf, size_t size, size_t offset) {
+    size_t length = (offset < _fileSize) ? min(size, _fileSize - offset) : 0;
+    if (length > 0) {
+        fetch(offset, length);
+        preadFully(_cacheFd, _entryDir, buf, length, offset);
+    }
+    if (length < size) {
+        memset(static_cast<char *>(buf) + length, 0, size - length);
+    }
+}
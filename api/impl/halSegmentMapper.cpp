@@ -11,18 +11,22 @@
 #include "halSegment.h"
 #include "halSegmentIterator.h"
 #include "halTopSegmentIterator.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 using namespace std;
 using namespace hal;
 
+typedef SegmentMapper::MappedSegmentList MappedSegmentList;
+typedef SegmentMapper::MappedSegmentVector MappedSegmentVector;
+
 enum OverlapCat { Same, Disjoint, AContainsB, BContainsA, AOverlapsLeftOfB, BOverlapsLeftOfA };
 
-static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &results, hal_size_t minLength);
+static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, MappedSegmentList &results, hal_size_t minLength);
 
 // note: takes smart pointer as it maybe added to the results
-static hal_size_t mapUp(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &results, bool doDupes, hal_size_t minLength) {
+static hal_size_t mapUp(MappedSegmentPtr mappedSeg, MappedSegmentList &results, bool doDupes, hal_size_t minLength) {
     const Genome *parent = mappedSeg->getGenome()->getParent();
     assert(parent != NULL);
     hal_size_t added = 0;
@@ -61,7 +65,7 @@ static hal_size_t mapUp(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &resu
             assert((hal_index_t)newSourceSegIt->getLength() > startDelta + endDelta);
             newSourceSegIt->slice(newSourceSegIt->getStartOffset() + startDelta, newSourceSegIt->getEndOffset() + endDelta);
 
-            MappedSegmentPtr newMappedSeg(new MappedSegment(newSourceSegIt, newTopSegIt));
+            MappedSegmentPtr newMappedSeg(makeFreeListPtr(new MappedSegment(newSourceSegIt, newTopSegIt)));
 
             assert(newMappedSeg->isTop() == true);
             assert(newMappedSeg->getSource()->getGenome() == mappedSeg->getSource()->getGenome());
@@ -82,13 +86,13 @@ static hal_size_t mapUp(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &resu
 // Map the input segments up until reaching the target genome. If the
 // target genome is below the source genome, fail miserably.
 // Destructive to any data in the input or results list.
-static hal_size_t mapRecursiveUp(list<MappedSegmentPtr> &input, list<MappedSegmentPtr> &results, const Genome *tgtGenome,
+static hal_size_t mapRecursiveUp(MappedSegmentList &input, MappedSegmentList &results, const Genome *tgtGenome,
                                  hal_size_t minLength) {
-    list<MappedSegmentPtr> *inputPtr = &input;
-    list<MappedSegmentPtr> *outputPtr = &results;
+    MappedSegmentList *inputPtr = &input;
+    MappedSegmentList *outputPtr = &results;
 
     if (inputPtr->empty() || (*inputPtr->begin())->getGenome() == tgtGenome) {
-        results = *inputPtr;
+        results.swap(*inputPtr);
         return 0;
     }
 
@@ -102,7 +106,7 @@ static hal_size_t mapRecursiveUp(list<MappedSegmentPtr> &input, list<MappedSegme
     }
 
     // Map all segments to the parent.
-    list<MappedSegmentPtr>::iterator i = inputPtr->begin();
+    MappedSegmentList::iterator i = inputPtr->begin();
     for (; i != inputPtr->end(); ++i) {
         assert((*i)->getGenome() == curGenome);
         mapUp(*i, *outputPtr, true, minLength);
@@ -116,7 +120,7 @@ static hal_size_t mapRecursiveUp(list<MappedSegmentPtr> &input, list<MappedSegme
     }
 
     if (outputPtr != &results) {
-        results = *outputPtr;
+        results.swap(*outputPtr);
     }
 
     results.sort(MappedSegment::LessSourcePtr());
@@ -125,7 +129,7 @@ static hal_size_t mapRecursiveUp(list<MappedSegmentPtr> &input, list<MappedSegme
 }
 
 // note: takes smart pointer as it maybe added to the results
-static hal_size_t mapDown(MappedSegmentPtr mappedSeg, hal_size_t childIndex, list<MappedSegmentPtr> &results,
+static hal_size_t mapDown(MappedSegmentPtr mappedSeg, hal_size_t childIndex, MappedSegmentList &results,
                           hal_size_t minLength) {
     const Genome *child = mappedSeg->getGenome()->getChild(childIndex);
     assert(child != NULL);
@@ -166,7 +170,7 @@ static hal_size_t mapDown(MappedSegmentPtr mappedSeg, hal_size_t childIndex, lis
             assert((hal_index_t)newSourceSegIt->getLength() > startDelta + endDelta);
             newSourceSegIt->slice(newSourceSegIt->getStartOffset() + startDelta, newSourceSegIt->getEndOffset() + endDelta);
 
-            MappedSegmentPtr newMappedSeg(new MappedSegment(newSourceSegIt, newBotSegIt));
+            MappedSegmentPtr newMappedSeg(makeFreeListPtr(new MappedSegment(newSourceSegIt, newBotSegIt)));
 
             assert(newMappedSeg->isTop() == false);
             assert(newMappedSeg->getSource()->getGenome() == mappedSeg->getSource()->getGenome());
@@ -188,45 +192,31 @@ static hal_size_t mapDown(MappedSegmentPtr mappedSeg, hal_size_t childIndex, lis
 // Map the input segments down until reaching the target genome. If the
 // target genome is above the source genome, fail miserably.
 // Destructive to any data in the input or results list.
-static hal_size_t mapRecursiveDown(list<MappedSegmentPtr> &input, list<MappedSegmentPtr> &results, const Genome *tgtGenome,
-                                   const set<string> &namesOnPath, bool doDupes, hal_size_t minLength) {
-    list<MappedSegmentPtr> *inputPtr = &input;
-    list<MappedSegmentPtr> *outputPtr = &results;
+hal_size_t SegmentMapper::mapRecursiveDown(MappedSegmentList &input, MappedSegmentList &results, const Genome *tgtGenome,
+                                           bool doDupes, hal_size_t minLength) {
+    MappedSegmentList *inputPtr = &input;
+    MappedSegmentList *outputPtr = &results;
 
     if (inputPtr->empty()) {
-        results = *inputPtr;
+        results.swap(*inputPtr);
         return 0;
     }
 
     const Genome *curGenome = (*inputPtr->begin())->getGenome();
     assert(curGenome != NULL);
     if (curGenome == tgtGenome) {
-        results = *inputPtr;
+        results.swap(*inputPtr);
         return 0;
     }
 
     // Find the correct child to move down into.
-    const Genome *nextGenome = NULL;
-    hal_size_t nextChildIndex = numeric_limits<hal_size_t>::max();
-    const Alignment *alignment = curGenome->getAlignment();
-    vector<string> childNames = alignment->getChildNames(curGenome->getName());
-    for (hal_size_t child = 0; nextGenome == NULL && child < childNames.size(); ++child) {
-        if (childNames[child] == tgtGenome->getName() || namesOnPath.find(childNames[child]) != namesOnPath.end()) {
-            const Genome *childGenome = curGenome->getChild(child);
-            nextGenome = childGenome;
-            nextChildIndex = child;
-        }
-    }
-
-    if (nextGenome == NULL) {
-        throw hal_exception("Could not find correct child that leads from " + curGenome->getName() + " to " +
-                            tgtGenome->getName());
-    }
-
+    const PathStep &step = getPathStep(curGenome, tgtGenome);
+    const Genome *nextGenome = step._child;
+    hal_size_t nextChildIndex = step._childIndex;
     assert(nextGenome->getParent() == curGenome);
 
     // Map the actual segments down.
-    list<MappedSegmentPtr>::iterator i = inputPtr->begin();
+    MappedSegmentList::iterator i = inputPtr->begin();
     for (; i != inputPtr->end(); ++i) {
         assert((*i)->getGenome() == curGenome);
         mapDown(*i, nextChildIndex, *outputPtr, minLength);
@@ -236,7 +226,7 @@ static hal_size_t mapRecursiveDown(list<MappedSegmentPtr> &input, list<MappedSeg
     if (doDupes == true) {
         swap(inputPtr, outputPtr);
         outputPtr->clear();
-        list<MappedSegmentPtr>::iterator i = inputPtr->begin();
+        MappedSegmentList::iterator i = inputPtr->begin();
         for (; i != inputPtr->end(); ++i) {
             assert((*i)->getGenome() == nextGenome);
             mapSelf(*i, *outputPtr, minLength);
@@ -247,11 +237,11 @@ static hal_size_t mapRecursiveDown(list<MappedSegmentPtr> &input, list<MappedSeg
         // Continue the recursion.
         swap(inputPtr, outputPtr);
         outputPtr->clear();
-        mapRecursiveDown(*inputPtr, *outputPtr, tgtGenome, namesOnPath, doDupes, minLength);
+        mapRecursiveDown(*inputPtr, *outputPtr, tgtGenome, doDupes, minLength);
     }
 
     if (outputPtr != &results) {
-        results = *outputPtr;
+        results.swap(*outputPtr);
     }
 
     results.sort(MappedSegment::LessSourcePtr());
@@ -260,7 +250,7 @@ static hal_size_t mapRecursiveDown(list<MappedSegmentPtr> &input, list<MappedSeg
 }
 
 // note: takes smart pointer as it maybe added to the results
-static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &results, hal_size_t minLength) {
+static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, MappedSegmentList &results, hal_size_t minLength) {
     hal_size_t added = 0;
     if (mappedSeg->isTop() == true) {
         SegmentIteratorPtr target = mappedSeg->getTargetIteratorPtr();
@@ -276,7 +266,7 @@ static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &re
                 newSource = std::dynamic_pointer_cast<BottomSegmentIterator>(source)->clone();
             }
             TopSegmentIteratorPtr newTop = topCopy->clone();
-            MappedSegmentPtr newMappedSeg(new MappedSegment(newSource, newTop));
+            MappedSegmentPtr newMappedSeg(makeFreeListPtr(new MappedSegment(newSource, newTop)));
             assert(newMappedSeg->getGenome() == mappedSeg->getGenome());
             assert(newMappedSeg->getSource()->getGenome() == mappedSeg->getSource()->getGenome());
             results.push_back(newMappedSeg);
@@ -311,7 +301,7 @@ static hal_size_t mapSelf(MappedSegmentPtr mappedSeg, list<MappedSegmentPtr> &re
             assert((hal_index_t)newSource->getLength() > startDelta + endDelta);
             newSource->slice(newSource->getStartOffset() + startDelta, newSource->getEndOffset() + endDelta);
 
-            MappedSegmentPtr newMappedSeg(new MappedSegment(newSource, topNew));
+            MappedSegmentPtr newMappedSeg(makeFreeListPtr(new MappedSegment(newSource, topNew)));
 
             assert(newMappedSeg->isTop() == true);
             assert(newMappedSeg->getSource()->getGenome() == mappedSeg->getSource()->getGenome());
@@ -395,7 +385,7 @@ static void getOverlapBounds(MappedSegmentPtr &seg, MappedSegmentSet &results, M
 }
 
 static void clipAagainstB(MappedSegmentPtr segA, MappedSegmentPtr segB, OverlapCat overlapCat,
-                          vector<MappedSegmentPtr> &clippedSegs) {
+                          MappedSegmentVector &clippedSegs) {
     assert(overlapCat != Same && overlapCat != Disjoint && overlapCat != BContainsA);
 
     hal_index_t startA = segA->getStartPosition();
@@ -409,7 +399,7 @@ static void clipAagainstB(MappedSegmentPtr segA, MappedSegmentPtr segB, OverlapC
         swap(startB, endB);
     }
     MappedSegmentPtr left = segA;
-    MappedSegmentPtr middle = MappedSegmentPtr(segA->clone());
+    MappedSegmentPtr middle = makeFreeListPtr(segA->clone());
     MappedSegmentPtr right;
 
     hal_index_t startO = segA->getStartOffset();
@@ -419,7 +409,7 @@ static void clipAagainstB(MappedSegmentPtr segA, MappedSegmentPtr segB, OverlapC
     hal_index_t rightSize = std::max((hal_index_t)0, endA - endB);
     hal_index_t middleSize = length - leftSize - rightSize;
     if (rightSize > 0) {
-        right = MappedSegmentPtr(segA->clone());
+        right = makeFreeListPtr(segA->clone());
     }
 
     assert(overlapCat == AOverlapsLeftOfB || overlapCat == BOverlapsLeftOfA || overlapCat == AContainsB);
@@ -472,68 +462,97 @@ static void clipAagainstB(MappedSegmentPtr segA, MappedSegmentPtr segB, OverlapC
     assert(segA->getLength() == segA->getSource()->getLength());
 }
 
-static void insertAndBreakOverlaps(MappedSegmentPtr seg, MappedSegmentSet &results) {
+/* cut segA where it contains segB, adding the pieces after the first to
+ * clippedSegs.  return true if segA was cut */
+static bool cutAContainingB(MappedSegmentPtr segA, const MappedSegmentPtr &segB, MappedSegmentVector &clippedSegs) {
+    assert(segA->getLength() == segA->getSource()->getLength());
+    OverlapCat oc = slowOverlap(segA->getTarget(), segB->getTarget());
+    // assert(oc == Same || oc == Disjoint || oc == AContainsB);
+    if (oc == AContainsB) {
+        clipAagainstB(segA, segB, oc, clippedSegs);
+        return true;
+    }
+    return false;
+}
+
+void SegmentMapper::insertAndBreakOverlaps(MappedSegmentPtr seg, MappedSegmentSet &results) {
     assert(seg->getLength() == seg->getSource()->getLength());
-    list<MappedSegmentPtr> inputSegs;
-    vector<MappedSegmentPtr> clippedSegs;
+    MappedSegmentVector &inputSegs = _inputSegs;
+    MappedSegmentVector &clippedSegs = _clippedSegs;
 
     // 1) compute invariant range in set of candidate overalaps
     MappedSegmentSet::iterator leftBound;
     MappedSegmentSet::iterator rightBound;
     getOverlapBounds(seg, results, leftBound, rightBound);
-    bool leftBegin = leftBound == results.begin();
+    size_t first = leftBound - results.begin();
+    size_t last = rightBound - results.begin();
 
     // 2) cut seg by each segment in range
-    list<MappedSegmentPtr>::iterator inputIt;
     OverlapCat oc;
     inputSegs.push_back(seg);
-    MappedSegmentSet::iterator resIt;
-    for (resIt = leftBound; resIt != rightBound; ++resIt) {
-        for (inputIt = inputSegs.begin(); inputIt != inputSegs.end(); ++inputIt) {
-            oc = slowOverlap(inputIt->get()->getTarget(), resIt->get()->getTarget());
+    for (MappedSegmentSet::iterator resIt = leftBound; resIt != rightBound; ++resIt) {
+        for (size_t j = 0; j < inputSegs.size(); ++j) {
+            oc = slowOverlap(inputSegs[j]->getTarget(), resIt->get()->getTarget());
             if (oc == AContainsB || oc == AOverlapsLeftOfB || oc == BOverlapsLeftOfA) {
                 clippedSegs.clear();
-                clipAagainstB(*inputIt, *resIt, oc, clippedSegs);
+                clipAagainstB(inputSegs[j], *resIt, oc, clippedSegs);
                 inputSegs.insert(inputSegs.end(), clippedSegs.begin(), clippedSegs.end());
             }
         }
     }
 
-    // 3) cut results by input list
-    for (inputIt = inputSegs.begin(); inputIt != inputSegs.end(); ++inputIt) {
-        assert((*inputIt)->getLength() == (*inputIt)->getSource()->getLength());
-        resIt = leftBegin ? results.begin() : leftBound;
-        for (; resIt != rightBound; ++resIt) {
-            assert((*resIt)->getLength() == (*resIt)->getSource()->getLength());
-            oc = slowOverlap(resIt->get()->getTarget(), inputIt->get()->getTarget());
-            // assert(oc == Same || oc == Disjoint || oc == AContainsB);
-            if (oc == AContainsB) {
-                clippedSegs.clear();
-                clipAagainstB(*resIt, *inputIt, oc, clippedSegs);
-                results.insert(clippedSegs.begin(), clippedSegs.end());
+    // 3) cut results by input list.  results are cut in place, which can
+    // change their position in the set, so we remember which ones were cut.
+    // the new pieces are kept aside (and cut by the remaining input) until
+    // they are all added at the end
+    vector<size_t> &cutIndexes = _cutIndexes;
+    MappedSegmentVector &newSegs = _newSegs;
+    for (size_t j = 0; j < inputSegs.size(); ++j) {
+        for (size_t i = first; i < last; ++i) {
+            if (cutAContainingB(*(results.begin() + i), inputSegs[j], newSegs)) {
+                cutIndexes.push_back(i);
             }
         }
+        for (size_t i = 0; i < newSegs.size(); ++i) {
+            cutAContainingB(newSegs[i], inputSegs[j], newSegs);
+        }
     }
 
-    // 4) insert the input list
+    // 4) re-insert the cut results, then add the new pieces and the input list
+    if (!cutIndexes.empty()) {
+        sort(cutIndexes.begin(), cutIndexes.end());
+        cutIndexes.erase(unique(cutIndexes.begin(), cutIndexes.end()), cutIndexes.end());
+        MappedSegmentVector &cutSegs = _cutSegs;
+        for (size_t i = cutIndexes.size(); i > 0; --i) {
+            MappedSegmentSet::iterator resIt = results.begin() + cutIndexes[i - 1];
+            cutSegs.push_back(*resIt);
+            results.erase(resIt);
+        }
+        results.insert(cutSegs.begin(), cutSegs.end());
+        cutSegs.clear();
+    }
+    results.insert(newSegs.begin(), newSegs.end());
     results.insert(inputSegs.begin(), inputSegs.end());
+    inputSegs.clear();
+    clippedSegs.clear();
+    cutIndexes.clear();
+    newSegs.clear();
 }
 
 // Map all segments from the input to any segments in the same genome
 // that coalesce in or before the given "coalescence limit" genome.
 // Destructive to any data in the input list.
-static hal_size_t mapRecursiveParalogies(const Genome *srcGenome, list<MappedSegmentPtr> &input,
-                                         list<MappedSegmentPtr> &results, const set<string> &namesOnPath,
-                                         const Genome *coalescenceLimit, hal_size_t minLength) {
+hal_size_t SegmentMapper::mapRecursiveParalogies(const Genome *srcGenome, MappedSegmentList &input, MappedSegmentList &results,
+                                                 hal_size_t minLength) {
     if (input.empty()) {
-        results = input;
+        results.swap(input);
         return 0;
     }
 
     const Genome *curGenome = (*input.begin())->getGenome();
     assert(curGenome != NULL);
-    if (curGenome == coalescenceLimit) {
-        results = input;
+    if (curGenome == _coalescenceLimit) {
+        results.swap(input);
         return 0;
     }
 
@@ -542,17 +561,17 @@ static hal_size_t mapRecursiveParalogies(const Genome *srcGenome, list<MappedSeg
     if (nextGenome == NULL) {
         throw hal_exception("Hit root genome when attempting to map paralogies");
     }
-    list<MappedSegmentPtr> paralogs;
+    MappedSegmentList paralogs;
     // Map to any paralogs in the current genome.
     // FIXME: I think the original segments are included in this, which is a waste.
-    list<MappedSegmentPtr>::iterator i = input.begin();
+    MappedSegmentList::iterator i = input.begin();
     for (; i != input.end(); ++i) {
         assert((*i)->getGenome() == curGenome);
         mapSelf(*i, paralogs, minLength);
     }
 
-    if (nextGenome != coalescenceLimit) {
-        list<MappedSegmentPtr> nextSegments;
+    if (nextGenome != _coalescenceLimit) {
+        MappedSegmentList nextSegments;
         // Map all of the original segments (not the paralogs, which is a
         // waste) up to the next genome.
         i = input.begin();
@@ -562,12 +581,12 @@ static hal_size_t mapRecursiveParalogies(const Genome *srcGenome, list<MappedSeg
         }
 
         // Recurse on the mapped segments.
-        mapRecursiveParalogies(srcGenome, nextSegments, results, namesOnPath, coalescenceLimit, minLength);
+        mapRecursiveParalogies(srcGenome, nextSegments, results, minLength);
     }
 
     // Map all the paralogs we found in this genome back to the source.
-    list<MappedSegmentPtr> paralogsMappedToSrc;
-    mapRecursiveDown(paralogs, paralogsMappedToSrc, srcGenome, namesOnPath, false, minLength);
+    MappedSegmentList paralogsMappedToSrc;
+    mapRecursiveDown(paralogs, paralogsMappedToSrc, srcGenome, false, minLength);
 
     results.splice(results.begin(), paralogsMappedToSrc);
     results.sort(MappedSegment::LessSourcePtr());
@@ -575,9 +594,9 @@ static hal_size_t mapRecursiveParalogies(const Genome *srcGenome, list<MappedSeg
     return results.size();
 }
 
-static hal_size_t mapSource(const SegmentIterator *source, MappedSegmentSet &results, const Genome *tgtGenome,
-                            const set<const Genome *> *genomesOnPath, bool doDupes, hal_size_t minLength,
-                            const Genome *coalescenceLimit, const Genome *mrca) {
+/* map the source to the target, leaving the mapped segments in output
+ * (without breaking overlaps) */
+void SegmentMapper::mapToList(const SegmentIterator *source, MappedSegmentList &output, hal_size_t minLength) {
     assert(source != NULL);
 
     // FIXME: why does target start out as source??  This is all a bit clunky
@@ -591,87 +610,273 @@ static hal_size_t mapSource(const SegmentIterator *source, MappedSegmentSet &res
         startTargetSegIt = dynamic_cast<const BottomSegmentIterator *>(source)->clone();
     }
 
-    MappedSegmentPtr newMappedSeg(new MappedSegment(startSourceSegIt, startTargetSegIt));
+    MappedSegmentPtr newMappedSeg(makeFreeListPtr(new MappedSegment(startSourceSegIt, startTargetSegIt)));
 
-    list<MappedSegmentPtr> input;
+    MappedSegmentList input;
     input.push_back(newMappedSeg);
-    list<MappedSegmentPtr> output;
-
-    set<string> namesOnPath;
-    assert(genomesOnPath != NULL);
-    for (set<const Genome *>::const_iterator i = genomesOnPath->begin(); i != genomesOnPath->end(); ++i) {
-        namesOnPath.insert((*i)->getName());
-    }
 
     // FIXME: using multiple lists is probably much slower than just
     // reusing the results list over and over.
-    list<MappedSegmentPtr> upResults;
+    MappedSegmentList upResults;
     // Map all segments up to the MRCA of src and tgt.
-    if (source->getGenome() != mrca) {
-        mapRecursiveUp(input, upResults, mrca, minLength);
+    if (source->getGenome() != _mrca) {
+        mapRecursiveUp(input, upResults, _mrca, minLength);
     } else {
-        upResults = input;
+        upResults.swap(input);
     }
 
-    list<MappedSegmentPtr> paralogResults;
+    MappedSegmentList paralogResults;
     // Map to all paralogs that coalesce in or below the coalescenceLimit.
-    if (mrca != coalescenceLimit && doDupes) {
-        mapRecursiveParalogies(mrca, upResults, paralogResults, namesOnPath, coalescenceLimit, minLength);
+    if (_mrca != _coalescenceLimit && _doDupes) {
+        mapRecursiveParalogies(_mrca, upResults, paralogResults, minLength);
     } else {
-        paralogResults = upResults;
+        paralogResults.swap(upResults);
     }
 
     // Finally, map back down to the target genome.
-    if (tgtGenome != mrca) {
-        mapRecursiveDown(paralogResults, output, tgtGenome, namesOnPath, doDupes, minLength);
+    if (_tgtGenome != _mrca) {
+        mapRecursiveDown(paralogResults, output, _tgtGenome, _doDupes, minLength);
     } else {
-        output = paralogResults;
+        output.swap(paralogResults);
     }
+}
 
-    list<MappedSegmentPtr>::iterator outIt = output.begin();
-    for (; outIt != output.end(); ++outIt) {
-        insertAndBreakOverlaps(*outIt, results);
-    }
+/* restrict a mapped segment to the part whose source lies in [start, end].
+ * return false if there is no overlap */
+static bool sliceSource(MappedSegment *mappedSeg, hal_index_t start, hal_index_t end) {
+    const SlicedSegment *source = mappedSeg->getSource();
+    hal_index_t sourceStart = min(source->getStartPosition(), source->getEndPosition());
+    hal_index_t sourceEnd = max(source->getStartPosition(), source->getEndPosition());
+    if (sourceEnd < start || sourceStart > end) {
+        return false;
+    }
+    hal_offset_t leftTrim = max(start - sourceStart, (hal_index_t)0);
+    hal_offset_t rightTrim = max(sourceEnd - end, (hal_index_t)0);
+    if (leftTrim > 0 || rightTrim > 0) {
+        // slice() works on target offsets, so temporarily swap source and target.
+        // the start offset of a reversed segment is measured from its right end
+        bool reversed = source->getReversed();
+        hal_offset_t startOffset = source->getStartOffset() + (reversed ? rightTrim : leftTrim);
+        hal_offset_t endOffset = source->getEndOffset() + (reversed ? leftTrim : rightTrim);
+        mappedSeg->flip();
+        mappedSeg->slice(startOffset, endOffset);
+        mappedSeg->flip();
+    }
+    return true;
+}
 
-    return output.size();
+/* map the source by slicing the (cached) mappings of its whole segment in the
+ * forward orientation.  a reversed source gets the reverse of the forward
+ * mappings */
+hal_size_t SegmentMapper::mapCached(const SegmentIterator *source, MappedSegmentSet &results) {
+    _cacheKey._isTop = source->isTop();
+    _cacheKey._arrayIndex = source->getArrayIndex();
+
+    const vector<MappedSegmentPtr> *mappings = _cache->find(_cacheKey);
+    if (mappings == NULL) {
+        SegmentIteratorPtr wholeSeg;
+        if (source->isTop()) {
+            wholeSeg = dynamic_cast<const TopSegmentIterator *>(source)->clone();
+        } else {
+            wholeSeg = dynamic_cast<const BottomSegmentIterator *>(source)->clone();
+        }
+        wholeSeg->slice(0, 0);
+        if (wholeSeg->getReversed()) {
+            wholeSeg->toReverseInPlace();
+        }
+        MappedSegmentList output;
+        mapToList(wholeSeg.get(), output, 0);
+        vector<MappedSegmentPtr> wholeMappings(output.begin(), output.end());
+        mappings = _cache->insert(_cacheKey, wholeMappings);
+    }
+
+    hal_index_t start = min(source->getStartPosition(), source->getEndPosition());
+    hal_index_t end = max(source->getStartPosition(), source->getEndPosition());
+    hal_size_t numResults = 0;
+    for (size_t i = 0; i < mappings->size(); ++i) {
+        MappedSegmentPtr mappedSeg(makeFreeListPtr((*mappings)[i]->clone()));
+        if (sliceSource(mappedSeg.get(), start, end)) {
+            if (source->getReversed()) {
+                mappedSeg->fullReverse();
+            }
+            insertAndBreakOverlaps(mappedSeg, results);
+            ++numResults;
+        }
+    }
+    return numResults;
 }
 
-hal_size_t hal::halMapSegment(const SegmentIterator *source, MappedSegmentSet &outSegments, const Genome *tgtGenome,
-                              const set<const Genome *> *genomesOnPath, bool doDupes, hal_size_t minLength,
-                              const Genome *coalescenceLimit, const Genome *mrca) {
-    assert(tgtGenome != NULL);
+SegmentMapper::SegmentMapper(const Genome *srcGenome, const Genome *tgtGenome, const set<const Genome *> *genomesOnPath,
+                             bool doDupes, hal_size_t minLength, const Genome *coalescenceLimit, const Genome *mrca)
+    : _srcGenome(srcGenome), _tgtGenome(tgtGenome), _doDupes(doDupes), _minLength(minLength), _mrca(mrca),
+      _coalescenceLimit(coalescenceLimit), _cache(NULL) {
+    assert(srcGenome != NULL && tgtGenome != NULL);
 
-    if (mrca == NULL) {
+    if (_mrca == NULL) {
         set<const Genome *> inputSet;
-        inputSet.insert(source->getGenome());
-        inputSet.insert(tgtGenome);
-        mrca = getLowestCommonAncestor(inputSet);
+        inputSet.insert(_srcGenome);
+        inputSet.insert(_tgtGenome);
+        _mrca = getLowestCommonAncestor(inputSet);
     }
 
-    if (coalescenceLimit == NULL) {
-        coalescenceLimit = mrca;
+    if (_coalescenceLimit == NULL) {
+        _coalescenceLimit = _mrca;
     }
 
     // Get the path from the coalescence limit to the target (necessary
     // for choosing which children to move through to get to the
     // target).
-    set<const Genome *> pathSet;
     if (genomesOnPath == NULL) {
         set<const Genome *> inputSet;
-        inputSet.insert(tgtGenome);
-        inputSet.insert(mrca);
-        getGenomesInSpanningTree(inputSet, pathSet);
-        genomesOnPath = &pathSet;
+        inputSet.insert(_tgtGenome);
+        inputSet.insert(_mrca);
+        getGenomesInSpanningTree(inputSet, _genomesOnPath);
+    } else {
+        _genomesOnPath = *genomesOnPath;
+    }
+    for (set<const Genome *>::const_iterator i = _genomesOnPath.begin(); i != _genomesOnPath.end(); ++i) {
+        _namesOnPath.insert((*i)->getName());
     }
 
-    hal_size_t numResults =
-        mapSource(source, outSegments, tgtGenome, genomesOnPath, doDupes, minLength, coalescenceLimit, mrca);
-    return numResults;
+    _cacheKey._srcGenome = _srcGenome;
+    _cacheKey._isTop = false;
+    _cacheKey._arrayIndex = NULL_INDEX;
+    _cacheKey._tgtGenome = _tgtGenome;
+    _cacheKey._coalescenceLimit = _coalescenceLimit;
+    _cacheKey._mrca = _mrca;
+    _cacheKey._doDupes = _doDupes;
+    _cacheKey._genomesOnPath.assign(_genomesOnPath.begin(), _genomesOnPath.end());
+}
+
+/* get the child of genome to move into when mapping down to target: the
+ * first one that is the target or on the path.  looked up the first time
+ * it's needed, as not every genome above the target has one */
+const SegmentMapper::PathStep &SegmentMapper::getPathStep(const Genome *genome, const Genome *target) {
+    for (size_t i = 0; i < _pathSteps.size(); ++i) {
+        if (_pathSteps[i]._genome == genome && _pathSteps[i]._target == target) {
+            return _pathSteps[i];
+        }
+    }
+    vector<string> childNames = genome->getAlignment()->getChildNames(genome->getName());
+    for (hal_size_t child = 0; child < childNames.size(); ++child) {
+        if (childNames[child] == target->getName() || _namesOnPath.find(childNames[child]) != _namesOnPath.end()) {
+            PathStep step = {genome, target, child, genome->getChild(child)};
+            _pathSteps.push_back(step);
+            return _pathSteps.back();
+        }
+    }
+    throw hal_exception("Could not find correct child that leads from " + genome->getName() + " to " + target->getName());
+}
+
+hal_size_t SegmentMapper::map(const SegmentIterator *source, MappedSegmentSet &outSegments) {
+    assert(source != NULL);
+    if (source->getGenome() != _srcGenome) {
+        throw hal_exception("Segment of genome " + source->getGenome()->getName() + " given to mapper from genome " +
+                            _srcGenome->getName());
+    }
+    if (_cache != NULL && _minLength == 0) {
+        return mapCached(source, outSegments);
+    }
+
+    MappedSegmentList output;
+    mapToList(source, output, _minLength);
+    for (MappedSegmentList::iterator outIt = output.begin(); outIt != output.end(); ++outIt) {
+        insertAndBreakOverlaps(*outIt, outSegments);
+    }
+    return output.size();
+}
+
+hal_size_t hal::halMapSegment(const SegmentIterator *source, MappedSegmentSet &outSegments, const Genome *tgtGenome,
+                              const set<const Genome *> *genomesOnPath, bool doDupes, hal_size_t minLength,
+                              const Genome *coalescenceLimit, const Genome *mrca, SegmentMapperCache *cache) {
+    assert(tgtGenome != NULL);
+    SegmentMapper mapper(source->getGenome(), tgtGenome, genomesOnPath, doDupes, minLength, coalescenceLimit, mrca);
+    mapper.setCache(cache);
+    return mapper.map(source, outSegments);
 }
 
 /* call main function with smart pointer */
 hal_size_t hal::halMapSegmentSP(const SegmentIteratorPtr &source, MappedSegmentSet &outSegments, const Genome *tgtGenome,
                                 const std::set<const Genome *> *genomesOnPath, bool doDupes, hal_size_t minLength,
-                                const Genome *coalescenceLimit, const Genome *mrca) {
-    return halMapSegment(source.get(), outSegments, tgtGenome, genomesOnPath, doDupes, minLength, coalescenceLimit, mrca);
+                                const Genome *coalescenceLimit, const Genome *mrca, SegmentMapperCache *cache) {
+    return halMapSegment(source.get(), outSegments, tgtGenome, genomesOnPath, doDupes, minLength, coalescenceLimit, mrca,
+                         cache);
+}
+
+const hal_size_t SegmentMapperCache::defaultMaxSize = 100000;
+
+SegmentMapperCache::SegmentMapperCache(hal_size_t maxSize)
+    : _maxSize(maxSize), _size(0), _numHits(0), _numMisses(0) {
+}
+
+void SegmentMapperCache::clear() {
+    _entries.clear();
+    _lru.clear();
+    _size = 0;
+}
+
+bool SegmentMapperCache::Key::operator<(const Key &other) const {
+    if (_arrayIndex != other._arrayIndex) {
+        return _arrayIndex < other._arrayIndex;
+    }
+    if (_srcGenome != other._srcGenome) {
+        return _srcGenome < other._srcGenome;
+    }
+    if (_isTop != other._isTop) {
+        return _isTop < other._isTop;
+    }
+    if (_tgtGenome != other._tgtGenome) {
+        return _tgtGenome < other._tgtGenome;
+    }
+    if (_coalescenceLimit != other._coalescenceLimit) {
+        return _coalescenceLimit < other._coalescenceLimit;
+    }
+    if (_mrca != other._mrca) {
+        return _mrca < other._mrca;
+    }
+    if (_doDupes != other._doDupes) {
+        return _doDupes < other._doDupes;
+    }
+    return _genomesOnPath < other._genomesOnPath;
+}
+
+const vector<MappedSegmentPtr> *SegmentMapperCache::find(const Key &key) {
+    EntryMap::iterator i = _entries.find(key);
+    if (i == _entries.end()) {
+        ++_numMisses;
+        return NULL;
+    }
+    ++_numHits;
+    _lru.splice(_lru.begin(), _lru, i->second._lruPos);
+    return &i->second._mappings;
+}
+
+const vector<MappedSegmentPtr> *SegmentMapperCache::insert(const Key &key, vector<MappedSegmentPtr> &mappings) {
+    pair<EntryMap::iterator, bool> inserted = _entries.insert(pair<Key, Entry>(key, Entry()));
+    Entry &entry = inserted.first->second;
+    if (inserted.second) {
+        _lru.push_front(key);
+    } else {
+        _size -= entry._mappings.size() + 1;
+        _lru.splice(_lru.begin(), _lru, entry._lruPos);
+    }
+    entry._lruPos = _lru.begin();
+    entry._mappings.swap(mappings);
+    mappings.clear();
+    // count the entry itself so that segments that don't map still take space
+    _size += entry._mappings.size() + 1;
+    evict();
+    return &entry._mappings;
+}
+
+/* drop least recently used entries until the cache fits, but always keep the
+ * most recent one */
+void SegmentMapperCache::evict() {
+    while (_size > _maxSize && _lru.size() > 1) {
+        EntryMap::iterator i = _entries.find(_lru.back());
+        assert(i != _entries.end());
+        _size -= i->second._mappings.size() + 1;
+        _entries.erase(i);
+        _lru.pop_back();
+    }
 }
@@ -8,6 +8,7 @@
 #include "halDefs.h"
 #include "halSequence.h"
 #include "halGenome.h"
+#include "halDnaIterator.h"
 
 
 /* thrown when sequence not found in genome */
@@ -15,3 +16,13 @@ hal::SequenceNotFoundException::SequenceNotFoundException(const Genome* genome,
                                                           const std::string &name):
     hal_exception("Sequence '" + name + "' not found in genome '" + genome->getName() + "'") {
 }
+
+void hal::Sequence::getBases(hal_size_t start, hal_size_t length, char *out) const {
+    DnaIteratorPtr dnaIt(getDnaIterator(start));
+    dnaIt->readBases(out, length);
+}
+
+void hal::Sequence::setBases(hal_size_t start, hal_size_t length, const char *in) {
+    DnaIteratorPtr dnaIt(getDnaIterator(start));
+    dnaIt->writeBases(in, length);
+}
@@ -61,16 +61,20 @@
 
 #include "halAlignment.h"
 #include "halAlignmentInstance.h"
+#include "halBlockColumnIterator.h"
 #include "halBottomSegment.h"
 #include "halBottomSegmentIterator.h"
 #include "halCLParser.h"
 #include "halColumnIterator.h"
+#include "halConvert.h"
 #include "halCommon.h"
 #include "halDefs.h"
 #include "halDnaIterator.h"
+#include "halFreeList.h"
 #include "halGappedBottomSegmentIterator.h"
 #include "halGappedTopSegmentIterator.h"
 #include "halGenome.h"
+#include "halGenomeMemoryBudget.h"
 #include "halMappedSegment.h"
 #include "halMetaData.h"
 #include "halPositionCache.h"
@@ -9,6 +9,7 @@
 #define _HALALIGNMENT_H
 
 #include "halDefs.h"
+#include "halGenomeMemoryBudget.h"
 #include <string>
 #include <vector>
 
@@ -159,6 +160,10 @@ namespace hal {
 
         /** Replace the newick tree with a new string */
         virtual void replaceNewickTree(const std::string &newick) = 0;
+
+        /** Memory held by the open genomes, which is only tracked given
+         * --genomeMemoryBudget or --genomeMemoryStats */
+        virtual GenomeMemoryStats getGenomeMemoryStats() const = 0;
     };
 }
 #endif
@@ -55,10 +55,19 @@ namespace hal {
     }
 
     /*
-     * MMap file default size when opening file for write access.
+     * MMap file default initial size when opening file for write access.
+     * The file is grown as it fills and truncated to the space used when
+     * closed.
      */
-    static const size_t MMAP_DEFAULT_FILE_SIZE_GB = 64;
-    static const size_t MMAP_DEFAULT_FILE_SIZE = 64 * GIGABYTE;
+    static const size_t MMAP_DEFAULT_FILE_SIZE_GB = 1;
+    static const size_t MMAP_DEFAULT_FILE_SIZE = 1 * GIGABYTE;
+
+    /*
+     * Default limit on the memory holding the decompressed blocks of a
+     * compressed mmap file, zero for no limit.
+     */
+    static const size_t MMAP_DEFAULT_CACHE_SIZE_MB = 1024;
+    static const size_t MMAP_DEFAULT_CACHE_BYTES = MMAP_DEFAULT_CACHE_SIZE_MB * 1024 * 1024;
 
     /* get default FileCreatPropList with HAL default properties set */
     const H5::FileCreatPropList &hdf5DefaultFileCreatPropList();
@@ -88,13 +97,27 @@ namespace hal {
      */
     Alignment *hdf5AlignmentInstance(const std::string &alignmentPath, unsigned mode, const CLParser *parser);
 
-    /** Get an instance of an mmap-implemented Alignment.
+    /** Get an instance of an mmap-implemented Alignment.  An alignment
+     * opened with READ_ACCESS may be shared by multiple threads: genomes and
+     * sequences can be opened concurrently, and each thread must use its
+     * own iterators.  HDF5 alignments are not thread-safe.
      * @param alignmentPath Path to file or URL for UDC access.
      * @param mode Access mode bit map
-     * @param fileSize Size to allocate when creating new file (CREATE_ACCESS)
+     * @param fileSize Initial size when creating new file (CREATE_ACCESS)
+     * @param packDna Store the DNA of genomes added to the file two bits per
+     * base, with N and lowercase runs kept separately.  Packed DNA can't be
+     * modified once the genome is closed.
+     * @param compactSegments Store the segments of genomes added to the file
+     * as compact tables, which are read-only once the genome is closed.
+     * @param compress Compress the file into independently compressed
+     * blocks when it is closed.  A compressed file can only be read.
+     * @param cacheBytes Limit on the memory holding decompressed blocks when
+     * reading a compressed file, zero for no limit.
      */
     Alignment *mmapAlignmentInstance(const std::string &alignmentPath, unsigned mode = hal::READ_ACCESS,
-                                     size_t fileSize = hal::MMAP_DEFAULT_FILE_SIZE);
+                                     size_t fileSize = hal::MMAP_DEFAULT_FILE_SIZE, bool packDna = false,
+                                     bool compactSegments = false, bool compress = false,
+                                     size_t cacheBytes = hal::MMAP_DEFAULT_CACHE_BYTES);
 
     /** Attempt to detect HAL alignment format, or return empty string if it doesn't
      * appear to be a hal file */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBLOCKCOLUMNITERATOR_H
+#define _HALBLOCKCOLUMNITERATOR_H
+
+#include "halColumnIterator.h"
+#include "halDefs.h"
+#include <string>
+#include <vector>
+
+namespace hal {
+
+    /**
+     * Iterates over the columns of a ColumnIterator in gapless blocks
+     * rather than one column at a time.  A block is a maximal run of
+     * consecutive columns with the same row structure: the same number of
+     * rows, and each row (including the reference) staying on the same
+     * sequence and strand and moving one base along it in the same
+     * direction from column to column.  The blocks cover exactly the
+     * columns of the wrapped iterator, so all its options (targets, dupes,
+     * insertions, ...) apply.  Consumers that reassemble columns into runs
+     * can instead handle thousands of columns per step.
+     */
+    class BlockColumnIterator {
+      public:
+        /** One row of a block */
+        struct BlockRow {
+            const Sequence *_sequence;
+            hal_index_t _genomeIndex; // index in getColumnGenomes()
+            hal_index_t _start;       // position in the sequence in the first column
+            hal_index_t _step;        // +1 or -1: how the position moves from column to column
+            bool _reversed;           // bases are read from the reverse strand
+        };
+
+        /** Read blocks from colIt, starting at its current column.
+         * @param maxBlockLength split blocks longer than this (0 for no
+         * limit) */
+        BlockColumnIterator(const ColumnIteratorPtr &colIt, hal_size_t maxBlockLength = 0);
+
+        /** Move to the next block (the first one on the first call).
+         * Returns false once there are no more columns */
+        bool toNextBlock();
+
+        /** Number of columns in the block */
+        hal_size_t getLength() const {
+            return _length;
+        }
+
+        const std::vector<BlockRow> &getRows() const {
+            return _rows;
+        }
+
+        /** Reference sequence of the block's columns */
+        const Sequence *getReferenceSequence() const {
+            return _refSequence;
+        }
+
+        /** Position, as given by ColumnIterator::getReferenceSequencePosition(),
+         * of the block's first column */
+        hal_index_t getReferenceSequencePosition() const {
+            return _refStart;
+        }
+
+        /** Genomes of the rows, indexed by BlockRow::_genomeIndex */
+        const std::vector<const Genome *> &getColumnGenomes() const {
+            return _colIt->getColumnGenomes();
+        }
+
+        /** Get the bases of a row, in column order, as they would be read
+         * from the column iterator's DNA iterators */
+        void getRowString(size_t row, std::string &outString) const;
+
+        /** Number of columns read between calls to
+         * ColumnIterator::defragment() */
+        static const hal_size_t defragmentInterval;
+
+      private:
+        void readColumn();
+        bool extendsBlock() const;
+
+        ColumnIteratorPtr _colIt;
+        hal_size_t _maxBlockLength;
+        hal_size_t _numColumnsRead;
+
+        std::vector<BlockRow> _rows;
+        hal_size_t _length;
+        const Sequence *_refSequence;
+        hal_index_t _refStart;
+        hal_index_t _refStep;
+
+        // the last column of the block, and the column after it
+        std::vector<ColumnIterator::ColumnRow> _lastColumn;
+        hal_index_t _lastRefPosition;
+        std::vector<ColumnIterator::ColumnRow> _nextColumn;
+        const Sequence *_nextRefSequence;
+        hal_index_t _nextRefPosition;
+        bool _hasNextColumn;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
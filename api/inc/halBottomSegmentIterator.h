@@ -26,7 +26,7 @@ namespace hal {
         /** constructor */
         BottomSegmentIterator(BottomSegment *bottomSegment, hal_size_t startOffset = 0, hal_size_t endOffset = 0,
                               bool reversed = false)
-            : SegmentIterator(startOffset, endOffset, reversed), _bottomSegment(bottomSegment) {
+            : SegmentIterator(startOffset, endOffset, reversed), _bottomSegment(makeFreeListPtr(bottomSegment)) {
         }
 
         /** destructor */
@@ -17,6 +17,8 @@
 #include <list>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 namespace hal {
 
@@ -91,6 +93,74 @@ namespace hal {
         /** Get the index of the column in the reference genome's array */
         virtual hal_index_t getArrayIndex() const;
 
+        /** One base of a column in the dense column view */
+        struct ColumnRow {
+            const Sequence *_sequence;
+            hal_index_t _genomeIndex;   // index in getColumnGenomes()
+            hal_index_t _sequenceIndex; // array index of the sequence in its genome
+            hal_index_t _position;      // position in the sequence
+            char _base;                 // base on the strand of the row
+            bool _reversed;
+        };
+
+        /** The rows of consecutive columns stored back to back in one
+         * array, so that they can be processed with contiguous memory
+         * access.  The rows of column i are [getColumnBegin(i),
+         * getColumnEnd(i)). */
+        class ColumnBatch {
+          public:
+            ColumnBatch() : _columnStarts(1, 0) {
+            }
+
+            hal_size_t getNumColumns() const {
+                return _columnStarts.size() - 1;
+            }
+
+            const ColumnRow *getColumnBegin(hal_size_t column) const {
+                return _rows.data() + _columnStarts[column];
+            }
+
+            const ColumnRow *getColumnEnd(hal_size_t column) const {
+                return _rows.data() + _columnStarts[column + 1];
+            }
+
+            hal_size_t getColumnSize(hal_size_t column) const {
+                return _columnStarts[column + 1] - _columnStarts[column];
+            }
+
+            const std::vector<ColumnRow> &getRows() const {
+                return _rows;
+            }
+
+            /** Remove all columns, keeping the memory for reuse */
+            void clear() {
+                _rows.clear();
+                _columnStarts.resize(1);
+            }
+
+          private:
+            friend class ColumnIterator;
+            std::vector<ColumnRow> _rows;
+            std::vector<size_t> _columnStarts;
+        };
+
+        /** Get the bases of the current column as rows, in the same order
+         * as the column map.  rows is cleared first.  Unlike the column map,
+         * there are no entries for sequences without bases. */
+        virtual void getColumnRows(std::vector<ColumnRow> &rows) const;
+
+        /** Add the current column and the ones to its right to batch, up
+         * to maxColumns columns in all or until the last column.  The
+         * iterator is left on the last column added, so call toRight()
+         * before reading the next batch.  Returns the number of columns
+         * added */
+        virtual hal_size_t readColumns(ColumnBatch &batch, hal_size_t maxColumns);
+
+        /** Genomes of the rows returned so far, indexed by
+         * ColumnRow::_genomeIndex.  Genomes are numbered in the order they
+         * are first seen, and keep their index for the life of the iterator */
+        virtual const std::vector<const Genome *> &getColumnGenomes() const;
+
         /** As we iterate along, we keep a column map entry for each sequence
          * visited.  This works out pretty well except for extreme cases (such
          * as iterating over entire fly genomes where we can accumulate 10s of
@@ -146,6 +216,7 @@ namespace hal {
 
         void resetColMap();
         void eraseColMap();
+        void appendColumnRows(std::vector<ColumnRow> &rows) const;
 
         stTree *buildTree() const;
         void clearTree();
@@ -175,6 +246,8 @@ namespace hal {
         mutable stTree *_treeCache;
         bool _unique;
         bool _onlyOrthologs;
+        mutable std::vector<const Genome *> _columnGenomes;
+        mutable std::unordered_map<const Genome *, hal_index_t> _columnGenomeIndexes;
     };
 
     inline std::ostream &operator<<(std::ostream &os, const ColumnIterator &cit) {
@@ -194,6 +194,17 @@ namespace hal {
         uint8_t code = dnaPackMap[uint8_t(unpackedChar)];
         return (index & 1) ? ((packedChar & 0xF0) | code) : ((packedChar & 0x0F) | (code << 4));
     }
+
+    /** Unpack length DNA characters, starting with the one at index in the
+     * packed buffer, into out.  Uses SSSE3 or AVX2 when the CPU has them. */
+    void dnaUnpackString(const char *packed, hal_index_t index, hal_size_t length, char *out);
+
+    /** Pack length DNA characters from in into the packed buffer, starting
+     * at index */
+    void dnaPackString(const char *in, hal_size_t length, char *packed, hal_index_t index);
+
+    /** Reverse complement a DNA buffer with no gaps in place */
+    void reverseComplement(char *dna, hal_size_t length);
 }
 
 #endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALCONVERT_H
+#define _HALCONVERT_H
+#include "halDefs.h"
+
+namespace hal {
+    class Alignment;
+
+    /* amount of data copied by convertAlignment() */
+    struct ConvertStats {
+        hal_size_t numGenomes = 0;
+        hal_size_t numBases = 0;
+        hal_size_t numTopSegments = 0;
+        hal_size_t numBottomSegments = 0;
+        hal_size_t numBytes = 0; // size of the DNA and segment arrays copied
+    };
+
+    /**
+     * Copy a whole alignment to another file, usually of the other storage
+     * format.  Rather than going segment by segment through the API, the DNA
+     * and segment arrays of each genome are streamed in large blocks, in the
+     * HDF5 chunks when an HDF5 file is read or written.  Blocks of all
+     * genomes are converted at once by numThreads threads; HDF5 access is
+     * serialized, but the HDF5 chunks are compressed and decompressed in
+     * parallel.
+     * @param inAlignment Alignment to copy
+     * @param outAlignment Empty alignment open for creation
+     * @param numThreads Number of threads, 0 for one per CPU
+     */
+    ConvertStats convertAlignment(const Alignment *inAlignment, Alignment *outAlignment, unsigned numThreads = 0);
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -8,6 +8,7 @@
 #ifndef _HALDNADRIVER_H
 #define _HALDNADRIVER_H
 #include "halCommon.h"
+#include <algorithm>
 
 namespace hal {
     /**
@@ -41,6 +42,31 @@ namespace hal {
             _dirty = true;
         }
 
+        /* get length bases starting at the specified index */
+        inline void getBases(hal_index_t index, hal_size_t length, char *out) const {
+            while (length > 0) {
+                hal_index_t relIndex = access(index);
+                hal_size_t count = std::min(length, hal_size_t(_endIndex - index));
+                dnaUnpackString(_buffer, relIndex, count, out);
+                index += count;
+                out += count;
+                length -= count;
+            }
+        }
+
+        /* set length bases starting at the specified index. */
+        inline void setBases(hal_index_t index, hal_size_t length, const char *in) {
+            while (length > 0) {
+                hal_index_t relIndex = access(index);
+                hal_size_t count = std::min(length, hal_size_t(_endIndex - index));
+                dnaPackString(in, count, _buffer, relIndex);
+                _dirty = true;
+                index += count;
+                in += count;
+                length -= count;
+            }
+        }
+
       protected:
         /* constructor */
         DnaAccess(hal_index_t startIndex, hal_index_t endIndex, char *buffer)
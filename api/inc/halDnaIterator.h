@@ -111,6 +111,13 @@ namespace hal {
         /* write a DNA string */
         void writeString(const std::string &inString, hal_size_t length);
 
+        /* read length bases into a buffer, moving past them.  This decodes
+         * whole buffers at a time, so is much faster than getBase() */
+        void readBases(char *out, hal_size_t length);
+
+        /* write length bases from a buffer, moving past them. */
+        void writeBases(const char *in, hal_size_t length);
+
         /** Compare (array indexes) of two iterators */
         bool equals(DnaIteratorPtr &other) const;
 
@@ -163,20 +170,51 @@ namespace hal {
     }
 
     inline void DnaIterator::readString(std::string &outString, hal_size_t length) {
-        assert(length == 0 || inRange() == true);
         outString.resize(length);
+        readBases(&outString[0], length);
+    }
 
-        for (hal_size_t i = 0; i < length; ++i) {
-            outString[i] = getBase();
-            toRight();
+    inline void DnaIterator::writeString(const std::string &inString, hal_size_t length) {
+        writeBases(inString.data(), length);
+    }
+
+    inline void DnaIterator::readBases(char *out, hal_size_t length) {
+        if (length == 0) {
+            return;
+        }
+        hal_index_t first = _reversed ? _index - (hal_index_t)length + 1 : _index;
+        if (first < 0 || first + length > _genome->getSequenceLength()) {
+            throw hal_exception("Trying to read characters out of range");
+        }
+        _dnaAccess->getBases(first, length, out);
+        if (_reversed) {
+            reverseComplement(out, length);
+            _index -= length;
+        } else {
+            _index += length;
         }
     }
 
-    inline void DnaIterator::writeString(const std::string &inString, hal_size_t length) {
-        assert(length == 0 || inRange());
-        for (hal_size_t i = 0; i < length; ++i) {
-            setBase(inString[i]);
-            toRight();
+    inline void DnaIterator::writeBases(const char *in, hal_size_t length) {
+        if (length > 0) {
+            hal_index_t first = _reversed ? _index - (hal_index_t)length + 1 : _index;
+            if (first < 0 || first + length > _genome->getSequenceLength()) {
+                throw hal_exception("Trying to set character out of range");
+            }
+            for (hal_size_t i = 0; i < length; ++i) {
+                if (not isNucleotide(in[i])) {
+                    throw hal_exception(std::string("Trying to set invalid character: ") + in[i]);
+                }
+            }
+            if (_reversed) {
+                std::string reversed(in, length);
+                reverseComplement(&reversed[0], length);
+                _dnaAccess->setBases(first, length, reversed.data());
+                _index -= length;
+            } else {
+                _dnaAccess->setBases(first, length, in);
+                _index += length;
+            }
         }
         flush();
     }
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALFREELIST_H
+#define _HALFREELIST_H
+
+#include <cstddef>
+#include <memory>
+
+namespace hal {
+
+    /**
+     * Allocate a block of memory from the calling thread's free lists.
+     * Segments, segment iterators and mapped segments are created and
+     * destroyed by the million when mapping between genomes, so they (and the
+     * control blocks of the smart pointers that hold them) come from here
+     * rather than the heap.  Small blocks freed by a thread are kept in lists
+     * by size for reuse by the same thread, so a steady stream of mapping
+     * calls does not touch malloc.  Larger blocks go straight to the heap.
+     */
+    void *freeListAllocate(size_t size);
+
+    /** Release a block from freeListAllocate().  size must be the size
+     * it was allocated with.  It may be called from a different thread. */
+    void freeListDeallocate(void *ptr, size_t size);
+
+    /**
+     * Base class that allocates objects (of any derived type) from the free
+     * lists.  Derived classes must have virtual destructors so that the
+     * size of the object is known when it is deleted.
+     */
+    class FreeListAllocated {
+      public:
+        static void *operator new(size_t size) {
+            return freeListAllocate(size);
+        }
+        static void operator delete(void *ptr, size_t size) {
+            freeListDeallocate(ptr, size);
+        }
+    };
+
+    /**
+     * STL allocator using the free lists, for node-based containers
+     * and smart pointer control blocks
+     */
+    template <class T> class FreeListAllocator {
+      public:
+        typedef T value_type;
+
+        FreeListAllocator() {
+        }
+        template <class U> FreeListAllocator(const FreeListAllocator<U> &) {
+        }
+        T *allocate(size_t n) {
+            return static_cast<T *>(freeListAllocate(n * sizeof(T)));
+        }
+        void deallocate(T *ptr, size_t n) {
+            freeListDeallocate(ptr, n * sizeof(T));
+        }
+        template <class U> bool operator==(const FreeListAllocator<U> &) const {
+            return true;
+        }
+        template <class U> bool operator!=(const FreeListAllocator<U> &) const {
+            return false;
+        }
+    };
+
+    /** Take ownership of a new object in a shared pointer whose control
+     * block is also allocated from the free lists */
+    template <class T> std::shared_ptr<T> makeFreeListPtr(T *ptr) {
+        return std::shared_ptr<T>(ptr, std::default_delete<T>(), FreeListAllocator<T>());
+    }
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
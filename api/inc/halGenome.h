@@ -12,6 +12,7 @@
 #include "halDefs.h"
 #include "halSegmentedSequence.h"
 #include "halSequence.h"
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -34,7 +35,8 @@ namespace hal {
       public:
         /* Constructor */
         Genome(Alignment *alignment, const std::string &name)
-            : _alignment(alignment), _name(name), _numChildren(alignment->getChildNames(name).size()), _parentCache(NULL){};
+            : _alignment(alignment), _name(name), _numChildren(alignment->getChildNames(name).size()), _parentCache(NULL),
+              _childCache(_numChildren){};
 
         /** Destructor */
         virtual ~Genome() {
@@ -194,6 +196,19 @@ namespace hal {
          * @param dest Genome to be copied to */
         void copyMetadata(Genome *dest) const;
 
+        /** Get length bases starting at start into a buffer.  Like
+         * getSubString(), but fills a caller's buffer
+         * @param start First position of the bases
+         * @param length Number of bases
+         * @param out Buffer of at least length characters */
+        void getBases(hal_size_t start, hal_size_t length, char *out) const;
+
+        /** Set length bases starting at start from a buffer
+         * @param start First position of the bases
+         * @param length Number of bases
+         * @param in Buffer of at least length characters */
+        void setBases(hal_size_t start, hal_size_t length, const char *in);
+
         /** Recompute parse info for this genome. */
         void fixParseInfo();
 
@@ -203,41 +218,41 @@ namespace hal {
         /** Reload the genome after some aspect has changed, clearing any caches. */
         void reload() {
             _numChildren = _alignment->getChildNames(_name).size();
-            _childCache.empty();
-            _parentCache = NULL;
+            clearGenomeCache();
         };
 
       protected:
+        /** Clear the cached parent and child genome pointers */
+        void clearGenomeCache() {
+            _parentCache = NULL;
+            _childCache = std::vector<std::atomic<Genome *>>(_numChildren);
+        }
+
         Alignment *_alignment;
         std::string _name;
         hal_index_t _numChildren;
-        mutable Genome *_parentCache;
-        mutable std::vector<Genome *> _childCache;
+        // Parent and child genomes are opened lazily.  These are atomic so the
+        // caches can be filled from multiple threads reading the same alignment;
+        // the alignment returns the same genome object to each of them.
+        mutable std::atomic<Genome *> _parentCache;
+        mutable std::vector<std::atomic<Genome *>> _childCache;
     };
 
     inline Genome *Genome::getChild(hal_size_t childIdx) {
-        if (_childCache.size() <= childIdx) {
-            _childCache.assign(_numChildren, NULL);
+        if (childIdx >= _numChildren) {
+            throw hal_exception("Genome::getChild() - child out of range");
         }
-        if (_childCache[childIdx] == NULL) {
+        Genome *child = _childCache.at(childIdx);
+        if (child == NULL) {
             std::vector<std::string> childNames = _alignment->getChildNames(_name);
-            _childCache[childIdx] = _alignment->openGenome(childNames.at(childIdx));
+            child = _alignment->openGenome(childNames.at(childIdx));
+            _childCache[childIdx] = child;
         }
-        return _childCache[childIdx];
+        return child;
     }
 
     inline const Genome *Genome::getChild(hal_size_t childIdx) const {
-        if (childIdx >= _numChildren) {
-            throw hal_exception("Genome::getChild() - child out of range");
-        }
-        if (_childCache.size() < _numChildren) {
-            _childCache.assign(_numChildren, NULL);
-        }
-        if (_childCache[childIdx] == NULL) {
-            std::vector<std::string> childNames = _alignment->getChildNames(_name);
-            _childCache[childIdx] = _alignment->openGenome(childNames.at(childIdx));
-        }
-        return _childCache[childIdx];
+        return const_cast<Genome *>(this)->getChild(childIdx);
     }
 
     inline hal_size_t Genome::getNumChildren() const {
@@ -256,23 +271,19 @@ namespace hal {
     }
 
     inline Genome *Genome::getParent() {
-        if (_parentCache == NULL) {
+        Genome *parent = _parentCache;
+        if (parent == NULL) {
             std::string parName = _alignment->getParentName(_name);
             if (parName.empty() == false) {
-                _parentCache = _alignment->openGenome(parName);
+                parent = _alignment->openGenome(parName);
+                _parentCache = parent;
             }
         }
-        return _parentCache;
+        return parent;
     }
 
     inline const Genome *Genome::getParent() const {
-        if (_parentCache == NULL) {
-            std::string parName = _alignment->getParentName(_name);
-            if (parName.empty() == false) {
-                _parentCache = _alignment->openGenome(parName);
-            }
-        }
-        return _parentCache;
+        return const_cast<Genome *>(this)->getParent();
     }
 }
 #endif
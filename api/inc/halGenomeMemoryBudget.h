@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALGENOMEMEMORYBUDGET_H
+#define _HALGENOMEMEMORYBUDGET_H
+
+#include "halDefs.h"
+#include <list>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace hal {
+
+    /** Memory held by the open genomes of an alignment, as tracked by
+     * GenomeMemoryBudget.  Byte counts are estimates. */
+    struct GenomeMemoryStats {
+        hal_size_t budgetBytes;        // 0 for no limit
+        hal_size_t residentBytes;      // held by open genomes now
+        hal_size_t peakResidentBytes;  // most held at once
+        hal_size_t numResidentGenomes; // genomes holding any memory
+        hal_size_t numEvictions;       // times a genome's memory was released
+        hal_size_t evictedBytes;       // memory released by evictions
+    };
+
+    std::ostream &operator<<(std::ostream &os, const GenomeMemoryStats &stats);
+
+    /**
+     * Keeps the memory held by the open genomes of an alignment (array
+     * buffers, caches, mapped pages) within a budget by releasing the memory
+     * of the least recently used genomes.  Genomes stay open, so pointers to
+     * them remain valid: released memory is read back from the file the next
+     * time a genome is used.  Memory is only tracked when there is a budget or
+     * tracking is requested for the statistics.
+     */
+    class GenomeMemoryBudget {
+      public:
+        /** The state of a genome whose memory can be released */
+        class Client {
+          public:
+            virtual ~Client() {
+            }
+
+            /** Estimate of the bytes held */
+            virtual hal_size_t getResidentBytes() const = 0;
+
+            /** Release the memory held, to be loaded again when used */
+            virtual void releaseMemory() = 0;
+        };
+
+        /** @param budgetBytes Memory the genomes may hold, 0 for no limit
+         * @param track Track memory even without a limit */
+        GenomeMemoryBudget(hal_size_t budgetBytes = 0, bool track = false);
+
+        /** Set the budget, which applies from the next touch() */
+        void setBudget(hal_size_t budgetBytes, bool track = false);
+
+        bool isTracking() const {
+            return _track;
+        }
+
+        /** The client was used and may hold more memory: make it the most
+         * recently used and release others, least recently used first,
+         * until the genomes fit in the budget */
+        void touch(Client *client) {
+            if (_track) {
+                touchTracked(client);
+            }
+        }
+
+        /** Stop tracking a client that is being destroyed */
+        void remove(Client *client);
+
+        GenomeMemoryStats getStats() const;
+
+      private:
+        struct Entry {
+            Client *client;
+            hal_size_t bytes;
+        };
+        typedef std::list<Entry> EntryList;
+
+        void touchTracked(Client *client);
+        void evict(Client *keep);
+
+        hal_size_t _budgetBytes;
+        bool _track;
+        EntryList _entries; // most recently used first
+        std::unordered_map<Client *, EntryList::iterator> _entryMap;
+        hal_size_t _residentBytes;
+        hal_size_t _peakResidentBytes;
+        hal_size_t _numEvictions;
+        hal_size_t _evictedBytes;
+        mutable std::mutex _mutex;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
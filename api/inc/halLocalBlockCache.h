@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALLOCALBLOCKCACHE_H
+#define _HALLOCALBLOCKCACHE_H
+
+#include "halDefs.h"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+
+namespace hal {
+    class CLParser;
+
+    /* default size of the blocks copied to a local block cache */
+    static const size_t LOCAL_BLOCK_CACHE_DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+    /** Where and how input files are cached locally, see LocalBlockCache */
+    struct LocalBlockCacheConfig {
+        LocalBlockCacheConfig() : maxBytes(0), blockSize(LOCAL_BLOCK_CACHE_DEFAULT_BLOCK_SIZE) {
+        }
+
+        /* from the --blockCache* options */
+        static LocalBlockCacheConfig fromOptions(const CLParser *parser);
+
+        bool isEnabled() const {
+            return not dir.empty();
+        }
+
+        std::string dir;  // cache directory, empty for no caching
+        size_t maxBytes;  // size of the cache directory, 0 for no limit
+        size_t blockSize; // bytes copied at a time
+    };
+
+    /**
+     * Read-only access to a file on a slow (shared or network) filesystem
+     * through a copy of it on local disk.  Blocks of the file are copied to a
+     * sparse file in the cache directory the first time they are read, and
+     * read from there after, by this and later processes on the same machine.
+     *
+     * The copy is only used while the size and modification time of the file
+     * are those it was made from; otherwise it is started again.  When a file
+     * is opened, the copies of other files are deleted, least recently opened
+     * first, to keep the cache directory within its size.  Processes may
+     * share the cache directory.
+     */
+    class LocalBlockCache {
+      public:
+        /* open path, throwing hal_exception on error */
+        LocalBlockCache(const std::string &path, const LocalBlockCacheConfig &config);
+        ~LocalBlockCache();
+
+        /* size of the file */
+        size_t getFileSize() const {
+            return _fileSize;
+        }
+
+        /* size of the blocks copied, a multiple of 4096 bytes */
+        size_t getBlockSize() const {
+            return _blockSize;
+        }
+
+        /* the local copy, which holds the blocks that have been fetched
+         * and zeros elsewhere */
+        int getCacheFd() const {
+            return _cacheFd;
+        }
+
+        /* make sure the blocks holding [offset, offset + size) are in
+         * the local copy */
+        void fetch(size_t offset, size_t size) {
+            size_t end = std::min(offset + size, _fileSize);
+            for (size_t block = offset / _blockSize; block * _blockSize < end; ++block) {
+                if (__atomic_load_n(&_present[block], __ATOMIC_ACQUIRE) == 0) {
+                    fetchBlock(block);
+                }
+            }
+        }
+
+        /* read size bytes at offset through the cache */
+        void read(void *buf, size_t size, size_t offset);
+
+        /* blocks this object copied from the file to the local copy */
+        size_t getNumFetchedBlocks() const {
+            return _numFetchedBlocks;
+        }
+
+      private:
+        LocalBlockCache(const LocalBlockCache &);
+        LocalBlockCache &operator=(const LocalBlockCache &);
+
+        std::string getEntryName(const std::string &fullPath) const;
+        bool openEntry(const std::string &infoText);
+        void createEntry(const std::string &infoText);
+        void trimCache(size_t maxBytes);
+        void fetchBlock(size_t block);
+        void closeFds();
+
+        const std::string _path;
+        const LocalBlockCacheConfig _config;
+        const size_t _blockSize;
+        size_t _fileSize;
+        size_t _numBlocks;
+        std::string _entryDir;
+        int _fileFd;
+        int _cacheFd;
+        uint8_t *_present; // shared map of blocks in the local copy
+        std::mutex _fetchMutex;
+        size_t _numFetchedBlocks;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
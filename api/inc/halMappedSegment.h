@@ -10,6 +10,7 @@
 
 #include "halBottomSegmentIterator.h"
 #include "halDefs.h"
+#include "halFreeList.h"
 #include "halSegmentIterator.h"
 #include "halSlicedSegment.h"
 #include "halTopSegmentIterator.h"
@@ -20,9 +21,9 @@ namespace hal {
      * Interface for a mapped segment.  A mapped segment stores a source segment
      * and a homologous region in a target genome (to which it was mapped).  Mapped
      * segments are used to keep pairwise alignment fragments across the tree as
-     * an alternative to the column iterator.
+     * an alternative to the column iterator.  Allocated from the free lists.
      */
-    class MappedSegment {
+    class MappedSegment : public FreeListAllocated {
       public:
         /* Constructor */
         MappedSegment(SegmentIteratorPtr sourceSegIt, SegmentIteratorPtr targetSegIt);
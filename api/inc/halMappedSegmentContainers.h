@@ -7,7 +7,11 @@
 #ifndef _HALMAPPEDSEGMENTCONTAINERS_H
 #define _HALMAPPEDSEGMENTCONTAINERS_H
 #include "halDefs.h"
-#include <set>
+#include "halFreeList.h"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <vector>
 
 namespace hal {
     /* Functor for set compare; implemented in halMappedSegment.cpp This needs
@@ -20,8 +24,118 @@ namespace hal {
         bool operator()(const hal::MappedSegmentPtr &m1, const hal::MappedSegmentPtr &m2) const;
     };
 
-    /* set of MappedSegments objects */
-    class MappedSegmentSet : public std::set<MappedSegmentPtr, MappedSegmentLess> {};
+    /* set of MappedSegments objects, with the interface of a std::set but
+     * kept as a sorted vector.  Lookups and iteration work on contiguous
+     * memory, and ranges of segments are added with a single merge rather than
+     * a tree node each.  Unlike a std::set, inserting or erasing elements
+     * invalidates iterators. */
+    class MappedSegmentSet {
+      public:
+        typedef MappedSegmentPtr key_type;
+        typedef MappedSegmentPtr value_type;
+        typedef MappedSegmentLess key_compare;
+        typedef std::vector<MappedSegmentPtr>::size_type size_type;
+        typedef std::vector<MappedSegmentPtr>::const_iterator iterator;
+        typedef std::vector<MappedSegmentPtr>::const_iterator const_iterator;
+
+        const_iterator begin() const {
+            return _segments.begin();
+        }
+        const_iterator end() const {
+            return _segments.end();
+        }
+        size_type size() const {
+            return _segments.size();
+        }
+        bool empty() const {
+            return _segments.empty();
+        }
+        void clear() {
+            _segments.clear();
+        }
+        void reserve(size_type n) {
+            _segments.reserve(n);
+        }
+        key_compare key_comp() const {
+            return key_compare();
+        }
+
+        const_iterator lower_bound(const MappedSegmentPtr &seg) const {
+            return std::lower_bound(_segments.begin(), _segments.end(), seg, key_compare());
+        }
+        const_iterator upper_bound(const MappedSegmentPtr &seg) const {
+            return std::upper_bound(_segments.begin(), _segments.end(), seg, key_compare());
+        }
+        const_iterator find(const MappedSegmentPtr &seg) const {
+            const_iterator i = lower_bound(seg);
+            return (i == end() || key_compare()(seg, *i)) ? end() : i;
+        }
+        size_type count(const MappedSegmentPtr &seg) const {
+            return find(seg) == end() ? 0 : 1;
+        }
+
+        /* add a segment unless an equivalent one is already present */
+        std::pair<iterator, bool> insert(const MappedSegmentPtr &seg) {
+            std::vector<MappedSegmentPtr>::iterator i =
+                std::lower_bound(_segments.begin(), _segments.end(), seg, key_compare());
+            if (i != _segments.end() && !key_compare()(seg, *i)) {
+                return std::pair<iterator, bool>(i, false);
+            }
+            return std::pair<iterator, bool>(_segments.insert(i, seg), true);
+        }
+
+        /* add a range of segments.  as with std::set, segments equivalent to
+         * one already present (or earlier in the range) are dropped.  the new
+         * segments are sorted, then placed with a single pass that shifts
+         * each existing segment at most once */
+        template <class InputIt> void insert(InputIt first, InputIt last) {
+            if (first != last && std::next(first) == last) {
+                insert(*first);
+                return;
+            }
+            typedef std::vector<MappedSegmentPtr, FreeListAllocator<MappedSegmentPtr>> SegmentVector;
+            SegmentVector newSegs;
+            for (; first != last; ++first) {
+                if (find(*first) == end()) {
+                    SegmentVector::iterator i =
+                        std::lower_bound(newSegs.begin(), newSegs.end(), *first, key_compare());
+                    if (i == newSegs.end() || key_compare()(*first, *i)) {
+                        newSegs.insert(i, *first);
+                    }
+                }
+            }
+            size_type oldEnd = _segments.size();
+            _segments.resize(_segments.size() + newSegs.size());
+            size_type dest = _segments.size();
+            for (size_type j = newSegs.size(); j > 0; --j) {
+                size_type pos =
+                    std::lower_bound(_segments.begin(), _segments.begin() + oldEnd, newSegs[j - 1], key_compare()) -
+                    _segments.begin();
+                std::move_backward(_segments.begin() + pos, _segments.begin() + oldEnd, _segments.begin() + dest);
+                dest -= oldEnd - pos;
+                _segments[--dest] = std::move(newSegs[j - 1]);
+                oldEnd = pos;
+            }
+        }
+
+        iterator erase(const_iterator pos) {
+            return _segments.erase(_segments.begin() + (pos - begin()));
+        }
+        iterator erase(const_iterator first, const_iterator last) {
+            return _segments.erase(_segments.begin() + (first - begin()), _segments.begin() + (last - begin()));
+        }
+        size_type erase(const MappedSegmentPtr &seg) {
+            const_iterator i = find(seg);
+            if (i == end()) {
+                return 0;
+            }
+            erase(i);
+            return 1;
+        }
+
+      private:
+        std::vector<MappedSegmentPtr> _segments;
+    };
 }
 
 #endif
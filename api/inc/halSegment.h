@@ -9,6 +9,7 @@
 #define _HALSEGMENT_H
 
 #include "halDefs.h"
+#include "halFreeList.h"
 #include "halMappedSegmentContainers.h"
 #include <cassert>
 #include <set>
@@ -19,9 +20,10 @@ namespace hal {
 
     /**
      * Interface for a segment of DNA. Note that segments should
-     * not be written to outside of creating new genomes.
+     * not be written to outside of creating new genomes.  Segments and
+     * segment iterators are allocated from the free lists.
      */
-    class Segment {
+    class Segment : public FreeListAllocated {
       public:
         /** Destructor */
         virtual ~Segment() {
@@ -8,14 +8,188 @@
 #ifndef _HALSEGMENTMAPPER_H
 #define _HALSEGMENTMAPPER_H
 #include "halDefs.h"
+#include "halFreeList.h"
 #include "halSegmentIterator.h"
+#include <list>
+#include <map>
 #include <set>
+#include <string>
+#include <vector>
 
 namespace hal {
     class Segment;
     class MappedSegmentSet;
     class Genome;
 
+    /** Size-bounded LRU cache of halMapSegment results.  The mappings of
+     * whole segments are stored, keyed on the source segment and all
+     * parameters that affect the result, and are sliced to the part of the
+     * segment that is being mapped.  This saves recomputing the mapping
+     * when the same segments are mapped over and over (ie by overlapping
+     * queries).  Calls with a minLength are not cached, as filtering the
+     * whole segment's mappings isn't the same as filtering those of a slice.
+     * A cache must not be shared between threads or outlive the alignment. */
+    class SegmentMapperCache {
+      public:
+        /** @param maxSize maximum number of mapped segments kept */
+        SegmentMapperCache(hal_size_t maxSize = defaultMaxSize);
+
+        static const hal_size_t defaultMaxSize;
+
+        /** Number of calls served from the cache */
+        hal_size_t getNumHits() const {
+            return _numHits;
+        }
+
+        /** Number of calls that had to map their segment */
+        hal_size_t getNumMisses() const {
+            return _numMisses;
+        }
+
+        /** Number of mapped segments in the cache */
+        hal_size_t getSize() const {
+            return _size;
+        }
+
+        hal_size_t getMaxSize() const {
+            return _maxSize;
+        }
+
+        /** Remove all entries.  The counters are not reset */
+        void clear();
+
+        void resetCounters() {
+            _numHits = 0;
+            _numMisses = 0;
+        }
+
+        /** Everything that determines the mappings of a segment */
+        struct Key {
+            const Genome *_srcGenome;
+            bool _isTop;
+            hal_index_t _arrayIndex;
+            const Genome *_tgtGenome;
+            const Genome *_coalescenceLimit;
+            const Genome *_mrca;
+            bool _doDupes;
+            std::vector<const Genome *> _genomesOnPath;
+            bool operator<(const Key &other) const;
+        };
+
+        /** Get the cached mappings for key, or NULL if there are none */
+        const std::vector<MappedSegmentPtr> *find(const Key &key);
+
+        /** Add the mappings for key, evicting the least recently used entries
+         * if the cache is full.  The mappings are moved into the cache,
+         * leaving the vector empty */
+        const std::vector<MappedSegmentPtr> *insert(const Key &key, std::vector<MappedSegmentPtr> &mappings);
+
+      private:
+        typedef std::list<Key> KeyList;
+        struct Entry {
+            std::vector<MappedSegmentPtr> _mappings;
+            KeyList::iterator _lruPos;
+        };
+        typedef std::map<Key, Entry> EntryMap;
+
+        void evict();
+
+        EntryMap _entries;
+        KeyList _lru;
+        hal_size_t _maxSize;
+        hal_size_t _size;
+        hal_size_t _numHits;
+        hal_size_t _numMisses;
+    };
+
+    /** Maps segments of one genome to another.  The path through the tree
+     * from the source genome up to the MRCA and coalescence limit and down to
+     * the target is worked out on construction, and the scratch buffers used
+     * to break overlaps are kept between calls, so mapping many segments
+     * with the same parameters has no per-call setup.  The parameters are as
+     * for halMapSegment() below.  A mapper must not be shared between
+     * threads. */
+    class SegmentMapper {
+      public:
+        SegmentMapper(const Genome *srcGenome, const Genome *tgtGenome, const std::set<const Genome *> *genomesOnPath = NULL,
+                      bool doDupes = true, hal_size_t minLength = 0, const Genome *coalescenceLimit = NULL,
+                      const Genome *mrca = NULL);
+
+        /** Add the homologous segments of source (a segment of the source
+         * genome) in the target genome to outSegments.  Returns the number
+         * of mapped segments found */
+        hal_size_t map(const SegmentIterator *source, MappedSegmentSet &outSegments);
+
+        hal_size_t map(const SegmentIteratorPtr &source, MappedSegmentSet &outSegments) {
+            return map(source.get(), outSegments);
+        }
+
+        /** Reuse the mappings of whole segments kept in cache (NULL for none) */
+        void setCache(SegmentMapperCache *cache) {
+            _cache = cache;
+        }
+
+        const Genome *getSrcGenome() const {
+            return _srcGenome;
+        }
+
+        const Genome *getTgtGenome() const {
+            return _tgtGenome;
+        }
+
+        const Genome *getMrca() const {
+            return _mrca;
+        }
+
+        const Genome *getCoalescenceLimit() const {
+            return _coalescenceLimit;
+        }
+
+        const std::set<const Genome *> &getGenomesOnPath() const {
+            return _genomesOnPath;
+        }
+
+        /** Containers used while mapping, allocated from the free lists */
+        typedef std::list<MappedSegmentPtr, FreeListAllocator<MappedSegmentPtr>> MappedSegmentList;
+        typedef std::vector<MappedSegmentPtr, FreeListAllocator<MappedSegmentPtr>> MappedSegmentVector;
+
+      private:
+        /** The child of a genome to move into on the way down to a target */
+        struct PathStep {
+            const Genome *_genome;
+            const Genome *_target;
+            hal_size_t _childIndex;
+            const Genome *_child;
+        };
+
+        const PathStep &getPathStep(const Genome *genome, const Genome *target);
+        void mapToList(const SegmentIterator *source, MappedSegmentList &output, hal_size_t minLength);
+        hal_size_t mapRecursiveDown(MappedSegmentList &input, MappedSegmentList &results, const Genome *tgtGenome,
+                                    bool doDupes, hal_size_t minLength);
+        hal_size_t mapRecursiveParalogies(const Genome *srcGenome, MappedSegmentList &input, MappedSegmentList &results,
+                                          hal_size_t minLength);
+        hal_size_t mapCached(const SegmentIterator *source, MappedSegmentSet &results);
+        void insertAndBreakOverlaps(MappedSegmentPtr seg, MappedSegmentSet &results);
+
+        const Genome *_srcGenome;
+        const Genome *_tgtGenome;
+        bool _doDupes;
+        hal_size_t _minLength;
+        const Genome *_mrca;
+        const Genome *_coalescenceLimit;
+        std::set<const Genome *> _genomesOnPath;
+        std::set<std::string> _namesOnPath;
+        std::vector<PathStep> _pathSteps;
+        SegmentMapperCache *_cache;
+        SegmentMapperCache::Key _cacheKey;
+
+        MappedSegmentVector _inputSegs;
+        MappedSegmentVector _clippedSegs;
+        MappedSegmentVector _newSegs;
+        MappedSegmentVector _cutSegs;
+        std::vector<size_t> _cutIndexes;
+    };
+
     /** Get homologous segments in target genome.  Returns the number
       * of mapped segments found.
       * @param source Input.
@@ -38,14 +212,18 @@ namespace hal {
       * this genome will be mapped to the target as well. Must be the
       * MRCA or higher. By default, the coalescenceLimit is the MRCA.
       * @param mrca The MRCA of the source and target genomes. By
-      * default, it is computed automatically. */
+      * default, it is computed automatically.
+      * @param cache Optional cache of mappings of whole segments to reuse
+      * across calls. */
     hal_size_t halMapSegment(const SegmentIterator *source, MappedSegmentSet &outSegments, const Genome *tgtGenome,
                              const std::set<const Genome *> *genomesOnPath = NULL, bool doDupes = true,
-                             hal_size_t minLength = 0, const Genome *coalescenceLimit = NULL, const Genome *mrca = NULL);
+                             hal_size_t minLength = 0, const Genome *coalescenceLimit = NULL, const Genome *mrca = NULL,
+                             SegmentMapperCache *cache = NULL);
 
     /* call main function with smart pointer */
     hal_size_t halMapSegmentSP(const SegmentIteratorPtr &source, MappedSegmentSet &outSegments, const Genome *tgtGenome,
                                const std::set<const Genome *> *genomesOnPath = NULL, bool doDupes = true,
-                               hal_size_t minLength = 0, const Genome *coalescenceLimit = NULL, const Genome *mrca = NULL);
+                               hal_size_t minLength = 0, const Genome *coalescenceLimit = NULL, const Genome *mrca = NULL,
+                               SegmentMapperCache *cache = NULL);
 }
 #endif
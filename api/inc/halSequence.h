@@ -164,6 +164,19 @@ namespace hal {
           * @param start First position of substring
           * @param length Length of substring */
         virtual void setSubString(const std::string &inString, hal_size_t start, hal_size_t length) = 0;
+
+        /** Get length bases starting at start into a buffer.  Like
+         * getSubString(), but fills a caller's buffer
+         * @param start First position of the bases
+         * @param length Number of bases
+         * @param out Buffer of at least length characters */
+        void getBases(hal_size_t start, hal_size_t length, char *out) const;
+
+        /** Set length bases starting at start from a buffer
+         * @param start First position of the bases
+         * @param length Number of bases
+         * @param in Buffer of at least length characters */
+        void setBases(hal_size_t start, hal_size_t length, const char *in);
     };
 }
 #endif
@@ -26,7 +26,7 @@ namespace hal {
         /* constructor */
         TopSegmentIterator(TopSegment *topSegment, hal_offset_t startOffset = 0, hal_offset_t endOffset = 0,
                            bool reversed = false)
-            : SegmentIterator(startOffset, endOffset, reversed), _topSegment(topSegment) {
+            : SegmentIterator(startOffset, endOffset, reversed), _topSegment(makeFreeListPtr(topSegment)) {
         }
 
         /* destructor */
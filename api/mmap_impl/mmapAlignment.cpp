@@ -1,16 +1,22 @@
 #include "mmapAlignment.h"
 #include "halCLParser.h"
+#include "mmapFileCompressed.h"
 #include "mmapGenome.h"
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
 
 using namespace hal;
 using namespace std;
 
 static const int NAME_HASH_GROWTH_FACTOR = 1024; // allow lots of initial space
 
-MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, size_t fileSize)
-    : _alignmentPath(alignmentPath), _mode(mode), _fileSize(fileSize), _file(NULL), _data(NULL), _genomeNameHash(NULL),
-      _tree(NULL) {
-    _file = MMapFile::factory(alignmentPath, mode, fileSize);
+MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, size_t fileSize, bool packDna,
+                             bool compactSegments, bool compress, size_t cacheBytes)
+    : _alignmentPath(alignmentPath), _mode(mode), _fileSize(fileSize), _packDna(packDna), _compactSegments(compactSegments),
+      _compress(compress), _cacheBytes(cacheBytes), _file(NULL), _data(NULL), _genomeNameHash(NULL), _tree(NULL),
+      _printMemoryStats(false) {
+    _file = MMapFile::factory(alignmentPath, mode, fileSize, cacheBytes);
     if (mode & CREATE_ACCESS) {
         create();
     } else {
@@ -19,10 +25,11 @@ MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, si
 }
 
 MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser)
-    : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _fileSize(0), _file(NULL), _data(NULL),
-      _genomeNameHash(NULL), _tree(NULL) {
+    : _alignmentPath(alignmentPath), _mode(halDefaultAccessMode(mode)), _fileSize(0), _packDna(false),
+      _compactSegments(false), _compress(false), _cacheBytes(MMAP_DEFAULT_CACHE_BYTES), _file(NULL), _data(NULL),
+      _genomeNameHash(NULL), _tree(NULL), _printMemoryStats(false) {
     initializeFromOptions(parser);
-    _file = MMapFile::factory(alignmentPath, _mode, _fileSize);
+    _file = MMapFile::factory(alignmentPath, _mode, _fileSize, _cacheBytes, _blockCacheConfig);
     if (mode & CREATE_ACCESS) {
         create();
     } else {
@@ -31,22 +38,78 @@ MMapAlignment::MMapAlignment(const std::string &alignmentPath, unsigned mode, co
 }
 
 void MMapAlignment::close() {
-    // Free the memory used by all open genomes.
+    // Free the memory used by all open genomes, packing any DNA and
+    // compacting any segments still waiting for it.
+    printGenomeMemoryStats();
     for (auto kv : _openGenomes) {
+        kv.second->packDna();
+        kv.second->compactSegments();
         delete kv.second;
     }
+    _openGenomes.clear();
     // Close the actual file.
     delete _genomeNameHash;
     _genomeNameHash = NULL;
     _file->close();
+    if (_compress) {
+        compressFile();
+    }
+}
+
+/* report the memory of the open genomes if requested, which is done once
+ * they are closed or the alignment is deleted without closing it */
+void MMapAlignment::printGenomeMemoryStats() const {
+    if (_printMemoryStats and not _openGenomes.empty()) {
+        cerr << _alignmentPath << ": " << getGenomeMemoryStats() << endl;
+    }
+}
+
+/* replace the closed file with its compressed version */
+void MMapAlignment::compressFile() {
+    string tmpPath = _alignmentPath + ".compressing";
+    try {
+        MMapFileCompressed::compress(_alignmentPath, tmpPath);
+    } catch (...) {
+        ::remove(tmpPath.c_str());
+        throw;
+    }
+    if (::rename(tmpPath.c_str(), _alignmentPath.c_str()) < 0) {
+        throw hal_errno_exception(_alignmentPath, "rename of compressed file failed", errno);
+    }
+}
+
+void MMapAlignment::closeGenome(const Genome *genome) const {
+    // Genomes stay open, but the DNA and segments of a new genome are packed
+    // once it is done with.
+    MMapGenome *mmapGenome = const_cast<MMapGenome *>(static_cast<const MMapGenome *>(genome));
+    mmapGenome->packDna();
+    mmapGenome->compactSegments();
 }
 
 void MMapAlignment::defineOptions(CLParser *parser, unsigned mode) {
     if (mode & CREATE_ACCESS) {
-        parser->addOption("mmapFileSize", "mmap HAL file initial size (in gigabytes)", MMAP_DEFAULT_FILE_SIZE_GB);
+        parser->addOption("mmapFileSize", "mmap HAL file initial size (in gigabytes), the file is grown as needed", MMAP_DEFAULT_FILE_SIZE_GB);
     } else if (mode & WRITE_ACCESS) {
-        parser->addOption("mmapSizeIncrease", "additional space to reserve at end of file (in gigabytes)", 1);
+        parser->addOption("mmapSizeIncrease", "additional space to reserve at end of file (in gigabytes), the file is grown as needed", 1);
+    }
+    if (mode & (CREATE_ACCESS | WRITE_ACCESS)) {
+        parser->addOptionFlag("mmapPackDna",
+                              "store the DNA of new genomes two bits per base with separate N and lowercase runs (about half "
+                              "the size, but the DNA can't be modified once written)",
+                              false);
+        parser->addOptionFlag("mmapCompactSegments",
+                              "store the segments of new genomes as compact tables with 32-bit fields where possible "
+                              "(smaller and faster to scan, but the segments can't be modified once written)",
+                              false);
+        parser->addOptionFlag("mmapCompress",
+                              "compress the file in independently compressed blocks when it is closed (the file can "
+                              "then only be read)",
+                              false);
     }
+    parser->addOption("mmapCacheSize",
+                      "memory (in megabytes) holding the blocks loaded when reading a compressed mmap file or reading through "
+                      "--blockCacheDir, 0 for no limit",
+                      MMAP_DEFAULT_CACHE_SIZE_MB);
 }
 
 /* initialize class from options */
@@ -62,6 +125,15 @@ void MMapAlignment::initializeFromOptions(const CLParser *parser) {
         // 3 separate factory functions.
         _fileSize = GIGABYTE * parser->get<size_t>("mmapSizeIncrease");
     }
+    if (_mode & (CREATE_ACCESS | WRITE_ACCESS)) {
+        _packDna = parser->getFlag("mmapPackDna");
+        _compactSegments = parser->getFlag("mmapCompactSegments");
+        _compress = parser->getFlag("mmapCompress");
+    }
+    _cacheBytes = parser->get<size_t>("mmapCacheSize") * 1024 * 1024;
+    _blockCacheConfig = LocalBlockCacheConfig::fromOptions(parser);
+    _printMemoryStats = parser->getFlag("genomeMemoryStats");
+    _memoryBudget.setBudget(parser->get<hal_size_t>("genomeMemoryBudget") * 1024 * 1024, _printMemoryStats);
 }
 
 void MMapAlignment::create() {
@@ -161,6 +233,7 @@ Genome *MMapAlignment::addRootGenome(const string &name, double branchLength) {
 }
 
 Genome *MMapAlignment::_openGenome(const string &name) const {
+    std::lock_guard<std::mutex> lock(_openGenomesMutex);
     if (_openGenomes.find(name) != _openGenomes.end()) {
         // Already loaded.
         return _openGenomes[name];
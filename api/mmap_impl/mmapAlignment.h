@@ -6,6 +6,7 @@
 #include "sonLib.h"
 #include <deque>
 #include <map>
+#include <mutex>
 
 namespace hal {
     class CLParser;
@@ -35,11 +36,14 @@ namespace hal {
 
       public:
         /* constructor with all arguments specified */
-        MMapAlignment(const std::string &alignmentPath, unsigned mode = READ_ACCESS, size_t fileSize = MMAP_DEFAULT_FILE_SIZE);
+        MMapAlignment(const std::string &alignmentPath, unsigned mode = READ_ACCESS, size_t fileSize = MMAP_DEFAULT_FILE_SIZE,
+                      bool packDna = false, bool compactSegments = false, bool compress = false,
+                      size_t cacheBytes = MMAP_DEFAULT_CACHE_BYTES);
 
         /* constructor from command line options */
         MMapAlignment(const std::string &alignmentPath, unsigned mode, const CLParser *parser);
         ~MMapAlignment() {
+            printGenomeMemoryStats();
             if (_tree != NULL) {
                 stTree_destruct(_tree);
             }
@@ -57,6 +61,17 @@ namespace hal {
 
         void close();
 
+        /* are the DNA arrays of new genomes packed (see MMapPackedDnaData)? */
+        bool getPackDna() const {
+            return _packDna;
+        }
+
+        /* are the segment arrays of new genomes stored as compact tables (see
+         * MMapSegmentTable)? */
+        bool getCompactSegments() const {
+            return _compactSegments;
+        }
+
         const std::string &getStorageFormat() const {
             return STORAGE_FORMAT_MMAP;
         }
@@ -64,6 +79,15 @@ namespace hal {
             return _file;
         }
 
+        /* budget for the memory of the open genomes */
+        GenomeMemoryBudget &getMemoryBudget() const {
+            return _memoryBudget;
+        }
+
+        GenomeMemoryStats getGenomeMemoryStats() const {
+            return _memoryBudget.getStats();
+        }
+
         Genome *addLeafGenome(const std::string &name, const std::string &parentName, double branchLength);
 
         Genome *addRootGenome(const std::string &name, double branchLength);
@@ -87,9 +111,7 @@ namespace hal {
             return _openGenome(name);
         }
 
-        void closeGenome(const Genome *genome) const {
-            // Intentionally left blank.
-        };
+        void closeGenome(const Genome *genome) const;
 
         std::string getRootName() const {
             return stTree_getLabel(_tree);
@@ -125,21 +147,15 @@ namespace hal {
         };
 
         std::vector<std::string> getChildNames(const std::string &name) const {
-            if (_childNames.find(name) != _childNames.end()) {
-                return _childNames[name];
-            } else {
-                _fillChildNames(name);
-                return _childNames[name];
-            }
+            return getChildNamesRef(name);
         }
 
         std::vector<std::string> &getChildNamesRef(const std::string &name) const {
-            if (_childNames.find(name) != _childNames.end()) {
-                return _childNames[name];
-            } else {
+            std::lock_guard<std::mutex> lock(_childNamesMutex);
+            if (_childNames.find(name) == _childNames.end()) {
                 _fillChildNames(name);
-                return _childNames[name];
             }
+            return _childNames[name];
         }
 
         void _fillChildNames(const std::string &name) const {
@@ -203,6 +219,8 @@ namespace hal {
       private:
         void initializeFromOptions(const CLParser *parser);
         void create();
+        void compressFile();
+        void printGenomeMemoryStats() const;
         void open();
         void addGenomeToNameHash(const MMapGenome *genome, vector<string> &existingNames);
         Genome *_openGenome(const std::string &name) const;
@@ -228,15 +246,27 @@ namespace hal {
             _data->setNewickString(this, newickString);
             free(newickString);
         };
+        // Genomes and child name lists are loaded lazily on first access.  The
+        // mutexes guard these caches so that an alignment opened read-only can be
+        // shared between threads.
+        mutable std::mutex _openGenomesMutex;
         mutable std::map<std::string, MMapGenome *> _openGenomes;
         std::string _alignmentPath;
         unsigned _mode;
         size_t _fileSize;
+        bool _packDna;
+        bool _compactSegments;
+        bool _compress;
+        size_t _cacheBytes;
+        LocalBlockCacheConfig _blockCacheConfig;
         MMapFile *_file;
         MMapAlignmentData *_data;
         MMapPerfectHashTable *_genomeNameHash;
         stTree *_tree;
+        mutable std::mutex _childNamesMutex;
         mutable std::map<std::string, std::vector<std::string>> _childNames;
+        mutable GenomeMemoryBudget _memoryBudget;
+        bool _printMemoryStats;
     };
 
     inline const char *MMapAlignmentData::getNewickString(const MMapAlignment *alignment) {
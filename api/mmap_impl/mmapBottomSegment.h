@@ -10,18 +10,19 @@ namespace hal {
     class MMapBottomSegment : public BottomSegment {
       public:
         MMapBottomSegment(MMapGenome *genome, hal_index_t arrayIndex)
-            : BottomSegment(genome, arrayIndex), _data(genome->getBottomSegmentPointer(arrayIndex)) {
+            : BottomSegment(genome, arrayIndex) {
+            setData(arrayIndex);
         }
 
         // SEGMENT INTERFACE
         void setArrayIndex(Genome *genome, hal_index_t arrayIndex) {
             _genome = genome;
-            _data = getMMapGenome()->getBottomSegmentPointer(arrayIndex);
+            setData(arrayIndex);
             _index = arrayIndex;
         };
         const Sequence *getSequence() const;
         hal_index_t getStartPosition() const {
-            return _data->getStartPosition();
+            return _table != NULL ? _table->getStartPosition(getAlignment(), _index) : _data->getStartPosition();
         };
         hal_index_t getEndPosition() const;
         hal_size_t getLength() const;
@@ -34,24 +35,30 @@ namespace hal {
         // BOTTOM SEGMENT INTERFACE
         hal_size_t getNumChildren() const;
         hal_index_t getChildIndex(hal_size_t i) const {
-            return _data->getChildIndex(i);
+            return _table != NULL ? _table->getIndex(getAlignment(), MMapSegmentTable::BOTTOM_CHILD_INDEX + i, _index)
+                                  : _data->getChildIndex(i);
         };
         hal_index_t getChildIndexG(const Genome *childGenome) const;
         bool hasChild(hal_size_t child) const;
         bool hasChildG(const Genome *childGenome) const;
         void setChildIndex(hal_size_t i, hal_index_t childIndex) {
+            checkWritable();
             _data->setChildIndex(i, childIndex);
         };
         bool getChildReversed(hal_size_t i) const {
-            return _data->getChildReversed(_genome->getNumChildren(), i);
+            return _table != NULL ? _table->getFlag(getAlignment(), i, _index)
+                                  : _data->getChildReversed(_genome->getNumChildren(), i);
         };
         void setChildReversed(hal_size_t child, bool isReversed) {
+            checkWritable();
             _data->setChildReversed(_genome->getNumChildren(), child, isReversed);
         };
         hal_index_t getTopParseIndex() const {
-            return _data->getTopParseIndex();
+            return _table != NULL ? _table->getIndex(getAlignment(), MMapSegmentTable::BOTTOM_PARSE_INDEX, _index)
+                                  : _data->getTopParseIndex();
         };
         void setTopParseIndex(hal_index_t parseIndex) {
+            checkWritable();
             _data->setTopParseIndex(parseIndex);
         };
         hal_offset_t getTopParseOffset() const;
@@ -63,11 +70,27 @@ namespace hal {
         MMapGenome *getMMapGenome() const {
             return static_cast<MMapGenome *>(_genome);
         }
+        MMapAlignment *getAlignment() const {
+            return getMMapGenome()->_alignment;
+        }
+        // Segments stored as a compact table are read through _table,
+        // otherwise through _data.
+        void setData(hal_index_t arrayIndex) {
+            _table = getMMapGenome()->getBottomSegmentTable();
+            _data = _table == NULL ? getMMapGenome()->getBottomSegmentPointer(arrayIndex) : NULL;
+        }
+        void checkWritable() const {
+            if (_table != NULL) {
+                throw hal_exception("can't modify the bottom segments of genome " + _genome->getName() +
+                                    ", which are stored as a compact table");
+            }
+        }
 
         // Return a pointer to the data for the segment *after* this one in the array.
         MMapBottomSegmentData *getNextData() const {
             return (MMapBottomSegmentData *)(((char *)_data) + MMapBottomSegmentData::getSize(_genome));
         };
+        const MMapSegmentTable *_table;
         MMapBottomSegmentData *_data;
     };
 
@@ -76,6 +99,9 @@ namespace hal {
     }
 
     inline hal_size_t MMapBottomSegment::getLength() const {
+        if (_table != NULL) {
+            return _table->getStartPosition(getAlignment(), _index + 1) - _table->getStartPosition(getAlignment(), _index);
+        }
         return getNextData()->getStartPosition() - _data->getStartPosition();
     }
 
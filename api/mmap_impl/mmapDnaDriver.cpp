@@ -7,15 +7,23 @@
 #include "mmapDnaDriver.h"
 #include "mmapAlignment.h"
 #include "mmapGenome.h"
+#include "mmapPackedDna.h"
 
 using namespace hal;
 
-static const int UDC_FETCH_SIZE = 64 * 1024; // size to bring in for UDC access
+static const int UDC_FETCH_SIZE = 64 * 1024;   // size to bring in for UDC access
+// packed DNA is decoded starting with a small window, which doubles with each
+// fetch up to a maximum, so short reads are cheap and long ones amortized
+static const hal_size_t PACKED_MIN_FETCH_SIZE = 256;
+static const hal_size_t PACKED_MAX_FETCH_SIZE = 16 * 1024;
 
 MMapDnaAccess::MMapDnaAccess(MMapGenome *genome, hal_index_t index)
     : DnaAccess(0, 0, NULL), _genome(genome),
-      _isUdcProtocol(dynamic_cast<MMapAlignment *>(_genome->getAlignment())->getMMapFile()->isUdcProtocol()) {
-    if (_isUdcProtocol) {
+      _isUdcProtocol(dynamic_cast<MMapAlignment *>(_genome->getAlignment())->getMMapFile()->isUdcProtocol()),
+      _packedDna(_genome->getPackedDna()), _fetchSize(PACKED_MIN_FETCH_SIZE) {
+    if (_packedDna != NULL) {
+        // decoded on first access, as an iterator can be created just past the end
+    } else if (_isUdcProtocol) {
         fetch(index);
     } else {
         // for local mmap, just include the whole thing
@@ -25,12 +33,30 @@ MMapDnaAccess::MMapDnaAccess(MMapGenome *genome, hal_index_t index)
 }
 
 void MMapDnaAccess::flush() {
+    if (_dirty && _packedDna != NULL) {
+        _dirty = false;
+        throw hal_exception("can't modify the DNA of genome " + _genome->getName() + ", which is stored packed");
+    }
     // kernel handles page out
     _dirty = false;
 }
 
 void MMapDnaAccess::fetch(hal_index_t index) const {
-    if (_isUdcProtocol) {
+    if (_packedDna != NULL) {
+        if (_dirty) {
+            const_cast<MMapDnaAccess *>(this)->flush();
+        }
+        if (index < 0 || index >= (hal_index_t)_genome->getSequenceLength()) {
+            throw hal_exception("DNA index " + std::to_string(index) + " out of range in genome " + _genome->getName());
+        }
+        _startIndex = 2 * (index / 2); // even boundary
+        _endIndex = std::min(hal_size_t(_startIndex + _fetchSize), _genome->getSequenceLength());
+        _unpacked.resize(_fetchSize / 2);
+        _fetchSize = std::min(2 * _fetchSize, PACKED_MAX_FETCH_SIZE);
+        _packedDna->unpack(dynamic_cast<MMapAlignment *>(_genome->getAlignment()), _startIndex, _endIndex - _startIndex,
+                           _unpacked.data());
+        _buffer = _unpacked.data();
+    } else if (_isUdcProtocol) {
         _startIndex = 2 * (index / 2); // even boundary
         _endIndex = std::max(hal_size_t(_startIndex + UDC_FETCH_SIZE), _genome->getSequenceLength());
         _buffer = _genome->getDNA(_startIndex / 2, (((_endIndex - _startIndex) + 1) / 2));
@@ -7,13 +7,16 @@
 #ifndef _MMAPDNADRIVER_H
 #define _MMAPDNADRIVER_H
 #include "halDnaDriver.h"
+#include <vector>
 
 namespace hal {
     class MMapGenome;
     class MMapAlignment;
+    class MMapPackedDnaData;
 
     /**
-     * Mmap implementation of DnaAccess.
+     * Mmap implementation of DnaAccess.  Packed DNA is decoded a window at a
+     * time into a buffer, and is read-only.
      */
     class MMapDnaAccess : public DnaAccess {
       public:
@@ -30,6 +33,9 @@ namespace hal {
       private:
         MMapGenome *_genome;
         bool _isUdcProtocol;
+        const MMapPackedDnaData *_packedDna;
+        mutable std::vector<char> _unpacked;
+        mutable hal_size_t _fetchSize;
     };
 }
 
@@ -1,7 +1,12 @@
 #include "mmapFile.h"
+#include "mmapFileBlocks.h"
+#include "mmapFileCompressed.h"
 #include "halCommon.h"
+#include "halLocalBlockCache.h"
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
+#include <mutex>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -18,10 +23,8 @@ static const std::string FORMAT_NAME = "HAL-MMAP";
 
 /* get current version as a string */
 static const std::string& getMmapApiVersion() {
-    static std::string version;
-    if (version == "") {
-        version = std::to_string(hal::MMAP_API_MAJOR_VERSION) + "." + std::to_string(hal::MMAP_API_MINOR_VERSION);
-    }
+    static const std::string version =
+        std::to_string(hal::MMAP_API_MAJOR_VERSION) + "." + std::to_string(hal::MMAP_API_MINOR_VERSION);
     return version;
 }
 
@@ -116,6 +119,11 @@ void hal::MMapFile::createHeader() {
     _header->nextOffset = _header->nextOffset;
 }
 
+/* file can't be grown by default */
+void hal::MMapFile::grow(size_t size) {
+    throw hal_exception("mmap file is full, specify file size larger than " + std::to_string(_fileSize));
+}
+
 namespace hal {
     /* Class that implements local file version of MMapFile */
     class MMapFileLocal : public MMapFile {
@@ -126,6 +134,13 @@ namespace hal {
         virtual bool isUdcProtocol() const {
             return false;
         }
+        virtual bool canRelease() const {
+            return true;
+        }
+        virtual void release(size_t offset, size_t size) const;
+
+      protected:
+        virtual void grow(size_t size);
 
       private:
         int openFile();
@@ -133,16 +148,18 @@ namespace hal {
         void adjustFileSize(size_t size);
         void *mapFile(void *requiredAddr = NULL);
         void unmapFile();
+        void reserveAddressSpace(size_t fileSize);
         void openRead();
         void openWrite(size_t fileSize);
 
-        int _fd; // open file descriptor
+        int _fd;              // open file descriptor
+        size_t _reservedSize; // address space reserved for growth, or 0
     };
 }
 
 /* Constructor. Open or create the specified file. */
 hal::MMapFileLocal::MMapFileLocal(const std::string &alignmentPath, unsigned mode, size_t fileSize)
-    : MMapFile(alignmentPath, mode, false), _fd(-1) {
+    : MMapFile(alignmentPath, mode, false), _fd(-1), _reservedSize(0) {
     if (_mode & WRITE_ACCESS) {
         openWrite(fileSize);
     } else {
@@ -196,7 +213,7 @@ void hal::MMapFileLocal::adjustFileSize(size_t size) {
 
 /* map file into memory */
 void *hal::MMapFileLocal::mapFile(void *requiredAddr) {
-    assert(_basePtr == NULL);
+    assert(_basePtr == NULL || _basePtr == requiredAddr);
     unsigned prot = PROT_READ | ((_mode & WRITE_ACCESS) ? PROT_WRITE : 0);
     int flags = MAP_SHARED | MAP_FILE;
     if (requiredAddr != NULL) {
@@ -216,16 +233,65 @@ void *hal::MMapFileLocal::mapFile(void *requiredAddr) {
     return ptr;
 }
 
-/* unmap file, if mapped */
+/* drop the whole pages in the range from memory.  The mapping is shared, so
+ * they are read back from the file (or page cache) when next accessed */
+void hal::MMapFileLocal::release(size_t offset, size_t size) const {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t start = ((offset + pageSize - 1) / pageSize) * pageSize;
+    size_t end = ((offset + size) / pageSize) * pageSize;
+    if ((_basePtr != NULL) && (start < end)) {
+        ::madvise(static_cast<char *>(_basePtr) + start, end - start, MADV_DONTNEED);
+    }
+}
+
+/* unmap file, if mapped, along with any reserved address space */
 void hal::MMapFileLocal::unmapFile() {
     if (_basePtr != NULL) {
-        if (::munmap(const_cast<void *>(_basePtr), _fileSize) < 0) {
+        if (::munmap(const_cast<void *>(_basePtr), std::max(_fileSize, _reservedSize)) < 0) {
             throw hal_errno_exception(_alignmentPath, "munmap failed", errno);
         }
         _basePtr = NULL;
+        _reservedSize = 0;
     }
 }
 
+/* Reserve a range of address space for the file to grow into, without
+ * committing any memory.  If MMAP_MAX_FILE_SIZE can't be reserved (ie
+ * because of a ulimit), ask for less, down to the initial size of the
+ * file. */
+void hal::MMapFileLocal::reserveAddressSpace(size_t fileSize) {
+    assert(_basePtr == NULL);
+    size_t reserveSize = std::max(fileSize, MMAP_MAX_FILE_SIZE);
+    while (true) {
+        void *ptr = mmap(NULL, reserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr != MAP_FAILED) {
+            _basePtr = ptr;
+            _reservedSize = reserveSize;
+            return;
+        }
+        if (reserveSize <= fileSize) {
+            throw hal_errno_exception(_alignmentPath, "reserving address space for mmap failed", errno);
+        }
+        reserveSize = std::max(reserveSize / 2, fileSize);
+    }
+}
+
+/* Grow the file to at least size bytes, doubling it so that the number of
+ * remaps stays small.  The file is mapped again at the start of the reserved
+ * space, replacing the old mapping, so its address doesn't change. */
+void hal::MMapFileLocal::grow(size_t size) {
+    assert(_mode & WRITE_ACCESS);
+    if (size > _reservedSize) {
+        throw hal_exception(_alignmentPath + ": mmap file is full, can't grow beyond the " +
+                            std::to_string(_reservedSize) + " bytes of address space reserved for it");
+    }
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t newSize = std::min(std::max(size, 2 * _fileSize), _reservedSize);
+    newSize = std::min(((newSize + pageSize - 1) / pageSize) * pageSize, _reservedSize);
+    adjustFileSize(newSize);
+    mapFile(_basePtr);
+}
+
 /* open the file for read access */
 void hal::MMapFileLocal::openRead() {
     _fd = openFile();
@@ -239,11 +305,13 @@ void hal::MMapFileLocal::openWrite(size_t fileSize) {
     _fd = openFile();
     if (_mode & CREATE_ACCESS) {
         adjustFileSize(0); // clear out existing data
-        adjustFileSize(fileSize);
+        // at least room for the header, the file grows from there
+        adjustFileSize(std::max(fileSize, (size_t)sysconf(_SC_PAGESIZE)));
     } else if (_mode & WRITE_ACCESS) {
         adjustFileSize(getFileStatSize(_fd) + fileSize);
     }
-    _basePtr = mapFile();
+    reserveAddressSpace(_fileSize);
+    mapFile(_basePtr);
     if (_mode & CREATE_ACCESS) {
         createHeader();
     } else {
@@ -261,6 +329,59 @@ void hal::MMapFileLocal::closeFile() {
     }
 }
 
+namespace hal {
+    /* Class that implements MMapFile reading a file on a slow filesystem
+     * through a local block cache.  Blocks are loaded from the local copy
+     * as they are touched, so only the blocks used are fetched. */
+    class MMapFileBlockCache : public MMapFileBlocks {
+      public:
+        MMapFileBlockCache(const std::string &alignmentPath, unsigned mode, size_t cacheBytes,
+                           const LocalBlockCacheConfig &blockCacheConfig);
+        virtual ~MMapFileBlockCache();
+        virtual bool isUdcProtocol() const {
+            return false;
+        }
+
+      protected:
+        virtual void readBlock(size_t block, char *dest) const;
+        virtual void loadAll();
+
+      private:
+        LocalBlockCache _blockCache;
+    };
+}
+
+/* Constructor. Open the specified file through the cache. */
+hal::MMapFileBlockCache::MMapFileBlockCache(const std::string &alignmentPath, unsigned mode, size_t cacheBytes,
+                                            const LocalBlockCacheConfig &blockCacheConfig)
+    : MMapFileBlocks(alignmentPath, mode, cacheBytes), _blockCache(alignmentPath, blockCacheConfig) {
+    try {
+        loadBlocks(_blockCache.getFileSize(), _blockCache.getBlockSize());
+    } catch (...) {
+        stopFaultHandler();
+        throw;
+    }
+}
+
+hal::MMapFileBlockCache::~MMapFileBlockCache() {
+    stopFaultHandler();
+}
+
+void hal::MMapFileBlockCache::readBlock(size_t block, char *dest) const {
+    const_cast<LocalBlockCache &>(_blockCache).read(dest, getBlockLength(block), block * _blockSize);
+}
+
+/* without loading on demand, copy the whole file to the cache and map the
+ * local copy */
+void hal::MMapFileBlockCache::loadAll() {
+    _blockCache.fetch(0, _fileSize);
+    void *basePtr = mmap(NULL, _mappedSize, PROT_READ, MAP_SHARED | MAP_FILE, _blockCache.getCacheFd(), 0);
+    if (basePtr == MAP_FAILED) {
+        throw hal_errno_exception(_alignmentPath, "mmap failed", errno);
+    }
+    _basePtr = basePtr;
+}
+
 #ifdef ENABLE_UDC
 namespace hal {
     /* Class that implements UDC file version of MMapFile */
@@ -278,6 +399,8 @@ namespace hal {
 
       private:
         struct udc2File *_udcFile;
+        // the UDC cache is not thread-safe, serialize fetches
+        mutable std::mutex _fetchMutex;
     };
 }
 
@@ -322,13 +445,15 @@ void hal::MMapFileUdc::fetch(size_t offset, size_t accessSize) const {
         accessSize = _fileSize - offset;
     }
 
+    std::lock_guard<std::mutex> lock(_fetchMutex);
     udc2MMapFetch(_udcFile, offset, accessSize);
 }
 
 #endif
 
 /** create a MMapFile object, opening a local file */
-hal::MMapFile *hal::MMapFile::factory(const std::string &alignmentPath, unsigned mode, size_t fileSize) {
+hal::MMapFile *hal::MMapFile::factory(const std::string &alignmentPath, unsigned mode, size_t fileSize,
+                                      size_t cacheBytes, const LocalBlockCacheConfig &blockCacheConfig) {
     if (isUrl(alignmentPath)) {
         if (mode & (CREATE_ACCESS | WRITE_ACCESS)) {
             throw hal_exception("create or write access not support with URL: " + alignmentPath);
@@ -338,6 +463,10 @@ hal::MMapFile *hal::MMapFile::factory(const std::string &alignmentPath, unsigned
 #else
         throw hal_exception("URL access requires UDC support to be compiled into HAL library: " + alignmentPath);
 #endif
+    } else if (((mode & CREATE_ACCESS) == 0) && MMapFileCompressed::isCompressedFile(alignmentPath)) {
+        return new MMapFileCompressed(alignmentPath, mode, cacheBytes, blockCacheConfig);
+    } else if (((mode & WRITE_ACCESS) == 0) && blockCacheConfig.isEnabled()) {
+        return new MMapFileBlockCache(alignmentPath, mode, cacheBytes, blockCacheConfig);
     } else {
         return new MMapFileLocal(alignmentPath, mode, fileSize);
     }
@@ -2,6 +2,7 @@
 #define _MMAPFILE_H
 #include "halAlignmentInstance.h"
 #include "halDefs.h"
+#include "halLocalBlockCache.h"
 #include <cassert>
 #include <cstddef>
 #include <iostream>
@@ -10,7 +11,7 @@
 namespace hal {
     /* Current API major and minor versions */
     static const unsigned MMAP_API_MAJOR_VERSION = 1;
-    static const unsigned MMAP_API_MINOR_VERSION = 1;
+    static const unsigned MMAP_API_MINOR_VERSION = 3;
 
     /* get current mmap version as a string */
     const std::string& getMmapCurentVersion();
@@ -19,6 +20,12 @@ namespace hal {
      * a offset to it */
     static const size_t MMAP_NULL_OFFSET = 0;
 
+    /* Address space reserved when a file is opened for write access.  The
+     * file is grown within this range as it fills, so it never moves in
+     * memory and pointers into it remain valid.  This is the limit on the
+     * size of a file being written. */
+    static const size_t MMAP_MAX_FILE_SIZE = 16 * 1024 * GIGABYTE;
+
     /* header for the file */
     struct MMapHeader {
         char format[32];
@@ -76,6 +83,14 @@ namespace hal {
         };
         virtual ~MMapFile() {
         }
+        /* can release() free memory? */
+        virtual bool canRelease() const {
+            return false;
+        }
+        /* the bytes [offset, offset + size) won't be used soon, so the
+         * memory holding them may be released; no-op by default */
+        virtual void release(size_t offset, size_t size) const {
+        }
         /* round up to alignment size */
         static size_t alignRound(size_t size) {
             return ((size + (sizeof(size_t) - 1)) / sizeof(size_t)) * sizeof(size_t);
@@ -88,6 +103,9 @@ namespace hal {
         virtual void fetch(size_t offset, size_t accessSize) const {
             // no-op by default
         }
+        /* grow the file to at least size bytes, keeping it at the same
+         * address; error by default */
+        virtual void grow(size_t size);
 
         void setHeaderPtr();
         void createHeader();
@@ -109,7 +127,9 @@ namespace hal {
         void parseCheckVersion();
 
         static MMapFile *factory(const std::string &alignmentPath, unsigned mode = READ_ACCESS,
-                                 size_t fileSize = MMAP_DEFAULT_FILE_SIZE);
+                                 size_t fileSize = MMAP_DEFAULT_FILE_SIZE,
+                                 size_t cacheBytes = MMAP_DEFAULT_CACHE_BYTES,
+                                 const LocalBlockCacheConfig &blockCacheConfig = LocalBlockCacheConfig());
 
         std::string _version;
         unsigned _majorVersion;
@@ -149,8 +169,8 @@ const void *hal::MMapFile::toPtr(size_t offset, size_t accessSize) const {
  * is stored as the root used to find all object.  */
 size_t hal::MMapFile::allocMem(size_t size, bool isRoot) {
     validateWriteAccess();
-    if (_header->nextOffset + size > _fileSize) {
-        throw hal_exception("mmap file is full, specify file size larger than " + std::to_string(_fileSize));
+    if (_header->nextOffset + alignRound(size) > _fileSize) {
+        grow(_header->nextOffset + alignRound(size));
     }
     size_t offset = _header->nextOffset;
     _header->nextOffset += alignRound(size);
@@ -0,0 +1,279 @@
+#include "mmapFileBlocks.h"
+#include "halCommon.h"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace hal;
+using namespace std;
+
+/* fewest blocks the cache holds, so an access spanning blocks can't keep
+ * dropping the block it is waiting on */
+static const size_t MIN_CACHE_BLOCKS = 64;
+
+static size_t getPageSize() {
+    return sysconf(_SC_PAGESIZE);
+}
+
+static size_t pageRound(size_t size) {
+    size_t pageSize = getPageSize();
+    return ((size + pageSize - 1) / pageSize) * pageSize;
+}
+
+static void writeFully(int fd, const string &path, const void *buf, size_t length) {
+    const char *src = static_cast<const char *>(buf);
+    while (length > 0) {
+        ssize_t n = ::write(fd, src, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw hal_errno_exception(path, "write failed", errno);
+        }
+        src += n;
+        length -= n;
+    }
+}
+
+/* constructor, used only by derived classes */
+MMapFileBlocks::MMapFileBlocks(const string &alignmentPath, unsigned mode, size_t cacheBytes)
+    : MMapFile(alignmentPath, mode, false), _blockSize(0), _numBlocks(0), _mappedSize(0), _cacheBytes(cacheBytes),
+      _faultFd(-1), _residentBytes(0), _blockBuffer(NULL) {
+    _stopPipe[0] = _stopPipe[1] = -1;
+    if (_mode & WRITE_ACCESS) {
+        throw hal_exception(_alignmentPath + ": file can only be opened read-only");
+    }
+}
+
+/* close file */
+void MMapFileBlocks::close() {
+    if (_basePtr == NULL) {
+        throw hal_exception(_alignmentPath + ": MMapFile::close() called on closed file");
+    }
+    stopFaultHandler();
+    if (::munmap(_basePtr, _mappedSize) < 0) {
+        throw hal_errno_exception(_alignmentPath, "munmap failed", errno);
+    }
+    _basePtr = NULL;
+}
+
+MMapFileBlocks::~MMapFileBlocks() {
+    stopFaultHandler();
+    if (_basePtr != NULL) {
+        ::munmap(_basePtr, _mappedSize);
+    }
+}
+
+void MMapFileBlocks::loadBlocks(size_t fileSize, size_t blockSize) {
+    _fileSize = fileSize;
+    _blockSize = blockSize;
+    _numBlocks = (fileSize + blockSize - 1) / blockSize;
+    _mappedSize = pageRound(_fileSize);
+    if (_cacheBytes > 0) {
+        _cacheBytes = max(_cacheBytes, MIN_CACHE_BLOCKS * _blockSize);
+    }
+    if (not startFaultHandler()) {
+        loadAll();
+    }
+    loadHeader(false);
+}
+
+/* length of a block, only the last is short */
+size_t MMapFileBlocks::getBlockLength(size_t block) const {
+    return min(_blockSize, _fileSize - block * _blockSize);
+}
+
+/* read every block into anonymous memory */
+void MMapFileBlocks::loadAll() {
+    void *basePtr = mmap(NULL, _mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (basePtr == MAP_FAILED) {
+        throw hal_errno_exception(_alignmentPath, "mmap failed", errno);
+    }
+    _basePtr = basePtr;
+    for (size_t block = 0; block < _numBlocks; ++block) {
+        readBlock(block, static_cast<char *>(_basePtr) + block * _blockSize);
+    }
+}
+
+#if defined(__linux__) && defined(UFFDIO_COPY)
+/* report an error in the fault handler thread, where there is no caller to
+ * throw to, and the faulting thread can't continue */
+static void faultHandlerError(const string &msg) {
+    cerr << "error loading mmap HAL file: " << msg << endl;
+    abort();
+}
+
+/* Set up loading blocks on page faults, returning false if this isn't
+ * supported. */
+bool MMapFileBlocks::startFaultHandler() {
+    size_t pageSize = getPageSize();
+    if ((_blockSize % pageSize) != 0) {
+        return false;
+    }
+    _faultFd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+#ifdef UFFD_USER_MODE_ONLY
+    if ((_faultFd < 0) && (errno == EPERM)) {
+        // unprivileged processes may only handle faults from user space
+        _faultFd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    }
+#endif
+    if (_faultFd < 0) {
+        return false;
+    }
+    struct uffdio_api api;
+    memset(&api, 0, sizeof(api));
+    api.api = UFFD_API;
+    if (ioctl(_faultFd, UFFDIO_API, &api) < 0) {
+        ::close(_faultFd);
+        _faultFd = -1;
+        return false;
+    }
+    void *basePtr = mmap(NULL, _mappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (basePtr == MAP_FAILED) {
+        throw hal_errno_exception(_alignmentPath, "mmap failed", errno);
+    }
+    struct uffdio_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.range.start = reinterpret_cast<uintptr_t>(basePtr);
+    reg.range.len = _mappedSize;
+    reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+    if (ioctl(_faultFd, UFFDIO_REGISTER, &reg) < 0) {
+        ::munmap(basePtr, _mappedSize);
+        ::close(_faultFd);
+        _faultFd = -1;
+        return false;
+    }
+    void *blockBuffer = mmap(NULL, _blockSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((blockBuffer == MAP_FAILED) || (pipe(_stopPipe) < 0)) {
+        throw hal_errno_exception(_alignmentPath, "can't set up block loading", errno);
+    }
+    _basePtr = basePtr;
+    _blockBuffer = static_cast<char *>(blockBuffer);
+    _resident.assign(_numBlocks, false);
+    _faultThread = thread(&MMapFileBlocks::handleFaults, this);
+    return true;
+}
+
+void MMapFileBlocks::stopFaultHandler() {
+    if (_faultThread.joinable()) {
+        writeFully(_stopPipe[1], _alignmentPath, "x", 1);
+        _faultThread.join();
+    }
+    for (int &fd : {std::ref(_faultFd), std::ref(_stopPipe[0]), std::ref(_stopPipe[1])}) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (_blockBuffer != NULL) {
+        ::munmap(_blockBuffer, _blockSize);
+        _blockBuffer = NULL;
+    }
+}
+
+/* fault handler thread, runs until something is written to the stop pipe */
+void MMapFileBlocks::handleFaults() {
+    size_t pageSize = getPageSize();
+    struct pollfd fds[2] = {{_faultFd, POLLIN, 0}, {_stopPipe[0], POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            faultHandlerError(_alignmentPath + ": poll failed: " + strerror(errno));
+        }
+        if (fds[1].revents != 0) {
+            return;
+        }
+        struct uffd_msg msg;
+        if (::read(_faultFd, &msg, sizeof(msg)) != sizeof(msg)) {
+            if ((errno == EAGAIN) || (errno == EINTR)) {
+                continue;
+            }
+            faultHandlerError(_alignmentPath + ": reading page fault failed: " + strerror(errno));
+        }
+        if (msg.event != UFFD_EVENT_PAGEFAULT) {
+            continue;
+        }
+        size_t offset = msg.arg.pagefault.address - reinterpret_cast<uintptr_t>(_basePtr);
+        size_t block = offset / _blockSize;
+        if (_resident[block]) {
+            // loaded since this fault was queued, just wake the faulting thread
+            struct uffdio_range range;
+            range.start = reinterpret_cast<uintptr_t>(_basePtr) + (offset / pageSize) * pageSize;
+            range.len = pageSize;
+            ioctl(_faultFd, UFFDIO_WAKE, &range);
+        } else {
+            try {
+                loadBlockOnFault(block);
+            } catch (const exception &ex) {
+                faultHandlerError(ex.what());
+            }
+        }
+    }
+}
+
+/* load a block in the fault handler thread, dropping the least recently
+ * loaded blocks to stay within the cache size */
+void MMapFileBlocks::loadBlockOnFault(size_t block) {
+    size_t length = pageRound(getBlockLength(block));
+    while ((_cacheBytes > 0) && !_residentOrder.empty() && (_residentBytes + length > _cacheBytes)) {
+        size_t oldBlock = _residentOrder.front();
+        _residentOrder.pop_front();
+        size_t oldLength = pageRound(getBlockLength(oldBlock));
+        if (::madvise(static_cast<char *>(_basePtr) + oldBlock * _blockSize, oldLength, MADV_DONTNEED) < 0) {
+            throw hal_errno_exception(_alignmentPath, "dropping cached block failed", errno);
+        }
+        _resident[oldBlock] = false;
+        _residentBytes -= oldLength;
+    }
+
+    readBlock(block, _blockBuffer);
+    memset(_blockBuffer + getBlockLength(block), 0, length - getBlockLength(block));
+    struct uffdio_copy copy;
+    size_t done = 0;
+    while (done < length) {
+        copy.dst = reinterpret_cast<uintptr_t>(_basePtr) + block * _blockSize + done;
+        copy.src = reinterpret_cast<uintptr_t>(_blockBuffer) + done;
+        copy.len = length - done;
+        copy.mode = 0;
+        copy.copy = 0;
+        if (ioctl(_faultFd, UFFDIO_COPY, &copy) == 0) {
+            break;
+        } else if ((errno == EAGAIN) && (copy.copy > 0)) {
+            done += copy.copy;
+        } else if (errno != EAGAIN) {
+            throw hal_errno_exception(_alignmentPath, "loading block into memory failed", errno);
+        }
+    }
+    _resident[block] = true;
+    _residentOrder.push_back(block);
+    _residentBytes += length;
+}
+
+#else
+bool MMapFileBlocks::startFaultHandler() {
+    return false;
+}
+
+void MMapFileBlocks::stopFaultHandler() {
+}
+
+void MMapFileBlocks::handleFaults() {
+}
+
+void MMapFileBlocks::loadBlockOnFault(size_t block) {
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef _MMAPFILEBLOCKS_H
+#define _MMAPFILEBLOCKS_H
+#include "mmapFile.h"
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace hal {
+    /**
+     * Read-only access to a mmap HAL file whose contents are loaded into
+     * memory a block at a time by a derived class, rather than mapped from a
+     * local file.  Blocks are loaded into an address range the size of the
+     * file, so offsets resolve as they do for a mapped file.
+     *
+     * On Linux the blocks are loaded by a thread handling the page faults in
+     * that range (userfaultfd), so toPtr() costs no more than for a mapped
+     * file.  Once the loaded blocks exceed the cache size, the least recently
+     * loaded are dropped, to be loaded again if touched.  Elsewhere the whole
+     * file is loaded when opened.
+     */
+    class MMapFileBlocks : public MMapFile {
+      public:
+        virtual void close();
+        virtual ~MMapFileBlocks();
+
+      protected:
+        MMapFileBlocks(const std::string &alignmentPath, unsigned mode, size_t cacheBytes);
+
+        /* set up loading a file of fileSize bytes in blocks of blockSize,
+         * and load the header */
+        void loadBlocks(size_t fileSize, size_t blockSize);
+
+        /* stop loading blocks; must be called by the destructors of derived
+         * classes, before whatever readBlock() uses goes away */
+        void stopFaultHandler();
+
+        /* length of a block, only the last is short */
+        size_t getBlockLength(size_t block) const;
+
+        /* read a block into dest, which has room for getBlockLength(block)
+         * bytes */
+        virtual void readBlock(size_t block, char *dest) const = 0;
+
+        /* Load the whole file into memory, when blocks can't be loaded on
+         * demand.  Callers index arrays beyond the ranges passed to toPtr(),
+         * so blocks can't be loaded by fetch() either.  Sets _basePtr to a
+         * mapping of _mappedSize bytes. */
+        virtual void loadAll();
+
+        size_t _blockSize;
+        size_t _numBlocks;
+        size_t _mappedSize;
+        size_t _cacheBytes;
+
+      private:
+        bool startFaultHandler();
+        void handleFaults();
+        void loadBlockOnFault(size_t block);
+
+        // page fault loading; the state is only touched by the handler thread
+        int _faultFd;
+        int _stopPipe[2];
+        std::thread _faultThread;
+        std::vector<bool> _resident;
+        std::deque<size_t> _residentOrder;
+        size_t _residentBytes;
+        char *_blockBuffer;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
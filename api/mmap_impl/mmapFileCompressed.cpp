@@ -0,0 +1,274 @@
+#include "mmapFileCompressed.h"
+#include "halCommon.h"
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <exception>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+
+using namespace hal;
+using namespace std;
+
+/* constants for header; the name starts with the uncompressed format name
+ * so the file is recognized as mmap */
+static const string COMPRESSED_FORMAT_NAME = "HAL-MMAP-COMPRESSED";
+static const string COMPRESSED_VERSION = "1.0";
+
+/* read length bytes at offset, failing on a short read */
+static void preadFully(int fd, const string &path, void *buf, size_t length, size_t offset) {
+    char *dest = static_cast<char *>(buf);
+    while (length > 0) {
+        ssize_t n = ::pread(fd, dest, length, offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw hal_errno_exception(path, "read failed", errno);
+        } else if (n == 0) {
+            throw hal_exception(path + ": unexpected end of file");
+        }
+        dest += n;
+        length -= n;
+        offset += n;
+    }
+}
+
+static void writeFully(int fd, const string &path, const void *buf, size_t length) {
+    const char *src = static_cast<const char *>(buf);
+    while (length > 0) {
+        ssize_t n = ::write(fd, src, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw hal_errno_exception(path, "write failed", errno);
+        }
+        src += n;
+        length -= n;
+    }
+}
+
+/* Constructor. Open the specified file, through the block cache if
+ * enabled. */
+MMapFileCompressed::MMapFileCompressed(const string &alignmentPath, unsigned mode, size_t cacheBytes,
+                                       const LocalBlockCacheConfig &blockCacheConfig)
+    : MMapFileBlocks(alignmentPath, mode, cacheBytes), _fd(-1), _blockCache(NULL), _compressedSize(0) {
+    try {
+        openFile(blockCacheConfig);
+        readIndex();
+        loadBlocks(_compressedHeader.fileSize, _compressedHeader.blockSize);
+    } catch (...) {
+        stopFaultHandler();
+        closeFile();
+        throw;
+    }
+}
+
+/* close file */
+void MMapFileCompressed::close() {
+    MMapFileBlocks::close();
+    closeFile();
+}
+
+MMapFileCompressed::~MMapFileCompressed() {
+    stopFaultHandler();
+    closeFile();
+}
+
+void MMapFileCompressed::closeFile() {
+    delete _blockCache;
+    _blockCache = NULL;
+    if (_fd >= 0) {
+        if (::close(_fd) < 0) {
+            throw hal_errno_exception(_alignmentPath, "close failed", errno);
+        }
+        _fd = -1;
+    }
+}
+
+/* read length bytes at offset of the compressed file */
+void MMapFileCompressed::readFile(void *buf, size_t length, size_t offset) const {
+    if (_blockCache != NULL) {
+        _blockCache->read(buf, length, offset);
+    } else {
+        preadFully(_fd, _alignmentPath, buf, length, offset);
+    }
+}
+
+/* check the first bytes of a local file */
+bool MMapFileCompressed::isCompressedFile(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char format[sizeof(MMapCompressedHeader::format)];
+    ssize_t n = ::pread(fd, format, sizeof(format), 0);
+    ::close(fd);
+    return (n == sizeof(format)) && (strncmp(format, COMPRESSED_FORMAT_NAME.c_str(), sizeof(format)) == 0);
+}
+
+/* open the file and validate the header */
+void MMapFileCompressed::openFile(const LocalBlockCacheConfig &blockCacheConfig) {
+    if (blockCacheConfig.isEnabled()) {
+        _blockCache = new LocalBlockCache(_alignmentPath, blockCacheConfig);
+        _compressedSize = _blockCache->getFileSize();
+    } else {
+        _fd = ::open(_alignmentPath.c_str(), O_RDONLY);
+        if (_fd < 0) {
+            throw hal_errno_exception(_alignmentPath, "open failed", errno);
+        }
+        _compressedSize = getFileStatSize(_fd);
+    }
+    if (_compressedSize < sizeof(MMapCompressedHeader)) {
+        throw hal_exception(_alignmentPath + ": file is smaller than the compressed mmap header");
+    }
+    readFile(&_compressedHeader, sizeof(MMapCompressedHeader), 0);
+    string format(_compressedHeader.format, strnlen(_compressedHeader.format, sizeof(_compressedHeader.format)));
+    if (format != COMPRESSED_FORMAT_NAME) {
+        throw hal_exception(_alignmentPath + ": invalid file header, expected format name of '" + COMPRESSED_FORMAT_NAME +
+                            "', got '" + format.substr(0, 20) + "'");
+    }
+    string version(_compressedHeader.version, strnlen(_compressedHeader.version, sizeof(_compressedHeader.version)));
+    if (version.substr(0, version.find('.')) != COMPRESSED_VERSION.substr(0, COMPRESSED_VERSION.find('.'))) {
+        throw hal_exception(_alignmentPath + ": incompatible compressed mmap versions: file version " + version.substr(0, 20) +
+                            ", API version " + COMPRESSED_VERSION);
+    }
+}
+
+/* read and check the block index */
+void MMapFileCompressed::readIndex() {
+    const MMapCompressedHeader &header = _compressedHeader;
+    if ((header.blockSize == 0) || (header.numBlocks != (header.fileSize + header.blockSize - 1) / header.blockSize) ||
+        (header.indexOffset + (header.numBlocks + 1) * sizeof(uint64_t) > _compressedSize)) {
+        throw hal_exception(_alignmentPath + ": invalid compressed mmap header, probably file corruption");
+    }
+    _blockOffsets.resize(header.numBlocks + 1);
+    readFile(_blockOffsets.data(), _blockOffsets.size() * sizeof(uint64_t), header.indexOffset);
+    for (size_t block = 0; block < header.numBlocks; ++block) {
+        if ((_blockOffsets[block] < sizeof(MMapCompressedHeader)) || (_blockOffsets[block] > _blockOffsets[block + 1])) {
+            throw hal_exception(_alignmentPath + ": invalid compressed mmap block index, probably file corruption");
+        }
+    }
+    if (_blockOffsets.back() != header.indexOffset) {
+        throw hal_exception(_alignmentPath + ": invalid compressed mmap block index, probably file corruption");
+    }
+}
+
+/* decompress a block into dest, which has room for getBlockLength(block)
+ * bytes */
+void MMapFileCompressed::readBlock(size_t block, char *dest) const {
+    size_t length = getBlockLength(block);
+    size_t frameLength = _blockOffsets[block + 1] - _blockOffsets[block];
+    if (frameLength == length) {
+        // stored as-is, didn't compress
+        readFile(dest, length, _blockOffsets[block]);
+        return;
+    }
+    vector<char> frame(frameLength);
+    readFile(frame.data(), frameLength, _blockOffsets[block]);
+    uLongf destLength = length;
+    if ((uncompress(reinterpret_cast<Bytef *>(dest), &destLength, reinterpret_cast<const Bytef *>(frame.data()),
+                    frameLength) != Z_OK) ||
+        (destLength != length)) {
+        throw hal_exception(_alignmentPath + ": can't decompress block " + to_string(block) + ", probably file corruption");
+    }
+}
+
+/* compress blocks [firstBlock, firstBlock + frames.size()) of the input,
+ * frames[i] is left empty if the block doesn't compress */
+static void compressBlocks(int inFd, const string &inPath, size_t fileSize, size_t blockSize, size_t firstBlock,
+                           vector<string> &frames, size_t numThreads) {
+    vector<exception_ptr> errors(numThreads);
+    vector<thread> threads;
+    for (size_t t = 0; t < numThreads; ++t) {
+        threads.push_back(thread([&, t]() {
+            try {
+                vector<char> block(blockSize);
+                for (size_t i = t; i < frames.size(); i += numThreads) {
+                    size_t offset = (firstBlock + i) * blockSize;
+                    size_t length = min(blockSize, fileSize - offset);
+                    preadFully(inFd, inPath, block.data(), length, offset);
+                    uLongf frameLength = compressBound(length);
+                    frames[i].resize(frameLength);
+                    if (compress2(reinterpret_cast<Bytef *>(&frames[i][0]), &frameLength,
+                                  reinterpret_cast<const Bytef *>(block.data()), length, Z_DEFAULT_COMPRESSION) != Z_OK) {
+                        throw hal_exception(inPath + ": compression failed");
+                    }
+                    if (frameLength < length) {
+                        frames[i].resize(frameLength);
+                    } else {
+                        frames[i].assign(block.data(), length);
+                    }
+                }
+            } catch (...) {
+                errors[t] = current_exception();
+            }
+        }));
+    }
+    for (thread &t : threads) {
+        t.join();
+    }
+    for (exception_ptr &error : errors) {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+/* compress an uncompressed file */
+void MMapFileCompressed::compress(const string &inPath, const string &outPath, size_t blockSize) {
+    if (isCompressedFile(inPath)) {
+        throw hal_exception(inPath + ": already compressed");
+    }
+    int inFd = ::open(inPath.c_str(), O_RDONLY);
+    if (inFd < 0) {
+        throw hal_errno_exception(inPath, "open failed", errno);
+    }
+    int outFd = ::open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (outFd < 0) {
+        ::close(inFd);
+        throw hal_errno_exception(outPath, "open failed", errno);
+    }
+    try {
+        MMapCompressedHeader header;
+        memset(&header, 0, sizeof(header));
+        strncpy(header.format, COMPRESSED_FORMAT_NAME.c_str(), sizeof(header.format) - 1);
+        strncpy(header.version, COMPRESSED_VERSION.c_str(), sizeof(header.version) - 1);
+        header.fileSize = getFileStatSize(inFd);
+        header.blockSize = blockSize;
+        header.numBlocks = (header.fileSize + blockSize - 1) / blockSize;
+        writeFully(outFd, outPath, &header, sizeof(header)); // rewritten when complete
+
+        // compressed in batches of a few blocks per thread, written in order
+        size_t numThreads = max(thread::hardware_concurrency(), 1u);
+        vector<uint64_t> blockOffsets(1, sizeof(header));
+        for (size_t block = 0; block < header.numBlocks;) {
+            vector<string> frames(min((size_t)header.numBlocks - block, 16 * numThreads));
+            compressBlocks(inFd, inPath, header.fileSize, blockSize, block, frames, numThreads);
+            for (const string &frame : frames) {
+                writeFully(outFd, outPath, frame.data(), frame.size());
+                blockOffsets.push_back(blockOffsets.back() + frame.size());
+            }
+            block += frames.size();
+        }
+        header.indexOffset = blockOffsets.back();
+        writeFully(outFd, outPath, blockOffsets.data(), blockOffsets.size() * sizeof(uint64_t));
+        if (::pwrite(outFd, &header, sizeof(header), 0) != sizeof(header)) {
+            throw hal_errno_exception(outPath, "write failed", errno);
+        }
+    } catch (...) {
+        ::close(inFd);
+        ::close(outFd);
+        throw;
+    }
+    ::close(inFd);
+    if (::close(outFd) < 0) {
+        throw hal_errno_exception(outPath, "close failed", errno);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef _MMAPFILECOMPRESSED_H
+#define _MMAPFILECOMPRESSED_H
+#include "halLocalBlockCache.h"
+#include "mmapFileBlocks.h"
+#include <cstdint>
+#include <vector>
+
+namespace hal {
+    /* size of the independently compressed blocks of new files */
+    static const size_t MMAP_COMPRESSED_BLOCK_SIZE = 64 * 1024;
+
+    /* header of a compressed mmap file, followed by the compressed blocks
+     * and their index */
+    struct MMapCompressedHeader {
+        char format[32];
+        char version[32];
+        uint64_t fileSize;    // size of the uncompressed file
+        uint64_t blockSize;   // uncompressed size of all but the last block
+        uint64_t numBlocks;
+        uint64_t indexOffset; // numBlocks + 1 file offsets of the blocks
+        char _reserved[256];
+    };
+
+    /**
+     * Read-only access to an mmap HAL file stored as blocks compressed
+     * independently with zlib, for files that are shipped around or stored
+     * for a long time.  Blocks are decompressed on demand, see
+     * MMapFileBlocks.  The compressed file may be read through a local block
+     * cache.
+     */
+    class MMapFileCompressed : public MMapFileBlocks {
+      public:
+        MMapFileCompressed(const std::string &alignmentPath, unsigned mode, size_t cacheBytes,
+                           const LocalBlockCacheConfig &blockCacheConfig = LocalBlockCacheConfig());
+        virtual void close();
+        virtual ~MMapFileCompressed();
+        virtual bool isUdcProtocol() const {
+            return false;
+        }
+
+        /* is the local file a compressed mmap file? */
+        static bool isCompressedFile(const std::string &path);
+
+        /* compress an uncompressed mmap file */
+        static void compress(const std::string &inPath, const std::string &outPath,
+                             size_t blockSize = MMAP_COMPRESSED_BLOCK_SIZE);
+
+      protected:
+        virtual void readBlock(size_t block, char *dest) const;
+
+      private:
+        void openFile(const LocalBlockCacheConfig &blockCacheConfig);
+        void closeFile();
+        void readFile(void *buf, size_t length, size_t offset) const;
+        void readIndex();
+
+        int _fd;
+        LocalBlockCache *_blockCache; // reads go through it if not NULL
+        size_t _compressedSize;
+        MMapCompressedHeader _compressedHeader;
+        std::vector<uint64_t> _blockOffsets;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -15,11 +15,12 @@ using namespace hal;
 using namespace std;
 
 MMapGenome::~MMapGenome() {
+    _alignment->getMemoryBudget().remove(this);
     deleteSequenceCache();
 }
 
 void MMapGenome::setDimensions(const vector<Sequence::Info> &sequenceDimensions, bool storeDNAArrays) {
-    _sequenceObjCache.resize(sequenceDimensions.size());
+    resetSequenceCache(sequenceDimensions.size());
 
     // FIXME: should we check storeDNAArrays??
     hal_size_t totalSequenceLength = 0;
@@ -40,7 +41,16 @@ void MMapGenome::setDimensions(const vector<Sequence::Info> &sequenceDimensions,
     // Write the new DNA/sequence information, allocating one base per nibble
     hal_size_t dnaLength = (totalSequenceLength + 1) / 2;
     _data->_totalSequenceLength = totalSequenceLength;
-    _data->_dnaOffset = _alignment->allocateNewArray(dnaLength);
+    if (_alignment->getPackDna()) {
+        // packed when the genome is closed
+        _dnaPending = true;
+        _pendingDna.assign(dnaLength, 0);
+        _data->_dnaOffset = MMAP_NULL_OFFSET;
+    } else {
+        _dnaPending = false;
+        _pendingDna.clear();
+        _data->_dnaOffset = _alignment->allocateNewArray(dnaLength);
+    }
     // Reverse space for the sequence data (plus an extra at the end
     // to indicate the end position of the sequence iterator).  FIXME: extra no longer needed
     _data->_sequencesOffset = _alignment->allocateNewArray(sizeof(MMapSequenceData) * sequenceDimensions.size() + 1);
@@ -63,7 +73,57 @@ void MMapGenome::setDimensions(const vector<Sequence::Info> &sequenceDimensions,
     createGenomeSiteMap(sequenceDimensions.size());
 }
 
+void MMapGenome::packDna() {
+    if (_dnaPending) {
+        _data->_dnaOffset =
+            MMapPackedDnaData::pack(_alignment, _pendingDna.data(), _data->_totalSequenceLength) | MMAP_PACKED_DNA_FLAG;
+        _dnaPending = false;
+        vector<char>().swap(_pendingDna);
+    }
+}
+
 /* must be called after sequences are created */
+void MMapGenome::compactSegments() {
+    if (!_pendingTopSegments.empty()) {
+        const MMapTopSegmentData *segments = reinterpret_cast<const MMapTopSegmentData *>(_pendingTopSegments.data());
+        _data->_topSegmentsOffset =
+            MMapSegmentTable::write(_alignment, _data->_numTopSegments, MMapSegmentTable::NUM_TOP_INDEXES, 1,
+                                    [&](hal_size_t i) { return segments[i].getStartPosition(); },
+                                    [&](hal_size_t field, hal_size_t i) {
+                                        switch (field) {
+                                        case MMapSegmentTable::TOP_PARSE_INDEX:
+                                            return segments[i].getBottomParseIndex();
+                                        case MMapSegmentTable::TOP_PARALOGY_INDEX:
+                                            return segments[i].getNextParalogyIndex();
+                                        default:
+                                            return segments[i].getParentIndex();
+                                        }
+                                    },
+                                    [&](hal_size_t, hal_size_t i) { return segments[i].getReversed() != 0; }) |
+            MMAP_SEGMENT_TABLE_FLAG;
+        vector<char>().swap(_pendingTopSegments);
+    }
+    if (!_pendingBottomSegments.empty()) {
+        const char *segments = _pendingBottomSegments.data();
+        size_t segmentSize = MMapBottomSegmentData::getSize(this);
+        hal_size_t numChildren = getNumChildren();
+        auto segment = [&](hal_size_t i) { return reinterpret_cast<const MMapBottomSegmentData *>(segments + i * segmentSize); };
+        _data->_bottomSegmentsOffset =
+            MMapSegmentTable::write(_alignment, _data->_numBottomSegments, MMapSegmentTable::BOTTOM_CHILD_INDEX + numChildren,
+                                    numChildren, [&](hal_size_t i) { return segment(i)->getStartPosition(); },
+                                    [&](hal_size_t field, hal_size_t i) {
+                                        return field == MMapSegmentTable::BOTTOM_PARSE_INDEX
+                                                   ? segment(i)->getTopParseIndex()
+                                                   : segment(i)->getChildIndex(field - MMapSegmentTable::BOTTOM_CHILD_INDEX);
+                                    },
+                                    [&](hal_size_t child, hal_size_t i) {
+                                        return segment(i)->getChildReversed(numChildren, child) != 0;
+                                    }) |
+            MMAP_SEGMENT_TABLE_FLAG;
+        vector<char>().swap(_pendingBottomSegments);
+    }
+}
+
 void MMapGenome::createSequenceNameHash(size_t numSequences) {
     // build perfect hash
     vector<string> sequenceNames;
@@ -81,7 +141,8 @@ void MMapGenome::createSequenceNameHash(size_t numSequences) {
 /* must be called after sequences are created */
 void MMapGenome::createGenomeSiteMap(size_t numSequences) {
     assert(_sequenceObjCache.size() == numSequences);
-    _data->_genomeSiteMapOffset = _genomeSiteMap.build(_sequenceObjCache);
+    vector<MMapSequence *> sequences(_sequenceObjCache.begin(), _sequenceObjCache.end());
+    _data->_genomeSiteMapOffset = _genomeSiteMap.build(sequences);
 }
 
 void MMapGenome::setSequenceData(size_t i, hal_index_t startPos, hal_index_t topSegmentStartIndex,
@@ -138,7 +199,15 @@ void MMapGenome::updateTopDimensions(const vector<Sequence::UpdateInfo> &updated
     }
     _data->_numTopSegments = numTopSegments;
 
-    _data->_topSegmentsOffset = _alignment->allocateNewArray((_data->_numTopSegments + 1) * sizeof(MMapTopSegmentData));
+    size_t topSegmentsSize = (_data->_numTopSegments + 1) * sizeof(MMapTopSegmentData);
+    if (_alignment->getCompactSegments()) {
+        // compacted when the genome is closed
+        _pendingTopSegments.assign(topSegmentsSize, 0);
+        _data->_topSegmentsOffset = MMAP_NULL_OFFSET;
+    } else {
+        _pendingTopSegments.clear();
+        _data->_topSegmentsOffset = _alignment->allocateNewArray(topSegmentsSize);
+    }
     hal_index_t topSegmentStartIndex = 0;
     for (size_t i = 0; i < topDimensions.size(); i++) {
         MMapSequence seq(this, getSequenceData(i));
@@ -156,8 +225,14 @@ void MMapGenome::updateBottomDimensions(const vector<Sequence::UpdateInfo> &upda
         numBottomSegments += i._numSegments;
     }
     _data->_numBottomSegments = numBottomSegments;
-    _data->_bottomSegmentsOffset =
-        _alignment->allocateNewArray((_data->_numBottomSegments + 1) * MMapBottomSegmentData::getSize(this));
+    size_t bottomSegmentsSize = (_data->_numBottomSegments + 1) * MMapBottomSegmentData::getSize(this);
+    if (_alignment->getCompactSegments()) {
+        _pendingBottomSegments.assign(bottomSegmentsSize, 0);
+        _data->_bottomSegmentsOffset = MMAP_NULL_OFFSET;
+    } else {
+        _pendingBottomSegments.clear();
+        _data->_bottomSegmentsOffset = _alignment->allocateNewArray(bottomSegmentsSize);
+    }
     hal_index_t bottomSegmentStartIndex = 0;
     for (size_t i = 0; i < bottomDimensions.size(); i++) {
         MMapSequence seq(this, getSequenceData(i));
@@ -173,10 +248,17 @@ hal_size_t MMapGenome::getNumSequences() const {
 }
 
 Sequence *MMapGenome::getSequenceByIndex(hal_index_t index) {
-    if (_sequenceObjCache[index] == NULL) {
-        _sequenceObjCache[index] = new MMapSequence(this, getSequenceData(index));
+    MMapSequence *sequence = _sequenceObjCache[index];
+    if (sequence == NULL) {
+        // another thread may have got here first, in which case use its object
+        MMapSequence *newSequence = new MMapSequence(this, getSequenceData(index));
+        if (_sequenceObjCache[index].compare_exchange_strong(sequence, newSequence)) {
+            sequence = newSequence;
+        } else {
+            delete newSequence;
+        }
     }
-    return _sequenceObjCache[index];
+    return sequence;
 }
 
 const Sequence *MMapGenome::getSequenceByIndex(hal_index_t index) const {
@@ -258,40 +340,45 @@ hal_size_t MMapGenome::getNumBottomSegments() const {
 }
 
 TopSegmentIteratorPtr MMapGenome::getTopSegmentIterator(hal_index_t segmentIndex) {
+    touch();
     MMapTopSegment *topSeg = new MMapTopSegment(this, segmentIndex);
     // ownership of topSeg is passed into topSegIt, whose lifespan is
     // governed by the returned smart pointer
     TopSegmentIterator *topSegIt = new TopSegmentIterator(topSeg);
-    return TopSegmentIteratorPtr(topSegIt);
+    return makeFreeListPtr(topSegIt);
 }
 
 TopSegmentIteratorPtr MMapGenome::getTopSegmentIterator(hal_index_t segmentIndex) const {
+    touch();
     MMapGenome *genome = const_cast<MMapGenome *>(this);
     MMapTopSegment *topSeg = new MMapTopSegment(genome, segmentIndex);
     // ownership of topSeg is passed into topSegIt, whose lifespan is
     // governed by the returned smart pointer
     TopSegmentIterator *topSegIt = new TopSegmentIterator(topSeg);
-    return TopSegmentIteratorPtr(topSegIt);
+    return makeFreeListPtr(topSegIt);
 }
 
 BottomSegmentIteratorPtr MMapGenome::getBottomSegmentIterator(hal_index_t segmentIndex) {
+    touch();
     MMapBottomSegment *botSeg = new MMapBottomSegment(this, segmentIndex);
     // ownership of botSeg is passed into botSegIt, whose lifespan is
     // governed by the returned smart pointer
     BottomSegmentIterator *botSegIt = new BottomSegmentIterator(botSeg);
-    return BottomSegmentIteratorPtr(botSegIt);
+    return makeFreeListPtr(botSegIt);
 }
 
 BottomSegmentIteratorPtr MMapGenome::getBottomSegmentIterator(hal_index_t segmentIndex) const {
+    touch();
     MMapGenome *genome = const_cast<MMapGenome *>(this);
     MMapBottomSegment *botSeg = new MMapBottomSegment(genome, segmentIndex);
     // ownership of botSeg is passed into botSegIt, whose lifespan is
     // governed by the returned smart pointer
     BottomSegmentIterator *botSegIt = new BottomSegmentIterator(botSeg);
-    return BottomSegmentIteratorPtr(botSegIt);
+    return makeFreeListPtr(botSegIt);
 }
 
 DnaIteratorPtr MMapGenome::getDnaIterator(hal_index_t position) {
+    touch();
     DnaAccess *dnaAcc = new MMapDnaAccess(this, position);
     DnaIterator *dnaIt = new DnaIterator(this, DnaAccessPtr(dnaAcc), position);
     return DnaIteratorPtr(dnaIt);
@@ -366,8 +453,71 @@ void MMapGenome::rename(const std::string &name) {
 }
 
 void MMapGenome::deleteSequenceCache() {
-    for (auto seq : _sequenceObjCache) {
-        delete seq;
+    for (auto &seq : _sequenceObjCache) {
+        delete seq.load();
     }
     _sequenceObjCache.clear();
 }
+
+void MMapGenome::resetSequenceCache(size_t numSequences) {
+    deleteSequenceCache();
+    _sequenceObjCache = vector<atomic<MMapSequence *>>(numSequences);
+}
+
+// MEMORY BUDGET CLIENT INTERFACE
+
+/* call f(offset, size) for each range of the file holding the DNA and
+ * segments, which are the bulk of a genome.  Data still held in memory for
+ * packing or compaction is left out, as it can't be released. */
+template <typename F> void MMapGenome::forEachDataRange(F f) const {
+    if (!_dnaPending && (_data->_dnaOffset != MMAP_NULL_OFFSET)) {
+        if (_data->isDnaPacked()) {
+            getPackedDna()->forEachRange(f);
+        } else {
+            f(_data->_dnaOffset, (_data->_totalSequenceLength + 1) / 2);
+        }
+    }
+    if (_pendingTopSegments.empty() && (_data->_topSegmentsOffset != MMAP_NULL_OFFSET)) {
+        if (_data->isTopSegmentTable()) {
+            getTopSegmentTable()->forEachRange(f);
+        } else {
+            f(_data->_topSegmentsOffset, (_data->_numTopSegments + 1) * sizeof(MMapTopSegmentData));
+        }
+    }
+    if (_pendingBottomSegments.empty() && (_data->_bottomSegmentsOffset != MMAP_NULL_OFFSET)) {
+        if (_data->isBottomSegmentTable()) {
+            getBottomSegmentTable()->forEachRange(f);
+        } else {
+            f(_data->_bottomSegmentsOffset, (_data->_numBottomSegments + 1) * MMapBottomSegmentData::getSize(this));
+        }
+    }
+}
+
+/* count the genome as used.  Only files whose pages can be released are
+ * tracked: the blocks of a compressed file are held by its own cache. */
+void MMapGenome::touch() const {
+    GenomeMemoryBudget &budget = _alignment->getMemoryBudget();
+    if (budget.isTracking() && _alignment->getMMapFile()->canRelease()) {
+        _inUse = true;
+        budget.touch(const_cast<MMapGenome *>(this));
+    }
+}
+
+hal_size_t MMapGenome::getResidentBytes() const {
+    hal_size_t bytes = 0;
+    if (_inUse) {
+        forEachDataRange([&bytes](size_t offset, size_t size) { bytes += size; });
+    }
+    return bytes;
+}
+
+void MMapGenome::releaseMemory() {
+    if (_inUse.exchange(false)) {
+        MMapFile *file = _alignment->getMMapFile();
+        forEachDataRange([file](size_t offset, size_t size) {
+            if (size > 0) {
+                file->release(offset, size);
+            }
+        });
+    }
+}
@@ -5,10 +5,14 @@
 #include "mmapBottomSegmentData.h"
 #include "mmapGenomeSiteMap.h"
 #include "mmapMetaData.h"
+#include "mmapPackedDna.h"
 #include "mmapPerfectHashTable.h"
+#include "mmapSegmentTable.h"
 #include "mmapString.h"
 #include "mmapTopSegmentData.h"
+#include <atomic>
 #include <map>
+#include <vector>
 
 namespace hal {
     class MMapBottomSegmentData;
@@ -21,6 +25,17 @@ namespace hal {
 
       public:
         char *getDNA(MMapAlignment *alignment, size_t start, size_t length) const;
+        bool isDnaPacked() const {
+            return (_dnaOffset & MMAP_PACKED_DNA_FLAG) != 0;
+        }
+        const MMapPackedDnaData *getPackedDna(MMapAlignment *alignment) const;
+        bool isTopSegmentTable() const {
+            return (_topSegmentsOffset & MMAP_SEGMENT_TABLE_FLAG) != 0;
+        }
+        bool isBottomSegmentTable() const {
+            return (_bottomSegmentsOffset & MMAP_SEGMENT_TABLE_FLAG) != 0;
+        }
+        const MMapSegmentTable *getSegmentTable(MMapAlignment *alignment, size_t segmentsOffset) const;
         std::string getName(MMapAlignment *alignment) const;
         void setName(MMapAlignment *alignment, const std::string &name);
         void initializeName(MMapAlignment *alignment, const std::string &name);
@@ -45,33 +60,50 @@ namespace hal {
         // of structs.
     };
 
-    class MMapGenome : public Genome {
+    class MMapGenome : public Genome, public GenomeMemoryBudget::Client {
       public:
         MMapGenome(MMapAlignment *alignment, MMapGenomeData *data, size_t arrayIndex)
             : Genome(alignment, data->getName(alignment)), _alignment(alignment), _data(data), _arrayIndex(arrayIndex),
               _name(data->getName(_alignment)), _metaData(_alignment, _data->_metadataOffset),
               _sequenceNameHash(alignment->getMMapFile(), data->_sequenceHashOffset),
-              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset) {
-            _sequenceObjCache.resize(data->_numSequences);
+              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset), _dnaPending(false),
+              _inUse(false), _sequenceObjCache(data->_numSequences) {
         };
         MMapGenome(MMapAlignment *alignment, MMapGenomeData *data, size_t arrayIndex, const std::string &name)
             : Genome(alignment, name), _alignment(alignment), _data(data), _arrayIndex(arrayIndex), _name(name),
               _metaData(_alignment), _sequenceNameHash(alignment->getMMapFile(), data->_sequenceHashOffset),
-              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset) {
+              _genomeSiteMap(alignment->getMMapFile(), data->_genomeSiteMapOffset), _dnaPending(false),
+              _inUse(false) {
             _data->initializeName(_alignment, _name);
             _data->_metadataOffset = _metaData.getOffset();
-            _sequenceObjCache.resize(data->_numSequences);
+            resetSequenceCache(data->_numSequences);
         };
 
         virtual ~MMapGenome();
 
         MMapTopSegmentData *getTopSegmentPointer(hal_index_t index) {
+            if (!_pendingTopSegments.empty()) {
+                return reinterpret_cast<MMapTopSegmentData *>(_pendingTopSegments.data()) + index;
+            }
             return _data->getTopSegmentData(_alignment, index);
         };
         MMapBottomSegmentData *getBottomSegmentPointer(hal_index_t index) {
+            if (!_pendingBottomSegments.empty()) {
+                return reinterpret_cast<MMapBottomSegmentData *>(_pendingBottomSegments.data() +
+                                                                 index * MMapBottomSegmentData::getSize(this));
+            }
             return _data->getBottomSegmentData(_alignment, this, index);
         };
 
+        /* the genome's segments if they are stored as compact tables,
+         * otherwise NULL */
+        const MMapSegmentTable *getTopSegmentTable() const {
+            return _data->isTopSegmentTable() ? _data->getSegmentTable(_alignment, _data->_topSegmentsOffset) : NULL;
+        }
+        const MMapSegmentTable *getBottomSegmentTable() const {
+            return _data->isBottomSegmentTable() ? _data->getSegmentTable(_alignment, _data->_bottomSegmentsOffset) : NULL;
+        }
+
         void updateGenomeArrayBasePtr(MMapGenomeData *base) {
             _data = base + _arrayIndex;
         }
@@ -162,17 +194,42 @@ namespace hal {
         MMapSequenceData *getSequenceData(size_t i) const;
 
         char *getDNA(size_t start, size_t length) {
-            return _data->getDNA(_alignment, start, length);
+            return _dnaPending ? _pendingDna.data() + start : _data->getDNA(_alignment, start, length);
+        }
+
+        /* the genome's DNA if it is stored packed, otherwise NULL */
+        const MMapPackedDnaData *getPackedDna() const {
+            return _data->isDnaPacked() ? _data->getPackedDna(_alignment) : NULL;
         }
+
+        /* when the alignment packs DNA, the DNA of a new genome is kept in
+         * memory until it is closed, then packed into the file by this */
+        void packDna();
+
+        /* likewise, when the alignment compacts segments the segments of a
+         * new genome are kept in memory until it is closed, then written as
+         * MMapSegmentTables by this */
+        void compactSegments();
         void createSequenceNameHash(size_t numSequences);
 
+        // MEMORY BUDGET CLIENT INTERFACE
+
+        /* the pages of the DNA and segments, if used since last released */
+        hal_size_t getResidentBytes() const;
+
+        void releaseMemory();
+
       private:
+        template <typename F> void forEachDataRange(F f) const;
+        void touch() const;
+
         void createGenomeSiteMap(size_t numSequences);
         void setSequenceData(size_t i, hal_index_t startPos, hal_index_t topSegmentStartIndex,
                              hal_index_t bottomSegmentStartIndex, const Sequence::Info &sequenceInfo);
         std::vector<Sequence::UpdateInfo> getCompleteInputDimensions(const std::vector<Sequence::UpdateInfo> &inputDimensions,
                                                                      bool isTop);
         void deleteSequenceCache();
+        void resetSequenceCache(size_t numSequences);
 
         MMapGenomeData *_data;
         size_t _arrayIndex; // Index within the alignment's genome array.
@@ -180,8 +237,15 @@ namespace hal {
         MMapMetaData _metaData;
         MMapPerfectHashTable _sequenceNameHash;
         MMapGenomeSiteMap _genomeSiteMap;
-
-        mutable std::vector<MMapSequence *> _sequenceObjCache;
+        bool _dnaPending;
+        std::vector<char> _pendingDna;
+        std::vector<char> _pendingTopSegments;
+        std::vector<char> _pendingBottomSegments;
+        mutable std::atomic<bool> _inUse; // pages may be resident
+
+        // Sequence objects are created on first access.  Entries are atomic so
+        // concurrent readers agree on a single object per sequence.
+        mutable std::vector<std::atomic<MMapSequence *>> _sequenceObjCache;
     };
 
     inline std::string MMapGenomeData::getName(MMapAlignment *alignment) const {
@@ -216,9 +280,19 @@ namespace hal {
             alignment->resolveOffset(_bottomSegmentsOffset + index * segmentSize, 2 * segmentSize));
     }
 
+    inline const MMapSegmentTable *MMapGenomeData::getSegmentTable(MMapAlignment *alignment, size_t segmentsOffset) const {
+        return static_cast<const MMapSegmentTable *>(
+            alignment->resolveOffset(segmentsOffset & ~MMAP_SEGMENT_TABLE_FLAG, sizeof(MMapSegmentTable)));
+    }
+
     inline char *MMapGenomeData::getDNA(MMapAlignment *alignment, size_t start, size_t length) const {
         return static_cast<char *>(alignment->resolveOffset(_dnaOffset + start, length));
     }
+
+    inline const MMapPackedDnaData *MMapGenomeData::getPackedDna(MMapAlignment *alignment) const {
+        return static_cast<const MMapPackedDnaData *>(
+            alignment->resolveOffset(_dnaOffset & ~MMAP_PACKED_DNA_FLAG, sizeof(MMapPackedDnaData)));
+    }
 }
 #endif
 // Local Variables:
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "mmapPackedDna.h"
+#include "mmapAlignment.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace hal;
+using namespace std;
+
+// the two bit codes are the low bits of the nibble encoding (a, c, g, t), see
+// dnaPackMap.  in the nibble encoding bit 2 is set for n and bit 3 for
+// uppercase.  bases are packed four to a byte, the first in the low bits.
+static const uint8_t NIBBLE_N = 4;
+static const uint8_t NIBBLE_UPPER = 8;
+
+namespace {
+    /* the four uppercase nibble-encoded bases of each packed byte, as two
+     * bytes of nibble DNA */
+    struct UnpackTable {
+        UnpackTable() {
+            for (size_t byte = 0; byte < 256; ++byte) {
+                uint8_t codes[4];
+                for (size_t j = 0; j < 4; ++j) {
+                    codes[j] = ((byte >> (2 * j)) & 3) | NIBBLE_UPPER;
+                }
+                _nibbles[byte][0] = (codes[0] << 4) | codes[1];
+                _nibbles[byte][1] = (codes[2] << 4) | codes[3];
+            }
+        }
+        char _nibbles[256][2];
+    };
+    const UnpackTable unpackTable;
+}
+
+static inline uint8_t getNibble(const char *nibbleDna, hal_index_t i) {
+    uint8_t byte = nibbleDna[i / 2];
+    return (i & 1) ? (byte & 0x0F) : (byte >> 4);
+}
+
+static inline void setNibble(char *nibbleDna, hal_index_t i, uint8_t code) {
+    uint8_t byte = nibbleDna[i / 2];
+    nibbleDna[i / 2] = (i & 1) ? ((byte & 0xF0) | code) : ((byte & 0x0F) | (code << 4));
+}
+
+/* add base i to the end of a list of runs */
+static inline void addToRuns(vector<MMapDnaRun> &runs, hal_index_t i) {
+    if (!runs.empty() && runs.back()._end == i) {
+        ++runs.back()._end;
+    } else {
+        runs.push_back({i, i + 1});
+    }
+}
+
+static size_t writeRuns(MMapAlignment *alignment, const vector<MMapDnaRun> &runs) {
+    if (runs.empty()) {
+        return MMAP_NULL_OFFSET;
+    }
+    size_t size = runs.size() * sizeof(MMapDnaRun);
+    size_t offset = alignment->allocateNewArray(size);
+    memcpy(alignment->resolveOffset(offset, size), runs.data(), size);
+    return offset;
+}
+
+size_t MMapPackedDnaData::pack(MMapAlignment *alignment, const char *nibbleDna, hal_size_t length) {
+    size_t dataOffset = alignment->allocateNewArray(sizeof(MMapPackedDnaData));
+    size_t basesSize = (length + 3) / 4;
+    size_t basesOffset = alignment->allocateNewArray(basesSize);
+    uint8_t *bases = static_cast<uint8_t *>(alignment->resolveOffset(basesOffset, basesSize));
+    vector<MMapDnaRun> nRuns, maskRuns;
+    for (hal_size_t i = 0; i < length; i += 4) {
+        uint8_t byte = 0;
+        for (hal_size_t j = 0; j < 4 && i + j < length; ++j) {
+            uint8_t code = getNibble(nibbleDna, i + j);
+            if (code & NIBBLE_N) {
+                addToRuns(nRuns, i + j);
+            } else {
+                byte |= (code & 3) << (2 * j);
+            }
+            if (!(code & NIBBLE_UPPER)) {
+                addToRuns(maskRuns, i + j);
+            }
+        }
+        bases[i / 4] = byte;
+    }
+    size_t nRunsOffset = writeRuns(alignment, nRuns);
+    size_t maskRunsOffset = writeRuns(alignment, maskRuns);
+
+    MMapPackedDnaData *data =
+        static_cast<MMapPackedDnaData *>(alignment->resolveOffset(dataOffset, sizeof(MMapPackedDnaData)));
+    data->_length = length;
+    data->_basesOffset = basesOffset;
+    data->_numNRuns = nRuns.size();
+    data->_nRunsOffset = nRunsOffset;
+    data->_numMaskRuns = maskRuns.size();
+    data->_maskRunsOffset = maskRunsOffset;
+    return dataOffset;
+}
+
+/* apply the runs overlapping [start, end) to nibble DNA starting at start,
+ * setting N if isN, otherwise lowercasing */
+static void applyRuns(MMapAlignment *alignment, size_t runsOffset, hal_size_t numRuns, hal_index_t start,
+                      hal_index_t end, char *nibbleDna, bool isN) {
+    if (numRuns == 0) {
+        return;
+    }
+    const MMapDnaRun *runs =
+        static_cast<const MMapDnaRun *>(alignment->resolveOffset(runsOffset, numRuns * sizeof(MMapDnaRun)));
+    const MMapDnaRun *run = upper_bound(runs, runs + numRuns, start,
+                                        [](hal_index_t pos, const MMapDnaRun &r) { return pos < r._end; });
+    for (; run != runs + numRuns && run->_start < end; ++run) {
+        hal_index_t runEnd = min(run->_end, end);
+        for (hal_index_t i = max(run->_start, start); i < runEnd; ++i) {
+            uint8_t code = getNibble(nibbleDna, i - start);
+            setNibble(nibbleDna, i - start, isN ? (NIBBLE_N | (code & NIBBLE_UPPER)) : (code & ~NIBBLE_UPPER));
+        }
+    }
+}
+
+void MMapPackedDnaData::unpack(MMapAlignment *alignment, hal_index_t start, hal_size_t length, char *nibbleDna) const {
+    assert(start >= 0 && start % 2 == 0 && start + length <= _length);
+    if (length == 0) {
+        return;
+    }
+    hal_index_t end = start + length;
+    hal_index_t firstByte = start / 4;
+    const uint8_t *bases = static_cast<const uint8_t *>(
+        alignment->resolveOffset(_basesOffset + firstByte, (end + 3) / 4 - firstByte));
+    hal_index_t i = start;
+    if (i % 4 != 0) {
+        // start is even, so this is the second half of a byte
+        memcpy(nibbleDna, &unpackTable._nibbles[bases[0]][1], 1);
+        i += 2;
+    }
+    for (; i + 4 <= end; i += 4) {
+        memcpy(nibbleDna + (i - start) / 2, unpackTable._nibbles[bases[i / 4 - firstByte]], 2);
+    }
+    if (i < end) {
+        // at most the three bases at the start of the last byte
+        const char *nibbles = unpackTable._nibbles[bases[i / 4 - firstByte]];
+        memcpy(nibbleDna + (i - start) / 2, nibbles, (end - i + 1) / 2);
+    }
+    applyRuns(alignment, _nRunsOffset, _numNRuns, start, end, nibbleDna, true);
+    applyRuns(alignment, _maskRunsOffset, _numMaskRuns, start, end, nibbleDna, false);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#ifndef _MMAPPACKEDDNA_H
+#define _MMAPPACKEDDNA_H
+#include "halDefs.h"
+#include <cstddef>
+
+namespace hal {
+    class MMapAlignment;
+
+    /* Set in MMapGenomeData::_dnaOffset when the genome's DNA is packed.
+     * Offsets are always word aligned, so the bit is otherwise unused.
+     * Added in mmap API 1.2. */
+    static const size_t MMAP_PACKED_DNA_FLAG = 1;
+
+    /* A run of bases [_start, _end) */
+    struct MMapDnaRun {
+        hal_index_t _start;
+        hal_index_t _end;
+    };
+
+    /**
+     * A genome's DNA stored two bits per base, with the N bases and the
+     * lowercase (soft-masked) bases kept as sorted lists of runs.  This is
+     * about half the size of the nibble encoding for typical assemblies,
+     * which are mostly ACGT with long runs of N and masking.  Packed DNA is
+     * read-only; MMapDnaAccess decodes it to the nibble encoding a window at
+     * a time.
+     */
+    class MMapPackedDnaData {
+      public:
+        /* pack length bases of nibble-encoded DNA into new space in the
+         * file, returning its offset */
+        static size_t pack(MMapAlignment *alignment, const char *nibbleDna, hal_size_t length);
+
+        /* decode the bases [start, start + length) to the nibble encoding.
+         * start must be even, and nibbleDna have room for (length + 1) / 2
+         * bytes */
+        void unpack(MMapAlignment *alignment, hal_index_t start, hal_size_t length, char *nibbleDna) const;
+
+        hal_size_t getLength() const {
+            return _length;
+        }
+        hal_size_t getNumNRuns() const {
+            return _numNRuns;
+        }
+        hal_size_t getNumMaskRuns() const {
+            return _numMaskRuns;
+        }
+
+        /* call f(offset, size) for each range of the file holding the
+         * bases and runs */
+        template <typename F> void forEachRange(F f) const {
+            f(_basesOffset, (_length + 3) / 4);
+            f(_nRunsOffset, _numNRuns * sizeof(MMapDnaRun));
+            f(_maskRunsOffset, _numMaskRuns * sizeof(MMapDnaRun));
+        }
+
+      private:
+        hal_size_t _length;
+        size_t _basesOffset;
+        hal_size_t _numNRuns;
+        size_t _nRunsOffset;
+        hal_size_t _numMaskRuns;
+        size_t _maskRunsOffset;
+    };
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
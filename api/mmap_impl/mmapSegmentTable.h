@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#ifndef _MMAPSEGMENTTABLE_H
+#define _MMAPSEGMENTTABLE_H
+#include "halDefs.h"
+#include "mmapAlignment.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace hal {
+    /* Set in MMapGenomeData::_topSegmentsOffset or _bottomSegmentsOffset
+     * when the segments are stored as an MMapSegmentTable.  Added in mmap
+     * API 1.3. */
+    static const size_t MMAP_SEGMENT_TABLE_FLAG = 1;
+
+    /**
+     * Compact, read-only encoding of a genome's top or bottom segment array,
+     * stored as a structure of arrays.  Each segment has a start position,
+     * some index fields (the parse index then parent and paralogy indexes for
+     * top segments, or the child indexes for bottom segments) and some
+     * reversed flags (one for top segments, one per child for bottom
+     * segments).  The start positions and the index fields are each stored
+     * 32 bits wide when all their values fit, and the flags are bitmaps.  A
+     * scan reading a few fields only touches their arrays.
+     */
+    class MMapSegmentTable {
+      public:
+        /* index fields of top segments */
+        enum { TOP_PARSE_INDEX = 0, TOP_PARALOGY_INDEX, TOP_PARENT_INDEX, NUM_TOP_INDEXES };
+        /* index fields of bottom segments, child i is BOTTOM_CHILD_INDEX + i */
+        enum { BOTTOM_PARSE_INDEX = 0, BOTTOM_CHILD_INDEX };
+
+        /* write a table of numSegments segments, with numIndexes index fields
+         * and numFlags flags, returning its offset.  The values are taken
+         * from getStart(segment) (called for numSegments + 1 segments, the
+         * last being the end of the array), getIndex(field, segment) and
+         * getFlag(flag, segment). */
+        template <typename GetStart, typename GetIndex, typename GetFlag>
+        static size_t write(MMapAlignment *alignment, hal_size_t numSegments, hal_size_t numIndexes, hal_size_t numFlags,
+                            GetStart getStart, GetIndex getIndex, GetFlag getFlag);
+
+        hal_size_t getNumSegments() const {
+            return _numSegments;
+        }
+
+        /* segment may be getNumSegments(), for the end of the last segment */
+        hal_index_t getStartPosition(MMapAlignment *alignment, hal_index_t segment) const {
+            return readValue(alignment, _startsOffset, _startWidth, segment);
+        }
+
+        hal_index_t getIndex(MMapAlignment *alignment, hal_size_t field, hal_index_t segment) const {
+            return readValue(alignment, _indexesOffset + field * getColumnSize(_indexWidth), _indexWidth, segment);
+        }
+
+        bool getFlag(MMapAlignment *alignment, hal_size_t flag, hal_index_t segment) const {
+            const uint64_t *word = static_cast<const uint64_t *>(alignment->resolveOffset(
+                _flagsOffset + (flag * getNumFlagWords() + segment / 64) * sizeof(uint64_t), sizeof(uint64_t)));
+            return (*word >> (segment % 64)) & 1;
+        }
+
+        /* call f(offset, size) for each range of the file holding the
+         * columns */
+        template <typename F> void forEachRange(F f) const {
+            f(_startsOffset, MMapFile::alignRound((_numSegments + 1) * _startWidth));
+            f(_indexesOffset, _numIndexes * getColumnSize(_indexWidth));
+            f(_flagsOffset, _numFlags * getNumFlagWords() * sizeof(uint64_t));
+        }
+
+      private:
+        static const uint32_t NULL_INDEX_32 = UINT32_MAX;
+
+        size_t getColumnSize(uint32_t width) const {
+            return MMapFile::alignRound(_numSegments * width);
+        }
+        size_t getNumFlagWords() const {
+            return (_numSegments + 63) / 64;
+        }
+        static uint32_t getWidth(hal_index_t minValue, hal_index_t maxValue) {
+            return minValue >= NULL_INDEX && maxValue < (hal_index_t)NULL_INDEX_32 ? sizeof(uint32_t) : sizeof(hal_index_t);
+        }
+        static hal_index_t readValue(MMapAlignment *alignment, size_t offset, uint32_t width, hal_index_t i) {
+            if (width == sizeof(uint32_t)) {
+                uint32_t value = *static_cast<const uint32_t *>(alignment->resolveOffset(offset + i * width, width));
+                return value == NULL_INDEX_32 ? NULL_INDEX : value;
+            } else {
+                return *static_cast<const hal_index_t *>(alignment->resolveOffset(offset + i * width, width));
+            }
+        }
+        static void writeValue(void *column, uint32_t width, hal_index_t i, hal_index_t value) {
+            if (width == sizeof(uint32_t)) {
+                static_cast<uint32_t *>(column)[i] = value == NULL_INDEX ? NULL_INDEX_32 : (uint32_t)value;
+            } else {
+                static_cast<hal_index_t *>(column)[i] = value;
+            }
+        }
+
+        hal_size_t _numSegments;
+        hal_size_t _numIndexes;
+        hal_size_t _numFlags;
+        uint32_t _startWidth;
+        uint32_t _indexWidth;
+        size_t _startsOffset;
+        size_t _indexesOffset;
+        size_t _flagsOffset;
+    };
+
+    template <typename GetStart, typename GetIndex, typename GetFlag>
+    size_t MMapSegmentTable::write(MMapAlignment *alignment, hal_size_t numSegments, hal_size_t numIndexes,
+                                   hal_size_t numFlags, GetStart getStart, GetIndex getIndex, GetFlag getFlag) {
+        // find the smallest widths that hold the values
+        hal_index_t minStart = 0, maxStart = 0, minIndex = 0, maxIndex = 0;
+        for (hal_size_t i = 0; i <= numSegments; ++i) {
+            hal_index_t start = getStart(i);
+            minStart = std::min(minStart, start);
+            maxStart = std::max(maxStart, start);
+        }
+        for (hal_size_t field = 0; field < numIndexes; ++field) {
+            for (hal_size_t i = 0; i < numSegments; ++i) {
+                hal_index_t index = getIndex(field, i);
+                minIndex = std::min(minIndex, index);
+                maxIndex = std::max(maxIndex, index);
+            }
+        }
+
+        size_t tableOffset = alignment->allocateNewArray(sizeof(MMapSegmentTable));
+        MMapSegmentTable table;
+        table._numSegments = numSegments;
+        table._numIndexes = numIndexes;
+        table._numFlags = numFlags;
+        table._startWidth = getWidth(minStart, maxStart);
+        table._indexWidth = getWidth(minIndex, maxIndex);
+        size_t startsSize = MMapFile::alignRound((numSegments + 1) * table._startWidth);
+        size_t indexesSize = numIndexes * table.getColumnSize(table._indexWidth);
+        size_t flagsSize = numFlags * table.getNumFlagWords() * sizeof(uint64_t);
+        table._startsOffset = alignment->allocateNewArray(startsSize);
+        table._indexesOffset = alignment->allocateNewArray(indexesSize);
+        table._flagsOffset = alignment->allocateNewArray(flagsSize);
+
+        void *starts = alignment->resolveOffset(table._startsOffset, startsSize);
+        for (hal_size_t i = 0; i <= numSegments; ++i) {
+            writeValue(starts, table._startWidth, i, getStart(i));
+        }
+        char *indexes = static_cast<char *>(alignment->resolveOffset(table._indexesOffset, indexesSize));
+        for (hal_size_t field = 0; field < numIndexes; ++field) {
+            void *column = indexes + field * table.getColumnSize(table._indexWidth);
+            for (hal_size_t i = 0; i < numSegments; ++i) {
+                writeValue(column, table._indexWidth, i, getIndex(field, i));
+            }
+        }
+        uint64_t *flags = static_cast<uint64_t *>(alignment->resolveOffset(table._flagsOffset, flagsSize));
+        std::fill(flags, flags + flagsSize / sizeof(uint64_t), 0);
+        for (hal_size_t flag = 0; flag < numFlags; ++flag) {
+            uint64_t *bitmap = flags + flag * table.getNumFlagWords();
+            for (hal_size_t i = 0; i < numSegments; ++i) {
+                if (getFlag(flag, i)) {
+                    bitmap[i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+        }
+        *static_cast<MMapSegmentTable *>(alignment->resolveOffset(tableOffset, sizeof(MMapSegmentTable))) = table;
+        return tableOffset;
+    }
+}
+
+#endif
+// Local Variables:
+// mode: c++
+// End:
@@ -9,6 +9,7 @@ void MMapTopSegment::setCoordinates(hal_index_t startPos, hal_size_t length) {
         (startPos >= (hal_index_t)_genome->getSequenceLength() || startPos + length > _genome->getSequenceLength())) {
         throw hal_exception("Trying to set top segment coordinate out of range");
     }
+    checkWritable();
 
     _data->setStartPosition(startPos);
     (_data + 1)->setStartPosition(startPos + length);
@@ -10,18 +10,19 @@ namespace hal {
     class MMapTopSegment : public TopSegment {
       public:
         MMapTopSegment(MMapGenome *genome, hal_index_t arrayIndex)
-            : TopSegment(genome, arrayIndex), _data(getMMapGenome()->getTopSegmentPointer(arrayIndex)) {
+            : TopSegment(genome, arrayIndex) {
+            setData(arrayIndex);
         }
 
         // SEGMENT INTERFACE
         void setArrayIndex(Genome *genome, hal_index_t arrayIndex) {
             _genome = genome;
-            _data = getMMapGenome()->getTopSegmentPointer(arrayIndex);
+            setData(arrayIndex);
             _index = arrayIndex;
         }
         const Sequence *getSequence() const;
         hal_index_t getStartPosition() const {
-            return _data->getStartPosition();
+            return _table != NULL ? _table->getStartPosition(getAlignment(), _index) : _data->getStartPosition();
         };
         hal_index_t getEndPosition() const;
         hal_size_t getLength() const;
@@ -33,31 +34,38 @@ namespace hal {
 
         // TOP SEGMENT INTERFACE
         hal_index_t getParentIndex() const {
-            return _data->getParentIndex();
+            return _table != NULL ? _table->getIndex(getAlignment(), MMapSegmentTable::TOP_PARENT_INDEX, _index)
+                                  : _data->getParentIndex();
         };
         bool hasParent() const;
         void setParentIndex(hal_index_t parIdx) {
+            checkWritable();
             _data->setParentIndex(parIdx);
         };
         bool getParentReversed() const {
-            return _data->getReversed();
+            return _table != NULL ? _table->getFlag(getAlignment(), 0, _index) : _data->getReversed();
         };
         void setParentReversed(bool isReversed) {
+            checkWritable();
             _data->setReversed(isReversed);
         };
         hal_index_t getBottomParseIndex() const {
-            return _data->getBottomParseIndex();
+            return _table != NULL ? _table->getIndex(getAlignment(), MMapSegmentTable::TOP_PARSE_INDEX, _index)
+                                  : _data->getBottomParseIndex();
         };
         void setBottomParseIndex(hal_index_t botParseIdx) {
+            checkWritable();
             _data->setBottomParseIndex(botParseIdx);
         };
         hal_offset_t getBottomParseOffset() const;
         bool hasParseDown() const;
         hal_index_t getNextParalogyIndex() const {
-            return _data->getNextParalogyIndex();
+            return _table != NULL ? _table->getIndex(getAlignment(), MMapSegmentTable::TOP_PARALOGY_INDEX, _index)
+                                  : _data->getNextParalogyIndex();
         }
         bool hasNextParalogy() const;
         void setNextParalogyIndex(hal_index_t parIdx) {
+            checkWritable();
             _data->setNextParalogyIndex(parIdx);
         };
         hal_index_t getLeftParentIndex() const;
@@ -68,6 +76,22 @@ namespace hal {
         MMapGenome *getMMapGenome() const {
             return static_cast<MMapGenome *>(_genome);
         }
+        MMapAlignment *getAlignment() const {
+            return getMMapGenome()->_alignment;
+        }
+        // Segments stored as a compact table are read through _table,
+        // otherwise through _data.
+        void setData(hal_index_t arrayIndex) {
+            _table = getMMapGenome()->getTopSegmentTable();
+            _data = _table == NULL ? getMMapGenome()->getTopSegmentPointer(arrayIndex) : NULL;
+        }
+        void checkWritable() const {
+            if (_table != NULL) {
+                throw hal_exception("can't modify the top segments of genome " + _genome->getName() +
+                                    ", which are stored as a compact table");
+            }
+        }
+        const MMapSegmentTable *_table;
         MMapTopSegmentData *_data;
     };
 
@@ -76,6 +100,9 @@ namespace hal {
     }
 
     inline hal_size_t MMapTopSegment::getLength() const {
+        if (_table != NULL) {
+            return _table->getStartPosition(getAlignment(), _index + 1) - _table->getStartPosition(getAlignment(), _index);
+        }
         return (_data + 1)->getStartPosition() - _data->getStartPosition();
     }
 
@@ -965,6 +965,154 @@ struct ColumnIteratorPositionCacheTest : public AlignmentTest {
     }
 };
 
+struct ColumnIteratorRowsTest : public AlignmentTest {
+    void createCallBack(AlignmentPtr alignment) {
+        createRandomAlignment(rng, alignment, 1.25, 0.7, 4, 8, 2, 50, 10, 100);
+    }
+
+    void checkColumnRows(const ColumnIterator *colIt, const vector<ColumnIterator::ColumnRow> &rows) {
+        // the rows are the non-empty entries of the column map, in order
+        const ColumnIterator::ColumnMap *colMap = colIt->getColumnMap();
+        size_t r = 0;
+        for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin(); i != colMap->end(); ++i) {
+            for (size_t j = 0; j < i->second->size(); ++j, ++r) {
+                const DnaIteratorPtr &dnaIt = i->second->at(j);
+                CuAssertTrue(_testCase, r < rows.size());
+                const ColumnIterator::ColumnRow &row = rows[r];
+                CuAssertTrue(_testCase, row._sequence == i->first);
+                CuAssertTrue(_testCase, colIt->getColumnGenomes().at(row._genomeIndex) == i->first->getGenome());
+                CuAssertTrue(_testCase, row._sequenceIndex == i->first->getArrayIndex());
+                CuAssertTrue(_testCase, row._position == dnaIt->getArrayIndex() - i->first->getStartPosition());
+                CuAssertTrue(_testCase, row._base == dnaIt->getBase());
+                CuAssertTrue(_testCase, row._reversed == dnaIt->getReversed());
+            }
+        }
+        CuAssertTrue(_testCase, r == rows.size());
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        validateAlignment(alignment.get());
+        set<const Genome *> genomes;
+        getGenomesInSubTree(alignment->openGenome(alignment->getRootName()), genomes);
+        for (set<const Genome *>::iterator g = genomes.begin(); g != genomes.end(); ++g) {
+            const Genome *genome = *g;
+            if (genome->getSequenceLength() == 0) {
+                continue;
+            }
+            // walk the genome one column at a time, keeping each column's
+            // rows to compare with those read in batches
+            vector<vector<ColumnIterator::ColumnRow>> columns;
+            vector<ColumnIterator::ColumnRow> rows;
+            ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0, NULL_INDEX, false, false, false, true);
+            while (true) {
+                colIt->getColumnRows(rows);
+                checkColumnRows(colIt.get(), rows);
+                columns.push_back(rows);
+                if (colIt->lastColumn()) {
+                    break;
+                }
+                colIt->toRight();
+            }
+
+            ColumnIteratorPtr batchIt = genome->getColumnIterator(NULL, 0, 0, NULL_INDEX, false, false, false, true);
+            ColumnIterator::ColumnBatch batch;
+            size_t c = 0;
+            while (true) {
+                batch.clear();
+                hal_size_t numColumns = batchIt->readColumns(batch, 7);
+                CuAssertTrue(_testCase, numColumns == batch.getNumColumns());
+                CuAssertTrue(_testCase, numColumns > 0 && numColumns <= 7);
+                for (hal_size_t i = 0; i < numColumns; ++i, ++c) {
+                    CuAssertTrue(_testCase, c < columns.size());
+                    CuAssertTrue(_testCase, batch.getColumnSize(i) == columns[c].size());
+                    const ColumnIterator::ColumnRow *row = batch.getColumnBegin(i);
+                    for (size_t r = 0; r < columns[c].size(); ++r, ++row) {
+                        CuAssertTrue(_testCase, row->_sequence == columns[c][r]._sequence);
+                        CuAssertTrue(_testCase, batchIt->getColumnGenomes().at(row->_genomeIndex) ==
+                                                    colIt->getColumnGenomes().at(columns[c][r]._genomeIndex));
+                        CuAssertTrue(_testCase, row->_position == columns[c][r]._position);
+                        CuAssertTrue(_testCase, row->_base == columns[c][r]._base);
+                        CuAssertTrue(_testCase, row->_reversed == columns[c][r]._reversed);
+                    }
+                    CuAssertTrue(_testCase, row == batch.getColumnEnd(i));
+                }
+                if (numColumns < 7) {
+                    CuAssertTrue(_testCase, batchIt->lastColumn());
+                }
+                if (batchIt->lastColumn()) {
+                    break;
+                }
+                batchIt->toRight();
+            }
+            CuAssertTrue(_testCase, c == columns.size());
+        }
+    }
+};
+
+struct BlockColumnIteratorTest : public AlignmentTest {
+    void createCallBack(AlignmentPtr alignment) {
+        createRandomAlignment(rng, alignment, 1.25, 0.7, 4, 8, 2, 50, 10, 100);
+    }
+
+    void checkBlocks(const Genome *genome, const vector<vector<ColumnIterator::ColumnRow>> &columns,
+                     const vector<const Genome *> &columnGenomes, hal_size_t maxBlockLength) {
+        ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0, NULL_INDEX, false, false, false, true);
+        BlockColumnIterator blockIt(colIt, maxBlockLength);
+        size_t c = 0;
+        string rowString;
+        while (blockIt.toNextBlock()) {
+            CuAssertTrue(_testCase, blockIt.getLength() > 0);
+            CuAssertTrue(_testCase, maxBlockLength == 0 || blockIt.getLength() <= maxBlockLength);
+            CuAssertTrue(_testCase, c + blockIt.getLength() <= columns.size());
+            const vector<BlockColumnIterator::BlockRow> &rows = blockIt.getRows();
+            for (size_t r = 0; r < rows.size(); ++r) {
+                const BlockColumnIterator::BlockRow &row = rows[r];
+                blockIt.getRowString(r, rowString);
+                CuAssertTrue(_testCase, rowString.length() == blockIt.getLength());
+                for (hal_size_t i = 0; i < blockIt.getLength(); ++i) {
+                    const vector<ColumnIterator::ColumnRow> &column = columns[c + i];
+                    CuAssertTrue(_testCase, column.size() == rows.size());
+                    CuAssertTrue(_testCase, column[r]._sequence == row._sequence);
+                    CuAssertTrue(_testCase, column[r]._reversed == row._reversed);
+                    CuAssertTrue(_testCase, column[r]._position == row._start + (hal_index_t)i * row._step);
+                    CuAssertTrue(_testCase, column[r]._base == rowString[i]);
+                    CuAssertTrue(_testCase, columnGenomes.at(column[r]._genomeIndex) ==
+                                                blockIt.getColumnGenomes().at(row._genomeIndex));
+                }
+            }
+            c += blockIt.getLength();
+        }
+        CuAssertTrue(_testCase, c == columns.size());
+        CuAssertTrue(_testCase, blockIt.toNextBlock() == false);
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        validateAlignment(alignment.get());
+        set<const Genome *> genomes;
+        getGenomesInSubTree(alignment->openGenome(alignment->getRootName()), genomes);
+        for (set<const Genome *>::iterator g = genomes.begin(); g != genomes.end(); ++g) {
+            const Genome *genome = *g;
+            if (genome->getSequenceLength() == 0) {
+                continue;
+            }
+            // the blocks must cover exactly the columns of a column iterator
+            vector<vector<ColumnIterator::ColumnRow>> columns;
+            vector<ColumnIterator::ColumnRow> rows;
+            ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0, NULL_INDEX, false, false, false, true);
+            while (true) {
+                colIt->getColumnRows(rows);
+                columns.push_back(rows);
+                if (colIt->lastColumn()) {
+                    break;
+                }
+                colIt->toRight();
+            }
+            checkBlocks(genome, columns, colIt->getColumnGenomes(), 0);
+            checkBlocks(genome, columns, colIt->getColumnGenomes(), 3);
+        }
+    }
+};
+
 static void halColumnIteratorBaseTest(CuTest *testCase) {
     ColumnIteratorBaseTest tester;
     tester.check(testCase);
@@ -1005,6 +1153,16 @@ static void halColumnIteratorPositionCacheTest(CuTest *testCase) {
     tester.check(testCase);
 }
 
+static void halColumnIteratorRowsTest(CuTest *testCase) {
+    ColumnIteratorRowsTest tester;
+    tester.check(testCase);
+}
+
+static void halBlockColumnIteratorTest(CuTest *testCase) {
+    BlockColumnIteratorTest tester;
+    tester.check(testCase);
+}
+
 static CuSuite *halColumnIteratorTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, halColumnIteratorBaseTest);
@@ -1015,6 +1173,8 @@ static CuSuite *halColumnIteratorTestSuite(void) {
     SUITE_ADD_TEST(suite, halColumnIteratorMultiGapTest);
     SUITE_ADD_TEST(suite, halColumnIteratorMultiGapInvTest);
     SUITE_ADD_TEST(suite, halColumnIteratorPositionCacheTest);
+    SUITE_ADD_TEST(suite, halColumnIteratorRowsTest);
+    SUITE_ADD_TEST(suite, halBlockColumnIteratorTest);
     return suite;
 }
 
@@ -7,15 +7,27 @@
 #include "halApiTestSupport.h"
 #include "halAlignment.h"
 #include "halBottomSegmentIterator.h"
+#include "halCLParser.h"
 #include "halColumnIterator.h"
+#include "halConvert.h"
 #include "halDnaIterator.h"
 #include "halGenome.h"
+#include "halLocalBlockCache.h"
 #include "halMetaData.h"
+#include "halRandNumberGen.h"
+#include "halRandomData.h"
 #include "halTopSegmentIterator.h"
 #include "halValidate.h"
+#include <H5Cpp.h>
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <dirent.h>
+#include <fstream>
 #include <iostream>
 #include <stdio.h>
 #include <string>
+#include <unistd.h>
 extern "C" {
 #include "commonC.h"
 }
@@ -556,6 +568,105 @@ static void halGenomeStringTest(CuTest *testCase) {
     tester.check(testCase);
 }
 
+/* Bulk DNA reads and writes must match those done a base at a time */
+struct GenomeBulkDnaTest : public AlignmentTest {
+    std::string _string;
+    void createCallBack(AlignmentPtr alignment) {
+        hal_size_t seqLength = 100003;
+        Genome *genome = alignment->addRootGenome("Genome", 0);
+        vector<Sequence::Info> seqVec;
+        seqVec.push_back(Sequence::Info("Sequence1", 50001, 0, 0));
+        seqVec.push_back(Sequence::Info("Sequence2", seqLength - 50001, 0, 0));
+        genome->setDimensions(seqVec);
+        _string = randomString(seqLength);
+        genome->setBases(0, seqLength, _string.data());
+
+        // overwrite some odd-aligned ranges, forwards and reversed
+        string replacement = randomString(1001);
+        genome->setBases(777, replacement.length(), replacement.data());
+        _string.replace(777, replacement.length(), replacement);
+        DnaIteratorPtr dnaIt = genome->getDnaIterator(60000);
+        dnaIt->toReverse();
+        dnaIt->writeBases(replacement.data(), replacement.length());
+        CuAssertTrue(_testCase, dnaIt->getArrayIndex() == 60000 - (hal_index_t)replacement.length());
+        reverseComplement(replacement);
+        _string.replace(60000 - replacement.length() + 1, replacement.length(), replacement);
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        const Genome *genome = alignment->openGenome("Genome");
+        vector<char> buffer(_string.length());
+        genome->getBases(0, _string.length(), buffer.data());
+        CuAssertTrue(_testCase, string(buffer.begin(), buffer.end()) == _string);
+        DnaIteratorPtr dnaIt = genome->getDnaIterator();
+        for (hal_size_t i = 0; i < _string.length(); ++i, dnaIt->toRight()) {
+            CuAssertTrue(_testCase, dnaIt->getBase() == _string[i]);
+        }
+        for (hal_size_t start = 1; start < _string.length(); start += 3001) {
+            hal_size_t length = min(_string.length() - start, start % 1013);
+            genome->getBases(start, length, buffer.data());
+            CuAssertTrue(_testCase, string(buffer.data(), length) == _string.substr(start, length));
+
+            DnaIteratorPtr revIt = genome->getDnaIterator(start + length - 1);
+            revIt->toReverse();
+            revIt->readBases(buffer.data(), length);
+            string expected = _string.substr(start, length);
+            reverseComplement(expected);
+            CuAssertTrue(_testCase, string(buffer.data(), length) == expected);
+        }
+        const Sequence *sequence = genome->getSequence("Sequence2");
+        sequence->getBases(3, 100, buffer.data());
+        CuAssertTrue(_testCase, string(buffer.data(), 100) == _string.substr(50001 + 3, 100));
+    }
+};
+
+static void halGenomeBulkDnaTest(CuTest *testCase) {
+    GenomeBulkDnaTest tester;
+    tester.check(testCase);
+}
+
+/* The bulk packing, unpacking and reverse complement kernels must match the
+ * per-character functions at all alignments */
+static void halGenomeDnaKernelTest(CuTest *testCase) {
+    string dna = AlignmentTest::randomString(300);
+    vector<char> packed(dna.length() / 2 + 1);
+    for (size_t i = 0; i < dna.length(); i++) {
+        packed[i / 2] = dnaPack(dna[i], i, packed[i / 2]);
+    }
+    for (size_t start = 0; start < 4; ++start) {
+        for (size_t length = 0; start + length <= dna.length(); ++length) {
+            string out(length, '\0');
+            dnaUnpackString(packed.data(), start, length, &out[0]);
+            CuAssertTrue(testCase, out == dna.substr(start, length));
+
+            vector<char> repacked(packed);
+            string replacement = AlignmentTest::randomString(length);
+            dnaPackString(replacement.data(), length, repacked.data(), start);
+            for (size_t i = 0; i < dna.length(); ++i) {
+                char expected = i >= start && i < start + length ? replacement[i - start] : dna[i];
+                CuAssertTrue(testCase, dnaUnpack(i, repacked[i / 2]) == expected);
+            }
+        }
+    }
+
+    // includes characters that aren't bases, which are left as they are
+    const char chars[] = "ACGTNacgtnRx.*";
+    for (size_t length = 0; length < 200; ++length) {
+        for (size_t numOdd = 0; numOdd < 2; ++numOdd) {
+            string s(length, 'A');
+            for (size_t i = 0; i < length; ++i) {
+                s[i] = chars[rand() % (numOdd ? sizeof(chars) - 1 : 10)];
+            }
+            string expected(s.rbegin(), s.rend());
+            for (size_t i = 0; i < length; ++i) {
+                expected[i] = reverseComplement(expected[i]);
+            }
+            reverseComplement(&s[0], length);
+            CuAssertTrue(testCase, s == expected);
+        }
+    }
+}
+
 static void halGenomeCopyTest(CuTest *testCase) {
     GenomeCopyTest tester;
     tester.check(testCase);
@@ -572,6 +683,614 @@ static void halGenomeDNAPackUnpackTest(CuTest *testCase) {
     }
 }
 
+/* Create an mmap file with a tiny initial size, so that it has to grow over and
+ * over as genomes are added, then append to it.  Genomes opened before the
+ * file grew must still be valid. */
+static void halGenomeMmapGrowTest(CuTest *testCase) {
+    string path = getTempFile();
+    hal_size_t seqLength = 2000000;
+    string dna1 = AlignmentTest::randomString(seqLength);
+    string dna2 = AlignmentTest::randomString(seqLength / 2);
+    try {
+        AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS, 64 * 1024));
+        Genome *ancGenome = alignment->addRootGenome("AncGenome", 0);
+        vector<Sequence::Info> seqVec(1);
+        seqVec[0] = Sequence::Info("Sequence", seqLength, 0, 100000);
+        ancGenome->setDimensions(seqVec);
+        Genome *leafGenome = alignment->addLeafGenome("Leaf", "AncGenome", 0.1);
+        seqVec[0] = Sequence::Info("Sequence", seqLength, 100000, 0);
+        leafGenome->setDimensions(seqVec);
+        leafGenome->setString(dna1);
+        ancGenome->setString(dna1);
+        CuAssertTrue(testCase, ancGenome->getName() == "AncGenome");
+        CuAssertTrue(testCase, ancGenome->getNumBottomSegments() == 100000);
+        alignment->close();
+
+        alignment = AlignmentPtr(mmapAlignmentInstance(path, WRITE_ACCESS, 4096));
+        Genome *leaf2Genome = alignment->addLeafGenome("Leaf2", "Leaf", 0.1);
+        seqVec[0] = Sequence::Info("Sequence2", seqLength / 2, 0, 0);
+        leaf2Genome->setDimensions(seqVec);
+        leaf2Genome->setString(dna2);
+        alignment->close();
+
+        AlignmentConstPtr ralignment(mmapAlignmentInstance(path, READ_ACCESS));
+        string genomeString;
+        ralignment->openGenome("AncGenome")->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna1);
+        ralignment->openGenome("Leaf")->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna1);
+        CuAssertTrue(testCase, ralignment->openGenome("Leaf")->getNumTopSegments() == 100000);
+        ralignment->openGenome("Leaf2")->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna2);
+        ralignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+}
+
+/* Write DNA with runs of N and lowercase to an mmap file with packed DNA and
+ * read it back */
+static void halGenomeMmapPackedDnaTest(CuTest *testCase) {
+    string path = getTempFile();
+    hal_size_t seqLength = 100001;
+    string dna = AlignmentTest::randomString(seqLength);
+    for (hal_size_t i = 0; i < seqLength; ++i) {
+        if (i % 5000 < 700) {
+            dna[i] = tolower(dna[i]);
+        }
+        if (i % 30011 < 1001 || i % 7919 == 3) {
+            dna[i] = isupper(dna[i]) ? 'N' : 'n';
+        }
+    }
+    try {
+        AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, true));
+        Genome *genome = alignment->addRootGenome("Genome", 0);
+        vector<Sequence::Info> seqVec;
+        seqVec.push_back(Sequence::Info("Sequence1", seqLength - 20000, 0, 0));
+        seqVec.push_back(Sequence::Info("Sequence2", 20000, 0, 0));
+        genome->setDimensions(seqVec);
+        genome->setString(dna);
+        alignment->closeGenome(genome);
+        alignment->close();
+
+        AlignmentConstPtr ralignment(mmapAlignmentInstance(path, READ_ACCESS));
+        const Genome *rgenome = ralignment->openGenome("Genome");
+        string genomeString;
+        rgenome->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna);
+        for (hal_size_t start = 0; start < seqLength; start += 997) {
+            hal_size_t length = min(seqLength - start, (hal_size_t)(start % 20011));
+            rgenome->getSubString(genomeString, start, length);
+            CuAssertTrue(testCase, genomeString == dna.substr(start, length));
+        }
+        const Sequence *sequence = rgenome->getSequence("Sequence2");
+        sequence->getString(genomeString);
+        CuAssertTrue(testCase, genomeString == dna.substr(seqLength - 20000));
+        ralignment->close();
+
+        // packed DNA is read-only
+        alignment = AlignmentPtr(mmapAlignmentInstance(path, WRITE_ACCESS));
+        bool threw = false;
+        try {
+            alignment->openGenome("Genome")->setSubString("ACGT", 10, 4);
+        } catch (const hal_exception &e) {
+            threw = true;
+        }
+        CuAssertTrue(testCase, threw);
+        alignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+}
+
+/* Copy a random alignment to an mmap file with compact segment tables and
+ * check every segment reads back the same */
+static void halGenomeMmapCompactSegmentsTest(CuTest *testCase) {
+    string path = getTempFile();
+    string compactPath = getTempFile();
+    try {
+        RandNumberGen rng;
+        AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS));
+        // branch lengths are whole numbers, so some are long enough to give
+        // reversed segments
+        createRandomAlignment(rng, alignment, 1.25, 3.0, 4, 8, 2, 50, 10, 100);
+        alignment->close();
+
+        AlignmentConstPtr inAlignment(mmapAlignmentInstance(path, READ_ACCESS));
+        AlignmentPtr outAlignment(mmapAlignmentInstance(compactPath, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, true));
+        deque<string> names(1, inAlignment->getRootName());
+        vector<string> genomeNames;
+        outAlignment->addRootGenome(names.front());
+        while (!names.empty()) {
+            string name = names.front();
+            names.pop_front();
+            genomeNames.push_back(name);
+            for (const string &childName : inAlignment->getChildNames(name)) {
+                outAlignment->addLeafGenome(childName, name, inAlignment->getBranchLength(name, childName));
+                names.push_back(childName);
+            }
+        }
+        // copying the bottom segments needs the children's dimensions
+        for (const string &name : genomeNames) {
+            inAlignment->openGenome(name)->copyDimensions(outAlignment->openGenome(name));
+        }
+        for (const string &name : genomeNames) {
+            const Genome *inGenome = inAlignment->openGenome(name);
+            Genome *outGenome = outAlignment->openGenome(name);
+            inGenome->copySequence(outGenome);
+            inGenome->copyTopSegments(outGenome);
+            inGenome->copyBottomSegments(outGenome);
+            outAlignment->closeGenome(outGenome);
+        }
+        outAlignment->close();
+
+        AlignmentConstPtr compactAlignment(mmapAlignmentInstance(compactPath, READ_ACCESS));
+        validateAlignment(compactAlignment.get());
+        for (const string &name : genomeNames) {
+            const Genome *genome = inAlignment->openGenome(name);
+            const Genome *compactGenome = compactAlignment->openGenome(name);
+            CuAssertTrue(testCase, genome->getNumTopSegments() == compactGenome->getNumTopSegments());
+            CuAssertTrue(testCase, genome->getNumBottomSegments() == compactGenome->getNumBottomSegments());
+            TopSegmentIteratorPtr top = genome->getTopSegmentIterator();
+            TopSegmentIteratorPtr compactTop = compactGenome->getTopSegmentIterator();
+            for (; !top->atEnd(); top->toRight(), compactTop->toRight()) {
+                CuAssertTrue(testCase, top->getStartPosition() == compactTop->getStartPosition());
+                CuAssertTrue(testCase, top->getLength() == compactTop->getLength());
+                CuAssertTrue(testCase, top->tseg()->getParentIndex() == compactTop->tseg()->getParentIndex());
+                CuAssertTrue(testCase, top->tseg()->getParentReversed() == compactTop->tseg()->getParentReversed());
+                CuAssertTrue(testCase, top->tseg()->getBottomParseIndex() == compactTop->tseg()->getBottomParseIndex());
+                CuAssertTrue(testCase, top->tseg()->getNextParalogyIndex() == compactTop->tseg()->getNextParalogyIndex());
+            }
+            BottomSegmentIteratorPtr bottom = genome->getBottomSegmentIterator();
+            BottomSegmentIteratorPtr compactBottom = compactGenome->getBottomSegmentIterator();
+            for (; !bottom->atEnd(); bottom->toRight(), compactBottom->toRight()) {
+                CuAssertTrue(testCase, bottom->getStartPosition() == compactBottom->getStartPosition());
+                CuAssertTrue(testCase, bottom->getLength() == compactBottom->getLength());
+                CuAssertTrue(testCase, bottom->bseg()->getTopParseIndex() == compactBottom->bseg()->getTopParseIndex());
+                for (hal_size_t child = 0; child < genome->getNumChildren(); ++child) {
+                    CuAssertTrue(testCase,
+                                 bottom->bseg()->getChildIndex(child) == compactBottom->bseg()->getChildIndex(child));
+                    CuAssertTrue(testCase,
+                                 bottom->bseg()->getChildReversed(child) == compactBottom->bseg()->getChildReversed(child));
+                }
+            }
+        }
+        compactAlignment->close();
+        inAlignment->close();
+
+        // compact segments are read-only
+        outAlignment = AlignmentPtr(mmapAlignmentInstance(compactPath, WRITE_ACCESS));
+        bool threw = false;
+        try {
+            outAlignment->openGenome(genomeNames.back())->getTopSegmentIterator()->tseg()->setParentIndex(0);
+        } catch (const hal_exception &e) {
+            threw = true;
+        }
+        CuAssertTrue(testCase, threw);
+        outAlignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+    ::unlink(compactPath.c_str());
+}
+
+/* compare the DNA and segments of all genomes of two alignments */
+static void compareAlignments(CuTest *testCase, const Alignment *alignment, const Alignment *otherAlignment) {
+    deque<string> names(1, alignment->getRootName());
+    while (!names.empty()) {
+        const Genome *genome = alignment->openGenome(names.front());
+        const Genome *otherGenome = otherAlignment->openGenome(names.front());
+        for (const string &childName : alignment->getChildNames(names.front())) {
+            names.push_back(childName);
+        }
+        names.pop_front();
+        string dna, otherDna;
+        genome->getString(dna);
+        otherGenome->getString(otherDna);
+        CuAssertTrue(testCase, dna == otherDna);
+        CuAssertTrue(testCase, genome->getNumTopSegments() == otherGenome->getNumTopSegments());
+        CuAssertTrue(testCase, genome->getNumBottomSegments() == otherGenome->getNumBottomSegments());
+        TopSegmentIteratorPtr top = genome->getTopSegmentIterator();
+        TopSegmentIteratorPtr otherTop = otherGenome->getTopSegmentIterator();
+        for (; !top->atEnd(); top->toRight(), otherTop->toRight()) {
+            CuAssertTrue(testCase, top->getStartPosition() == otherTop->getStartPosition());
+            CuAssertTrue(testCase, top->getLength() == otherTop->getLength());
+            CuAssertTrue(testCase, top->tseg()->getParentIndex() == otherTop->tseg()->getParentIndex());
+            CuAssertTrue(testCase, top->tseg()->getParentReversed() == otherTop->tseg()->getParentReversed());
+            CuAssertTrue(testCase, top->tseg()->getNextParalogyIndex() == otherTop->tseg()->getNextParalogyIndex());
+        }
+        BottomSegmentIteratorPtr bottom = genome->getBottomSegmentIterator();
+        BottomSegmentIteratorPtr otherBottom = otherGenome->getBottomSegmentIterator();
+        for (; !bottom->atEnd(); bottom->toRight(), otherBottom->toRight()) {
+            CuAssertTrue(testCase, bottom->getStartPosition() == otherBottom->getStartPosition());
+            CuAssertTrue(testCase, bottom->getLength() == otherBottom->getLength());
+            for (hal_size_t child = 0; child < genome->getNumChildren(); ++child) {
+                CuAssertTrue(testCase, bottom->bseg()->getChildIndex(child) == otherBottom->bseg()->getChildIndex(child));
+                // the flag isn't set when there is no child segment
+                if (bottom->bseg()->getChildIndex(child) != NULL_INDEX) {
+                    CuAssertTrue(testCase,
+                                 bottom->bseg()->getChildReversed(child) == otherBottom->bseg()->getChildReversed(child));
+                }
+            }
+        }
+    }
+}
+
+/* Write the same random alignment to plain and compressed mmap files and
+ * compare them, then read a genome several times the size of the cache of
+ * decompressed blocks */
+static void halGenomeMmapCompressedTest(CuTest *testCase) {
+    string path = getTempFile();
+    string compressedPath = getTempFile();
+    try {
+        RandNumberGen rng(false, 42);
+        AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS));
+        createRandomAlignment(rng, alignment, 1.25, 3.0, 4, 8, 2, 50, 10, 100);
+        alignment->close();
+        RandNumberGen compressedRng(false, 42);
+        AlignmentPtr compressedAlignment(
+            mmapAlignmentInstance(compressedPath, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, false, true));
+        createRandomAlignment(compressedRng, compressedAlignment, 1.25, 3.0, 4, 8, 2, 50, 10, 100);
+        compressedAlignment->close();
+
+        AlignmentConstPtr inAlignment(mmapAlignmentInstance(path, READ_ACCESS));
+        AlignmentConstPtr compressedInAlignment(mmapAlignmentInstance(compressedPath, READ_ACCESS));
+        validateAlignment(compressedInAlignment.get());
+        compareAlignments(testCase, inAlignment.get(), compressedInAlignment.get());
+        compressedInAlignment->close();
+        inAlignment->close();
+
+        // compressed files are read-only
+        bool threw = false;
+        try {
+            AlignmentPtr writeAlignment(mmapAlignmentInstance(compressedPath, WRITE_ACCESS));
+        } catch (const hal_exception &e) {
+            threw = true;
+        }
+        CuAssertTrue(testCase, threw);
+
+        // blocks are dropped from the smallest cache and loaded again
+        hal_size_t seqLength = 20000000;
+        string dna = AlignmentTest::randomString(seqLength);
+        compressedAlignment =
+            AlignmentPtr(mmapAlignmentInstance(compressedPath, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, false, true));
+        Genome *genome = compressedAlignment->addRootGenome("Genome", 0);
+        genome->setDimensions(vector<Sequence::Info>(1, Sequence::Info("Sequence", seqLength, 0, 0)));
+        genome->setString(dna);
+        compressedAlignment->close();
+        compressedInAlignment = AlignmentConstPtr(
+            mmapAlignmentInstance(compressedPath, READ_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, false, false, 1));
+        const Genome *compressedGenome = compressedInAlignment->openGenome("Genome");
+        string genomeString;
+        for (int pass = 0; pass < 2; ++pass) {
+            compressedGenome->getString(genomeString);
+            CuAssertTrue(testCase, genomeString == dna);
+        }
+        for (hal_size_t end = seqLength; end >= 1000; end -= 999983) {
+            compressedGenome->getSubString(genomeString, end - 1000, 1000);
+            CuAssertTrue(testCase, genomeString == dna.substr(end - 1000, 1000));
+        }
+        compressedInAlignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+    ::unlink(compressedPath.c_str());
+}
+
+static void halGenomeConvertTest(CuTest *testCase) {
+    string path = getTempFile();
+    string mmapPath = getTempFile();
+    string hdf5Path = getTempFile();
+    try {
+        RandNumberGen rng(false, 7);
+        AlignmentPtr alignment(getTestAlignmentInstances(STORAGE_FORMAT_HDF5, path, CREATE_ACCESS));
+        createRandomAlignment(rng, alignment, 1.25, 3.0, 4, 8, 2, 50, 10, 100);
+        alignment->close();
+
+        // to packed and compacted mmap, then back to hdf5
+        AlignmentConstPtr inAlignment(getTestAlignmentInstances(STORAGE_FORMAT_HDF5, path, READ_ACCESS));
+        AlignmentPtr mmapAlignment(mmapAlignmentInstance(mmapPath, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, true, true));
+        ConvertStats stats = convertAlignment(inAlignment.get(), mmapAlignment.get(), 4);
+        CuAssertTrue(testCase, stats.numGenomes == inAlignment->getNumGenomes());
+        mmapAlignment->close();
+        AlignmentConstPtr mmapInAlignment(mmapAlignmentInstance(mmapPath, READ_ACCESS));
+        AlignmentPtr hdf5Alignment(getTestAlignmentInstances(STORAGE_FORMAT_HDF5, hdf5Path, CREATE_ACCESS));
+        convertAlignment(mmapInAlignment.get(), hdf5Alignment.get(), 4);
+        hdf5Alignment->close();
+        AlignmentConstPtr hdf5InAlignment(getTestAlignmentInstances(STORAGE_FORMAT_HDF5, hdf5Path, READ_ACCESS));
+
+        validateAlignment(mmapInAlignment.get());
+        validateAlignment(hdf5InAlignment.get());
+        compareAlignments(testCase, inAlignment.get(), mmapInAlignment.get());
+        compareAlignments(testCase, inAlignment.get(), hdf5InAlignment.get());
+        hdf5InAlignment->close();
+        mmapInAlignment->close();
+        inAlignment->close();
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+    ::unlink(mmapPath.c_str());
+    ::unlink(hdf5Path.c_str());
+}
+
+/* Read an hdf5 alignment stored in small chunks with read-ahead, which is on
+ * by default, and compare it forwards, backwards and at random with the same
+ * alignment loaded in memory, which isn't read ahead */
+static void halGenomeHdf5ReadAheadTest(CuTest *testCase) {
+    string path = getTempFile();
+    try {
+        H5::DSetCreatPropList dcprops;
+        dcprops.copy(hdf5DefaultDSetCreatPropList());
+        hsize_t chunkSize = 20;
+        dcprops.setChunk(1, &chunkSize);
+        RandNumberGen rng(false, 11);
+        AlignmentPtr alignment(
+            hdf5AlignmentInstance(path, CREATE_ACCESS, hdf5DefaultFileCreatPropList(), hdf5DefaultFileAccPropList(), dcprops));
+        createRandomAlignment(rng, alignment, 1.25, 3.0, 4, 8, 2, 50, 10, 100);
+        alignment->close();
+
+        AlignmentConstPtr readAheadAlignment(getTestAlignmentInstances(STORAGE_FORMAT_HDF5, path, READ_ACCESS));
+        AlignmentConstPtr memoryAlignment(hdf5AlignmentInstance(path, READ_ACCESS, hdf5DefaultFileCreatPropList(),
+                                                                hdf5DefaultFileAccPropList(), hdf5DefaultDSetCreatPropList(), true));
+        compareAlignments(testCase, memoryAlignment.get(), readAheadAlignment.get());
+
+        deque<string> names(1, memoryAlignment->getRootName());
+        while (!names.empty()) {
+            const Genome *genome = readAheadAlignment->openGenome(names.front());
+            const Genome *memoryGenome = memoryAlignment->openGenome(names.front());
+            for (const string &childName : memoryAlignment->getChildNames(names.front())) {
+                names.push_back(childName);
+            }
+            names.pop_front();
+            hal_size_t numTop = genome->getNumTopSegments();
+            if (numTop > 0) {
+                TopSegmentIteratorPtr top = genome->getTopSegmentIterator(numTop - 1);
+                TopSegmentIteratorPtr memoryTop = memoryGenome->getTopSegmentIterator(numTop - 1);
+                for (; !top->atEnd(); top->toLeft(), memoryTop->toLeft()) {
+                    CuAssertTrue(testCase, top->getStartPosition() == memoryTop->getStartPosition());
+                    CuAssertTrue(testCase, top->tseg()->getParentIndex() == memoryTop->tseg()->getParentIndex());
+                }
+                for (int i = 0; i < 500; ++i) {
+                    hal_index_t index = rng.getRandInt(0, numTop - 1);
+                    top = genome->getTopSegmentIterator(index);
+                    memoryTop = memoryGenome->getTopSegmentIterator(index);
+                    CuAssertTrue(testCase, top->getStartPosition() == memoryTop->getStartPosition());
+                    CuAssertTrue(testCase, top->getLength() == memoryTop->getLength());
+                }
+            }
+            hal_size_t length = genome->getSequenceLength();
+            string dna, memoryDna;
+            for (int i = 0; i < 500 && length > 10; ++i) {
+                hal_size_t start = rng.getRandInt(0, length - 10);
+                genome->getSubString(dna, start, 10);
+                memoryGenome->getSubString(memoryDna, start, 10);
+                CuAssertTrue(testCase, dna == memoryDna);
+            }
+        }
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    ::unlink(path.c_str());
+}
+
+/* genome state whose memory is a byte count, for checking eviction order */
+struct BudgetTestClient : public GenomeMemoryBudget::Client {
+    BudgetTestClient(hal_size_t bytes) : _bytes(bytes), _numReleases(0) {
+    }
+    hal_size_t getResidentBytes() const {
+        return _bytes;
+    }
+    void releaseMemory() {
+        _bytes = 0;
+        ++_numReleases;
+    }
+    hal_size_t _bytes;
+    hal_size_t _numReleases;
+};
+
+static void halGenomeMemoryBudgetLruTest(CuTest *testCase) {
+    GenomeMemoryBudget budget(100);
+    BudgetTestClient a(40), b(40), c(40);
+    budget.touch(&a);
+    budget.touch(&b);
+    budget.touch(&a);
+    // b is the least recently used
+    budget.touch(&c);
+    CuAssertTrue(testCase, a._numReleases == 0 && b._numReleases == 1 && c._numReleases == 0);
+    GenomeMemoryStats stats = budget.getStats();
+    CuAssertTrue(testCase, stats.residentBytes == 80 && stats.peakResidentBytes == 120);
+    CuAssertTrue(testCase, stats.numResidentGenomes == 2 && stats.numEvictions == 1 && stats.evictedBytes == 40);
+
+    // a client larger than the budget is kept while it is being used
+    c._bytes = 150;
+    budget.touch(&c);
+    CuAssertTrue(testCase, a._numReleases == 1 && c._numReleases == 0);
+    budget.remove(&c);
+    stats = budget.getStats();
+    CuAssertTrue(testCase, stats.residentBytes == 0 && stats.numResidentGenomes == 0 && stats.numEvictions == 2);
+
+    // nothing is tracked without a budget unless asked for
+    GenomeMemoryBudget untracked;
+    untracked.touch(&a);
+    CuAssertTrue(testCase, !untracked.isTracking() && untracked.getStats().peakResidentBytes == 0);
+}
+
+/* Read alignments with a budget smaller than a genome, so that every genome
+ * opened evicts the others, and compare them twice with the same alignments
+ * read without a budget, reading the evicted genomes back */
+static void halGenomeMemoryBudgetTest(CuTest *testCase) {
+    for (const string &storageFormat : {STORAGE_FORMAT_HDF5, STORAGE_FORMAT_MMAP}) {
+        string path = getTempFile();
+        try {
+            RandNumberGen rng(false, 19);
+            AlignmentPtr alignment(getTestAlignmentInstances(storageFormat, path, CREATE_ACCESS));
+            createRandomAlignment(rng, alignment, 1.25, 3.0, 3, 4, 20, 50, 30000, 40000);
+            alignment->close();
+
+            CLParser parser(READ_ACCESS);
+            const char *argv[] = {"halGenomeTest", "--genomeMemoryBudget", "1"};
+            parser.parseOptions(3, const_cast<char **>(argv));
+            AlignmentConstPtr budgetAlignment(openHalAlignment(path, &parser));
+            AlignmentConstPtr inAlignment(getTestAlignmentInstances(storageFormat, path, READ_ACCESS));
+            compareAlignments(testCase, inAlignment.get(), budgetAlignment.get());
+            GenomeMemoryStats stats = budgetAlignment->getGenomeMemoryStats();
+            CuAssertTrue(testCase, stats.budgetBytes == 1024 * 1024);
+            CuAssertTrue(testCase, stats.numEvictions > 0 && stats.evictedBytes > 0);
+            CuAssertTrue(testCase, stats.numResidentGenomes == 1 && stats.residentBytes <= stats.peakResidentBytes);
+            compareAlignments(testCase, inAlignment.get(), budgetAlignment.get());
+            CuAssertTrue(testCase, budgetAlignment->getGenomeMemoryStats().numEvictions > stats.numEvictions);
+            CuAssertTrue(testCase, inAlignment->getGenomeMemoryStats().numEvictions == 0);
+            budgetAlignment->close();
+            inAlignment->close();
+        } catch (const exception &e) {
+            CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+        }
+        ::unlink(path.c_str());
+    }
+}
+
+/* write size random bytes to path */
+static vector<char> writeBlockCacheTestFile(const string &path, size_t size, unsigned seed) {
+    srand(seed);
+    vector<char> data(size);
+    for (char &c : data) {
+        c = rand() % 256;
+    }
+    ofstream(path.c_str(), ios::binary | ios::trunc).write(data.data(), data.size());
+    return data;
+}
+
+/* entries in a block cache directory, deleted if requested */
+static size_t countBlockCacheEntries(const string &cacheDir, bool remove = false) {
+    size_t count = 0;
+    DIR *dir = opendir(cacheDir.c_str());
+    for (struct dirent *entry = (dir == NULL) ? NULL : readdir(dir); entry != NULL; entry = readdir(dir)) {
+        string name = entry->d_name;
+        if ((name != ".") && (name != "..")) {
+            ++count;
+            if (remove) {
+                for (const char *file : {"info", "data", "blocks"}) {
+                    ::unlink((cacheDir + "/" + name + "/" + file).c_str());
+                }
+                ::rmdir((cacheDir + "/" + name).c_str());
+            }
+        }
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    if (remove) {
+        ::rmdir(cacheDir.c_str());
+    }
+    return count;
+}
+
+static void halGenomeLocalBlockCacheTest(CuTest *testCase) {
+    string path = getTempFile();
+    string otherPath = getTempFile();
+    string cacheDir = string(getTempFile()) + ".cache";
+    try {
+        LocalBlockCacheConfig config;
+        config.dir = cacheDir;
+        config.blockSize = 4096;
+        vector<char> data = writeBlockCacheTestFile(path, 100000, 1);
+        vector<char> buf(100000);
+        {
+            LocalBlockCache cache(path, config);
+            CuAssertTrue(testCase, cache.getFileSize() == data.size());
+            cache.read(buf.data(), 10000, 5000);
+            CuAssertTrue(testCase, memcmp(buf.data(), data.data() + 5000, 10000) == 0);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 3);
+            // zeros past the end
+            cache.read(buf.data(), 1000, 99500);
+            CuAssertTrue(testCase, memcmp(buf.data(), data.data() + 99500, 500) == 0);
+            CuAssertTrue(testCase, count(buf.begin() + 500, buf.begin() + 1000, 0) == 500);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 4);
+        }
+        {
+            // a later open uses the blocks already copied
+            LocalBlockCache cache(path, config);
+            cache.read(buf.data(), 10000, 5000);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 0);
+            cache.read(buf.data(), data.size(), 0);
+            CuAssertTrue(testCase, memcmp(buf.data(), data.data(), data.size()) == 0);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 25 - 4);
+        }
+        {
+            // the copy of a file that changed isn't used
+            data = writeBlockCacheTestFile(path, 90000, 2);
+            LocalBlockCache cache(path, config);
+            CuAssertTrue(testCase, cache.getFileSize() == data.size());
+            cache.read(buf.data(), data.size(), 0);
+            CuAssertTrue(testCase, memcmp(buf.data(), data.data(), data.size()) == 0);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 22);
+        }
+        {
+            // the least recently used copies are deleted to keep within the
+            // size when a file is opened
+            config.maxBytes = 150000;
+            vector<char> otherData = writeBlockCacheTestFile(otherPath, 100000, 3);
+            LocalBlockCache otherCache(otherPath, config);
+            otherCache.read(buf.data(), otherData.size(), 0);
+            CuAssertTrue(testCase, memcmp(buf.data(), otherData.data(), otherData.size()) == 0);
+            CuAssertTrue(testCase, countBlockCacheEntries(cacheDir) == 2);
+            LocalBlockCache cache(path, config);
+            CuAssertTrue(testCase, countBlockCacheEntries(cacheDir) == 1);
+            cache.read(buf.data(), data.size(), 0);
+            CuAssertTrue(testCase, memcmp(buf.data(), data.data(), data.size()) == 0);
+            CuAssertTrue(testCase, cache.getNumFetchedBlocks() == 0);
+            // reading a deleted copy still works
+            otherCache.read(buf.data(), otherData.size(), 0);
+            CuAssertTrue(testCase, memcmp(buf.data(), otherData.data(), otherData.size()) == 0);
+        }
+    } catch (const exception &e) {
+        CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+    }
+    countBlockCacheEntries(cacheDir, true);
+    ::unlink(path.c_str());
+    ::unlink(otherPath.c_str());
+}
+
+static void halGenomeBlockCacheTest(CuTest *testCase) {
+    for (const string &storageFormat : {STORAGE_FORMAT_HDF5, STORAGE_FORMAT_MMAP, string("compressed")}) {
+        string path = getTempFile();
+        string cacheDir = string(getTempFile()) + ".cache";
+        try {
+            RandNumberGen rng(false, 23);
+            AlignmentPtr alignment;
+            if (storageFormat == "compressed") {
+                alignment = AlignmentPtr(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, false, true));
+            } else {
+                alignment = getTestAlignmentInstances(storageFormat, path, CREATE_ACCESS);
+            }
+            createRandomAlignment(rng, alignment, 1.25, 3.0, 3, 4, 20, 50, 3000, 4000);
+            alignment->close();
+
+            CLParser parser(READ_ACCESS);
+            const char *argv[] = {"halGenomeTest", "--blockCacheDir", cacheDir.c_str(), "--blockCacheBlockSize", "4"};
+            parser.parseOptions(5, const_cast<char **>(argv));
+            AlignmentConstPtr inAlignment(openHalAlignment(path, NULL));
+            for (int pass = 0; pass < 2; ++pass) {
+                // copied to the cache, then read from it
+                AlignmentConstPtr cachedAlignment(openHalAlignment(path, &parser));
+                compareAlignments(testCase, inAlignment.get(), cachedAlignment.get());
+                cachedAlignment->close();
+                CuAssertTrue(testCase, countBlockCacheEntries(cacheDir) == 1);
+            }
+            inAlignment->close();
+        } catch (const exception &e) {
+            CuFail(testCase, stString_print("Caught exception while testing: %s", e.what()));
+        }
+        countBlockCacheEntries(cacheDir, true);
+        ::unlink(path.c_str());
+    }
+}
+
 static CuSuite *halGenomeTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, halGenomeMetaTest);
@@ -581,6 +1300,18 @@ static CuSuite *halGenomeTestSuite(void) {
     SUITE_ADD_TEST(suite, halGenomeCopyTest);
     SUITE_ADD_TEST(suite, halGenomeCopySegmentsWhenSequencesOutOfOrderTest);
     SUITE_ADD_TEST(suite, halGenomeDNAPackUnpackTest);
+    SUITE_ADD_TEST(suite, halGenomeDnaKernelTest);
+    SUITE_ADD_TEST(suite, halGenomeBulkDnaTest);
+    SUITE_ADD_TEST(suite, halGenomeMmapGrowTest);
+    SUITE_ADD_TEST(suite, halGenomeMmapPackedDnaTest);
+    SUITE_ADD_TEST(suite, halGenomeMmapCompactSegmentsTest);
+    SUITE_ADD_TEST(suite, halGenomeMmapCompressedTest);
+    SUITE_ADD_TEST(suite, halGenomeConvertTest);
+    SUITE_ADD_TEST(suite, halGenomeHdf5ReadAheadTest);
+    SUITE_ADD_TEST(suite, halGenomeMemoryBudgetLruTest);
+    SUITE_ADD_TEST(suite, halGenomeMemoryBudgetTest);
+    SUITE_ADD_TEST(suite, halGenomeLocalBlockCacheTest);
+    SUITE_ADD_TEST(suite, halGenomeBlockCacheTest);
     return suite;
 }
 
@@ -14,6 +14,7 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 using namespace std;
@@ -796,6 +797,144 @@ struct MappedSegmentColCompareTest3 : public MappedSegmentColCompareTest {
     }
 };
 
+/* map random slices of every segment, in both orientations, with and without
+ * a cache and check that the results are the same */
+struct MappedSegmentCacheTest : virtual public AlignmentTest {
+    void createCallBack(AlignmentPtr alignment) {
+        createRandomAlignment(rng, alignment, 1.25, 0.7, 4, 8, 2, 50, 10, 100);
+    }
+
+    static string mappingString(const MappedSegmentSet &results) {
+        ostringstream os;
+        for (MappedSegmentSet::const_iterator i = results.begin(); i != results.end(); ++i) {
+            const SlicedSegment *source = (*i)->getSource();
+            os << source->getGenome()->getName() << ":" << source->getStartPosition() << "-" << source->getEndPosition()
+               << " " << (*i)->getGenome()->getName() << ":" << (*i)->getStartPosition() << "-" << (*i)->getEndPosition()
+               << ",";
+        }
+        return os.str();
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        set<const Genome *> genomeSet;
+        hal::getGenomesInSubTree(alignment->openGenome(alignment->getRootName()), genomeSet);
+        SegmentMapperCache cache;
+        // small enough that entries are evicted
+        SegmentMapperCache smallCache(10);
+        hal_size_t numCalls = 0;
+        for (set<const Genome *>::iterator i = genomeSet.begin(); i != genomeSet.end(); ++i) {
+            const Genome *srcGenome = *i;
+            if (srcGenome->getSequenceLength() == 0) {
+                continue;
+            }
+            bool top = srcGenome->getNumTopSegments() > 0;
+            hal_index_t numSegs = top ? srcGenome->getNumTopSegments() : srcGenome->getNumBottomSegments();
+            for (set<const Genome *>::iterator j = genomeSet.begin(); j != genomeSet.end(); ++j) {
+                const Genome *tgtGenome = *j;
+                for (hal_index_t segIdx = 0; segIdx < numSegs; ++segIdx) {
+                    // each segment is mapped twice so that there are hits
+                    for (size_t k = 0; k < 2; ++k) {
+                        SegmentIteratorPtr slicedSeg;
+                        if (top) {
+                            slicedSeg = srcGenome->getTopSegmentIterator(segIdx);
+                        } else {
+                            slicedSeg = srcGenome->getBottomSegmentIterator(segIdx);
+                        }
+                        hal_size_t length = slicedSeg->getLength();
+                        hal_offset_t startOffset = rng.getRandInt(0, length - 1);
+                        hal_offset_t endOffset = rng.getRandInt(0, length - 1 - startOffset);
+                        slicedSeg->slice(startOffset, endOffset);
+                        if (rng.getRand() < 0.5) {
+                            slicedSeg->toReverseInPlace();
+                        }
+                        bool doDupes = rng.getRand() < 0.5;
+
+                        MappedSegmentSet expected;
+                        halMapSegmentSP(slicedSeg, expected, tgtGenome, NULL, doDupes);
+                        MappedSegmentSet results;
+                        halMapSegmentSP(slicedSeg, results, tgtGenome, NULL, doDupes, 0, NULL, NULL, &cache);
+                        CuAssertStrEquals(_testCase, mappingString(expected).c_str(), mappingString(results).c_str());
+                        MappedSegmentSet smallResults;
+                        halMapSegmentSP(slicedSeg, smallResults, tgtGenome, NULL, doDupes, 0, NULL, NULL, &smallCache);
+                        CuAssertStrEquals(_testCase, mappingString(expected).c_str(), mappingString(smallResults).c_str());
+                        ++numCalls;
+                    }
+                }
+            }
+        }
+        CuAssertTrue(_testCase, cache.getNumHits() + cache.getNumMisses() == numCalls);
+        CuAssertTrue(_testCase, cache.getNumHits() > 0);
+        CuAssertTrue(_testCase, smallCache.getNumHits() + smallCache.getNumMisses() == numCalls);
+        CuAssertTrue(_testCase, smallCache.getNumMisses() >= cache.getNumMisses());
+
+        cache.clear();
+        CuAssertTrue(_testCase, cache.getSize() == 0);
+        cache.resetCounters();
+        CuAssertTrue(_testCase, cache.getNumHits() == 0 && cache.getNumMisses() == 0);
+    }
+};
+
+// one mapper per genome pair, reused for every segment, must give the same
+// results as separate halMapSegment calls
+struct SegmentMapperReuseTest : public MappedSegmentCacheTest {
+    void checkCallBack(AlignmentConstPtr alignment) {
+        set<const Genome *> genomeSet;
+        hal::getGenomesInSubTree(alignment->openGenome(alignment->getRootName()), genomeSet);
+        for (set<const Genome *>::iterator i = genomeSet.begin(); i != genomeSet.end(); ++i) {
+            const Genome *srcGenome = *i;
+            if (srcGenome->getSequenceLength() == 0) {
+                continue;
+            }
+            bool top = srcGenome->getNumTopSegments() > 0;
+            hal_index_t numSegs = top ? srcGenome->getNumTopSegments() : srcGenome->getNumBottomSegments();
+            for (set<const Genome *>::iterator j = genomeSet.begin(); j != genomeSet.end(); ++j) {
+                const Genome *tgtGenome = *j;
+                for (size_t k = 0; k < 2; ++k) {
+                    bool doDupes = k == 0;
+                    SegmentMapper mapper(srcGenome, tgtGenome, NULL, doDupes);
+                    SegmentMapperCache cache;
+                    SegmentMapper cachedMapper(srcGenome, tgtGenome, NULL, doDupes);
+                    cachedMapper.setCache(&cache);
+                    for (hal_index_t segIdx = 0; segIdx < numSegs; ++segIdx) {
+                        SegmentIteratorPtr seg;
+                        if (top) {
+                            seg = srcGenome->getTopSegmentIterator(segIdx);
+                        } else {
+                            seg = srcGenome->getBottomSegmentIterator(segIdx);
+                        }
+                        if (rng.getRand() < 0.5) {
+                            seg->toReverseInPlace();
+                        }
+                        MappedSegmentSet expected;
+                        halMapSegmentSP(seg, expected, tgtGenome, NULL, doDupes);
+                        MappedSegmentSet results;
+                        CuAssertTrue(_testCase, mapper.map(seg, results) == expected.size());
+                        CuAssertStrEquals(_testCase, mappingString(expected).c_str(), mappingString(results).c_str());
+                        MappedSegmentSet cachedResults;
+                        cachedMapper.map(seg, cachedResults);
+                        CuAssertStrEquals(_testCase, mappingString(expected).c_str(),
+                                          mappingString(cachedResults).c_str());
+                    }
+                }
+            }
+        }
+
+        // segments of other genomes are refused
+        const Genome *root = alignment->openGenome(alignment->getRootName());
+        if (root->getNumChildren() > 0 && root->getNumBottomSegments() > 0) {
+            SegmentMapper mapper(root->getChild(0), root);
+            MappedSegmentSet results;
+            bool threw = false;
+            try {
+                mapper.map(root->getBottomSegmentIterator(), results);
+            } catch (const hal_exception &) {
+                threw = true;
+            }
+            CuAssertTrue(_testCase, threw);
+        }
+    }
+};
+
 static void halMappedSegmentMapUpTest(CuTest *testCase) {
     MappedSegmentMapUpTest tester;
     tester.check(testCase);
@@ -851,6 +990,16 @@ static void halMappedSegmentColCompareTest3(CuTest *testCase) {
     tester.check(testCase);
 }
 
+static void halMappedSegmentCacheTest(CuTest *testCase) {
+    MappedSegmentCacheTest tester;
+    tester.check(testCase);
+}
+
+static void halMappedSegmentMapperReuseTest(CuTest *testCase) {
+    SegmentMapperReuseTest tester;
+    tester.check(testCase);
+}
+
 static CuSuite *halMappedSegmentTestSuite(void) {
     CuSuite *suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, halMappedSegmentMapExtraParalogsTest);
@@ -862,6 +1011,8 @@ static CuSuite *halMappedSegmentTestSuite(void) {
     SUITE_ADD_TEST(suite, halMappedSegmentColCompareTestCheck1);
     SUITE_ADD_TEST(suite, halMappedSegmentColCompareTestCheck2);
     SUITE_ADD_TEST(suite, halMappedSegmentColCompareTest1);
+    SUITE_ADD_TEST(suite, halMappedSegmentCacheTest);
+    SUITE_ADD_TEST(suite, halMappedSegmentMapperReuseTest);
     // FIXME: why are these disabled?
     if (false) {
         SUITE_ADD_TEST(suite, halMappedSegmentColCompareTest2);
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "halApiTestSupport.h"
+#include "halColumnIterator.h"
+#include "halDnaIterator.h"
+#include "halRandNumberGen.h"
+#include "halRandomData.h"
+#include "halTopSegmentIterator.h"
+#include <deque>
+#include <sstream>
+#include <string>
+#include <thread>
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+static RandNumberGen rng;
+
+static const size_t NUM_THREADS = 8;
+
+/* list all genomes in the alignment, in breadth-first order */
+static vector<string> getGenomeNames(const Alignment *alignment) {
+    vector<string> names;
+    deque<string> bfQueue(1, alignment->getRootName());
+    while (not bfQueue.empty()) {
+        names.push_back(bfQueue.front());
+        vector<string> childNames = alignment->getChildNames(bfQueue.front());
+        bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+        bfQueue.pop_front();
+    }
+    return names;
+}
+
+/* summarize a genome by walking its sequences, segments and columns.  Column
+ * iteration opens neighbouring genomes, so this exercises the lazy genome and
+ * sequence caches. */
+static string getGenomeSummary(const Alignment *alignment, const string &genomeName) {
+    ostringstream os;
+    const Genome *genome = alignment->openGenome(genomeName);
+    for (SequenceIteratorPtr seqIt = genome->getSequenceIterator(); not seqIt->atEnd(); seqIt->toNext()) {
+        const Sequence *sequence = seqIt->getSequence();
+        string dna;
+        sequence->getString(dna);
+        os << sequence->getName() << " " << sequence->getStartPosition() << " " << dna << "\n";
+    }
+    if (genome->getParent() != NULL) {
+        for (TopSegmentIteratorPtr topIt = genome->getTopSegmentIterator(); not topIt->atEnd(); topIt->toRight()) {
+            os << topIt->getStartPosition() << "," << topIt->tseg()->getParentIndex() << ","
+               << topIt->tseg()->getParentReversed() << " ";
+        }
+        os << "\n";
+    }
+    if (genome->getSequenceLength() > 0) {
+        hal_index_t lastPosition = min((hal_index_t)genome->getSequenceLength(), (hal_index_t)200) - 1;
+        ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0, lastPosition);
+        while (true) {
+            const ColumnIterator::ColumnMap *colMap = colIt->getColumnMap();
+            for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin(); i != colMap->end(); ++i) {
+                for (ColumnIterator::DNASet::const_iterator dnaIt = i->second->begin(); dnaIt != i->second->end(); ++dnaIt) {
+                    os << i->first->getFullName() << ":" << (*dnaIt)->getArrayIndex() << (*dnaIt)->getBase() << " ";
+                }
+            }
+            os << "\n";
+            if (colIt->lastColumn()) {
+                break;
+            }
+            colIt->toRight();
+        }
+    }
+    return os.str();
+}
+
+/* summarize every genome, starting at a different genome in each thread so
+ * the threads open genomes in different orders */
+static void summarizeGenomes(const Alignment *alignment, const vector<string> *genomeNames, size_t first,
+                             vector<string> *summaries, string *error) {
+    try {
+        for (size_t i = 0; i < genomeNames->size(); ++i) {
+            size_t j = (first + i) % genomeNames->size();
+            (*summaries)[j] = getGenomeSummary(alignment, (*genomeNames)[j]);
+        }
+    } catch (const exception &e) {
+        *error = e.what();
+    }
+}
+
+struct MMapThreadReadTest : public AlignmentTest {
+    void createCallBack(AlignmentPtr alignment) {
+        createRandomAlignment(rng, alignment, 1.25, 0.7, 10, 20, 2, 50, 10, 100);
+    }
+
+    void checkCallBack(AlignmentConstPtr alignment) {
+        // only mmap alignments can be shared between threads
+        if (alignment->getStorageFormat() != STORAGE_FORMAT_MMAP) {
+            return;
+        }
+        vector<string> genomeNames = getGenomeNames(alignment.get());
+        vector<string> expected(genomeNames.size());
+        for (size_t i = 0; i < genomeNames.size(); ++i) {
+            expected[i] = getGenomeSummary(alignment.get(), genomeNames[i]);
+        }
+
+        // use a freshly opened alignment so that all caches start out empty
+        AlignmentPtr sharedAlignment(getTestAlignmentInstances(STORAGE_FORMAT_MMAP, _checkPath, READ_ACCESS));
+        vector<vector<string>> summaries(NUM_THREADS, vector<string>(genomeNames.size()));
+        vector<string> errors(NUM_THREADS);
+        vector<thread> threads;
+        for (size_t t = 0; t < NUM_THREADS; ++t) {
+            threads.push_back(thread(summarizeGenomes, sharedAlignment.get(), &genomeNames, t, &summaries[t], &errors[t]));
+        }
+        for (size_t t = 0; t < NUM_THREADS; ++t) {
+            threads[t].join();
+        }
+        for (size_t t = 0; t < NUM_THREADS; ++t) {
+            CuAssertStrEquals(_testCase, "", errors[t].c_str());
+            for (size_t i = 0; i < genomeNames.size(); ++i) {
+                CuAssertTrue(_testCase, summaries[t][i] == expected[i]);
+            }
+        }
+        sharedAlignment->close();
+    }
+};
+
+static void halMMapThreadReadTest(CuTest *testCase) {
+    MMapThreadReadTest tester;
+    tester.check(testCase);
+}
+
+static CuSuite *halThreadTestSuite(void) {
+    CuSuite *suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, halMMapThreadReadTest);
+    return suite;
+}
+
+int main(int argc, char *argv[]) {
+    return runHalTestSuite(argc, argv, halThreadTestSuite());
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "hal.h"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace hal;
+
+// compares an alignment stored as HDF5, as an mmap file and as a compressed
+// mmap file.  the files are made from the same alignment with
+//     halExtract --outputFormat mmap in.hal plain.hal
+//     halExtract --outputFormat mmap --mmapCompress in.hal compressed.hal
+// reports the file sizes and the rate of random queries, each reading a
+// short substring of a random genome and the segments overlapping it.  the
+// file is evicted from the page cache and opened, then the queries are run
+// once (cold) and again (warm).  the cache of decompressed blocks is the
+// default size unless given in megabytes.
+// h5c++ -O3 -std=c++11 -pthread -I../api/inc -I${sonLibRootDir}/lib compressedMmapBench.cpp ../lib/libHal.a \
+//     ${sonLibRootDir}/lib/sonLib.a -o compressedMmapBench
+
+static const int NUM_QUERIES = 20000;
+static const hal_size_t QUERY_LENGTH = 1000;
+
+/* drop the file from the page cache */
+static void evict(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "can't open " << path << endl;
+        exit(1);
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+static AlignmentConstPtr open(const string &path, size_t cacheBytes) {
+    if (detectHalAlignmentFormat(path) == STORAGE_FORMAT_HDF5) {
+        return AlignmentConstPtr(hdf5AlignmentInstance(path, READ_ACCESS, hdf5DefaultFileCreatPropList(),
+                                                       hdf5DefaultFileAccPropList(), hdf5DefaultDSetCreatPropList()));
+    }
+    return AlignmentConstPtr(mmapAlignmentInstance(path, READ_ACCESS, MMAP_DEFAULT_FILE_SIZE, false, false, false, cacheBytes));
+}
+
+/* run the same queries on each file */
+static double query(const vector<const Genome *> &genomes, hal_size_t &checksum) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    srand(1);
+    checksum = 0;
+    string dna;
+    for (int i = 0; i < NUM_QUERIES; ++i) {
+        const Genome *genome = genomes[rand() % genomes.size()];
+        if (genome->getSequenceLength() <= QUERY_LENGTH) {
+            continue;
+        }
+        hal_index_t position = rand() % (genome->getSequenceLength() - QUERY_LENGTH);
+        genome->getSubString(dna, position, QUERY_LENGTH);
+        checksum += dna[0] + dna[QUERY_LENGTH - 1];
+        if (genome->getNumTopSegments() > 0) {
+            TopSegmentIteratorPtr top = genome->getTopSegmentIterator();
+            top->toSite(position, false);
+            for (; !top->atEnd() && (top->getStartPosition() < position + (hal_index_t)QUERY_LENGTH); top->toRight()) {
+                checksum += top->getLength() + top->tseg()->getParentIndex();
+            }
+        }
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    if ((argc != 4) && (argc != 5)) {
+        cerr << "usage : compressedMmapBench <in.hal> <plain.hal> <compressed.hal> [cacheMegabytes]" << endl;
+        return 1;
+    }
+    size_t cacheBytes = (argc == 5) ? atol(argv[4]) * 1024 * 1024 : MMAP_DEFAULT_CACHE_BYTES;
+    cout << "file, size(bytes), cold queries/s, warm queries/s" << endl;
+    hal_size_t checksums[3];
+    for (int i = 0; i < 3; ++i) {
+        string path = argv[i + 1];
+        struct stat fileStat;
+        stat(path.c_str(), &fileStat);
+        evict(path);
+        AlignmentConstPtr alignment = open(path, cacheBytes);
+        vector<const Genome *> genomes(1, alignment->openGenome(alignment->getRootName()));
+        for (size_t j = 0; j < genomes.size(); ++j) {
+            for (const string &childName : alignment->getChildNames(genomes[j]->getName())) {
+                genomes.push_back(alignment->openGenome(childName));
+            }
+        }
+        double coldSeconds = query(genomes, checksums[i]);
+        double warmSeconds = query(genomes, checksums[i]);
+        cout << path << ", " << fileStat.st_size << ", " << NUM_QUERIES / coldSeconds << ", " << NUM_QUERIES / warmSeconds
+             << endl;
+    }
+    if ((checksums[0] != checksums[1]) || (checksums[1] != checksums[2])) {
+        cerr << "query results don't match" << endl;
+        return 1;
+    }
+    return 0;
+}
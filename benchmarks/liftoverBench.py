@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+
+# Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+#
+#Released under the MIT license, see LICENSE.txt
+
+"""Compare halLiftover throughput (records/second) lifting one line at a time
+against the sorted batch mode (--batchSize)."""
+
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+def runHalGen(halPath, seed):
+    subprocess.check_call(["halRandGen", "--format", "mmap", "--seed", str(seed),
+                           "--minGenomes", "10", "--maxGenomes", "12", "--meanDegree", "1.5",
+                           "--minSegmentLength", "5", "--maxSegmentLength", "40",
+                           "--minSegments", "5000", "--maxSegments", "8000", halPath])
+
+def getSequences(halPath, genome):
+    out = subprocess.check_output(["halStats", "--bedSequences", genome, halPath]).decode()
+    seqs = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) >= 3:
+            seqs.append((fields[0], int(fields[2])))
+    return seqs
+
+def writeBed(bedPath, seqs, numRecords, maxLength, rng):
+    with open(bedPath, "w") as bed:
+        for i in range(numRecords):
+            name, length = rng.choice(seqs)
+            start = rng.randrange(0, length - 1)
+            end = min(length, start + rng.randint(1, maxLength))
+            bed.write("%s\t%d\t%d\tr%d\t0\t%s\n" % (name, start, end, i, rng.choice("+-")))
+
+def timeLiftover(halPath, srcGenome, bedPath, tgtGenome, outPath, options):
+    t = time.time()
+    subprocess.check_call(["halLiftover"] + options + [halPath, srcGenome, bedPath, tgtGenome, outPath])
+    return time.time() - t
+
+def main(argv=None):
+    if argv is None:
+        argv = sys.argv
+
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--hal', type=str, default=None,
+                        help='HAL file to use (default: generate a random one)')
+    parser.add_argument('--srcGenome', type=str, default='Genome_1')
+    parser.add_argument('--tgtGenome', type=str, default='Genome_3')
+    parser.add_argument('--numRecords', type=int, default=100000)
+    parser.add_argument('--maxLength', type=int, default=500,
+                        help='maximum length of a BED record')
+    parser.add_argument('--batchSize', type=int, default=100000)
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args(argv[1:])
+
+    tempDir = tempfile.mkdtemp(dir=".")
+    try:
+        halPath = args.hal
+        if halPath is None:
+            halPath = os.path.join(tempDir, "bench.hal")
+            runHalGen(halPath, args.seed)
+        bedPath = os.path.join(tempDir, "in.bed")
+        writeBed(bedPath, getSequences(halPath, args.srcGenome), args.numRecords, args.maxLength,
+                 random.Random(args.seed))
+
+        lineOut = os.path.join(tempDir, "line.bed")
+        batchOut = os.path.join(tempDir, "batch.bed")
+        lineTime = timeLiftover(halPath, args.srcGenome, bedPath, args.tgtGenome, lineOut, [])
+        batchTime = timeLiftover(halPath, args.srcGenome, bedPath, args.tgtGenome, batchOut,
+                                 ["--batchSize", str(args.batchSize)])
+        with open(lineOut) as f1, open(batchOut) as f2:
+            same = f1.read() == f2.read()
+
+        print("mode, time(s), records/s")
+        print("line, %.3f, %.0f" % (lineTime, args.numRecords / lineTime))
+        print("batch, %.3f, %.0f" % (batchTime, args.numRecords / batchTime))
+        if not same:
+            print("ERROR: batch output differs from line-at-a-time output")
+            return 1
+    finally:
+        shutil.rmtree(tempDir)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "hal.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+using namespace std;
+using namespace hal;
+
+// microbenchmark of the segment mapper and the MappedSegmentSet it fills.  every
+// segment of a source genome is mapped to a target genome, accumulating the
+// results of windows of consecutive segments in one set like blockViz does.
+// run it on a deep, duplication-heavy alignment (ie from halRandGen with small
+// segments) to exercise insertAndBreakOverlaps.  reports wall time and the
+// number of heap allocations.
+// h5c++ -O3 -std=c++11 -pthread -I../api/inc -I${sonLibRootDir}/lib mappedSegmentBench.cpp ../lib/libHal.a \
+//     ${sonLibRootDir}/lib/sonLib.a -o mappedSegmentBench
+
+static atomic<size_t> numAllocs(0);
+
+void *operator new(size_t size) {
+    ++numAllocs;
+    void *p = malloc(size);
+    if (p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4 || argc > 5) {
+        cerr << "usage : mappedSegmentBench <halFile> <srcGenome> <tgtGenome> [windowSegments (default 100)]" << endl;
+        return 1;
+    }
+    size_t window = argc == 5 ? atol(argv[4]) : 100;
+    AlignmentConstPtr alignment(openHalAlignment(argv[1], NULL));
+    const Genome *srcGenome = alignment->openGenome(argv[2]);
+    const Genome *tgtGenome = alignment->openGenome(argv[3]);
+    if (srcGenome == NULL || tgtGenome == NULL || window == 0) {
+        cerr << "invalid genome or window" << endl;
+        return 1;
+    }
+    SegmentIteratorPtr segIt;
+    hal_index_t numSegments;
+    if (srcGenome->getNumTopSegments() > 0) {
+        segIt = srcGenome->getTopSegmentIterator();
+        numSegments = srcGenome->getNumTopSegments();
+    } else {
+        segIt = srcGenome->getBottomSegmentIterator();
+        numSegments = srcGenome->getNumBottomSegments();
+    }
+
+    // the tree is walked once up front, as by the liftover and blockViz mappers
+    SegmentMapper mapper(srcGenome, tgtGenome);
+
+    size_t startAllocs = numAllocs;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    hal_size_t numMapped = 0;
+    MappedSegmentSet results;
+    for (hal_index_t i = 0; i < numSegments; ++i, segIt->toRight()) {
+        if (i % window == 0) {
+            numMapped += results.size();
+            results.clear();
+        }
+        mapper.map(segIt, results);
+    }
+    numMapped += results.size();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "segments, mapped, time(s), allocations" << endl;
+    cout << numSegments << ", " << numMapped << ", " << seconds << ", " << numAllocs - startAllocs << endl;
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "hal.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace hal;
+
+// compares the nibble and packed DNA encodings of mmap files.  a synthetic
+// genome that is mostly ACGT, with runs of N and soft-masked (lowercase) runs
+// like an assembly, is written to a file in each encoding.  reports the file
+// sizes, the throughput of reading the whole genome and the rate of random
+// reads of short substrings.
+// h5c++ -O3 -std=c++11 -pthread -I../api/inc -I${sonLibRootDir}/lib packedDnaBench.cpp ../lib/libHal.a \
+//     ${sonLibRootDir}/lib/sonLib.a -o packedDnaBench
+
+static string makeDna(hal_size_t length) {
+    static const char bases[] = "ACGT";
+    string dna(length, 'A');
+    for (hal_size_t i = 0; i < length; ++i) {
+        dna[i] = bases[rand() % 4];
+    }
+    // about half is soft-masked, in runs of up to 5kb
+    for (hal_size_t i = 0; i < length; i += rand() % 10000) {
+        for (hal_size_t j = i, end = min(length, i + rand() % 5000); j < end; ++j) {
+            dna[j] = tolower(dna[j]);
+        }
+    }
+    // a few percent is N, in gaps of up to 50kb
+    for (hal_size_t i = 0; i < length; i += 100000 + rand() % 1000000) {
+        for (hal_size_t j = i, end = min(length, i + rand() % 50000); j < end; ++j) {
+            dna[j] = 'N';
+        }
+    }
+    return dna;
+}
+
+static void writeFile(const string &path, const string &dna, bool packDna) {
+    AlignmentPtr alignment(mmapAlignmentInstance(path, CREATE_ACCESS, MMAP_DEFAULT_FILE_SIZE, packDna));
+    Genome *genome = alignment->addRootGenome("Genome", 0);
+    vector<Sequence::Info> seqVec(1, Sequence::Info("Sequence", dna.length(), 0, 0));
+    genome->setDimensions(seqVec);
+    genome->setString(dna);
+    alignment->closeGenome(genome);
+    alignment->close();
+}
+
+static void readFile(const string &path, const string &dna, size_t numReads, size_t readLength) {
+    struct stat fileStat;
+    stat(path.c_str(), &fileStat);
+    AlignmentConstPtr alignment(mmapAlignmentInstance(path, READ_ACCESS));
+    const Genome *genome = alignment->openGenome("Genome");
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    string genomeString;
+    genome->getString(genomeString);
+    double sequentialSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (genomeString != dna) {
+        cerr << path << ": DNA doesn't match" << endl;
+        exit(1);
+    }
+
+    start = chrono::steady_clock::now();
+    string read;
+    size_t numN = 0;
+    for (size_t i = 0; i < numReads; ++i) {
+        genome->getSubString(read, rand() % (dna.length() - readLength), readLength);
+        numN += read[0] == 'N';
+    }
+    double randomSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << path << ", " << fileStat.st_size << ", " << dna.length() / sequentialSeconds / 1e6 << ", "
+         << numReads / randomSeconds << endl;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 4) {
+        cerr << "usage : packedDnaBench <outPrefix> [length (default 100000000)] [randomReads (default 100000)]" << endl;
+        return 1;
+    }
+    string prefix = argv[1];
+    hal_size_t length = argc > 2 ? atol(argv[2]) : 100000000;
+    size_t numReads = argc > 3 ? atol(argv[3]) : 100000;
+    string dna = makeDna(length);
+
+    cout << "file, size(bytes), sequential(Mbases/s), random 100bp reads/s" << endl;
+    string nibblePath = prefix + ".nibble.hal";
+    string packedPath = prefix + ".packed.hal";
+    writeFile(nibblePath, dna, false);
+    writeFile(packedPath, dna, true);
+    readFile(nibblePath, dna, numReads, 100);
+    readFile(packedPath, dna, numReads, 100);
+    ::unlink(nibblePath.c_str());
+    ::unlink(packedPath.c_str());
+    return 0;
+}
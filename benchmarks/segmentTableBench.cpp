@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include "hal.h"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace hal;
+
+// compares mmap files with plain and compact (MMapSegmentTable) segment
+// arrays.  the files are made from the same alignment with
+//     halExtract --outputFormat mmap in.hal plain.hal
+//     halExtract --outputFormat mmap --mmapCompactSegments in.hal compact.hal
+// reports the file sizes and the time to scan every top and bottom segment of
+// every genome, reading their coordinates, parent and child indexes and
+// orientations, with the file evicted from the page cache first (cold) and
+// again with it cached (warm).
+// h5c++ -O3 -std=c++11 -pthread -I../api/inc -I${sonLibRootDir}/lib segmentTableBench.cpp ../lib/libHal.a \
+//     ${sonLibRootDir}/lib/sonLib.a -o segmentTableBench
+
+/* drop the file from the page cache */
+static void evict(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "can't open " << path << endl;
+        exit(1);
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+static hal_size_t scanGenome(const Genome *genome) {
+    hal_size_t checksum = 0;
+    for (TopSegmentIteratorPtr top = genome->getTopSegmentIterator(); !top->atEnd(); top->toRight()) {
+        checksum += top->getLength() + top->tseg()->getParentIndex() + top->tseg()->getParentReversed();
+    }
+    hal_size_t numChildren = genome->getNumChildren();
+    for (BottomSegmentIteratorPtr bottom = genome->getBottomSegmentIterator(); !bottom->atEnd(); bottom->toRight()) {
+        checksum += bottom->getLength();
+        for (hal_size_t child = 0; child < numChildren; ++child) {
+            checksum += bottom->bseg()->getChildIndex(child) + bottom->bseg()->getChildReversed(child);
+        }
+    }
+    return checksum;
+}
+
+static double scan(const string &path, hal_size_t &checksum) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    AlignmentConstPtr alignment(mmapAlignmentInstance(path, READ_ACCESS));
+    checksum = 0;
+    vector<string> names(1, alignment->getRootName());
+    for (size_t i = 0; i < names.size(); ++i) {
+        checksum += scanGenome(alignment->openGenome(names[i]));
+        for (const string &childName : alignment->getChildNames(names[i])) {
+            names.push_back(childName);
+        }
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        cerr << "usage : segmentTableBench <plain.hal> <compact.hal>" << endl;
+        return 1;
+    }
+    cout << "file, size(bytes), cold scan(s), warm scan(s)" << endl;
+    hal_size_t checksums[2];
+    for (int i = 0; i < 2; ++i) {
+        string path = argv[i + 1];
+        struct stat fileStat;
+        stat(path.c_str(), &fileStat);
+        evict(path);
+        double coldSeconds = scan(path, checksums[i]);
+        double warmSeconds = scan(path, checksums[i]);
+        cout << path << ", " << fileStat.st_size << ", " << coldSeconds << ", " << warmSeconds << endl;
+    }
+    if (checksums[0] != checksums[1]) {
+        cerr << "segments don't match" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -19,44 +19,59 @@
 #include <deque>
 #include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef ENABLE_UDC
-#include <pthread.h>
-static pthread_mutex_t HAL_MUTEX = PTHREAD_MUTEX_INITIALIZER;
-static inline void halLock() {
-    if (pthread_mutex_lock(&HAL_MUTEX) != 0) {
-        throw hal_exception("pthread_mutex_lock failed: " + std::string(std::strerror(errno)));
-    }
-}
-static inline void halUnlock() {
-    if (pthread_mutex_unlock(&HAL_MUTEX) != 0) {
-        throw hal_exception("pthread_mutex_unlock failed: " + std::string(std::strerror(errno)));
-    }
-}
-#else
-static inline void halLock() {
-}
-static inline void halUnlock() {
-}
-#endif
-
 using namespace std;
 using namespace hal;
 
-typedef map<int, pair<string, LodManagerPtr>> HandleMap;
+/* An open HAL or LOD file.  Queries on handles whose alignments can be
+ * shared between threads (mmap files) run concurrently, including on the
+ * same handle.  The HDF5 library is not thread-safe, so queries on all other
+ * handles are serialized by serialMutex. */
+struct HalHandle {
+    string path;
+    LodManagerPtr lodManager;
+    bool shareable;
+};
+typedef shared_ptr<HalHandle> HalHandlePtr;
+typedef map<int, HalHandlePtr> HandleMap;
+
 static HandleMap handleMap;
+// guards handleMap, it is not held during queries
+static mutex handleMapMutex;
+static mutex serialMutex;
+
+/* A handle in use by a query.  The reference keeps the handle open if it is
+ * closed during the query, and the lock is held for handles that are not
+ * shareable.  The reference is released before the lock, so that closing
+ * the alignments is also serialized. */
+class HandleQuery {
+  public:
+    HandleQuery(int handle);
+
+    AlignmentConstPtr getAlignment(hal_size_t queryLength, bool needDNASequence) {
+        return _halHandle->lodManager->getAlignment(queryLength, needDNASequence);
+    }
 
+    bool isLod0(hal_size_t queryLength) const {
+        return _halHandle->lodManager->isLod0(queryLength);
+    }
+
+  private:
+    unique_lock<mutex> _serialLock;
+    HalHandlePtr _halHandle;
+};
+
+static HalHandlePtr findHandle(int handle);
 static int openLodOrHal(char *inputPath, bool isLod, char **errStr);
-static void checkHandle(int handle);
 static void checkGenomes(int halHandle, AlignmentConstPtr alignment, const string &qSpecies, const string &tSpecies,
                          const string &tChrom);
 
-static AlignmentConstPtr getExistingAlignment(int handle, hal_size_t queryLength, bool needSequence);
-static bool isAlignmentLod0(int handle, hal_size_t queryLength);
 static char *copyCString(const string &inString);
 
 static hal_block_results_t *readBlocks(AlignmentConstPtr seqAlignment, const Sequence *tSequence, hal_index_t absStart,
@@ -85,23 +100,17 @@ static void handleError(const string &msg, char **errStr) {
 }
 
 static bool isHalFile(char *lodFilePath) {
-    // must be locked
     return not hal::detectHalAlignmentFormat(lodFilePath).empty();
 }
 
 extern "C" int halOpenHalOrLod(char *lodFilePath, char **errStr) {
-    halLock();
     try {
         bool isHal = isHalFile(lodFilePath);
-        int handle = openLodOrHal(lodFilePath, !isHal, errStr);
-        halUnlock();
-        return handle;
+        return openLodOrHal(lodFilePath, !isHal, errStr);
     } catch (exception &e) {
-        halUnlock();
         handleError("halOpenLodOrHal error: " + string(lodFilePath) + ": " + e.what(), errStr);
         return -1;
     } catch (...) {
-        halUnlock();
         handleError("halOpenLodOrHal error: " + string(lodFilePath) + ": Unknown exception", errStr);
         return -1;
     }
@@ -114,23 +123,21 @@ extern "C" int halOpenLOD(char *lodFilePath, char **errStr) {
 }
 
 extern "C" int halOpen(char *halFilePath, char **errStr) {
-    halLock();
-    try {
-        int handle = openLodOrHal(halFilePath, false, errStr);
-        halUnlock();
-        return handle;
-    } catch (...) {
-        halUnlock();
-        throw;
-    }
+    return openLodOrHal(halFilePath, false, errStr);
 }
 
-static int findOrAllocHandle(char *inputPath) {
+/* find the handle of an open path, or -1, must be locked */
+static int findOpenHandle(const string &inputPath) {
     for (HandleMap::iterator mapIt = handleMap.begin(); mapIt != handleMap.end(); ++mapIt) {
-        if (mapIt->second.first == string(inputPath)) {
+        if (mapIt->second->path == inputPath) {
             return mapIt->first;
         }
     }
+    return -1;
+}
+
+/* must be locked */
+static int allocHandle() {
     HandleMap::reverse_iterator mapIt = handleMap.rbegin();
     if (mapIt == handleMap.rend()) {
         return 0;
@@ -140,15 +147,34 @@ static int findOrAllocHandle(char *inputPath) {
 }
 
 static int openLodOrHal(char *inputPath, bool isLod, char **errStr) {
-    int handle = findOrAllocHandle(inputPath);
     try {
-        LodManagerPtr lodManager(new LodManager());
+        {
+            lock_guard<mutex> mapLock(handleMapMutex);
+            int handle = findOpenHandle(inputPath);
+            if (handle >= 0) {
+                return handle;
+            }
+        }
+        // the alignments are opened by the first query, so no lock is needed
+        // to load the file
+        HalHandlePtr halHandle(new HalHandle());
+        halHandle->path = inputPath;
+        halHandle->lodManager = LodManagerPtr(new LodManager());
         if (isLod == true) {
-            lodManager->loadLODFile(inputPath);
+            halHandle->lodManager->loadLODFile(inputPath);
         } else {
-            lodManager->loadSingeHALFile(inputPath);
+            halHandle->lodManager->loadSingeHALFile(inputPath);
+        }
+        halHandle->shareable = halHandle->lodManager->isShareable();
+
+        lock_guard<mutex> mapLock(handleMapMutex);
+        int handle = findOpenHandle(inputPath);
+        if (handle < 0) {
+            // not opened by another thread in the meantime
+            handle = allocHandle();
+            handleMap.insert(pair<int, HalHandlePtr>(handle, halHandle));
         }
-        handleMap.insert(pair<int, pair<string, LodManagerPtr>>(handle, pair<string, LodManagerPtr>(inputPath, lodManager)));
+        return handle;
     } catch (exception &e) {
         handleError("openLodOrHal error: " + string(inputPath) + ": " + e.what(), errStr);
         return -1;
@@ -156,31 +182,35 @@ static int openLodOrHal(char *inputPath, bool isLod, char **errStr) {
         handleError("openLodOrHal error: " + string(inputPath) + ": Unknown exception", errStr);
         return -1;
     }
-    return handle;
 }
 
 extern "C" int halClose(int handle, char **errStr) {
-    halLock();
-    int ret = 0;
     try {
-        HandleMap::iterator mapIt = handleMap.find(handle);
-        if (mapIt == handleMap.end()) {
-            halUnlock();
-            handleError("halClose error on handle: " + std::to_string(handle) + ": not found", errStr);
-            return -1;
+        HalHandlePtr halHandle;
+        {
+            lock_guard<mutex> mapLock(handleMapMutex);
+            HandleMap::iterator mapIt = handleMap.find(handle);
+            if (mapIt == handleMap.end()) {
+                handleError("halClose error on handle: " + std::to_string(handle) + ": not found", errStr);
+                return -1;
+            }
+            halHandle = mapIt->second;
+            handleMap.erase(mapIt);
+        }
+        // the alignments are closed here, or by the last query still using
+        // the handle
+        if (not halHandle->shareable) {
+            lock_guard<mutex> serialLock(serialMutex);
+            halHandle.reset();
         }
-        handleMap.erase(mapIt);
     } catch (exception &e) {
-        halUnlock();
         handleError("halClose error on handle: " + std::to_string(handle) + ": " + e.what(), errStr);
         return -1;
     } catch (...) {
-        halUnlock();
         handleError("halClose error on handle: " + std::to_string(handle) + ": unknown exception", errStr);
         return -1;
     }
-    halUnlock();
-    return ret;
+    return 0;
 }
 
 extern "C" void halFreeBlockResults(struct hal_block_results_t *results) {
@@ -221,27 +251,24 @@ extern "C" struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
                                                                  hal_seqmode_type_t seqMode, hal_dup_type_t dupMode,
                                                                  int mapBackAdjacencies, const char *coalescenceLimitName,
                                                                  char **errStr) {
-    halLock();
     hal_block_results_t *results = NULL;
     try {
         hal_int_t rangeLength = tEnd - tStart;
         if (rangeLength < 0) {
-            halUnlock();
             handleError("halGetBlocksInTargetRange invalid query range [" + std::to_string(tStart) + "," +
                             std::to_string(tEnd) + ")",
                         errStr);
             return NULL;
         }
         if (tReversed != 0 && mapBackAdjacencies != 0) {
-            halUnlock();
             handleError("halGetBlocksInTargetRange tReversed can only be set when mapBackAdjacencies is 0", errStr);
             return NULL;
         }
         if (tReversed != 0 && dupMode == HAL_QUERY_AND_TARGET_DUPS) {
-            halUnlock();
             handleError("tReversed cannot be set in conjunction with dupMode=HAL_QUERY_AND_TARGET_DUPS", errStr);
             return NULL;
         }
+        HandleQuery query(halHandle);
         bool getSequenceString;
         switch (seqMode) {
         case HAL_NO_SEQUENCE:
@@ -252,10 +279,10 @@ extern "C" struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
             break;
         case HAL_LOD0_SEQUENCE:
         default:
-            getSequenceString = isAlignmentLod0(halHandle, hal_size_t(rangeLength));
+            getSequenceString = query.isLod0(hal_size_t(rangeLength));
         }
 
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, hal_size_t(rangeLength), getSequenceString);
+        AlignmentConstPtr alignment = query.getAlignment(hal_size_t(rangeLength), getSequenceString);
         checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
 
         const Genome *qGenome = alignment->openGenome(qSpecies);
@@ -266,18 +293,16 @@ extern "C" struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
         hal_index_t absStart = tSequence->getStartPosition() + tStart;
         hal_index_t absEnd = tSequence->getStartPosition() + myEnd - 1;
         if (absStart > absEnd) {
-            halUnlock();
             handleError("halGetBlocksInTargetRange invalid range", errStr);
             return NULL;
         }
         if (absEnd > tSequence->getEndPosition()) {
-            halUnlock();
             handleError("halGetBlocksInTargetRange target end position outside of target sequence", errStr);
             return NULL;
         }
         // We now know the query length so we can do a proper lod query
         if (tEnd == 0) {
-            alignment = getExistingAlignment(halHandle, absEnd - absStart, false);
+            alignment = query.getAlignment(absEnd - absStart, false);
             checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
             qGenome = alignment->openGenome(qSpecies);
             tGenome = alignment->openGenome(tSpecies);
@@ -291,22 +316,19 @@ extern "C" struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
             // getting rid of it since it allows us to easily revert back to
             // the previous functionaly of allowing lod-blocks to acces lod-0
             // sequence (FIXME: delete)
-            seqAlignment = getExistingAlignment(halHandle, absEnd - absStart, true);
+            seqAlignment = query.getAlignment(absEnd - absStart, true);
         }
 
         results = readBlocks(seqAlignment, tSequence, absStart, absEnd, tReversed != 0, qGenome, getSequenceString,
                              dupMode != HAL_NO_DUPS, dupMode == HAL_QUERY_AND_TARGET_DUPS, mapBackAdjacencies != 0,
                              coalescenceLimitName);
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetBlocksInTargetRange error reading blocks: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetBlocksInTargetRange error reading blocks: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return results;
 }
 
@@ -382,16 +404,15 @@ halGetBlocksInTargetRange_filterByChrom(int halHandle, char *qSpecies, char *tSp
 extern "C" hal_int_t halGetMaf(FILE *outFile, int halHandle, hal_species_t *qSpeciesNames, char *tSpecies, char *tChrom,
                                hal_int_t tStart, hal_int_t tEnd, int maxRefGap, int maxBlockLength, int doDupes,
                                char **errStr) {
-    halLock();
     hal_int_t numBytes = 0;
     try {
+        HandleQuery query(halHandle);
         hal_int_t rangeLength = tEnd - tStart;
         if (rangeLength < 0) {
-            halUnlock();
             handleError("halGetMaf invalid query range [" + std::to_string(tStart) + "," + std::to_string(tEnd) + ")", errStr);
             return -1;
         }
-        AlignmentConstPtr alignment(getExistingAlignment(halHandle, hal_size_t(0), true));
+        AlignmentConstPtr alignment(query.getAlignment(hal_size_t(0), true));
 
         set<const Genome *> qGenomeSet;
         for (hal_species_t *qSpecies = qSpeciesNames; qSpecies != NULL; qSpecies = qSpecies->next) {
@@ -407,12 +428,10 @@ extern "C" hal_int_t halGetMaf(FILE *outFile, int halHandle, hal_species_t *qSpe
         hal_index_t absStart = tSequence->getStartPosition() + tStart;
         hal_index_t absEnd = tSequence->getStartPosition() + myEnd - 1;
         if (absStart > absEnd) {
-            halUnlock();
             handleError("halGetMaf invalid range", errStr);
             return -1;
         }
         if (absEnd > tSequence->getEndPosition()) {
-            halUnlock();
             handleError("halGetMaf target end position outside of target sequence", errStr);
             return -1;
         }
@@ -434,15 +453,12 @@ extern "C" hal_int_t halGetMaf(FILE *outFile, int halHandle, hal_species_t *qSpe
             numBytes = (hal_int_t)fwrite(mafStringBuffer.c_str(), mafStringBuffer.length(), sizeof(char), outFile);
         }
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetMaf error writing MAF blocks: " + string(e.what()), errStr);
         return -1;
     } catch (...) {
-        halUnlock();
         handleError("halGetMaf error writing MAF blocks: unknown exception", errStr);
         return -1;
     }
-    halUnlock();
     return numBytes;
 }
 
@@ -454,11 +470,11 @@ extern "C" hal_int_t halGetMAF(FILE *outFile, int halHandle, struct hal_species_
 }
 
 extern "C" struct hal_species_t *halGetSpecies(int halHandle, char **errStr) {
-    halLock();
     hal_species_t *head = NULL;
     try {
+        HandleQuery query(halHandle);
         // read the lowest level of detail because it's fastest
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, numeric_limits<hal_size_t>::max(), false);
+        AlignmentConstPtr alignment = query.getAlignment(numeric_limits<hal_size_t>::max(), false);
         hal_species_t *prev = NULL;
         if (alignment->getNumGenomes() > 0) {
             string rootName = alignment->getRootName();
@@ -494,25 +510,22 @@ extern "C" struct hal_species_t *halGetSpecies(int halHandle, char **errStr) {
             }
         }
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetSpecies: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetSpecies: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return head;
 }
 
 extern "C" struct hal_species_t *halGetPossibleCoalescenceLimits(int halHandle, const char *qSpecies, const char *tSpecies,
                                                                  char **errStr) {
-    halLock();
     hal_species_t *head = NULL;
     try {
+        HandleQuery query(halHandle);
         // read the lowest level of detail because it's fastest
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, numeric_limits<hal_size_t>::max(), false);
+        AlignmentConstPtr alignment = query.getAlignment(numeric_limits<hal_size_t>::max(), false);
         hal_species_t *prev = NULL;
         const Genome *qGenome = alignment->openGenome(qSpecies);
         const Genome *tGenome = alignment->openGenome(tSpecies);
@@ -544,15 +557,12 @@ extern "C" struct hal_species_t *halGetPossibleCoalescenceLimits(int halHandle,
             prev = cur;
         } while ((curGenome = curGenome->getParent()) != NULL);
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetPossibleCoalescenceLimits: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetPossibleCoalescenceLimits: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return head;
 }
 
@@ -567,15 +577,14 @@ extern "C" void halFreeSpeciesList(struct hal_species_t *species) {
 }
 
 extern "C" struct hal_chromosome_t *halGetChroms(int halHandle, char *speciesName, char **errStr) {
-    halLock();
     hal_chromosome_t *head = NULL;
     try {
+        HandleQuery query(halHandle);
         // read the lowest level of detail because it's fastest
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, numeric_limits<hal_size_t>::max(), false);
+        AlignmentConstPtr alignment = query.getAlignment(numeric_limits<hal_size_t>::max(), false);
 
         const Genome *genome = alignment->openGenome(speciesName);
         if (genome == NULL) {
-            halUnlock();
             handleError("halGetChroms: species with name " + string(speciesName) + " not found in alignment with handle " +
                             std::to_string(halHandle),
                         errStr);
@@ -601,26 +610,22 @@ extern "C" struct hal_chromosome_t *halGetChroms(int halHandle, char *speciesNam
             }
         }
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetChroms: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetChroms: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return head;
 }
 
 extern "C" char *halGetDna(int halHandle, char *speciesName, char *chromName, hal_int_t start, hal_int_t end, char **errStr) {
-    halLock();
     char *dna = NULL;
     try {
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, 0, true);
+        HandleQuery query(halHandle);
+        AlignmentConstPtr alignment = query.getAlignment(0, true);
         const Genome *genome = alignment->openGenome(speciesName);
         if (genome == NULL) {
-            halUnlock();
             handleError("halGetChroms: species with name " + string(speciesName) + " not found in alignment with handle " +
                         std::to_string(halHandle),
                         errStr);
@@ -628,13 +633,11 @@ extern "C" char *halGetDna(int halHandle, char *speciesName, char *chromName, ha
         }
         const Sequence *sequence = genome->getSequence(chromName);
         if (sequence == NULL) {
-            halUnlock();
             handleError("halGetDna: chromosome with name " + string(chromName) + " not found in species " + speciesName,
                         errStr);
             return NULL;
         }
         if (start > end || end > (hal_index_t)sequence->getSequenceLength()) {
-            halUnlock();
             handleError("halGetDna: specified range [" + std::to_string(start) + "," + std::to_string(end) + ") is invalid " +
                             "for chromsome " + chromName + " in species " + speciesName + " which is of length " +
                             std::to_string(sequence->getSequenceLength()),
@@ -646,52 +649,54 @@ extern "C" char *halGetDna(int halHandle, char *speciesName, char *chromName, ha
         sequence->getSubString(buffer, start, end - start);
         dna = copyCString(buffer);
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetDna: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetDna: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return dna;
 }
 
 extern "C" hal_int_t halGetMaxLODQueryLength(int halHandle, char **errStr) {
-    halLock();
     hal_int_t ret = 0;
     try {
-        HandleMap::iterator mapIt = handleMap.find(halHandle);
-        if (mapIt == handleMap.end()) {
-            halUnlock();
+        HalHandlePtr handle = findHandle(halHandle);
+        if (handle.get() == NULL) {
             handleError("halGetMaxLODQueryLength error getting Max LOD Query Length.  handle " + std::to_string(halHandle) +
                             ": not found",
                         errStr);
             return -1;
         }
-        ret = (hal_int_t)mapIt->second.second->getMaxQueryLength();
+        ret = (hal_int_t)handle->lodManager->getMaxQueryLength();
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetMaxLODQueryLength: " + string(e.what()), errStr);
         return -1;
     } catch (...) {
-        halUnlock();
         handleError("halGetMaxLODQueryLength: unknown exception", errStr);
         return -1;
     }
-    halUnlock();
     return ret;
 }
 
-static void checkHandle(int handle) {
+static HalHandlePtr findHandle(int handle) {
+    lock_guard<mutex> mapLock(handleMapMutex);
     HandleMap::iterator mapIt = handleMap.find(handle);
     if (mapIt == handleMap.end()) {
-        throw hal_exception("Handle " + std::to_string(handle) + "not found in alignment map");
+        return HalHandlePtr();
     }
-    if (mapIt->second.second.get() == NULL) {
-        throw hal_exception("Handle " + std::to_string(handle) + "points to NULL alignment");
+    return mapIt->second;
+}
+
+HandleQuery::HandleQuery(int handle) {
+    HalHandlePtr halHandle = findHandle(handle);
+    if (halHandle.get() == NULL) {
+        throw hal_exception("Handle " + std::to_string(handle) + " not found in alignment map");
+    }
+    if (not halHandle->shareable) {
+        _serialLock = unique_lock<mutex>(serialMutex);
     }
+    _halHandle = halHandle;
 }
 
 static void checkGenomes(int halHandle, AlignmentConstPtr alignment, const string &qSpecies, const string &tSpecies,
@@ -713,18 +718,6 @@ static void checkGenomes(int halHandle, AlignmentConstPtr alignment, const strin
     }
 }
 
-static AlignmentConstPtr getExistingAlignment(int handle, hal_size_t queryLength, bool needDNASequence) {
-    checkHandle(handle);
-    HandleMap::iterator mapIt = handleMap.find(handle);
-    return mapIt->second.second->getAlignment(queryLength, needDNASequence);
-}
-
-static bool isAlignmentLod0(int handle, hal_size_t queryLength) {
-    checkHandle(handle);
-    HandleMap::iterator mapIt = handleMap.find(handle);
-    return mapIt->second.second->isLod0(queryLength);
-}
-
 static char *copyCString(const string &inString) {
     char *outString = (char *)malloc(inString.length() + 1);
     strcpy(outString, inString.c_str());
@@ -1097,10 +1090,10 @@ static void mergeCompatibleDupes(vector<hal_target_dupe_list_t *> &dupeList) {
 }
 
 extern "C" struct hal_metadata_t *halGetGenomeMetadata(int halHandle, const char *genomeName, char **errStr) {
-    halLock();
     struct hal_metadata_t *ret = NULL;
     try {
-        AlignmentConstPtr alignment = getExistingAlignment(halHandle, numeric_limits<hal_size_t>::max(), false);
+        HandleQuery query(halHandle);
+        AlignmentConstPtr alignment = query.getAlignment(numeric_limits<hal_size_t>::max(), false);
 
         const Genome *genome = alignment->openGenome(genomeName);
         if (genome == NULL) {
@@ -1122,15 +1115,12 @@ extern "C" struct hal_metadata_t *halGetGenomeMetadata(int halHandle, const char
             prevMetadata = curMetadata;
         }
     } catch (exception &e) {
-        halUnlock();
         handleError("halGetGenomeMetadata: " + string(e.what()), errStr);
         return NULL;
     } catch (...) {
-        halUnlock();
         handleError("halGetGenomeMetadata: unknown exception", errStr);
         return NULL;
     }
-    halUnlock();
     return ret;
 }
 
@@ -14,7 +14,12 @@ extern "C" {
 #endif
 
 /** This is all prototype code to evaluate how to get blocks streamed
- * from HAL to the browser. Interface is speficied by Brian */
+ * from HAL to the browser. Interface is speficied by Brian
+ *
+ * The functions may be called from multiple threads.  Queries on handles
+ * to mmap HAL files run concurrently, also on the same handle.  Queries on
+ * HDF5 files are run one at a time, as the HDF5 library is not thread-safe,
+ * but don't hold up queries on mmap files. */
 
 /* keep integer type definition in one place */
 typedef long hal_int_t;
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2012-2019 by UCSC Computational Genomics Lab
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "hal.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+using namespace hal;
+
+static void initParser(CLParser &optionsParser) {
+    optionsParser.addArgument("inHalPath", "input hal file");
+    optionsParser.addArgument("outHalPath", "output hal file");
+    optionsParser.addOption("outputFormat", "format for output hal file (the other format than the input file by default)",
+                            "");
+    optionsParser.addOption("numThreads", "number of threads to convert with, 0 for one per CPU", 0);
+    optionsParser.addOptionFlag("verbose", "print the amount of data converted and the rate", false);
+    optionsParser.setDescription("Copy a whole alignment to a file of another storage format, faster than halExtract");
+}
+
+int main(int argc, char **argv) {
+    CLParser optionsParser(CREATE_ACCESS);
+    initParser(optionsParser);
+
+    string inHalPath;
+    string outHalPath;
+    string outputFormat;
+    unsigned numThreads;
+    bool verbose;
+    try {
+        optionsParser.parseOptions(argc, argv);
+        inHalPath = optionsParser.getArgument<string>("inHalPath");
+        outHalPath = optionsParser.getArgument<string>("outHalPath");
+        outputFormat = optionsParser.getOption<string>("outputFormat");
+        numThreads = optionsParser.getOption<unsigned>("numThreads");
+        verbose = optionsParser.getFlag("verbose");
+    } catch (exception &e) {
+        cerr << e.what() << endl;
+        optionsParser.printUsage(cerr);
+        exit(1);
+    }
+
+    try {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        AlignmentConstPtr inAlignment(openHalAlignment(inHalPath, &optionsParser));
+        if (inAlignment->getNumGenomes() == 0) {
+            throw hal_exception("input hal alignment is empty");
+        }
+        if (outputFormat.empty()) {
+            outputFormat = (inAlignment->getStorageFormat() == STORAGE_FORMAT_HDF5) ? STORAGE_FORMAT_MMAP : STORAGE_FORMAT_HDF5;
+        }
+        AlignmentPtr outAlignment(
+            openHalAlignment(outHalPath, &optionsParser, READ_ACCESS | WRITE_ACCESS | CREATE_ACCESS, outputFormat));
+        ConvertStats stats = convertAlignment(inAlignment.get(), outAlignment.get(), numThreads);
+        outAlignment->close();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (verbose) {
+            cerr << "converted " << stats.numGenomes << " genomes, " << stats.numBases << " bases, " << stats.numTopSegments
+                 << " top segments and " << stats.numBottomSegments << " bottom segments (" << stats.numBytes / (1024 * 1024)
+                 << " MB) in " << seconds << "s, " << stats.numBytes / (1024 * 1024) / seconds << " MB/s" << endl;
+        }
+    } catch (hal_exception &e) {
+        cerr << "hal exception caught: " << e.what() << endl;
+        return 1;
+    } catch (exception &e) {
+        cerr << "Exception caught: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -96,18 +96,11 @@ void getDimensions(AlignmentConstPtr outAlignment, const Genome *genome, vector<
 }
 
 void copyGenome(const Genome *inGenome, Genome *outGenome) {
-    DnaIteratorPtr inDna = inGenome->getDnaIterator();
-    DnaIteratorPtr outDna = outGenome->getDnaIterator();
-    hal_size_t n = inGenome->getSequenceLength();
-    assert(n == outGenome->getSequenceLength());
-    for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), outDna->toRight()) {
-        outDna->setBase(inDna->getBase());
-    }
-    outDna->flush();
+    inGenome->copySequence(outGenome);
 
     TopSegmentIteratorPtr inTop = inGenome->getTopSegmentIterator();
     TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator();
-    n = outGenome->getNumTopSegments();
+    hal_size_t n = outGenome->getNumTopSegments();
     assert(n == 0 || n == inGenome->getNumTopSegments());
     for (; (hal_size_t)inTop->getArrayIndex() < n; inTop->toRight(), outTop->toRight()) {
         outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
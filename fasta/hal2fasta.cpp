@@ -11,18 +11,18 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 using namespace hal;
 
-static void printSequenceLine(ostream &outStream, const Sequence *sequence, hal_size_t start, hal_size_t length,
-                              string &buffer, bool upper);
 static void printSequence(ostream &outStream, const Sequence *sequence, hal_size_t lineWidth, hal_size_t start,
                           hal_size_t length, bool fullNames, bool upper);
 static void printGenome(ostream &outStream, const Genome *genome, const Sequence *sequence, hal_size_t lineWidth,
                         hal_size_t start, hal_size_t length, bool fullNames, bool upper);
 
-static const hal_size_t StringBufferSize = 1024;
+// number of bases read from the alignment at a time (rounded to whole lines)
+static const hal_size_t StringBufferSize = 1024 * 1024;
 
 static void initParser(CLParser &optionsParser) {
     optionsParser.addArgument("inHalPath", "input hal file");
@@ -148,21 +148,6 @@ int main(int argc, char **argv) {
     return 0;
 }
 
-void printSequenceLine(ostream &outStream, const Sequence *sequence, hal_size_t start, hal_size_t length, string &buffer, bool upper) {
-    hal_size_t last = start + length;
-    hal_size_t readLen;
-    for (hal_size_t i = start; i < last; i += StringBufferSize) {
-        readLen = std::min(StringBufferSize, last - i);
-        sequence->getSubString(buffer, i, readLen);
-        if (upper) {
-            for (int j = 0; j < buffer.size(); ++j) {
-                buffer[j] = std::toupper(buffer[j]);
-            }
-        }
-        outStream << buffer;
-    }
-}
-
 void printSequence(ostream &outStream, const Sequence *sequence, hal_size_t lineWidth, hal_size_t start, hal_size_t length, bool fullNames, bool upper) {
     hal_size_t seqLen = sequence->getSequenceLength();
     if (length == 0) {
@@ -175,12 +160,20 @@ void printSequence(ostream &outStream, const Sequence *sequence, hal_size_t line
                             std::to_string(seqLen));
     }
     outStream << '>' << (fullNames ? sequence->getFullName() : sequence->getName()) << '\n';
-    hal_size_t readLen;
-    string buffer;
-    for (hal_size_t i = start; i < last; i += lineWidth) {
-        readLen = std::min(lineWidth, last - i);
-        printSequenceLine(outStream, sequence, i, readLen, buffer, upper);
-        outStream << '\n';
+    hal_size_t bufferSize = std::max(StringBufferSize / lineWidth, (hal_size_t)1) * lineWidth;
+    vector<char> buffer(std::min(bufferSize, length));
+    for (hal_size_t i = start; i < last; i += buffer.size()) {
+        hal_size_t readLen = std::min((hal_size_t)buffer.size(), last - i);
+        sequence->getBases(i, readLen, buffer.data());
+        if (upper) {
+            for (hal_size_t j = 0; j < readLen; ++j) {
+                buffer[j] = std::toupper(buffer[j]);
+            }
+        }
+        for (hal_size_t j = 0; j < readLen; j += lineWidth) {
+            outStream.write(buffer.data() + j, std::min(lineWidth, readLen - j));
+            outStream << '\n';
+        }
     }
 }
 
@@ -32,15 +32,19 @@ void BlockLiftover::visitBegin() {
     set<const Genome *> inputSet;
     inputSet.insert(_srcGenome);
     inputSet.insert(_tgtGenome);
-    _mrca = getLowestCommonAncestor(inputSet);
+    const Genome *mrca = getLowestCommonAncestor(inputSet);
     if (_coalescenceLimit == NULL) {
-        _coalescenceLimit = _mrca;
+        _coalescenceLimit = mrca;
     }
 
     inputSet.clear();
     inputSet.insert(_coalescenceLimit);
     inputSet.insert(_tgtGenome);
-    getGenomesInSpanningTree(inputSet, _downwardPath);
+    set<const Genome *> downwardPath;
+    getGenomesInSpanningTree(inputSet, downwardPath);
+    _mapper.reset(new SegmentMapper(_srcGenome, _tgtGenome, &downwardPath, _traverseDupes, 0, _coalescenceLimit, mrca));
+    _mapperCache.clear();
+    _mapper->setCache(_batchSize > 0 ? &_mapperCache : NULL);
 }
 
 void BlockLiftover::liftInterval(BedList &mappedBedLines) {
@@ -49,27 +53,7 @@ void BlockLiftover::liftInterval(BedList &mappedBedLines) {
     hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
     bool flip = _bedLine._strand == '-';
 
-    _refSeg->toSite(globalStart, false);
-    hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
-    hal_offset_t endOffset = 0;
-    if (globalEnd <= _refSeg->getEndPosition()) {
-        endOffset = _refSeg->getEndPosition() - globalEnd;
-    }
-    _refSeg->slice(startOffset, endOffset);
-
-    assert(_refSeg->getStartPosition() == globalStart);
-    assert(_refSeg->getEndPosition() <= globalEnd);
-
-    while (_refSeg->getArrayIndex() < _lastIndex && _refSeg->getStartPosition() <= globalEnd) {
-        if (flip == true) {
-            _refSeg->toReverseInPlace();
-        }
-        halMapSegment(_refSeg.get(), _mappedSegments, _tgtGenome, &_downwardPath, _traverseDupes, 0, _coalescenceLimit, _mrca);
-        if (flip == true) {
-            _refSeg->toReverseInPlace();
-        }
-        _refSeg->toRight(globalEnd);
-    }
+    mapInterval(globalStart, globalEnd, flip);
 
     vector<MappedSegmentPtr> fragments;
     MappedSegmentSet emptySet;
@@ -160,3 +144,30 @@ void BlockLiftover::readPSLInfo(vector<MappedSegmentPtr> &fragments, BedLine &ou
         }
     }
 }
+
+/* map the source interval one segment at a time.  in batch mode, neighbouring
+ * lines are lifted together so the mappings of whole segments are cached and
+ * sliced for each line */
+void BlockLiftover::mapInterval(hal_index_t globalStart, hal_index_t globalEnd, bool flip) {
+    _refSeg->toSite(globalStart, false);
+    hal_offset_t startOffset = globalStart - _refSeg->getStartPosition();
+    hal_offset_t endOffset = 0;
+    if (globalEnd <= _refSeg->getEndPosition()) {
+        endOffset = _refSeg->getEndPosition() - globalEnd;
+    }
+    _refSeg->slice(startOffset, endOffset);
+
+    assert(_refSeg->getStartPosition() == globalStart);
+    assert(_refSeg->getEndPosition() <= globalEnd);
+
+    while (_refSeg->getArrayIndex() < _lastIndex && _refSeg->getStartPosition() <= globalEnd) {
+        if (flip == true) {
+            _refSeg->toReverseInPlace();
+        }
+        _mapper->map(_refSeg.get(), _mappedSegments);
+        if (flip == true) {
+            _refSeg->toReverseInPlace();
+        }
+        _refSeg->toRight(globalEnd);
+    }
+}
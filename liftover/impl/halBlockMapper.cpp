@@ -29,8 +29,8 @@ BlockMapper::~BlockMapper() {
 void BlockMapper::erase() {
     _segSet.clear();
     _adjSet.clear();
-    _downwardPath.clear();
-    _upwardPath.clear();
+    _downMapper.reset();
+    _upMapper.reset();
 }
 
 void BlockMapper::init(const Genome *refGenome, const Genome *queryGenome, hal_index_t absRefFirst, hal_index_t absRefLast,
@@ -65,13 +65,18 @@ void BlockMapper::init(const Genome *refGenome, const Genome *queryGenome, hal_i
     inputSet.clear();
     inputSet.insert(_queryGenome);
     inputSet.insert(_coalescenceLimit);
-    getGenomesInSpanningTree(inputSet, _downwardPath);
+    set<const Genome *> downwardPath;
+    getGenomesInSpanningTree(inputSet, downwardPath);
+    _downMapper.reset(
+        new SegmentMapper(_refGenome, _queryGenome, &downwardPath, _doDupes, _minLength, _coalescenceLimit, _mrca));
 
     // similarly, the upward path is needed to get the adjacencies properly.
     inputSet.clear();
     inputSet.insert(_refGenome);
     inputSet.insert(_coalescenceLimit);
-    getGenomesInSpanningTree(inputSet, _upwardPath);
+    set<const Genome *> upwardPath;
+    getGenomesInSpanningTree(inputSet, upwardPath);
+    _upMapper.reset(new SegmentMapper(_queryGenome, _refGenome, &upwardPath, _doDupes, _minLength, NULL, _mrca));
 }
 
 void BlockMapper::map() {
@@ -100,7 +105,7 @@ void BlockMapper::map() {
         if (_targetReversed == true) {
             refSeg->toReverseInPlace();
         }
-        halMapSegment(refSeg.get(), _segSet, _queryGenome, &_downwardPath, _doDupes, _minLength, _coalescenceLimit, _mrca);
+        _downMapper->map(refSeg.get(), _segSet);
         if (_targetReversed == true) {
             refSeg->toReverseInPlace();
         }
@@ -109,10 +114,13 @@ void BlockMapper::map() {
 
     if (_mapAdj) {
         assert(_targetReversed == false);
-        MappedSegmentSet::const_iterator i;
-        for (i = _segSet.begin(); i != _segSet.end(); ++i) {
-            if (_adjSet.find(*i) == _adjSet.end()) {
-                mapAdjacencies(i);
+        // mapAdjacencies() adds to _segSet, which invalidates iterators, so
+        // we walk it by index and find our place again after each call
+        for (size_t i = 0; i < _segSet.size(); ++i) {
+            MappedSegmentPtr mappedSeg = *(_segSet.begin() + i);
+            if (_adjSet.find(mappedSeg) == _adjSet.end()) {
+                mapAdjacencies(_segSet.begin() + i);
+                i = _segSet.lower_bound(mappedSeg) - _segSet.begin();
             }
         }
     }
@@ -120,11 +128,11 @@ void BlockMapper::map() {
 
 void BlockMapper::extractReferenceParalogies(MappedSegmentSet &outParalogies) {
     MappedSegmentSet::iterator i = _segSet.begin();
-    MappedSegmentSet::iterator j = _segSet.end();
-    MappedSegmentSet::iterator k;
-    hal_index_t iStart = NULL_INDEX;
-    hal_index_t iEnd = NULL_INDEX;
-    bool iIns = false;
+    MappedSegmentSet::iterator j;
+    vector<MappedSegmentPtr> paralogies;
+    vector<MappedSegmentPtr> kept;
+    hal_index_t iStart;
+    hal_index_t iEnd;
     hal_index_t jStart;
     hal_index_t jEnd;
     while (i != _segSet.end()) {
@@ -133,47 +141,36 @@ void BlockMapper::extractReferenceParalogies(MappedSegmentSet &outParalogies) {
         // are ordered by their reference coordinates.  we keep
         // the lowest entry in each class (by ref coordinates) and
         // extract all the others into outParalogies
-        if (iStart == NULL_INDEX) {
-            iIns = false;
-            iStart = (*i)->getStartPosition();
-            iEnd = (*i)->getEndPosition();
-            if ((*i)->getReversed()) {
-                swap(iStart, iEnd);
-            }
+        iStart = (*i)->getStartPosition();
+        iEnd = (*i)->getEndPosition();
+        if ((*i)->getReversed()) {
+            swap(iStart, iEnd);
         }
-        j = i;
-        ++j;
-        // if (_adjSet.find(*i) == _adjSet.end())
-        {
-            while (j != _segSet.end()) {
-                jStart = (*j)->getStartPosition();
-                jEnd = (*j)->getEndPosition();
-                if ((*j)->getReversed()) {
-                    swap(jStart, jEnd);
-                }
-                // note we should not have overlaps here because the mappedSegment
-                // results cuts everything to be same or disjoint
-                if (iStart == jStart) {
-                    assert(iEnd == jEnd);
-                    if (!iIns) {
-                        iIns = true;
-                        outParalogies.insert(*i);
-                    }
-                    outParalogies.insert(*j);
-                    k = j;
-                    ++k;
-                    _segSet.erase(*j);
-                    j = k;
-                } else {
-                    assert(iStart > jEnd || iEnd < jStart);
-                    iStart = NULL_INDEX;
-                    iIns = false;
-                    break;
-                }
+        kept.push_back(*i);
+        for (j = i + 1; j != _segSet.end(); ++j) {
+            jStart = (*j)->getStartPosition();
+            jEnd = (*j)->getEndPosition();
+            if ((*j)->getReversed()) {
+                swap(jStart, jEnd);
+            }
+            // note we should not have overlaps here because the mappedSegment
+            // results cuts everything to be same or disjoint
+            if (iStart != jStart) {
+                assert(iStart > jEnd || iEnd < jStart);
+                break;
             }
+            assert(iEnd == jEnd);
+        }
+        if (j - i > 1) {
+            paralogies.insert(paralogies.end(), i, j);
         }
         i = j;
     }
+    outParalogies.insert(paralogies.begin(), paralogies.end());
+    if (kept.size() < _segSet.size()) {
+        _segSet.clear();
+        _segSet.insert(kept.begin(), kept.end());
+    }
 
 #ifndef _NDEBUG
     for (i = _segSet.begin(); i != _segSet.end(); ++i) {
@@ -216,7 +213,7 @@ void BlockMapper::mapAdjacencies(MappedSegmentSet::const_iterator segIt) {
         }
         size_t backSize = backResults.size();
         assert(queryIt->getArrayIndex() >= 0);
-        halMapSegment(queryIt.get(), backResults, _refGenome, &_upwardPath, _doDupes, _minLength);
+        _upMapper->map(queryIt.get(), backResults);
         // something was found, that's good enough.
         if (backResults.size() > backSize) {
             break;
@@ -246,7 +243,7 @@ void BlockMapper::mapAdjacencies(MappedSegmentSet::const_iterator segIt) {
             break;
         }
         size_t backSize = backResults.size();
-        halMapSegment(queryIt.get(), backResults, _refGenome, &_upwardPath, _doDupes, _minLength);
+        _upMapper->map(queryIt.get(), backResults);
         // something was found, that's good enough.
         if (backResults.size() > backSize) {
             break;
@@ -424,8 +421,9 @@ void BlockMapper::extractSegment(MappedSegmentSet::iterator start, const MappedS
         queryCutPoints.insert(max(fragments.back()->getStartPosition(), fragments.back()->getEndPosition()));
     }
 
-    for (size_t i = 0; i < toErase.size(); ++i) {
-        startSet->erase(toErase[i]);
+    // erase from the back so that the remaining iterators stay valid
+    for (size_t i = toErase.size(); i > 0; --i) {
+        startSet->erase(toErase[i - 1]);
     }
 
     assert(fragments.front()->getSequence() == fragments.back()->getSequence());
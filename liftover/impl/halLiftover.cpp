@@ -6,15 +6,24 @@
  */
 
 #include "halLiftover.h"
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace hal;
 
+const hal_size_t Liftover::defaultChunkSize = 1000;
+
 Liftover::Liftover()
     : _outBedStream(NULL), _outPSL(false), _outPSLWithName(false), _srcGenome(NULL),
-      _tgtGenome(NULL) {
+      _tgtGenome(NULL), _batchSize(0), _numThreads(1), _unordered(false), _chunkQueue(NULL) {
 }
 
 Liftover::~Liftover() {
@@ -33,17 +42,228 @@ void Liftover::convert(AlignmentConstPtr alignment, const Genome *srcGenome, ist
     _outPSLWithName = outPSLWithName;
     _missedSet.clear();
     _tgtSet.clear();
+    _batch.clear();
     assert(_srcGenome && inBedStream && tgtGenome && outBedStream);
 
     _tgtSet.insert(tgtGenome);
 
-    scan(inBedStream, bedType);
+    if (_numThreads > 1) {
+        convertThreaded(inBedStream, bedType);
+    } else {
+        scan(inBedStream, bedType);
+    }
+}
+
+/* A chunk of input lines, lifted by one worker */
+struct Liftover::Chunk {
+    std::vector<BatchLine> _lines;
+    std::string _output;
+    bool _done;
+};
+
+/* Queue of chunks shared by the reading thread and the workers.  The reading
+ * thread also writes the results, keeping at most window chunks in memory. */
+struct Liftover::ChunkQueue {
+    ChunkQueue(ostream &outStream, size_t window, bool unordered)
+        : _outStream(outStream), _window(window), _unordered(unordered), _closed(false), _failed(false) {
+    }
+    ~ChunkQueue() {
+        for (size_t i = 0; i < _chunks.size(); ++i) {
+            delete _chunks[i];
+        }
+    }
+
+    /* add lines to lift, writing finished chunks to make room if needed */
+    void push(std::vector<BatchLine> &lines) {
+        Chunk *chunk = new Chunk();
+        chunk->_lines.swap(lines);
+        chunk->_done = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _chunks.push_back(chunk);
+            _todo.push_back(chunk);
+        }
+        _cond.notify_all();
+        write(_window);
+    }
+
+    /* no more chunks will be pushed */
+    void close() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _cond.notify_all();
+    }
+
+    /* get the next chunk to lift, or NULL if there is nothing left to do */
+    Chunk *next() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_todo.empty() and not _closed and not _failed) {
+            _cond.wait(lock);
+        }
+        if (_todo.empty() or _failed) {
+            return NULL;
+        }
+        Chunk *chunk = _todo.front();
+        _todo.pop_front();
+        return chunk;
+    }
+
+    void done(Chunk *chunk) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        chunk->_done = true;
+        _cond.notify_all();
+    }
+
+    /* record the first error, which stops all threads */
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (not _failed) {
+            _failed = true;
+            _error = error;
+        }
+        _cond.notify_all();
+    }
+
+    /* write finished chunks, waiting until no more than maxPending chunks are
+     * left unwritten */
+    void write(size_t maxPending) {
+        while (true) {
+            std::vector<Chunk *> ready;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (true) {
+                    if (_failed) {
+                        throw hal_exception("liftover stopped due to an error in another thread");
+                    }
+                    if (_unordered) {
+                        std::deque<Chunk *> pending;
+                        for (size_t i = 0; i < _chunks.size(); ++i) {
+                            if (_chunks[i]->_done) {
+                                ready.push_back(_chunks[i]);
+                            } else {
+                                pending.push_back(_chunks[i]);
+                            }
+                        }
+                        _chunks.swap(pending);
+                    } else {
+                        while (not _chunks.empty() and _chunks.front()->_done) {
+                            ready.push_back(_chunks.front());
+                            _chunks.pop_front();
+                        }
+                    }
+                    if (not ready.empty() or _chunks.size() <= maxPending) {
+                        break;
+                    }
+                    _cond.wait(lock);
+                }
+            }
+            if (ready.empty()) {
+                return;
+            }
+            for (size_t i = 0; i < ready.size(); ++i) {
+                _outStream << ready[i]->_output;
+                delete ready[i];
+            }
+        }
+    }
+
+    ostream &_outStream;
+    size_t _window;
+    bool _unordered;
+    std::deque<Chunk *> _chunks; // not yet written, in input order
+    std::deque<Chunk *> _todo;   // not yet started
+    bool _closed;
+    bool _failed;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+};
+
+/* copy the conversion settings from the liftover that reads the input */
+void Liftover::initWorker(const Liftover &liftover) {
+    _alignment = liftover._alignment;
+    _srcGenome = liftover._srcGenome;
+    _tgtGenome = liftover._tgtGenome;
+    _coalescenceLimit = liftover._coalescenceLimit;
+    _bedType = liftover._bedType;
+    _traverseDupes = liftover._traverseDupes;
+    _outPSL = liftover._outPSL;
+    _outPSLWithName = liftover._outPSLWithName;
+    _tgtSet = liftover._tgtSet;
+    _batchSize = liftover._batchSize;
+    visitBegin();
+}
+
+/* read the input in this thread while worker threads, each with their own
+ * liftover object, lift it one chunk at a time */
+void Liftover::convertThreaded(istream *inBedStream, int bedType) {
+    ChunkQueue queue(*_outBedStream, 4 * _numThreads, _unordered);
+    std::vector<std::unique_ptr<Liftover>> workers;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < _numThreads; ++i) {
+        workers.push_back(std::unique_ptr<Liftover>(createWorker()));
+        workers.back()->initWorker(*this);
+        threads.push_back(std::thread(&Liftover::liftChunks, workers.back().get(), std::ref(queue)));
+    }
+    _chunkQueue = &queue;
+    try {
+        scan(inBedStream, bedType);
+        queue.close();
+        queue.write(0);
+    } catch (...) {
+        queue.fail(std::current_exception());
+    }
+    _chunkQueue = NULL;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (queue._failed) {
+        std::rethrow_exception(queue._error);
+    }
+}
+
+/* worker thread body */
+void Liftover::liftChunks(ChunkQueue &queue) {
+    try {
+        Chunk *chunk;
+        while ((chunk = queue.next()) != NULL) {
+            ostringstream outStream;
+            _outBedStream = &outStream;
+            _batch.swap(chunk->_lines);
+            liftBatch();
+            chunk->_output = outStream.str();
+            queue.done(chunk);
+        }
+    } catch (...) {
+        queue.fail(std::current_exception());
+    }
 }
 
 void Liftover::visitBegin() {
 }
 
 void Liftover::visitLine() {
+    if ((_batchSize == 0) and (_chunkQueue == NULL)) {
+        liftLine();
+        return;
+    }
+    _batch.push_back(BatchLine());
+    BatchLine &batchLine = _batch.back();
+    batchLine._bedLine = _bedLine;
+    batchLine._lineNumber = _lineNumber;
+    const Sequence *srcSequence = _srcGenome->getSequence(_bedLine._chrName);
+    batchLine._srcPosition = srcSequence == NULL ? NULL_INDEX : srcSequence->getStartPosition() + _bedLine._start;
+    if (_chunkQueue != NULL) {
+        if (_batch.size() >= (_batchSize > 0 ? _batchSize : defaultChunkSize)) {
+            _chunkQueue->push(_batch);
+        }
+    } else if (_batch.size() >= _batchSize) {
+        liftBatch();
+    }
+}
+
+/* lift the current bed line and write the results */
+void Liftover::liftLine() {
     if ((_outPSL || _outPSLWithName) && (_bedLine._bedType < 12)) {
         // forcing to BED12 makes PSL code simpler
         _bedLine.expandToBed12();
@@ -92,6 +312,48 @@ void Liftover::visitLine() {
 }
 
 void Liftover::visitEOF() {
+    if (_batch.empty()) {
+        return;
+    }
+    if (_chunkQueue != NULL) {
+        _chunkQueue->push(_batch);
+    } else {
+        liftBatch();
+    }
+}
+
+/* lift the buffered lines in order of source position, then write their
+ * results in input order */
+void Liftover::liftBatch() {
+    vector<BatchLine *> sortedBatch;
+    for (size_t i = 0; i < _batch.size(); ++i) {
+        sortedBatch.push_back(&_batch[i]);
+    }
+    stable_sort(sortedBatch.begin(), sortedBatch.end(), BatchLinePLess());
+
+    ostream *outBedStream = _outBedStream;
+    hal_size_t lineNumber = _lineNumber;
+    try {
+        for (size_t i = 0; i < sortedBatch.size(); ++i) {
+            BatchLine &batchLine = *sortedBatch[i];
+            _bedLine = batchLine._bedLine;
+            _lineNumber = batchLine._lineNumber;
+            ostringstream outStream;
+            _outBedStream = &outStream;
+            liftLine();
+            batchLine._output = outStream.str();
+        }
+    } catch (...) {
+        _outBedStream = outBedStream;
+        throw;
+    }
+    _outBedStream = outBedStream;
+    _lineNumber = lineNumber;
+
+    for (size_t i = 0; i < _batch.size(); ++i) {
+        *_outBedStream << _batch[i]._output;
+    }
+    _batch.clear();
 }
 
 void Liftover::writeLineResults() {
@@ -39,6 +39,15 @@ static void initParser(CLParser &optionsParser) {
     optionsParser.addOption("bedType", "number of standard columns (3 to 12), columns beyond this are passed "
                             "through.  This only needs to be specified for BEDs with less than 12 columns and "
                             "having non-standard extra columns.", 0);
+    optionsParser.addOption("batchSize", "lift records in batches of this many lines, sorted by source position so "
+                                         "that overlapping and nearby records share segment mappings.  Output "
+                                         "order and content are unchanged (0 to lift one line at a time)",
+                            0);
+    optionsParser.addOption("numThreads", "number of threads used to lift records.  Requires a mmap format HAL file",
+                            1);
+    optionsParser.addOptionFlag("unordered", "with --numThreads, write results as soon as they are ready rather "
+                                             "than in input order",
+                                false);
     optionsParser.setDescription("Map BED or PSL genome interval coordinates between "
                                  "two genomes.");
 }
@@ -58,6 +67,9 @@ int main(int argc, char **argv) {
     int bedType;
     bool outPSL;
     bool outPSLWithName;
+    hal_size_t batchSize;
+    size_t numThreads;
+    bool unordered;
     try {
         optionsParser.parseOptions(argc, argv);
         halPath = optionsParser.getArgument<string>("halFile");
@@ -78,6 +90,12 @@ int main(int argc, char **argv) {
         }
         outPSL = optionsParser.getFlag("outPSL");
         outPSLWithName = optionsParser.getFlag("outPSLWithName");
+        batchSize = optionsParser.getOption<hal_size_t>("batchSize");
+        numThreads = optionsParser.getOption<size_t>("numThreads");
+        if (numThreads < 1) {
+            throw hal_exception("--numThreads must be at least 1");
+        }
+        unordered = optionsParser.getFlag("unordered");
     } catch (exception &e) {
         cerr << e.what() << endl;
         optionsParser.printUsage(cerr);
@@ -92,6 +110,10 @@ int main(int argc, char **argv) {
         if (alignment->getNumGenomes() == 0) {
             throw hal_exception("hal alignment is empty");
         }
+        if ((numThreads > 1) and (alignment->getStorageFormat() != STORAGE_FORMAT_MMAP)) {
+            // worker threads share the alignment, which is only safe for mmap
+            throw hal_exception("--numThreads greater than 1 requires a HAL file in " + STORAGE_FORMAT_MMAP + " format");
+        }
 
         const Genome *srcGenome = alignment->openGenome(srcGenomeName);
         if (srcGenome == NULL) {
@@ -136,6 +158,8 @@ int main(int argc, char **argv) {
         }
 
         BlockLiftover liftover;
+        liftover.setBatchSize(batchSize);
+        liftover.setNumThreads(numThreads, unordered);
         liftover.convert(alignment, srcGenome, srcBedPtr, tgtGenome, tgtBedPtr, bedType,
                          !noDupes, outPSL, outPSLWithName, coalescenceLimit);
 
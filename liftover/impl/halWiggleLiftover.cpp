@@ -50,7 +50,9 @@ void WiggleLiftover::convert(AlignmentConstPtr alignment, const Genome *srcGenom
     set<const Genome *> inputSet;
     inputSet.insert(_srcGenome);
     inputSet.insert(_tgtGenome);
-    getGenomesInSpanningTree(inputSet, _tgtSet);
+    set<const Genome *> tgtSet;
+    getGenomesInSpanningTree(inputSet, tgtSet);
+    _mapper.reset(new SegmentMapper(_srcGenome, _tgtGenome, &tgtSet, _traverseDupes));
     // if not init'd by preload()...
     if (_outVals.getGenomeSize() == 0) {
         _outVals.init(tgtGenome->getSequenceLength(), DefaultValue, DefaultTileSize);
@@ -121,7 +123,7 @@ void WiggleLiftover::mapSegment() {
 
     _mappedSegments.clear();
     while (_segment->getArrayIndex() < _lastIndex && _segment->getStartPosition() <= (_cvals.back()._last)) {
-        halMapSegment(_segment.get(), _mappedSegments, _tgtGenome, &_tgtSet, _traverseDupes);
+        _mapper->map(_segment.get(), _mappedSegments);
         _segment->toRight(_cvals.back()._last);
     }
 
@@ -130,7 +132,7 @@ void WiggleLiftover::mapSegment() {
     set<hal_index_t> queryCutSet;
     set<hal_index_t> targetCutSet;
 
-    for (std::set<MappedSegmentPtr>::iterator i = _mappedSegments.begin(); i != _mappedSegments.end(); ++i) {
+    for (MappedSegmentSet::iterator i = _mappedSegments.begin(); i != _mappedSegments.end(); ++i) {
         BlockMapper::extractSegment(i, emptySet, fragments, &_mappedSegments, targetCutSet, queryCutSet);
         mapFragments(fragments);
     }
@@ -9,8 +9,10 @@
 #define _HALBLOCKLIFTOVER_H
 
 #include "halLiftover.h"
+#include "halSegmentMapper.h"
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -22,9 +24,15 @@ namespace hal {
         virtual ~BlockLiftover();
 
       protected:
+        Liftover *createWorker() const {
+            return new BlockLiftover();
+        }
+
         void liftInterval(BedList &mappedBedLines);
         void visitBegin();
 
+        void mapInterval(hal_index_t globalStart, hal_index_t globalEnd, bool flip);
+
         void cleanTargetParalogies();
         void readPSLInfo(std::vector<MappedSegmentPtr> &fragments, BedLine &outBedLine);
 
@@ -32,8 +40,8 @@ namespace hal {
         MappedSegmentSet _mappedSegments;
         SegmentIteratorPtr _refSeg;
         hal_index_t _lastIndex;
-        std::set<const Genome *> _downwardPath;
-        const Genome *_mrca;
+        std::unique_ptr<SegmentMapper> _mapper;
+        SegmentMapperCache _mapperCache;
     };
 }
 #endif
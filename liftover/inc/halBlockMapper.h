@@ -12,6 +12,7 @@
 #include "halMappedSegmentContainers.h"
 #include <iostream>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -56,8 +57,8 @@ namespace hal {
       protected:
         MappedSegmentSet _segSet;
         MappedSegmentSet _adjSet;
-        std::set<const Genome *> _downwardPath;
-        std::set<const Genome *> _upwardPath;
+        std::unique_ptr<SegmentMapper> _downMapper;
+        std::unique_ptr<SegmentMapper> _upMapper;
         const Genome *_refGenome;
         const Sequence *_refSequence;
         const Genome *_queryGenome;
@@ -22,6 +22,9 @@ namespace hal {
         virtual ~ColumnLiftover();
 
       protected:
+        Liftover *createWorker() const {
+            return new ColumnLiftover();
+        }
         void liftInterval(BedList &mappedBedLines);
 
         typedef ColumnIterator::DNASet DNASet;
@@ -27,12 +27,56 @@ namespace hal {
                      bool traverseDupes = true, bool outPSL = false, bool outPSLWithName = false,
                      const Genome *coalescenceLimit = NULL);
 
+        /** Lift records in batches of up to batchSize lines.  Each batch is
+         * sorted by source position so that neighbouring records can share
+         * work, and the results are written in input order.  0 lifts each
+         * record as it is read. */
+        void setBatchSize(hal_size_t batchSize) {
+            _batchSize = batchSize;
+        }
+
+        /** Lift records with this many threads.  The input is read in chunks
+         * (of the batch size if set) that are lifted by worker objects sharing
+         * the alignment, so the alignment must be thread-safe (mmap).  Results
+         * are written in input order unless unordered is set, in which case
+         * each chunk is written as soon as it is done. */
+        void setNumThreads(size_t numThreads, bool unordered = false) {
+            _numThreads = numThreads;
+            _unordered = unordered;
+        }
+
       protected:
         typedef std::list<BedLine> BedList;
 
+        /** A record waiting to be lifted as part of a batch */
+        struct BatchLine {
+            BedLine _bedLine;
+            hal_size_t _lineNumber;
+            hal_index_t _srcPosition;
+            std::string _output;
+        };
+        struct BatchLinePLess {
+            bool operator()(const BatchLine *b1, const BatchLine *b2) const {
+                return b1->_srcPosition < b2->_srcPosition;
+            }
+        };
+
+        // chunk of input lifted by a worker and the queue of chunks shared with
+        // the worker threads
+        struct Chunk;
+        struct ChunkQueue;
+
+        static const hal_size_t defaultChunkSize;
+
         virtual void visitBegin();
         virtual void visitLine();
         virtual void visitEOF();
+        virtual Liftover *createWorker() const = 0;
+        virtual void initWorker(const Liftover &liftover);
+        virtual void convertThreaded(std::istream *inBedStream, int bedType);
+        virtual void liftChunks(ChunkQueue &queue);
+        virtual void liftLine();
+        virtual void liftBatch();
         virtual void writeLineResults();
         virtual void assignBlocksToIntervals();
         virtual bool compatible(const BedLine &tgtBed, const BedLine &newBlock);
@@ -62,6 +106,13 @@ namespace hal {
 
         ColumnIteratorPtr _colIt;
         std::set<std::string> _missedSet;
+
+        hal_size_t _batchSize;
+        std::vector<BatchLine> _batch;
+
+        size_t _numThreads;
+        bool _unordered;
+        ChunkQueue *_chunkQueue;
     };
 }
 #endif
@@ -12,6 +12,7 @@
 #include "halWiggleTiles.h"
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -56,7 +57,7 @@ namespace hal {
         const Genome *_srcGenome;
         const Genome *_tgtGenome;
         const Sequence *_srcSequence;
-        std::set<const Genome *> _tgtSet;
+        std::unique_ptr<SegmentMapper> _mapper;
         MappedSegmentSet _mappedSegments;
         hal_index_t _lastIndex;
 
@@ -119,6 +119,7 @@ AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength, bool needDNA)
         --mapIt;
     }
     assert(mapIt->first <= queryLength);
+    lock_guard<mutex> lock(_mutex);
     AlignmentConstPtr &alignment = mapIt->second.second;
     if (mapIt->first == _maxLodLowerBound) {
         throw hal_exception("Query length " + std::to_string(queryLength) + " above maximum LOD size of " +
@@ -132,6 +133,29 @@ AlignmentConstPtr LodManager::getAlignment(hal_size_t queryLength, bool needDNA)
     return alignment;
 }
 
+bool LodManager::isShareable() const {
+    for (AlignmentMap::const_iterator mapIt = _map.begin(); mapIt != _map.end(); ++mapIt) {
+        const string &path = mapIt->second.first;
+        if (path == MaxLodToken) {
+            continue;
+        }
+        string format;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (mapIt->second.second.get() != NULL) {
+                format = mapIt->second.second->getStorageFormat();
+            }
+        }
+        if (format.empty()) {
+            format = detectHalAlignmentFormat(path, _options);
+        }
+        if (format != STORAGE_FORMAT_MMAP) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool LodManager::isLod0(hal_size_t queryLength) const {
     assert(_map.size() > 0);
     AlignmentMap::const_iterator mapIt = _map.upper_bound(queryLength);
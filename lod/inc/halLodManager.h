@@ -11,6 +11,7 @@
 #include "hal.h"
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <vector>
@@ -40,8 +41,14 @@ namespace hal {
          * lodFile containing only "0 halPath"*/
         void loadSingeHALFile(const std::string &halPath, const CLParser *options = NULL);
 
+        /** Get the alignment for a query, opening it if needed.  May be
+         * called from multiple threads. */
         AlignmentConstPtr getAlignment(hal_size_t queryLength, bool needDNA);
 
+        /** Check if all the alignments can be shared between threads (are
+         * mmap files).  Reads the start of the files not yet opened. */
+        bool isShareable() const;
+
         /** Check if query length corresponds to LOD 0 (ie original HAL) */
         bool isLod0(hal_size_t queryLenth) const;
 
@@ -67,6 +74,8 @@ namespace hal {
         const CLParser *_options;
         AlignmentMap _map;
         hal_size_t _maxLodLowerBound;
+        // guards opening the alignments in _map
+        mutable std::mutex _mutex;
     };
 
     inline hal_size_t LodManager::getMaxQueryLength() const {
@@ -63,6 +63,15 @@ static void initParser(CLParser &optionsParser) {
                                 false);
     optionsParser.addOptionFlag("keepEmptyRefBlocks", "keep blocks that contain no reference sequence",
                                 false);
+    optionsParser.addOption("numThreads", "number of threads used to convert reference sequences in parallel. "
+                                          "Output is identical to a single-threaded run.  Requires a mmap format "
+                                          "HAL file and is not supported with --global or --refTargets",
+                            1);
+    optionsParser.addOption("shardLength", "with --numThreads, also split reference sequences into pieces of at most "
+                                           "this many bases that are converted in parallel.  MAF blocks are broken at "
+                                           "piece boundaries, so the output will differ from a run without this option "
+                                           "(0 to only split by sequence)",
+                            0);
 
     optionsParser.setDescription("Convert hal database to maf.");
 }
@@ -90,6 +99,8 @@ class MafOptions {
     bool onlyOrthologs;
     bool keepEmptyRefBlocks;
     hal_index_t maxBlockLen;
+    size_t numThreads;
+    hal_size_t shardLength;
 };
 
 /* This empty string options specified using the old convention of '""' rather than
@@ -192,17 +203,29 @@ static void hal2maf(AlignmentConstPtr alignment, const MafOptions &opts) {
     mafExport.setPrintTree(opts.printTree);
     mafExport.setOnlyOrthologs(opts.onlyOrthologs);
     mafExport.setKeepEmptyRefBlocks(opts.keepEmptyRefBlocks);
+    mafExport.setNumThreads(opts.numThreads);
+    mafExport.setShardLength(opts.shardLength);
+    if ((opts.numThreads > 1) and (alignment->getStorageFormat() != STORAGE_FORMAT_MMAP)) {
+        // worker threads share the alignment, which is only safe for mmap
+        throw hal_exception("--numThreads greater than 1 requires a HAL file in " + STORAGE_FORMAT_MMAP + " format");
+    }
 
     if (opts.refTargetsPath != "") {
         hal2mafWithTargets(opts, alignment, refGenome, targetSet, mafExport, mafStream);
     } else if (opts.global) {
         mafExport.convertEntireAlignment(mafStream, alignment);
-    } else if (refSequence != NULL) {
-        mafExport.convertSequence(mafStream, alignment, refSequence, opts.start, opts.length, targetSet);
     } else {
-        for (SequenceIteratorPtr seqIt(refGenome->getSequenceIterator()); not seqIt->atEnd(); seqIt->toNext()) {
-            mafExport.convertSequence(mafStream, alignment, seqIt->getSequence(), opts.start, opts.length, targetSet);
+        vector<const Sequence *> refSequences;
+        if (refSequence != NULL) {
+            refSequences.push_back(refSequence);
+        } else {
+            // sequence objects returned by the iterator don't outlive it, so get the ones
+            // owned by the genome
+            for (SequenceIteratorPtr seqIt(refGenome->getSequenceIterator()); not seqIt->atEnd(); seqIt->toNext()) {
+                refSequences.push_back(refGenome->getSequence(seqIt->getSequence()->getName()));
+            }
         }
+        mafExport.convertSequences(mafStream, alignment, refSequences, opts.start, opts.length, targetSet);
     }
     if (opts.mafPath != "stdout") {
         // dont want to leave a size 0 file when there's not ouput because
@@ -242,6 +265,8 @@ int main(int argc, char **argv) {
         opts.maxBlockLen = optionsParser.getOption<hal_index_t>("maxBlockLen");
         opts.onlyOrthologs = optionsParser.getFlag("onlyOrthologs");
         opts.keepEmptyRefBlocks = optionsParser.getFlag("keepEmptyRefBlocks");
+        opts.numThreads = optionsParser.getOption<size_t>("numThreads");
+        opts.shardLength = optionsParser.getOption<hal_size_t>("shardLength");
 
         if (((opts.length != 0) || (opts.start != 0)) && (opts.refSequenceName == "")) {
             throw hal_exception("--start and --length require --refSequenceName");
@@ -254,6 +279,12 @@ int main(int argc, char **argv) {
             ((opts.start != 0) || (opts.length != 0) || (not opts.refSequenceName.empty()))) {
             throw hal_exception("--refSequence, --start, and --length options are unsupported when using BED input");
         }
+        if (opts.numThreads == 0) {
+            throw hal_exception("--numThreads must be at least 1");
+        }
+        if ((opts.numThreads > 1) and (opts.global or (not opts.refTargetsPath.empty()))) {
+            throw hal_exception("--numThreads is not supported with --global or --refTargets");
+        }
 
     } catch (exception &e) {
         cerr << e.what() << endl;
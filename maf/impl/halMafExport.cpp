@@ -6,8 +6,14 @@
  */
 
 #include "halMafExport.h"
+#include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <deque>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace hal;
@@ -21,8 +27,9 @@ void MafExport::writeHeader() {
     }
 }
 
-void MafExport::convertSequence(ostream &mafStream, AlignmentConstPtr alignment, const Sequence *seq, hal_index_t startPosition,
-                                hal_size_t length, const set<const Genome *> &targets) {
+/* validate a range of a sequence and return the last position in it, length of
+ * zero indicates the rest of the sequence */
+hal_index_t MafExport::checkRange(const Sequence *seq, hal_index_t startPosition, hal_size_t length) const {
     assert(seq != NULL);
     if (startPosition >= (hal_index_t)seq->getSequenceLength() ||
         (hal_size_t)startPosition + length > seq->getSequenceLength()) {
@@ -34,14 +41,25 @@ void MafExport::convertSequence(ostream &mafStream, AlignmentConstPtr alignment,
     if (length == 0) {
         throw hal_exception("Cannot convert zero length sequence");
     }
-    hal_index_t lastPosition = startPosition + (hal_index_t)(length - 1);
+    return startPosition + (hal_index_t)(length - 1);
+}
+
+void MafExport::convertSequence(ostream &mafStream, AlignmentConstPtr alignment, const Sequence *seq, hal_index_t startPosition,
+                                hal_size_t length, const set<const Genome *> &targets) {
+    hal_index_t lastPosition = checkRange(seq, startPosition, length);
 
     _mafStream = &mafStream;
     _alignment = alignment;
     if (!_append) {
         writeHeader();
     }
+    convertRange(mafStream, _mafBlock, seq, startPosition, lastPosition, targets);
+}
 
+/* convert one range of a sequence using the specified block, which allows
+ * worker threads to each have their own */
+void MafExport::convertRange(ostream &mafStream, MafBlock &mafBlock, const Sequence *seq, hal_index_t startPosition,
+                             hal_index_t lastPosition, const set<const Genome *> &targets) const {
     ColumnIteratorPtr colIt = seq->getColumnIterator(&targets, _maxRefGap, startPosition, lastPosition, _noDupes, _noAncestors,
                                                      false, // reverseStrand,
                                                      true,  // unique
@@ -49,9 +67,9 @@ void MafExport::convertSequence(ostream &mafStream, AlignmentConstPtr alignment,
 
     hal_size_t appendCount = 0;
     if (_unique == false || colIt->isCanonicalOnRef() == true) {
-        _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-        assert(_mafBlock.canAppendColumn(colIt) == true);
-        _mafBlock.appendColumn(colIt);
+        mafBlock.initBlock(colIt, _ucscNames, _printTree);
+        assert(mafBlock.canAppendColumn(colIt) == true);
+        mafBlock.appendColumn(colIt);
         ++appendCount;
     }
     size_t numBlocks = 0;
@@ -59,30 +77,171 @@ void MafExport::convertSequence(ostream &mafStream, AlignmentConstPtr alignment,
         colIt->toRight();
         if (_unique == false || colIt->isCanonicalOnRef() == true) {
             if (appendCount == 0) {
-                _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-                assert(_mafBlock.canAppendColumn(colIt) == true);
+                mafBlock.initBlock(colIt, _ucscNames, _printTree);
+                assert(mafBlock.canAppendColumn(colIt) == true);
             }
-            if (_mafBlock.canAppendColumn(colIt) == false) {
+            if (mafBlock.canAppendColumn(colIt) == false) {
                 // erase empty entries from the column.  helps when there are
                 // millions of sequences (ie from fastas with lots of scaffolds)
                 if (numBlocks++ % 1000 == 0) {
                     colIt->defragment();
                 }
-                if ((appendCount > 0) and (_keepEmptyRefBlocks or (not _mafBlock.referenceIsAllGaps()))) {
-                    mafStream << _mafBlock << '\n';
+                if ((appendCount > 0) and (_keepEmptyRefBlocks or (not mafBlock.referenceIsAllGaps()))) {
+                    mafStream << mafBlock << '\n';
                 }
-                _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-                assert(_mafBlock.canAppendColumn(colIt) == true);
+                mafBlock.initBlock(colIt, _ucscNames, _printTree);
+                assert(mafBlock.canAppendColumn(colIt) == true);
             }
-            _mafBlock.appendColumn(colIt);
+            mafBlock.appendColumn(colIt);
             ++appendCount;
         }
     }
     // if nothing was ever added (seems to happen in corner case where
     // all columns violate unique), mafBlock ostream operator will crash
     // so we do following check
-    if ((appendCount > 0) and (_keepEmptyRefBlocks or (not _mafBlock.referenceIsAllGaps()))) {
-        mafStream << _mafBlock << endl;
+    if ((appendCount > 0) and (_keepEmptyRefBlocks or (not mafBlock.referenceIsAllGaps()))) {
+        mafStream << mafBlock << endl;
+    }
+}
+
+void MafExport::convertSequences(ostream &mafStream, AlignmentConstPtr alignment, const vector<const Sequence *> &sequences,
+                                 hal_index_t startPosition, hal_size_t length, const set<const Genome *> &targets) {
+    // validate everything up front so errors are reported the same way
+    // regardless of the number of threads
+    vector<MafExportShard> shards;
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        hal_index_t lastPosition = checkRange(sequences[i], startPosition, length);
+        hal_index_t shardStart = startPosition;
+        while (shardStart <= lastPosition) {
+            hal_index_t shardLast = lastPosition;
+            if ((_shardLength > 0) and ((hal_size_t)(lastPosition - shardStart) >= _shardLength)) {
+                shardLast = shardStart + (hal_index_t)_shardLength - 1;
+            }
+            shards.push_back({sequences[i], shardStart, shardLast});
+            shardStart = shardLast + 1;
+        }
+    }
+
+    _mafStream = &mafStream;
+    _alignment = alignment;
+    if (!_append) {
+        writeHeader();
+    }
+    if ((_numThreads <= 1) or (shards.size() <= 1)) {
+        for (size_t i = 0; i < shards.size(); ++i) {
+            convertRange(mafStream, _mafBlock, shards[i]._sequence, shards[i]._startPosition, shards[i]._lastPosition,
+                         targets);
+        }
+    } else {
+        convertShards(mafStream, shards, targets);
+    }
+}
+
+/* Shards are handed out to the workers in reference order and their MAF text
+ * is passed back to the writer, which outputs them in the same order.  Workers
+ * don't get more than a window of shards ahead of the writer to bound the
+ * amount of buffered output. */
+struct MafExport::ShardQueue {
+    ShardQueue(size_t numShards, size_t window)
+        : _results(numShards), _done(numShards, false), _nextShard(0), _nextWrite(0), _window(window), _failed(false) {
+    }
+
+    /* get the next shard to convert, or false if there are no more or the
+     * conversion has failed */
+    bool next(size_t &shardIndex) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.wait(lock, [this] { return _failed or (_nextShard >= _results.size()) or (_nextShard < _nextWrite + _window); });
+        if (_failed or (_nextShard >= _results.size())) {
+            return false;
+        }
+        shardIndex = _nextShard++;
+        return true;
+    }
+
+    void put(size_t shardIndex, const std::string &mafText) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _results[shardIndex] = mafText;
+        _done[shardIndex] = true;
+        _cond.notify_all();
+    }
+
+    /* record the first exception thrown by a worker and stop the others */
+    void fail(std::exception_ptr error) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (not _failed) {
+            _error = error;
+            _failed = true;
+        }
+        _cond.notify_all();
+    }
+
+    /* write shards to the stream in order as they become available */
+    void write(ostream &mafStream) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_nextWrite < _results.size()) {
+            _cond.wait(lock, [this] { return _failed or _done[_nextWrite]; });
+            if (_failed) {
+                return;
+            }
+            std::string mafText;
+            mafText.swap(_results[_nextWrite]);
+            _nextWrite++;
+            _cond.notify_all();
+            lock.unlock();
+            mafStream << mafText;
+            lock.lock();
+        }
+    }
+
+    std::vector<std::string> _results;
+    std::vector<bool> _done;
+    size_t _nextShard;
+    size_t _nextWrite;
+    size_t _window;
+    bool _failed;
+    std::exception_ptr _error;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+};
+
+/* Convert shards with the worker threads */
+void MafExport::convertShards(ostream &mafStream, const vector<MafExportShard> &shards, const set<const Genome *> &targets) {
+    size_t numWorkers = min(_numThreads, shards.size());
+    ShardQueue queue(shards.size(), 4 * numWorkers);
+    vector<std::thread> workers;
+    for (size_t w = 0; w < numWorkers; ++w) {
+        workers.push_back(
+            std::thread(&MafExport::convertShardsWorker, this, std::ref(queue), std::cref(shards), std::cref(targets)));
+    }
+    try {
+        queue.write(mafStream);
+    } catch (...) {
+        queue.fail(std::current_exception());
+    }
+    for (size_t w = 0; w < workers.size(); ++w) {
+        workers[w].join();
+    }
+    if (queue._failed) {
+        std::rethrow_exception(queue._error);
+    }
+    mafStream.flush();
+}
+
+/* Worker thread body.  The workers share the (read-only) alignment, but each
+ * uses its own column iterator and block */
+void MafExport::convertShardsWorker(ShardQueue &queue, const vector<MafExportShard> &shards,
+                                    const set<const Genome *> &targets) const {
+    try {
+        MafBlock mafBlock(_mafBlock.getMaxLength());
+        size_t shardIndex;
+        while (queue.next(shardIndex)) {
+            const MafExportShard &shard = shards[shardIndex];
+            ostringstream mafText;
+            convertRange(mafText, mafBlock, shard._sequence, shard._startPosition, shard._lastPosition, targets);
+            queue.put(shardIndex, mafText.str());
+        }
+    } catch (...) {
+        queue.fail(std::current_exception());
     }
 }
 
@@ -133,6 +133,10 @@ namespace hal {
             _maxLength = maxLen;
         }
 
+        inline hal_index_t getMaxLength() const {
+            return _maxLength;
+        }
+
         bool referenceIsAllGaps() const {
             return (_reference != NULL) and (_reference->allGaps());
         }
@@ -16,12 +16,19 @@
 
 namespace hal {
 
+    /* A range of a reference sequence that is converted independently of the others */
+    struct MafExportShard {
+        const Sequence *_sequence;
+        hal_index_t _startPosition;
+        hal_index_t _lastPosition;
+    };
+
     class MafExport {
       public:
         MafExport():
             _mafStream(NULL), _maxRefGap(0), _noDupes(false), _noAncestors(false),
             _ucscNames(false), _unique(false), _append(false), _printTree(false),
-            _onlyOrthologs(false), _keepEmptyRefBlocks(false) {
+            _onlyOrthologs(false), _keepEmptyRefBlocks(false), _numThreads(1), _shardLength(0) {
         }
         
         virtual ~MafExport() {
@@ -30,6 +37,16 @@ namespace hal {
         void convertSequence(std::ostream &mafStream, AlignmentConstPtr alignment, const Sequence *seq,
                              hal_index_t startPosition, hal_size_t length, const std::set<const Genome *> &targets);
 
+        // Convert the same range of each of a list of reference sequences,
+        // as if convertSequence was called on each one in turn.  If more than
+        // one thread is set, the sequences (or shards of them, see
+        // setShardLength) are converted concurrently and the blocks are
+        // written back in reference order, so the output is identical to a
+        // serial run as long as no shard length is set.
+        void convertSequences(std::ostream &mafStream, AlignmentConstPtr alignment,
+                              const std::vector<const Sequence *> &sequences, hal_index_t startPosition,
+                              hal_size_t length, const std::set<const Genome *> &targets);
+
         // Convert all columns in the leaf genomes to MAF. Each column is
         // reported exactly once regardless of the unique setting, although
         // this may change in the future. Likewise, maxRefGap has no
@@ -66,9 +83,28 @@ namespace hal {
         void setKeepEmptyRefBlocks(bool keepEmptyRefBlocks) {
             _keepEmptyRefBlocks = keepEmptyRefBlocks;
         }
+        void setNumThreads(size_t numThreads) {
+            _numThreads = numThreads;
+        }
+        // Split reference sequences into shards of at most this many bases
+        // for convertSequences.  Blocks are always broken at shard
+        // boundaries. 0 converts each sequence as a single shard.
+        void setShardLength(hal_size_t shardLength) {
+            _shardLength = shardLength;
+        }
 
       protected:
+        // ordered output queue shared by the worker threads in convertShards
+        struct ShardQueue;
+
         void writeHeader();
+        hal_index_t checkRange(const Sequence *seq, hal_index_t startPosition, hal_size_t length) const;
+        void convertRange(std::ostream &mafStream, MafBlock &mafBlock, const Sequence *seq, hal_index_t startPosition,
+                          hal_index_t lastPosition, const std::set<const Genome *> &targets) const;
+        void convertShards(std::ostream &mafStream, const std::vector<MafExportShard> &shards,
+                           const std::set<const Genome *> &targets);
+        void convertShardsWorker(ShardQueue &queue, const std::vector<MafExportShard> &shards,
+                                 const std::set<const Genome *> &targets) const;
 
       protected:
         AlignmentConstPtr _alignment;
@@ -83,6 +119,8 @@ namespace hal {
         bool _printTree;
         bool _onlyOrthologs;
         bool _keepEmptyRefBlocks;
+        size_t _numThreads;
+        hal_size_t _shardLength;
     };
 }
 
@@ -45,6 +45,13 @@ int main(int argc, char **argv) {
 
     hal_size_t maxDepth = 0;
 
+    // the paths from the reference to each leaf are worked out once, rather
+    // than for every sample
+    vector<SegmentMapper> mappers;
+    for (size_t j = 0; j < leafGenomes.size(); j++) {
+        mappers.push_back(SegmentMapper(ref, leafGenomes[j]));
+    }
+
     for (hal_size_t i = 0; i < numSamples; i++) {
         // Sample (with replacement) a random position in the reference genome.
         hal_index_t pos = st_randomInt64(0, ref->getSequenceLength());
@@ -54,7 +61,7 @@ int main(int argc, char **argv) {
         for (size_t j = 0; j < leafGenomes.size(); j++) {
             const Genome *leafGenome = leafGenomes[j];
             MappedSegmentSet segments;
-            halMapSegmentSP(refSeg, segments, leafGenome, NULL, true, 0, NULL, NULL);
+            mappers[j].map(refSeg, segments);
             vector<hal_size_t> &histogram = coverage[leafGenome];
             hal_size_t depth = segments.size();
             if (depth > maxDepth) {
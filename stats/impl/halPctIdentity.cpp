@@ -44,6 +44,13 @@ int main(int argc, char **argv) {
         idStats.insert(make_pair(leafGenomes[i], make_pair(0, 0)));
     }
 
+    // the paths from the reference to each leaf are worked out once, rather
+    // than for every sample
+    vector<SegmentMapper> mappers;
+    for (size_t j = 0; j < leafGenomes.size(); j++) {
+        mappers.push_back(SegmentMapper(ref, leafGenomes[j]));
+    }
+
     for (hal_size_t i = 0; i < numSamples; i++) {
         // Sample (with replacement) a random position in the reference genome.
         hal_index_t pos = st_randomInt64(0, ref->getSequenceLength());
@@ -59,7 +66,7 @@ int main(int argc, char **argv) {
         for (size_t j = 0; j < leafGenomes.size(); j++) {
             const Genome *leafGenome = leafGenomes[j];
             MappedSegmentSet segments;
-            halMapSegmentSP(refSeg, segments, leafGenome, NULL, true, 0, NULL, NULL);
+            mappers[j].map(refSeg, segments);
             if (segments.size() == 1) {
                 auto i = segments.begin();
                 string tgtString;
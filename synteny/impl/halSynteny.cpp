@@ -85,7 +85,7 @@ static void syntenyBlockForChrom(AlignmentConstPtr alignment,
                                  const Genome *targetGenome, const Genome *queryGenome,
                                  std::string queryChromosome, hal_size_t minBlockSize,
                                  hal_size_t maxAnchorDistance, std::ofstream &pslFh) {
-    auto hal2psl = hal::Hal2Psl();
+    hal::Hal2Psl hal2psl;
     auto blocks = hal2psl.convert2psl(alignment, queryGenome, targetGenome, queryChromosome);
     makeSyntenyBlocks(blocks, minBlockSize, maxAnchorDistance, pslFh);
 }